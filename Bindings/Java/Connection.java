@@ -20,6 +20,7 @@
 package org.a11y.brlapi;
 
 import java.io.InterruptedIOException;
+import java.nio.ByteBuffer;
 
 public class Connection extends ConnectionBase {
   public Connection (ConnectionSettings settings) throws ConnectException {
@@ -68,6 +69,16 @@ public class Connection extends ConnectionBase {
     writeDots(dots);
   }
 
+  public void write (ByteBuffer dots) {
+    if (dots.isDirect()) {
+      writeDirectDots(dots, dots.position());
+    } else {
+      byte[] array = new byte[dots.remaining()];
+      dots.duplicate().get(array);
+      write(array);
+    }
+  }
+
   public void write (int cursor, String text) {
     if (text != null) {
       int count = getCellCount();
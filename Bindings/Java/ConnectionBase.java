@@ -23,6 +23,7 @@ import java.util.Map;
 import java.util.HashMap;
 
 import java.io.InterruptedIOException;
+import java.nio.ByteBuffer;
 import java.util.concurrent.TimeoutException;
 
 public class ConnectionBase extends NativeComponent implements AutoCloseable {
@@ -108,10 +109,15 @@ public class ConnectionBase extends NativeComponent implements AutoCloseable {
 
   protected native void writeText (int cursor, String text);
   protected native void writeDots (byte[] dots);
+  protected native void writeDirectDots (ByteBuffer dots, int offset);
   public native void write (WriteArguments arguments);
 
   public native Long readKey (boolean wait) throws InterruptedIOException;
 
+  // the buffer must be direct - the key codes are stored in native byte order
+  public native int readKeys (boolean wait, ByteBuffer keys)
+         throws InterruptedIOException;
+
   public native long readKeyWithTimeout (int milliseconds)
          throws InterruptedIOException, TimeoutException;
 
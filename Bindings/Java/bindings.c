@@ -27,24 +27,6 @@
 
 #include "bindings.h"
 
-#define NEW_PRIMITIVE_WRAPPER(name, type, sig) \
-static jobject \
-new##name (JNIEnv *env, type value) { \
-  static JAVA_CLASS_VARIABLE(class); \
-  static JAVA_METHOD_VARIABLE(constructor); \
-  \
-  if (!javaFindClassAndMethod( \
-    env, \
-    &class, JAVA_OBJ_LANG(#name), \
-    &constructor, JAVA_CONSTRUCTOR_NAME, \
-    JAVA_SIG_CONSTRUCTOR(JAVA_SIG_##sig) \
-  )) return NULL; \
-  \
-  return (*env)->NewObject(env, class, constructor, value); \
-}
-
-NEW_PRIMITIVE_WRAPPER(Long, jlong, LONG)
-
 #define BRLAPI_NO_DEPRECATED
 #define BRLAPI_NO_SINGLE_SESSION
 #include "brlapi.h"
@@ -55,11 +37,159 @@ static int libraryVersion_major = 0;
 static int libraryVersion_minor = 0;
 static int libraryVersion_revision = 0;
 
+// Resolved once when the library is loaded so that the frequently called
+// methods don't need to look them up each time. The class references are
+// global so that they remain valid across calls. They're released when the
+// class loader which loaded the library (and, therefore, these classes)
+// goes away.
+static struct {
+  unsigned char resolved:1;
+
+  struct {
+    jclass class;
+    jmethodID constructor;
+  } Long;
+
+  struct {
+    jfieldID connectionHandle;
+  } ConnectionBase;
+
+  struct {
+    jclass class;
+    jmethodID constructor;
+  } DisplaySize;
+
+  struct {
+    jfieldID displayNumber;
+    jfieldID regionBegin;
+    jfieldID regionSize;
+    jfieldID text;
+    jfieldID andMask;
+    jfieldID orMask;
+    jfieldID cursorPosition;
+  } WriteArguments;
+} javaIdentifiers;
+
+static jclass
+newGlobalClass (JNIEnv *env, const char *name) {
+  jclass class = (*env)->FindClass(env, name);
+  if (!class) return NULL;
+
+  jclass global = (*env)->NewGlobalRef(env, class);
+  (*env)->DeleteLocalRef(env, class);
+  return global;
+}
+
+static void
+releaseJavaIdentifiers (JNIEnv *env) {
+  if (javaIdentifiers.Long.class) {
+    (*env)->DeleteGlobalRef(env, javaIdentifiers.Long.class);
+  }
+
+  if (javaIdentifiers.DisplaySize.class) {
+    (*env)->DeleteGlobalRef(env, javaIdentifiers.DisplaySize.class);
+  }
+
+  memset(&javaIdentifiers, 0, sizeof(javaIdentifiers));
+}
+
+static int
+findJavaField (JNIEnv *env, jfieldID *field, jclass class, const char *name, const char *signature) {
+  return !!(*field = (*env)->GetFieldID(env, class, name, signature));
+}
+
+static int
+resolveJavaIdentifiers (JNIEnv *env) {
+  {
+    jclass class = newGlobalClass(env, JAVA_OBJ_LANG("Long"));
+    if (!(javaIdentifiers.Long.class = class)) return 0;
+
+    if (!(javaIdentifiers.Long.constructor = JAVA_GET_CONSTRUCTOR(env, class,
+      JAVA_SIG_LONG // value
+    ))) return 0;
+  }
+
+  {
+    jclass class = (*env)->FindClass(env, BRLAPI_OBJECT("ConnectionBase"));
+    if (!class) return 0;
+
+    int ok = findJavaField(env, &javaIdentifiers.ConnectionBase.connectionHandle, class, "connectionHandle", JAVA_SIG_LONG);
+    (*env)->DeleteLocalRef(env, class);
+    if (!ok) return 0;
+  }
+
+  {
+    jclass class = newGlobalClass(env, BRLAPI_OBJECT("DisplaySize"));
+    if (!(javaIdentifiers.DisplaySize.class = class)) return 0;
+
+    if (!(javaIdentifiers.DisplaySize.constructor = JAVA_GET_CONSTRUCTOR(env, class,
+      JAVA_SIG_INT // width
+      JAVA_SIG_INT // height
+    ))) return 0;
+  }
+
+  {
+    jclass class = (*env)->FindClass(env, BRLAPI_OBJECT("WriteArguments"));
+    if (!class) return 0;
+
+    int ok = findJavaField(env, &javaIdentifiers.WriteArguments.displayNumber, class, "displayNumber", JAVA_SIG_INT)
+          && findJavaField(env, &javaIdentifiers.WriteArguments.regionBegin, class, "regionBegin", JAVA_SIG_INT)
+          && findJavaField(env, &javaIdentifiers.WriteArguments.regionSize, class, "regionSize", JAVA_SIG_INT)
+          && findJavaField(env, &javaIdentifiers.WriteArguments.text, class, "text", JAVA_SIG_STRING)
+          && findJavaField(env, &javaIdentifiers.WriteArguments.andMask, class, "andMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE))
+          && findJavaField(env, &javaIdentifiers.WriteArguments.orMask, class, "orMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE))
+          && findJavaField(env, &javaIdentifiers.WriteArguments.cursorPosition, class, "cursorPosition", JAVA_SIG_INT);
+
+    (*env)->DeleteLocalRef(env, class);
+    if (!ok) return 0;
+  }
+
+  javaIdentifiers.resolved = 1;
+  return 1;
+}
+
+JNIEXPORT void JNICALL
+JNI_OnUnload (JavaVM *vm, void *reserved) {
+  void *env;
+
+  if ((*vm)->GetEnv(vm, &env, JNI_VERSION_1_4) == JNI_OK) {
+    releaseJavaIdentifiers(env);
+  }
+}
+
+#define NEW_PRIMITIVE_WRAPPER(name, type, sig) \
+static jobject \
+new##name (JNIEnv *env, type value) { \
+  if (javaIdentifiers.resolved) { \
+    return (*env)->NewObject( \
+      env, javaIdentifiers.name.class, javaIdentifiers.name.constructor, value \
+    ); \
+  } \
+  \
+  jclass class = (*env)->FindClass(env, JAVA_OBJ_LANG(#name)); \
+  if (!class) return NULL; \
+  \
+  jmethodID constructor = JAVA_GET_CONSTRUCTOR( \
+    env, class, JAVA_SIG_##sig \
+  ); \
+  if (!constructor) return NULL; \
+  \
+  return (*env)->NewObject(env, class, constructor, value); \
+}
+
+NEW_PRIMITIVE_WRAPPER(Long, jlong, LONG)
+
 JAVA_STATIC_METHOD(
   org_a11y_brlapi_NativeComponent, initializeNativeData, void
 ) {
   jniVersion = (*env)->GetVersion(env);
 
+  if (!resolveJavaIdentifiers(env)) {
+    // fall back to looking them up when they're needed
+    (*env)->ExceptionClear(env);
+    releaseJavaIdentifiers(env);
+  }
+
   brlapi_getLibraryVersion(
     &libraryVersion_major,
     &libraryVersion_minor,
@@ -394,9 +524,28 @@ JAVA_STATIC_METHOD(
     if (!(field = (*(env))->GetFieldID((env), (class), (name), (signature)))) return ret; \
   } while (0)
 
+#define FIND_CACHED_FIELD(env, field, class, cached, name, signature, ret) \
+  jfieldID field = (cached); \
+  do { \
+    if (!field) { \
+      if (!(field = (*(env))->GetFieldID((env), (class), (name), (signature)))) return ret; \
+    } \
+  } while (0)
+
+static jfieldID
+getConnectionHandleField (JNIEnv *env, jobject object) {
+  if (javaIdentifiers.resolved) return javaIdentifiers.ConnectionBase.connectionHandle;
+
+  jclass class = (*env)->GetObjectClass(env, object);
+  if (!class) return NULL;
+  return (*env)->GetFieldID(env, class, "connectionHandle", JAVA_SIG_LONG);
+}
+
 #define FIND_CONNECTION_HANDLE(env, object, ret) \
-  GET_CLASS((env), class, (object), ret); \
-  FIND_FIELD((env), field, class, "connectionHandle", JAVA_SIG_LONG, ret);
+  jfieldID field; \
+  do { \
+    if (!(field = getConnectionHandleField((env), (object)))) return ret; \
+  } while (0)
 
 #define GET_CONNECTION_HANDLE(env, object, ret) \
   brlapi_handle_t *handle; \
@@ -598,14 +747,17 @@ JAVA_INSTANCE_METHOD(
     return NULL;
   }
 
-  jclass class = (*env)->FindClass(env, BRLAPI_OBJECT("DisplaySize"));
-  if (!class) return NULL;
+  jclass class = javaIdentifiers.DisplaySize.class;
+  jmethodID constructor = javaIdentifiers.DisplaySize.constructor;
 
-  jmethodID constructor = JAVA_GET_CONSTRUCTOR(env, class,
-    JAVA_SIG_INT // width
-    JAVA_SIG_INT // height
-  );
-  if (!constructor) return NULL;
+  if (!javaIdentifiers.resolved) {
+    if (!(class = (*env)->FindClass(env, BRLAPI_OBJECT("DisplaySize")))) return NULL;
+
+    if (!(constructor = JAVA_GET_CONSTRUCTOR(env, class,
+      JAVA_SIG_INT // width
+      JAVA_SIG_INT // height
+    ))) return NULL;
+  }
 
   jobject object = (*env)->NewObject(env, class, constructor, width, height);
   if (!object) return NULL;
@@ -745,6 +897,51 @@ JAVA_INSTANCE_METHOD(
   }
 }
 
+static unsigned char *
+getDirectBuffer (JNIEnv *env, jobject jBuffer, jlong *capacity) {
+  if (!jBuffer) {
+    throwJavaError(env, JAVA_OBJ_NULL_POINTER_EXCEPTION, __func__);
+    return NULL;
+  }
+
+  unsigned char *address = (*env)->GetDirectBufferAddress(env, jBuffer);
+
+  if (!address) {
+    throwJavaError(env, JAVA_OBJ_ILLEGAL_ARGUMENT_EXCEPTION, "not a direct buffer");
+    return NULL;
+  }
+
+  *capacity = (*env)->GetDirectBufferCapacity(env, jBuffer);
+  return address;
+}
+
+JAVA_INSTANCE_METHOD(
+  org_a11y_brlapi_ConnectionBase, writeDirectDots, void,
+  jobject jDots, jint offset
+) {
+  GET_CONNECTION_HANDLE(env, this, );
+
+  jlong capacity;
+  unsigned char *cDots = getDirectBuffer(env, jDots, &capacity);
+  if (!cDots) return;
+
+  unsigned int width, height;
+  if (brlapi__getDisplaySize(handle, &width, &height) < 0) {
+    throwAPIError(env);
+    return;
+  }
+
+  if ((offset < 0) || ((capacity - offset) < (width * height))) {
+    throwJavaError(env, JAVA_OBJ_ILLEGAL_ARGUMENT_EXCEPTION, "buffer too small");
+    return;
+  }
+
+  if (brlapi__writeDots(handle, &cDots[offset]) < 0) {
+    throwAPIError(env);
+    return;
+  }
+}
+
 JAVA_INSTANCE_METHOD(
   org_a11y_brlapi_ConnectionBase, write, void,
   jobject jArguments
@@ -755,27 +952,31 @@ JAVA_INSTANCE_METHOD(
   }
 
   GET_CONNECTION_HANDLE(env, this, );
-  GET_CLASS(env, class, jArguments, );
   brlapi_writeArguments_t cArguments = BRLAPI_WRITEARGUMENTS_INITIALIZER;
 
+  jclass class = NULL;
+  if (!javaIdentifiers.resolved) {
+    if (!(class = (*env)->GetObjectClass(env, jArguments))) return;
+  }
+
   {
-    FIND_FIELD(env, field, class, "displayNumber", JAVA_SIG_INT, );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.displayNumber, "displayNumber", JAVA_SIG_INT, );
     cArguments.displayNumber = JAVA_GET_FIELD(env, Int, jArguments, field);
   }
 
   {
-    FIND_FIELD(env, field, class, "regionBegin", JAVA_SIG_INT, );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.regionBegin, "regionBegin", JAVA_SIG_INT, );
     cArguments.regionBegin = JAVA_GET_FIELD(env, Int, jArguments, field);
   }
 
   {
-    FIND_FIELD(env, field, class, "regionSize", JAVA_SIG_INT, );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.regionSize, "regionSize", JAVA_SIG_INT, );
     cArguments.regionSize = JAVA_GET_FIELD(env, Int, jArguments, field);
   }
 
   jstring jText;
   {
-    FIND_FIELD(env, field, class, "text", JAVA_SIG_STRING, );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.text, "text", JAVA_SIG_STRING, );
 
     if ((jText = JAVA_GET_FIELD(env, Object, jArguments, field))) {
       cArguments.text = (char *) (*env)->GetStringUTFChars(env, jText, NULL);
@@ -787,7 +988,7 @@ JAVA_INSTANCE_METHOD(
 
   jbyteArray jAndMask;
   {
-    FIND_FIELD(env, field, class, "andMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE), );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.andMask, "andMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE), );
 
     if ((jAndMask = JAVA_GET_FIELD(env, Object, jArguments, field))) {
       cArguments.andMask = (unsigned char *) (*env)->GetByteArrayElements(env, jAndMask, NULL);
@@ -798,7 +999,7 @@ JAVA_INSTANCE_METHOD(
 
   jbyteArray jOrMask;
   {
-    FIND_FIELD(env, field, class, "orMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE), );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.orMask, "orMask", JAVA_SIG_ARRAY(JAVA_SIG_BYTE), );
 
     if ((jOrMask = JAVA_GET_FIELD(env, Object, jArguments, field))) {
       cArguments.orMask = (unsigned char *) (*env)->GetByteArrayElements(env, jOrMask, NULL);
@@ -808,7 +1009,7 @@ JAVA_INSTANCE_METHOD(
   }
 
   {
-    FIND_FIELD(env, field, class, "cursorPosition", JAVA_SIG_INT, );
+    FIND_CACHED_FIELD(env, field, class, javaIdentifiers.WriteArguments.cursorPosition, "cursorPosition", JAVA_SIG_INT, );
     cArguments.cursor = JAVA_GET_FIELD(env, Int, jArguments, field);
   }
 
@@ -835,6 +1036,38 @@ JAVA_INSTANCE_METHOD(
   return newLong(env, code);
 }
 
+JAVA_INSTANCE_METHOD(
+  org_a11y_brlapi_ConnectionBase, readKeys, jint,
+  jboolean jWait, jobject jKeys
+) {
+  GET_CONNECTION_HANDLE(env, this, -1);
+
+  jlong capacity;
+  unsigned char *cKeys = getDirectBuffer(env, jKeys, &capacity);
+  if (!cKeys) return -1;
+
+  brlapi_keyCode_t code;
+  jlong limit = capacity / sizeof(code);
+  int cWait = jWait != JNI_FALSE;
+  jint count = 0;
+
+  while (count < limit) {
+    int result = brlapi__readKey(handle, cWait, &code);
+
+    if (result < 0) {
+      // report it on the next call if some keys have already been read
+      if (!count) throwAPIError(env);
+      break;
+    }
+
+    if (!result) break;
+    memcpy(&cKeys[count++ * sizeof(code)], &code, sizeof(code));
+    cWait = 0;
+  }
+
+  return count;
+}
+
 JAVA_INSTANCE_METHOD(
   org_a11y_brlapi_ConnectionBase, readKeyWithTimeout, jlong,
   jint milliseconds
@@ -0,0 +1,307 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "hid_defs.h"
+#include "hid_braille.h"
+
+#include "brl_driver.h"
+#include "brldefs-hi.h"
+
+#define KEY_ENTRY(k,n) {.value = {.group=HI_GRP_NavigationKeys, .number=HI_KEY_##k}, .name=n}
+
+BEGIN_KEY_NAME_TABLE(keyboard)
+  KEY_ENTRY(Dot1, "Dot1"),
+  KEY_ENTRY(Dot2, "Dot2"),
+  KEY_ENTRY(Dot3, "Dot3"),
+  KEY_ENTRY(Dot4, "Dot4"),
+  KEY_ENTRY(Dot5, "Dot5"),
+  KEY_ENTRY(Dot6, "Dot6"),
+  KEY_ENTRY(Dot7, "Dot7"),
+  KEY_ENTRY(Dot8, "Dot8"),
+  KEY_ENTRY(Space, "Space"),
+  KEY_ENTRY(LeftSpace, "LeftSpace"),
+  KEY_ENTRY(RightSpace, "RightSpace"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLE(joystick)
+  KEY_ENTRY(JoystickCenter, "JoystickCenter"),
+  KEY_ENTRY(JoystickUp, "JoystickUp"),
+  KEY_ENTRY(JoystickDown, "JoystickDown"),
+  KEY_ENTRY(JoystickLeft, "JoystickLeft"),
+  KEY_ENTRY(JoystickRight, "JoystickRight"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLE(dpad)
+  KEY_ENTRY(DPadCenter, "DPadCenter"),
+  KEY_ENTRY(DPadUp, "DPadUp"),
+  KEY_ENTRY(DPadDown, "DPadDown"),
+  KEY_ENTRY(DPadLeft, "DPadLeft"),
+  KEY_ENTRY(DPadRight, "DPadRight"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLE(panning)
+  KEY_ENTRY(PanLeft, "PanLeft"),
+  KEY_ENTRY(PanRight, "PanRight"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLE(rocker)
+  KEY_ENTRY(RockerUp, "RockerUp"),
+  KEY_ENTRY(RockerDown, "RockerDown"),
+  KEY_ENTRY(RockerPress, "RockerPress"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLE(routing)
+  KEY_GROUP_ENTRY(HI_GRP_RoutingKeys, "RoutingKey"),
+END_KEY_NAME_TABLE
+
+BEGIN_KEY_NAME_TABLES(all)
+  KEY_NAME_TABLE(keyboard),
+  KEY_NAME_TABLE(joystick),
+  KEY_NAME_TABLE(dpad),
+  KEY_NAME_TABLE(panning),
+  KEY_NAME_TABLE(rocker),
+  KEY_NAME_TABLE(routing),
+END_KEY_NAME_TABLES
+
+DEFINE_KEY_TABLE(all)
+
+BEGIN_KEY_TABLE_LIST
+  &KEY_TABLE_DEFINITION(all),
+END_KEY_TABLE_LIST
+
+struct BrailleDataStruct {
+  HidBrailleLayout *layout;
+  const KeyNameEntry *keyNameTable[7];
+  HidBrailleKeys keys;
+
+  struct {
+    unsigned char buttons[HID_BRAILLE_BUTTON_COUNT];
+    unsigned char routers[HID_BRAILLE_ROUTER_LIMIT];
+  } pressed;
+
+  struct {
+    unsigned char cells[0XFF];
+    unsigned char rewrite;
+  } text;
+};
+
+static BraillePacketVerifierResult
+verifyPacket (
+  BrailleDisplay *brl,
+  unsigned char *bytes, size_t size,
+  size_t *length, void *data
+) {
+  if (size == 1) {
+    const HidBrailleLayout *layout = brl->data->layout;
+
+    // Reports only begin with an identifier when the device uses them,
+    // in which case report zero can't have been defined.
+    if (!(*length = hidGetBrailleInputSize(layout, 0))) {
+      if (!(*length = hidGetBrailleInputSize(layout, bytes[0]))) {
+        return BRL_PVR_INVALID;
+      }
+    }
+  }
+
+  return BRL_PVR_INCLUDE;
+}
+
+static size_t
+readPacket (BrailleDisplay *brl, void *packet, size_t size) {
+  return readBraillePacket(brl, NULL, packet, size, verifyPacket, NULL);
+}
+
+static int
+updateKeyGroup (
+  BrailleDisplay *brl, KeyGroup group,
+  const unsigned char *new, unsigned char *old, unsigned int count
+) {
+  KeyNumber pressStack[count];
+  unsigned int pressCount = 0;
+
+  for (KeyNumber number=0; number<count; number+=1) {
+    if (new[number] == old[number]) continue;
+    old[number] = new[number];
+
+    if (new[number]) {
+      pressStack[pressCount++] = number;
+    } else if (!enqueueKeyEvent(brl, group, number, 0)) {
+      return 0;
+    }
+  }
+
+  while (pressCount > 0) {
+    if (!enqueueKeyEvent(brl, group, pressStack[--pressCount], 1)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+updateKeys (BrailleDisplay *brl) {
+  const HidBrailleKeys *keys = &brl->data->keys;
+
+  if (!updateKeyGroup(brl, HI_GRP_NavigationKeys,
+                      keys->buttons, brl->data->pressed.buttons,
+                      HID_BRAILLE_BUTTON_COUNT)) {
+    return 0;
+  }
+
+  if (!updateKeyGroup(brl, HI_GRP_RoutingKeys,
+                      keys->routers, brl->data->pressed.routers,
+                      hidGetBrailleRouterCount(brl->data->layout))) {
+    return 0;
+  }
+
+  return 1;
+}
+
+static int
+brl_readCommand (BrailleDisplay *brl, KeyTableCommandContext context) {
+  unsigned char packet[0X100];
+  size_t size;
+
+  while ((size = readPacket(brl, packet, sizeof(packet)))) {
+    if (!hidDecodeBrailleInput(brl->data->layout, &brl->data->keys, packet, size)) {
+      logUnexpectedPacket(packet, size);
+      continue;
+    }
+
+    // Each report is applied as it's read so that a press and release
+    // which arrive together aren't merged into no change at all.
+    if (!updateKeys(brl)) return BRL_CMD_RESTARTBRL;
+  }
+
+  return (errno == EAGAIN)? EOF: BRL_CMD_RESTARTBRL;
+}
+
+static int
+brl_writeWindow (BrailleDisplay *brl, const wchar_t *text) {
+  unsigned int count = brl->textColumns;
+
+  if (cellsHaveChanged(brl->data->text.cells, brl->buffer, count, NULL, NULL, &brl->data->text.rewrite)) {
+    const HidBrailleLayout *layout = brl->data->layout;
+    unsigned char cells[count];
+    unsigned char report[hidGetBrailleOutputSize(layout)];
+
+    translateOutputCells(cells, brl->data->text.cells, count);
+    size_t size = hidEncodeBrailleOutput(layout, cells, count, report, sizeof(report));
+    if (!size) return 0;
+
+    if (gioWriteHidReport(brl->gioEndpoint, report, size) == -1) return 0;
+  }
+
+  return 1;
+}
+
+static int
+hasKeys (const HidBrailleLayout *layout, const KeyNameEntry *keys) {
+  while (keys->name) {
+    if (keys->value.group == HI_GRP_RoutingKeys) {
+      if (hidGetBrailleRouterCount(layout)) return 1;
+    } else if (hidHasBrailleButton(layout, keys->value.number)) {
+      return 1;
+    }
+
+    keys += 1;
+  }
+
+  return 0;
+}
+
+static void
+setKeyTable (BrailleDisplay *brl) {
+  const KeyTableDefinition *ktd = &KEY_TABLE_DEFINITION(all);
+  const KeyNameEntry *const *keys = ktd->names;
+  const KeyNameEntry **names = brl->data->keyNameTable;
+
+  while (*keys) {
+    if (hasKeys(brl->data->layout, *keys)) *names++ = *keys;
+    keys += 1;
+  }
+
+  *names = LAST_KEY_NAME_TABLE;
+  brl->keyBindings = ktd->bindings;
+  brl->keyNames = brl->data->keyNameTable;
+}
+
+static int
+connectResource (BrailleDisplay *brl, const char *identifier) {
+  GioDescriptor descriptor;
+  gioInitializeDescriptor(&descriptor);
+
+  descriptor.hid.usagePage = HID_UPG_Braille;
+
+  if (connectBrailleResource(brl, identifier, &descriptor, NULL)) {
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+brl_construct (BrailleDisplay *brl, char **parameters, const char *device) {
+  if ((brl->data = malloc(sizeof(*brl->data)))) {
+    memset(brl->data, 0, sizeof(*brl->data));
+
+    if (connectResource(brl, device)) {
+      const HidItemsDescriptor *items = gioGetHidItems(brl->gioEndpoint);
+
+      if (items) {
+        if ((brl->data->layout = hidNewBrailleLayout(items))) {
+          unsigned int count = hidGetBrailleCellCount(brl->data->layout);
+          if (count > sizeof(brl->data->text.cells)) count = sizeof(brl->data->text.cells);
+
+          brl->textColumns = count;
+          brl->textRows = 1;
+          brl->data->text.rewrite = 1;
+
+          setKeyTable(brl);
+          makeOutputTable(dotsTable_ISO11548_1);
+          return 1;
+        }
+      }
+
+      disconnectBrailleResource(brl, NULL);
+    }
+
+    free(brl->data);
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static void
+brl_destruct (BrailleDisplay *brl) {
+  disconnectBrailleResource(brl, NULL);
+
+  if (brl->data) {
+    hidDestroyBrailleLayout(brl->data->layout);
+    free(brl->data);
+  }
+}
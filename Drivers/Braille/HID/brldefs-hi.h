@@ -0,0 +1,61 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_HI_BRLDEFS
+#define BRLTTY_INCLUDED_HI_BRLDEFS
+
+/* The key numbers are the offsets of the HID braille usages from Dot1. */
+typedef enum {
+  HI_KEY_Dot1           = 0X00,
+  HI_KEY_Dot2           = 0X01,
+  HI_KEY_Dot3           = 0X02,
+  HI_KEY_Dot4           = 0X03,
+  HI_KEY_Dot5           = 0X04,
+  HI_KEY_Dot6           = 0X05,
+  HI_KEY_Dot7           = 0X06,
+  HI_KEY_Dot8           = 0X07,
+  HI_KEY_Space          = 0X08,
+  HI_KEY_LeftSpace      = 0X09,
+  HI_KEY_RightSpace     = 0X0A,
+
+  HI_KEY_JoystickCenter = 0X0F,
+  HI_KEY_JoystickUp     = 0X10,
+  HI_KEY_JoystickDown   = 0X11,
+  HI_KEY_JoystickLeft   = 0X12,
+  HI_KEY_JoystickRight  = 0X13,
+
+  HI_KEY_DPadCenter     = 0X14,
+  HI_KEY_DPadUp         = 0X15,
+  HI_KEY_DPadDown       = 0X16,
+  HI_KEY_DPadLeft       = 0X17,
+  HI_KEY_DPadRight      = 0X18,
+
+  HI_KEY_PanLeft        = 0X19,
+  HI_KEY_PanRight       = 0X1A,
+
+  HI_KEY_RockerUp       = 0X1B,
+  HI_KEY_RockerDown     = 0X1C,
+  HI_KEY_RockerPress    = 0X1D,
+} HI_NavigationKey;
+
+typedef enum {
+  HI_GRP_NavigationKeys = 0,
+  HI_GRP_RoutingKeys
+} HI_KeyGroup;
+
+#endif /* BRLTTY_INCLUDED_HI_BRLDEFS */ 
@@ -459,47 +459,260 @@ isText (void) {
   return isRole(ROLE_TEXT);
 }
 
-/* Get the role of an AT-SPI2 object */
-static char *getRole(const char *sender, const char *path) {
-  const char *text;
-  char *res = NULL;
-  DBusMessage *msg, *reply;
-  DBusMessageIter iter;
+/* Cache of the role, interfaces, and state of the accessible objects we've
+ * looked at. It's kept up to date by the AT-SPI2 change events so that
+ * getting back to a known object needs fewer round trips. */
+#define A2_OBJECT_HASH_SIZE 0X100
+#define A2_OBJECT_CACHE_LIMIT 0X400
+
+typedef struct A2ObjectStruct A2Object;
+
+struct A2ObjectStruct {
+  A2Object *next;
+  char *sender;
+  char *path;
+
+  char *role;
+  dbus_uint32_t states[2];
+
+  unsigned char haveRole:1;
+  unsigned char haveInterfaces:1;
+  unsigned char haveStates:1;
+  unsigned char hasText:1;
+};
 
-  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetRoleName");
-  if (!msg)
+static A2Object *a2Objects[A2_OBJECT_HASH_SIZE];
+static unsigned int a2ObjectCount;
+
+static unsigned int
+hashObject (const char *sender, const char *path) {
+  unsigned int hash = 0;
+
+  while (*sender) hash = (hash * 31) + (unsigned char)*sender++;
+  while (*path) hash = (hash * 31) + (unsigned char)*path++;
+
+  return hash % A2_OBJECT_HASH_SIZE;
+}
+
+static void
+freeObject (A2Object *object) {
+  free(object->sender);
+  free(object->path);
+  free(object->role);
+  free(object);
+}
+
+static void
+clearObjects (void) {
+  for (unsigned int index=0; index<A2_OBJECT_HASH_SIZE; index+=1) {
+    A2Object *object;
+
+    while ((object = a2Objects[index])) {
+      a2Objects[index] = object->next;
+      freeObject(object);
+    }
+  }
+
+  a2ObjectCount = 0;
+}
+
+static A2Object **
+locateObject (const char *sender, const char *path) {
+  A2Object **object = &a2Objects[hashObject(sender, path)];
+
+  while (*object) {
+    if ((strcmp((*object)->path, path) == 0) &&
+        (strcmp((*object)->sender, sender) == 0)) break;
+    object = &(*object)->next;
+  }
+
+  return object;
+}
+
+static A2Object *
+findObject (const char *sender, const char *path) {
+  return *locateObject(sender, path);
+}
+
+static A2Object *
+getObject (const char *sender, const char *path) {
+  A2Object **location = locateObject(sender, path);
+  if (*location) return *location;
+
+  if (a2ObjectCount == A2_OBJECT_CACHE_LIMIT) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER), "object cache full");
+    clearObjects();
+    location = locateObject(sender, path);
+  }
+
+  A2Object *object;
+
+  if ((object = calloc(1, sizeof(*object)))) {
+    if ((object->sender = strdup(sender))) {
+      if ((object->path = strdup(path))) {
+        *location = object;
+        a2ObjectCount += 1;
+        return object;
+      }
+
+      free(object->sender);
+    }
+
+    free(object);
+  }
+
+  logMallocError();
+  return NULL;
+}
+
+static void
+forgetObject (const char *sender, const char *path) {
+  A2Object **location = locateObject(sender, path);
+  A2Object *object = *location;
+
+  if (object) {
+    *location = object->next;
+    freeObject(object);
+    a2ObjectCount -= 1;
+  }
+}
+
+static void
+updateObjectState (const char *sender, const char *path, const char *name, int set) {
+  A2Object *object = findObject(sender, path);
+  if (!object) return;
+
+  if (strcmp(name, "defunct") == 0) {
+    forgetObject(sender, path);
+    return;
+  }
+
+  if (!object->haveStates) return;
+  unsigned int state;
+
+  if (strcmp(name, "active") == 0) {
+    state = ATSPI_STATE_ACTIVE;
+  } else if (strcmp(name, "focused") == 0) {
+    state = ATSPI_STATE_FOCUSED;
+  } else {
+    /* we don't know its bit so we can't keep the cached states accurate */
+    object->haveStates = 0;
+    return;
+  }
+
+  dbus_uint32_t bit = 1 << (state % 32);
+  dbus_uint32_t *word = &object->states[state / 32];
+
+  if (set) {
+    *word |= bit;
+  } else {
+    *word &= ~bit;
+  }
+}
+
+/* Sends a method call message, and returns the pending call, if any. This unrefs the message.  */
+static DBusPendingCall *
+send_with_reply(DBusConnection *bus, DBusMessage *msg, int timeout_ms, const char *doing)
+{
+  DBusPendingCall *pending = NULL;
+
+  if (!dbus_connection_send_with_reply(bus, msg, &pending, timeout_ms)) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "no memory while %s", doing);
+    pending = NULL;
+  } else if (!pending) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "disconnected while %s", doing);
+  }
+
+  dbus_message_unref(msg);
+  return pending;
+}
+
+/* Returns the reply of a completed pending call, if it isn't an error. */
+static DBusMessage *
+steal_reply(DBusPendingCall *pending, const char *doing)
+{
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+
+  if (!reply) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "timeout while %s", doing);
     return NULL;
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting role");
-  if (!reply)
+  }
+  if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_ERROR) {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "error while %s: %s", doing, dbus_message_get_error_name(reply));
+    dbus_message_unref(reply);
     return NULL;
+  }
+  return reply;
+}
+
+static DBusMessage *
+new_property_get(const char *sender, const char *path, const char *interface, const char *property)
+{
+  DBusMessage *msg = new_method_call(sender, path, DBUS_INTERFACE_PROPERTIES, "Get");
+  if (msg)
+    dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
+  return msg;
+}
+
+/* Switching to a new object needs several queries. They're all sent at once,
+ * and the switch is completed when the last of their replies has arrived.  */
+typedef enum {
+  A2_QUERY_ROLE,
+  A2_QUERY_INTERFACES,
+  A2_QUERY_TEXT,
+  A2_QUERY_NAME,
+  A2_QUERY_CARET,
+  A2_QUERY_COUNT
+} A2QueryType;
+
+typedef struct {
+  char *sender;
+  char *path;
+  DBusPendingCall *pending[A2_QUERY_COUNT];
+  unsigned int pendingCount;
+
+  char *role;
+  char *text;
+  char *name;
+  dbus_int32_t caret;
+  unsigned char haveRole:1;
+  unsigned char hasText:1;
+} A2FocusRequest;
+
+static A2FocusRequest *focusRequest;
+
+/* Get the role of an AT-SPI2 object */
+static DBusMessage *newRoleQuery(const char *sender, const char *path) {
+  return new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetRoleName");
+}
+
+static void handleRoleReply(A2FocusRequest *request, DBusMessage *reply) {
+  const char *text;
+  DBusMessageIter iter;
 
   dbus_message_iter_init(reply, &iter);
   if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "GetRoleName didn't return a string but '%c'", dbus_message_iter_get_arg_type(&iter));
-    goto out;
+    return;
   }
   dbus_message_iter_get_basic(&iter, &text);
-  res = strdup(text);
-
-out:
-  dbus_message_unref(reply);
-  return res;
+  request->role = strdup(text);
+  request->haveRole = 1;
 }
 
 /* Get the get interfaces of an AT-SPI2 object */
-static int getHasTextInterface(const char *sender, const char *path) {
-  DBusMessage *msg, *reply;
+static DBusMessage *newInterfacesQuery(const char *sender, const char *path) {
+  return new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetInterfaces");
+}
+
+static void handleInterfacesReply(A2FocusRequest *request, DBusMessage *reply) {
   DBusMessageIter iter;
   DBusMessageIter iter_array;
-  int ret = 0;
-
-  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetInterfaces");
-  if (!msg)
-    return 0;
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting interfaces");
-  if (!reply)
-    return 0;
 
   dbus_message_iter_init(reply, &iter);
   dbus_message_iter_recurse (&iter, &iter_array);
@@ -510,129 +723,162 @@ static int getHasTextInterface(const char *sender, const char *path) {
 
     if (!strcmp (iface, "org.a11y.atspi.Text"))
     {
-      ret = 1;
-      goto out;
+      request->hasText = 1;
+      break;
     }
     dbus_message_iter_next (&iter_array);
   }
 
-out:
-  dbus_message_unref(reply);
-  return ret;
+  A2Object *object = getObject(request->sender, request->path);
+  if (object) {
+    object->hasText = request->hasText;
+    object->haveInterfaces = 1;
+  }
+}
+
+static DBusMessage *newNameQuery(const char *sender, const char *path) {
+  return new_property_get(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "Name");
 }
 
-static char *getName(const char *sender, const char *path) {
+static void handleNameReply(A2FocusRequest *request, DBusMessage *reply) {
   const char *name;
-  char *res = NULL;
-  DBusMessage *msg, *reply = NULL;
-  const char *interface = SPI2_DBUS_INTERFACE_ACCESSIBLE;
-  const char *property = "Name";
   DBusMessageIter iter, iter_variant;
 
-  msg = new_method_call(sender, path, DBUS_INTERFACE_PROPERTIES, "Get");
-  if (!msg)
-    return NULL;
-  dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting name");
-  if (!reply)
-    return NULL;
-
   dbus_message_iter_init(reply, &iter);
   if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "getName didn't return a variant but '%c'", dbus_message_iter_get_arg_type(&iter));
-    goto out;
+    return;
   }
   dbus_message_iter_recurse(&iter, &iter_variant);
   if (dbus_message_iter_get_arg_type(&iter_variant) != DBUS_TYPE_STRING) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "getName didn't return a variant but '%c'", dbus_message_iter_get_arg_type(&iter_variant));
-    goto out;
+    return;
   }
   dbus_message_iter_get_basic(&iter_variant, &name);
-  res = strdup(name);
-
-out:
-  dbus_message_unref(reply);
-  return res;
+  request->name = strdup(name);
 }
 
 /* Get the text of an AT-SPI2 object */
-static char *getText(const char *sender, const char *path) {
-  const char *text;
-  char *res = NULL;
-  DBusMessage *msg, *reply;
+static DBusMessage *newTextQuery(const char *sender, const char *path) {
   dbus_int32_t begin = 0;
   dbus_int32_t end = -1;
-  DBusMessageIter iter;
+  DBusMessage *msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_TEXT, "GetText");
 
-  msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_TEXT, "GetText");
-  if (!msg)
-    return NULL;
-  dbus_message_append_args(msg, DBUS_TYPE_INT32, &begin, DBUS_TYPE_INT32, &end, DBUS_TYPE_INVALID);
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting text");
-  if (!reply)
-    return NULL;
+  if (msg)
+    dbus_message_append_args(msg, DBUS_TYPE_INT32, &begin, DBUS_TYPE_INT32, &end, DBUS_TYPE_INVALID);
+  return msg;
+}
+
+static void handleTextReply(A2FocusRequest *request, DBusMessage *reply) {
+  const char *text;
+  DBusMessageIter iter;
 
   dbus_message_iter_init(reply, &iter);
   if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "GetText didn't return a string but '%c'", dbus_message_iter_get_arg_type(&iter));
-    goto out;
+    return;
   }
   dbus_message_iter_get_basic(&iter, &text);
-  res = strdup(text);
-
-out:
-  dbus_message_unref(reply);
-  return res;
+  request->text = strdup(text);
 }
 
 /* Get the caret of an AT-SPI2 object */
-static dbus_int32_t getCaret(const char *sender, const char *path) {
-  dbus_int32_t res = -1;
-  DBusMessage *msg, *reply = NULL;
-  const char *interface = SPI2_DBUS_INTERFACE_TEXT;
-  const char *property = "CaretOffset";
-  DBusMessageIter iter, iter_variant;
+static DBusMessage *newCaretQuery(const char *sender, const char *path) {
+  return new_property_get(sender, path, SPI2_DBUS_INTERFACE_TEXT, "CaretOffset");
+}
 
-  msg = new_method_call(sender, path, DBUS_INTERFACE_PROPERTIES, "Get");
-  if (!msg)
-    return -1;
-  dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_STRING, &property, DBUS_TYPE_INVALID);
-  reply = send_with_reply_and_block(bus, msg, 1000, "getting caret");
-  if (!reply)
-    return -1;
+static void handleCaretReply(A2FocusRequest *request, DBusMessage *reply) {
+  dbus_int32_t res;
+  DBusMessageIter iter, iter_variant;
 
   dbus_message_iter_init(reply, &iter);
   if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "getCaret didn't return a variant but '%c'", dbus_message_iter_get_arg_type(&iter));
-    goto out;
+    return;
   }
   dbus_message_iter_recurse(&iter, &iter_variant);
   if (dbus_message_iter_get_arg_type(&iter_variant) != DBUS_TYPE_INT32) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "getCaret didn't return an int32 but '%c'", dbus_message_iter_get_arg_type(&iter_variant));
-    goto out;
+    return;
   }
   dbus_message_iter_get_basic(&iter_variant, &res);
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "Got caret %d", res);
+  request->caret = res;
+}
 
-out:
-  dbus_message_unref(reply);
-  return res;
+typedef struct {
+  const char *doing;
+  DBusMessage *(*newQuery) (const char *sender, const char *path);
+  void (*handleReply) (A2FocusRequest *request, DBusMessage *reply);
+} A2QueryEntry;
+
+static const A2QueryEntry a2QueryTable[A2_QUERY_COUNT] = {
+  [A2_QUERY_ROLE] = {
+    .doing = "getting role",
+    .newQuery = newRoleQuery,
+    .handleReply = handleRoleReply
+  },
+
+  [A2_QUERY_INTERFACES] = {
+    .doing = "getting interfaces",
+    .newQuery = newInterfacesQuery,
+    .handleReply = handleInterfacesReply
+  },
+
+  [A2_QUERY_TEXT] = {
+    .doing = "getting text",
+    .newQuery = newTextQuery,
+    .handleReply = handleTextReply
+  },
+
+  [A2_QUERY_NAME] = {
+    .doing = "getting name",
+    .newQuery = newNameQuery,
+    .handleReply = handleNameReply
+  },
+
+  [A2_QUERY_CARET] = {
+    .doing = "getting caret",
+    .newQuery = newCaretQuery,
+    .handleReply = handleCaretReply
+  },
+};
+
+static void
+destroyFocusRequest (A2FocusRequest *request) {
+  for (unsigned int query=0; query<A2_QUERY_COUNT; query+=1) {
+    DBusPendingCall *pending = request->pending[query];
+
+    if (pending) {
+      dbus_pending_call_cancel(pending);
+      dbus_pending_call_unref(pending);
+    }
+  }
+
+  free(request->sender);
+  free(request->path);
+  free(request->role);
+  free(request->text);
+  free(request->name);
+  free(request);
 }
 
-/* Switched to a new terminal, restart from scratch */
-static void restartTerm(const char *sender, const char *path) {
-  char *text = getText(sender, path);
-  if (!text) {
-    text = getName(sender, path);
-    if (!text) return;
+static void
+cancelFocusRequest (void) {
+  if (focusRequest) {
+    destroyFocusRequest(focusRequest);
+    focusRequest = NULL;
   }
+}
 
+/* Switched to a new terminal, restart from scratch */
+static void restartTerm(const char *sender, const char *path, char *text, dbus_int32_t caret) {
   char *c,*d;
   const char *e;
   long i,len;
@@ -688,20 +934,33 @@ static void restartTerm(const char *sender, const char *path) {
   }
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "%ld cols",curNumCols);
-  caretPosition(getCaret(sender, path));
-  free(text);
+  caretPosition(caret);
 }
 
-/* Switched to a new object, check whether we want to read it, and if so, restart with it */
-static void tryRestartTerm(const char *sender, const char *path) {
+/* All of the replies have arrived, switch to the new object */
+static void finishFocusRequest(A2FocusRequest *request) {
   if (curPath) finiTerm();
-  restartTerm(sender, path);
 
-  curRole = getRole(sender, path);
+  char *text = request->text;
+  if (!text) text = request->name;
+  if (text) restartTerm(request->sender, request->path, text, request->caret);
+
+  A2Object *object = getObject(request->sender, request->path);
+
+  if (request->haveRole) {
+    curRole = request->role;
+    request->role = NULL;
+
+    if (object && !object->haveRole) {
+      object->role = curRole? strdup(curRole): NULL;
+      object->haveRole = 1;
+    }
+  }
+
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "state changed focus to role %s", curRole);
 
-  curQuality = getHasTextInterface(sender, path)? SCQ_POOR: SCQ_NONE;
+  curQuality = request->hasText? SCQ_POOR: SCQ_NONE;
   unsigned char requested = typeFlags[TYPE_ALL];
 
   if (!requested) {
@@ -715,6 +974,117 @@ static void tryRestartTerm(const char *sender, const char *path) {
   }
 
   if (requested) curQuality = SCQ_GOOD;     
+  updated = 1;
+}
+
+static void handleFocusReply(DBusPendingCall *pending, void *data) {
+  A2FocusRequest *request = data;
+
+  for (unsigned int query=0; query<A2_QUERY_COUNT; query+=1) {
+    if (request->pending[query] == pending) {
+      const A2QueryEntry *entry = &a2QueryTable[query];
+      DBusMessage *reply = steal_reply(pending, entry->doing);
+
+      if (reply) {
+        entry->handleReply(request, reply);
+        dbus_message_unref(reply);
+      }
+
+      request->pending[query] = NULL;
+      dbus_pending_call_unref(pending);
+      break;
+    }
+  }
+
+  if (!--request->pendingCount) {
+    if (request == focusRequest) focusRequest = NULL;
+    finishFocusRequest(request);
+    destroyFocusRequest(request);
+  }
+}
+
+/* Switched to a new object, check whether we want to read it, and if so, restart with it */
+static void tryRestartTerm(const char *sender, const char *path) {
+  A2FocusRequest *request;
+
+  if (!(request = calloc(1, sizeof(*request)))) goto noMemory;
+  if (!(request->sender = strdup(sender))) goto noMemory;
+  if (!(request->path = strdup(path))) goto noMemory;
+
+  cancelFocusRequest();
+  focusRequest = request;
+  request->caret = -1;
+
+  int needQuery[A2_QUERY_COUNT] = {
+    [A2_QUERY_ROLE] = 1,
+    [A2_QUERY_INTERFACES] = 1,
+    [A2_QUERY_TEXT] = 1,
+    [A2_QUERY_NAME] = 1,
+    [A2_QUERY_CARET] = 1,
+  };
+
+  {
+    A2Object *object = findObject(sender, path);
+
+    if (object) {
+      if (object->haveRole) {
+        request->role = object->role? strdup(object->role): NULL;
+        request->haveRole = 1;
+        needQuery[A2_QUERY_ROLE] = 0;
+      }
+
+      if (object->haveInterfaces) {
+        request->hasText = object->hasText;
+        needQuery[A2_QUERY_INTERFACES] = 0;
+
+        if (!object->hasText) {
+          needQuery[A2_QUERY_TEXT] = 0;
+          needQuery[A2_QUERY_CARET] = 0;
+        }
+      }
+    }
+  }
+
+  /* hold the completion until all of the queries have been sent */
+  request->pendingCount = 1;
+
+  for (unsigned int query=0; query<A2_QUERY_COUNT; query+=1) {
+    if (!needQuery[query]) continue;
+
+    const A2QueryEntry *entry = &a2QueryTable[query];
+    DBusMessage *msg = entry->newQuery(sender, path);
+    if (!msg) continue;
+
+    DBusPendingCall *pending = send_with_reply(bus, msg, 1000, entry->doing);
+    if (!pending) continue;
+
+    if (!dbus_pending_call_set_notify(pending, handleFocusReply, request, NULL)) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "no memory while %s", entry->doing);
+      dbus_pending_call_cancel(pending);
+      dbus_pending_call_unref(pending);
+      continue;
+    }
+
+    request->pending[query] = pending;
+    request->pendingCount += 1;
+  }
+
+  if (!--request->pendingCount) {
+    focusRequest = NULL;
+    finishFocusRequest(request);
+    destroyFocusRequest(request);
+  }
+
+  return;
+
+noMemory:
+  logMallocError();
+
+  if (request) {
+    free(request->sender);
+    free(request);
+  }
 }
 
 /* Get the state of an object */
@@ -724,6 +1094,13 @@ static dbus_uint32_t *getState(const char *sender, const char *path)
   DBusMessageIter iter, iter_array;
   dbus_uint32_t *states, *ret = NULL;
   int count;
+  A2Object *object = findObject(sender, path);
+
+  if (object && object->haveStates) {
+    ret = malloc(sizeof(object->states));
+    if (ret) memcpy(ret, object->states, sizeof(object->states));
+    return ret;
+  }
 
   msg = new_method_call(sender, path, SPI2_DBUS_INTERFACE_ACCESSIBLE, "GetState");
   if (!msg)
@@ -750,6 +1127,11 @@ static dbus_uint32_t *getState(const char *sender, const char *path)
   ret = malloc(sizeof(*ret) * count);
   memcpy(ret, states, sizeof(*ret) * count);
 
+  if ((object = getObject(sender, path))) {
+    memcpy(object->states, states, sizeof(object->states));
+    object->haveStates = 1;
+  }
+
 out:
   dbus_message_unref(reply);
   return ret;
@@ -987,12 +1369,39 @@ static void AtSpi2HandleEvent(const char *interface, DBusMessage *message)
   }
   dbus_message_iter_recurse(&iter, &iter_variant);
 
+  if (!strcmp(interface, "Object")) {
+    if (!strcmp(member, "StateChanged")) {
+      updateObjectState(sender, path, detail, detail1);
+    } else if (!strcmp(member, "PropertyChange") && !strcmp(detail, "accessible-role")) {
+      A2Object *object = findObject(sender, path);
+
+      if (object) {
+        free(object->role);
+        object->role = NULL;
+        object->haveRole = 0;
+      }
+    } else if (!strcmp(member, "ChildrenChanged") && !strncmp(detail, "remove", 6)) {
+      if (dbus_message_iter_get_arg_type(&iter_variant) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter iter_struct;
+        const char *childsender, *childpath;
+
+        dbus_message_iter_recurse(&iter_variant, &iter_struct);
+        dbus_message_iter_get_basic(&iter_struct, &childsender);
+        dbus_message_iter_next(&iter_struct);
+        dbus_message_iter_get_basic(&iter_struct, &childpath);
+        forgetObject(childsender, childpath);
+      }
+    }
+  }
+
   StateChanged_focused =
        !strcmp(interface, "Object")
     && !strcmp(member, "StateChanged")
     && !strcmp(detail, "focused");
 
   if (StateChanged_focused && !detail1) {
+    if (focusRequest && !strcmp(sender, focusRequest->sender) && !strcmp(path, focusRequest->path))
+      cancelFocusRequest();
     if (curSender && !strcmp(sender, curSender) && !strcmp(path, curPath))
       finiTerm();
   } else if (!strcmp(interface,"Focus") || (StateChanged_focused && detail1)) {
@@ -1258,13 +1667,8 @@ struct a2Watch
   DBusWatch *watch;
 };
 
-int a2ProcessWatch(const AsyncMonitorCallbackParameters *parameters, int flags)
+static void a2DispatchMessages(void)
 {
-  struct a2Watch *a2Watch = parameters->data;
-  DBusWatch *watch = a2Watch->watch;
-  /* Read/Write on socket */
-  dbus_watch_handle(watch, parameters->error?DBUS_WATCH_ERROR:flags);
-  /* And process messages */
   while (dbus_connection_dispatch(bus) != DBUS_DISPATCH_COMPLETE)
     ;
   if (updated)
@@ -1272,6 +1676,16 @@ int a2ProcessWatch(const AsyncMonitorCallbackParameters *parameters, int flags)
     updated = 0;
     mainScreenUpdated();
   }
+}
+
+int a2ProcessWatch(const AsyncMonitorCallbackParameters *parameters, int flags)
+{
+  struct a2Watch *a2Watch = parameters->data;
+  DBusWatch *watch = a2Watch->watch;
+  /* Read/Write on socket */
+  dbus_watch_handle(watch, parameters->error?DBUS_WATCH_ERROR:flags);
+  /* And process messages */
+  a2DispatchMessages();
   return dbus_watch_get_enabled(watch);
 }
 
@@ -1346,13 +1760,7 @@ ASYNC_ALARM_CALLBACK(a2ProcessTimeout)
   /* Process timeout */
   dbus_timeout_handle(timeout);
   /* And process messages */
-  while (dbus_connection_dispatch(bus) != DBUS_DISPATCH_COMPLETE)
-    ;
-  if (updated)
-  {
-    updated = 0;
-    mainScreenUpdated();
-  }
+  a2DispatchMessages();
   asyncDiscardHandle(a2Timeout->monitor);
   a2Timeout->monitor = NULL;
   if (dbus_timeout_get_enabled(timeout))
@@ -1390,6 +1798,26 @@ void a2TimeoutToggled(DBusTimeout *timeout, void *data)
   }
 }
 
+/* Replies to our pending calls may have been read while we were blocked
+ * waiting for another one, in which case there's nothing left on the socket
+ * to wake us up. */
+
+static AsyncHandle a2DispatchAlarm;
+
+ASYNC_ALARM_CALLBACK(a2ProcessDispatch)
+{
+  asyncDiscardHandle(a2DispatchAlarm);
+  a2DispatchAlarm = NULL;
+  a2DispatchMessages();
+}
+
+void a2DispatchStatusChanged(DBusConnection *connection, DBusDispatchStatus status, void *data)
+{
+  if (status == DBUS_DISPATCH_DATA_REMAINS)
+    if (!a2DispatchAlarm)
+      asyncNewRelativeAlarm(&a2DispatchAlarm, 0, a2ProcessDispatch, NULL);
+}
+
 /* Driver construction / destruction */
 
 static int addWatch(const char *message, const char *event) {
@@ -1532,6 +1960,8 @@ construct_AtSpi2Screen (void) {
 
   dbus_connection_set_watch_functions(bus, a2AddWatch, a2RemoveWatch, a2WatchToggled, NULL, NULL);
   dbus_connection_set_timeout_functions(bus, a2AddTimeout, a2RemoveTimeout, a2TimeoutToggled, NULL, NULL);
+  dbus_connection_set_dispatch_status_function(bus, a2DispatchStatusChanged, NULL, NULL);
+  a2DispatchStatusChanged(bus, dbus_connection_get_dispatch_status(bus), NULL);
 
 #ifdef HAVE_PKG_X11
   closeX = 0;
@@ -1585,12 +2015,19 @@ destruct_AtSpi2Screen (void) {
     clipboardContent = NULL;
   }
 #endif /* HAVE_PKG_X11 */
+  cancelFocusRequest();
+  if (a2DispatchAlarm) {
+    asyncCancelRequest(a2DispatchAlarm);
+    a2DispatchAlarm = NULL;
+  }
+  dbus_connection_set_dispatch_status_function(bus, NULL, NULL, NULL);
   dbus_connection_remove_filter(bus, AtSpi2Filter, NULL);
   dbus_connection_close(bus);
   dbus_connection_unref(bus);
   logMessage(LOG_CATEGORY(SCREEN_DRIVER),
              "SPI2 stopped");
   finiTerm();
+  clearObjects();
 }
 
 static int
@@ -19,14 +19,17 @@
 #include "prologue.h"
 
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
+
 #include "log.h"
 #include "alert.h"
 #include "strfmt.h"
 #include "utf8.h"
+#include "unicode.h"
 #include "brl_cmds.h"
 #include "embed.h"
 
@@ -38,7 +41,12 @@ typedef enum {
 #include "scr_driver.h"
 
 static const char *filePath;
-static wchar_t *fileCharacters;
+
+// The file's UTF-8 text is kept as is and each line is only converted to
+// characters when it's read. It's a private copy rather than a mapping so
+// that the file being truncated while it's viewed can't raise SIGBUS.
+static char *fileText;
+static size_t fileSize;
 
 typedef struct {
   unsigned int offset;
@@ -48,23 +56,43 @@ typedef struct {
 static LineDescriptor *lineDescriptors;
 static unsigned int lineSize;
 static unsigned int lineCount;
+static unsigned int lastLineEnd;
+
+static struct {
+  wchar_t *characters;
+  unsigned int size;
+  unsigned int row;
+  unsigned char isValid:1;
+} decodedLine;
 
 static int screenWidth;
-static int cursorOffset;
+static int64_t cursorOffset;
+
+static void
+releaseText (void) {
+  if (fileText) {
+    free(fileText);
+    fileText = NULL;
+  }
+
+  fileSize = 0;
+}
 
 static void
 destruct_FileViewerScreen (void) {
   brlttyDisableInterrupt();
 
+  if (decodedLine.characters) {
+    free(decodedLine.characters);
+    decodedLine.characters = NULL;
+  }
+
   if (lineDescriptors) {
     free(lineDescriptors);
     lineDescriptors = NULL;
   }
 
-  if (fileCharacters) {
-    free(fileCharacters);
-    fileCharacters = NULL;
-  }
+  releaseText();
 }
 
 static int
@@ -75,9 +103,34 @@ processParameters_FileViewerScreen (char **parameters) {
   return 1;
 }
 
+static wchar_t
+getNextCharacter (const char **byte, size_t *count) {
+  if (!(**byte & 0X80)) {
+    wchar_t wc = *(*byte)++;
+    *count -= 1;
+    return wc? wc: UNICODE_REPLACEMENT_CHARACTER;
+  }
+
+  wint_t wc = convertUtf8ToWchar(byte, count);
+  return (wc != WEOF)? wc: UNICODE_REPLACEMENT_CHARACTER;
+}
+
 static int
-addLine (const wchar_t *from, const wchar_t *to) {
-  size_t lineLength = to - from;
+addLine (const char *from, const char *to) {
+  unsigned int lineLength = 0;
+
+  {
+    // count the characters the same way that they'll be decoded - an
+    // invalid sequence may be more than one byte yet only one character
+    const char *byte = from;
+    size_t count = to - from;
+
+    while (count) {
+      getNextCharacter(&byte, &count);
+      lineLength += 1;
+    }
+  }
+
   if (lineLength > screenWidth) screenWidth = lineLength;
 
   if (lineCount == lineSize) {
@@ -94,41 +147,73 @@ addLine (const wchar_t *from, const wchar_t *to) {
   }
 
   LineDescriptor *line = &lineDescriptors[lineCount++];
-  line->offset = from - fileCharacters;
-  line->length = to - from;
+  line->offset = from - fileText;
+  line->length = lineLength;
+  lastLineEnd = to - fileText;
 
   return 1;
 }
 
 static int
-setScreenContent (const char *text) {
-  unsigned int characterCount = countUtf8Characters(text);
-  fileCharacters = malloc(characterCount * sizeof(*fileCharacters));
+setScreenContent (void) {
+  const char *current = fileText;
+  const char *end = current + fileSize;
 
-  if (fileCharacters) {
-    makeWcharsFromUtf8(text, fileCharacters, characterCount);
+  do {
+    const char *next = memchr(current, '\n', end-current);
 
-    const wchar_t *current = fileCharacters;
-    const wchar_t *end = current + characterCount;
+    if (!next) {
+      if (!addLine(current, end)) return 0;
+      break;
+    }
 
-    while (current < end) {
-      wchar_t *next = wcschr(current, WC_C('\n'));
+    if (!addLine(current, next)) return 0;
+    current = next + 1;
+  } while (current < end);
 
-      if (!next) {
-        if (!addLine(current, end)) return 0;
-        break;
+  return 1;
+}
+
+static int
+setMessageContent (const char *message) {
+  releaseText();
+  if (!(fileText = strdup(message))) return 0;
+  fileSize = strlen(fileText);
+
+  lineCount = 0;
+  screenWidth = 0;
+  return setScreenContent();
+}
+
+static const char *
+readFile (int fileDescriptor) {
+  struct stat status;
+  if (fstat(fileDescriptor, &status) == -1) return strerror(errno);
+
+  if (status.st_size > UINT_MAX) return gettext("file too large");
+  fileSize = status.st_size;
+  if (!fileSize) return NULL;
+  if (!(fileText = malloc(fileSize))) return strerror(errno);
+
+  {
+    size_t length = 0;
+
+    while (length < fileSize) {
+      ssize_t result = read(fileDescriptor, &fileText[length], fileSize-length);
+
+      if (result == -1) {
+        if (errno == EINTR) continue;
+        return strerror(errno);
       }
 
-      if (!addLine(current, next)) return 0;
-      current = next + 1;
+      if (!result) break;
+      length += result;
     }
 
-    return 1;
-  } else {
-    logMallocError();
+    fileSize = length;
   }
 
-  return 0;
+  return NULL;
 }
 
 static int
@@ -136,35 +221,11 @@ loadFile (void) {
   const char *problem = NULL;
 
   if (filePath) {
-    struct stat status;
-
-    if (stat(filePath, &status) != -1) {
-      size_t fileSize = status.st_size;
-      char *text = malloc(fileSize + 1);
-
-      if (text) {
-        int fileDescriptor = open(filePath, O_RDONLY);
-
-        if (fileDescriptor != -1) {
-          ssize_t result = read(fileDescriptor, text, fileSize);
-
-          if (result != -1) {
-            if (result < fileSize) fileSize = result;
-            text[fileSize] = 0;
-            setScreenContent(text);
-          } else {
-            problem = strerror(errno);
-          }
-
-          close(fileDescriptor);
-        } else {
-          problem = strerror(errno);
-        }
-
-        free(text);
-      } else {
-        problem = strerror(errno);
-      }
+    int fileDescriptor = open(filePath, O_RDONLY);
+
+    if (fileDescriptor != -1) {
+      problem = readFile(fileDescriptor);
+      close(fileDescriptor);
     } else {
       problem = strerror(errno);
     }
@@ -173,7 +234,11 @@ loadFile (void) {
     filePath = NULL;
   }
 
-  if (!problem) return 1;
+  if (!problem) {
+    if (setScreenContent()) return 1;
+    problem = strerror(errno);
+  }
+
   char log[0X100];
   STR_BEGIN(log, sizeof(log));
 
@@ -183,22 +248,30 @@ loadFile (void) {
   STR_END;
   logMessage(LOG_WARNING, "%s", log);
 
-  setScreenContent(log);
+  setMessageContent(log);
   return 0;
 }
 
 static int
 construct_FileViewerScreen (void) {
-  fileCharacters = NULL;
+  fileText = NULL;
+  fileSize = 0;
 
   lineDescriptors = NULL;
   lineSize = 0;
   lineCount = 0;
+  lastLineEnd = 0;
+
+  decodedLine.characters = NULL;
+  decodedLine.size = 0;
+  decodedLine.isValid = 0;
 
   screenWidth = 0;
   cursorOffset = 0;
 
   loadFile();
+  if (!screenWidth) screenWidth = 1;
+
   brlttyEnableInterrupt();
   return 1;
 }
@@ -214,12 +287,12 @@ refresh_FileViewerScreen (void) {
 }
 
 static int
-toScreenRow (int offset) {
+toScreenRow (int64_t offset) {
   return offset / screenWidth;
 }
 
 static int
-toScreenColumn (int offset) {
+toScreenColumn (int64_t offset) {
   return offset % screenWidth;
 }
 
@@ -231,6 +304,42 @@ describe_FileViewerScreen (ScreenDescription *description) {
   description->posx = toScreenColumn(cursorOffset);
 }
 
+static const wchar_t *
+getLineCharacters (unsigned int row) {
+  if (decodedLine.isValid && (decodedLine.row == row)) return decodedLine.characters;
+  const LineDescriptor *line = &lineDescriptors[row];
+
+  if (line->length > decodedLine.size) {
+    unsigned int newSize = MAX(decodedLine.size, 0X80);
+    while (newSize < line->length) newSize <<= 1;
+
+    wchar_t *newCharacters = realloc(decodedLine.characters, ARRAY_SIZE(newCharacters, newSize));
+    if (!newCharacters) {
+      logMallocError();
+      return NULL;
+    }
+
+    decodedLine.characters = newCharacters;
+    decodedLine.size = newSize;
+  }
+
+  {
+    const char *byte = &fileText[line->offset];
+    size_t count = (((row + 1) < lineCount)? (line[1].offset - 1): lastLineEnd) - line->offset;
+
+    wchar_t *character = decodedLine.characters;
+    const wchar_t *end = character + line->length;
+
+    while (character < end) {
+      *character++ = count? getNextCharacter(&byte, &count): WC_C(' ');
+    }
+  }
+
+  decodedLine.row = row;
+  decodedLine.isValid = 1;
+  return decodedLine.characters;
+}
+
 static int
 readCharacters_FileViewerScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   if (validateScreenBox(box, screenWidth, lineCount)) {
@@ -238,12 +347,17 @@ readCharacters_FileViewerScreen (const ScreenBox *box, ScreenCharacter *buffer)
 
     for (unsigned int row=0; row<box->height; row+=1) {
       const LineDescriptor *line = &lineDescriptors[box->top + row];
+      const wchar_t *characters = NULL;
 
       unsigned int from = box->left;
       unsigned int to = from + box->width;
 
+      if (from < line->length) {
+        if (!(characters = getLineCharacters(box->top + row))) return 0;
+      }
+
       for (unsigned int column=from; column<to; column+=1) {
-        target->text = (column < line->length)? fileCharacters[line->offset + column]: WC_C(' ');
+        target->text = (column < line->length)? characters[column]: WC_C(' ');
         target->attributes = SCR_COLOUR_DEFAULT;
         target += 1;
       }
@@ -256,8 +370,46 @@ readCharacters_FileViewerScreen (const ScreenBox *box, ScreenCharacter *buffer)
 }
 
 static int
+readText_FileViewerScreen (const ScreenBox *box, wchar_t *buffer) {
+  if (validateScreenBox(box, screenWidth, lineCount)) {
+    wchar_t *target = buffer;
+
+    for (unsigned int row=0; row<box->height; row+=1) {
+      const LineDescriptor *line = &lineDescriptors[box->top + row];
+      unsigned int from = box->left;
+      unsigned int to = from + box->width;
+      unsigned int column = from;
+
+      if (from < line->length) {
+        const wchar_t *characters = getLineCharacters(box->top + row);
+        if (!characters) return 0;
+
+        unsigned int count = MIN(to, line->length) - from;
+        wmemcpy(target, &characters[from], count);
+
+        target += count;
+        column += count;
+      }
+
+      while (column++ < to) *target++ = WC_C(' ');
+    }
+
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+getRowLength_FileViewerScreen (int row, int *length) {
+  if ((row < 0) || (row >= lineCount)) return 0;
+  *length = lineDescriptors[row].length;
+  return 1;
+}
+
+static int64_t
 toScreenOffset (int row, int column) {
-  return (row * screenWidth) + column;
+  return ((int64_t)row * screenWidth) + column;
 }
 
 static int
@@ -268,9 +420,9 @@ routeCursor_FileViewerScreen (int column, int row, int screen) {
 
 static void
 moveCursor (int amount) {
-  int newOffset = cursorOffset + amount;
+  int64_t newOffset = cursorOffset + amount;
 
-  if ((newOffset >= 0) && (newOffset < (lineCount * screenWidth))) {
+  if ((newOffset >= 0) && (newOffset < toScreenOffset(lineCount, 0))) {
     cursorOffset = newOffset;
   } else {
     alert(ALERT_COMMAND_REJECTED);
@@ -280,7 +432,10 @@ moveCursor (int amount) {
 static int
 isBlankRow (int row) {
   const LineDescriptor *line = &lineDescriptors[row];
-  const wchar_t *character = &fileCharacters[line->offset];
+  if (!line->length) return 1;
+
+  const wchar_t *character = getLineCharacters(row);
+  if (!character) return 0;
   const wchar_t *end = character + line->length;
 
   while (character < end) {
@@ -387,6 +542,8 @@ scr_initialize (MainScreen *main) {
 
   main->base.describe = describe_FileViewerScreen;
   main->base.readCharacters = readCharacters_FileViewerScreen;
+  main->base.readText = readText_FileViewerScreen;
+  main->base.getRowLength = getRowLength_FileViewerScreen;
 
   main->base.routeCursor = routeCursor_FileViewerScreen;
   main->base.handleCommand = handleCommand_FileViewerScreen;
@@ -659,6 +659,13 @@ static int currentConsoleNumber;
 static int inTextMode;
 static TimePeriod mappingRecalculationTimer;
 
+static int activeConsoleDescriptor = -1;
+static THREAD_LOCAL AsyncHandle activeConsoleMonitor = NULL;
+static int activeConsoleNumber;
+static int consoleSwitched;
+static const char *consoleProblem;
+static TimePeriod textModeTimer;
+
 typedef struct {
   unsigned char rows;
   unsigned char columns;
@@ -694,6 +701,67 @@ canMonitorScreen (void) {
 }
 #endif /* can poll */
 
+static int
+readActiveConsole (void) {
+  char buffer[0X20];
+  ssize_t count = pread(activeConsoleDescriptor, buffer, sizeof(buffer)-1, 0);
+
+  if (count == -1) {
+    logSystemError("active console read");
+  } else {
+    int console;
+    buffer[count] = 0;
+
+    if (sscanf(buffer, "tty%d", &console) == 1) {
+      activeConsoleNumber = console;
+      return 1;
+    }
+
+    logMessage(LOG_WARNING, "unexpected active console: %s", buffer);
+  }
+
+  return 0;
+}
+
+static void
+closeActiveConsole (void) {
+  if (activeConsoleMonitor) {
+    asyncCancelRequest(activeConsoleMonitor);
+    activeConsoleMonitor = NULL;
+  }
+
+  if (activeConsoleDescriptor != -1) {
+    close(activeConsoleDescriptor);
+    activeConsoleDescriptor = -1;
+  }
+}
+
+static void
+openActiveConsole (void) {
+  static const char path[] = "/sys/class/tty/tty0/active";
+
+  if ((activeConsoleDescriptor = open(path, O_RDONLY | O_CLOEXEC)) != -1) {
+    if (readActiveConsole()) {
+      logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+                 "active console opened: %s: fd=%d",
+                 path, activeConsoleDescriptor);
+      return;
+    }
+
+    closeActiveConsole();
+  } else {
+    logMessage(LOG_CATEGORY(SCREEN_DRIVER),
+               "active console not available: %s: %s",
+               path, strerror(errno));
+  }
+}
+
+static int
+isTrackingConsoleSwitches (void) {
+  if (virtualTerminalNumber) return 0;
+  return !!activeConsoleMonitor;
+}
+
 static int
 setScreenName (void) {
   static const char *const names[] = {"vcsa", "vcsa0", "vcc/a", NULL};
@@ -756,6 +824,7 @@ setCurrentScreen (unsigned char vt) {
 
   screenMonitor = NULL;
   screenUpdated = 1;
+  consoleSwitched = 1;
   return 1;
 }
 
@@ -1203,7 +1272,7 @@ readScreenRow (int row, size_t size, ScreenCharacter *characters, int *offsets)
 }
 
 static void
-adjustCursorColumn (short *column, short row, short columns) {
+adjustCursorColumn (int *column, int row, int columns) {
   int offsets[columns];
 
   if (readScreenRow(row, columns, NULL, offsets)) {
@@ -1389,6 +1458,11 @@ construct_LinuxScreen (void) {
   inTextMode = 1;
   startTimePeriod(&mappingRecalculationTimer, 4000);
 
+  activeConsoleNumber = 0;
+  consoleSwitched = 1;
+  consoleProblem = NULL;
+  startTimePeriod(&textModeTimer, 1000);
+
   brailleDeviceOfflineListener = NULL;
 
 #ifdef HAVE_LINUX_INPUT_H
@@ -1408,6 +1482,7 @@ construct_LinuxScreen (void) {
 
       if (openMainConsole()) {
         if (setCurrentScreen(virtualTerminalNumber)) {
+          openActiveConsole();
           openKeyboard();
           brailleDeviceOfflineListener = registerReportListener(REPORT_BRAILLE_DEVICE_OFFLINE, lxBrailleDeviceOfflineListener, NULL);
           return 1;
@@ -1416,6 +1491,7 @@ construct_LinuxScreen (void) {
     }
   }
 
+  closeActiveConsole();
   closeCurrentConsole();
   closeCurrentScreen();
   closeMainConsole();
@@ -1429,6 +1505,7 @@ destruct_LinuxScreen (void) {
     brailleDeviceOfflineListener = NULL;
   }
 
+  closeActiveConsole();
   closeCurrentConsole();
   consoleName = NULL;
 
@@ -1458,6 +1535,25 @@ destruct_LinuxScreen (void) {
   closeMainConsole();
 }
 
+ASYNC_MONITOR_CALLBACK(lxActiveConsoleChanged) {
+  asyncDiscardHandle(activeConsoleMonitor);
+  activeConsoleMonitor = NULL;
+
+  if (parameters->error) {
+    logActionError(parameters->error, "active console monitor");
+    closeActiveConsole();
+  } else if (!readActiveConsole()) {
+    closeActiveConsole();
+  } else if (activeConsoleNumber == currentConsoleNumber) {
+    return 0;
+  }
+
+  consoleSwitched = 1;
+  screenUpdated = 1;
+  mainScreenUpdated();
+  return 0;
+}
+
 ASYNC_MONITOR_CALLBACK(lxScreenUpdated) {
   asyncDiscardHandle(screenMonitor);
   screenMonitor = NULL;
@@ -1475,6 +1571,13 @@ poll_LinuxScreen (void) {
              !asyncMonitorFileAlert(&screenMonitor, screenDescriptor,
                                     lxScreenUpdated, NULL);
 
+  if (activeConsoleDescriptor != -1) {
+    if (!activeConsoleMonitor) {
+      asyncMonitorFileAlert(&activeConsoleMonitor, activeConsoleDescriptor,
+                            lxActiveConsoleChanged, NULL);
+    }
+  }
+
   if (poll) screenUpdated = 1;
   return poll;
 }
@@ -1547,6 +1650,8 @@ getConsoleNumber (void) {
 
   if (virtualTerminalNumber) {
     console = virtualTerminalNumber;
+  } else if (isTrackingConsoleSwitches()) {
+    console = activeConsoleNumber;
   } else {
     struct vt_stat state;
     if (!getConsoleState(&state)) return NO_CONSOLE;
@@ -1575,10 +1680,11 @@ testTextMode (void) {
   if (problemText) return 0;
   int mode;
 
+  restartTimePeriod(&textModeTimer);
+
   if (controlCurrentConsole(KDGETMODE, &mode) == -1) {
     logSystemError("ioctl[KDGETMODE]");
   } else if (mode == KD_TEXT) {
-    if (afterTimePeriod(&mappingRecalculationTimer, NULL)) setTranslationTable(0);
     return 1;
   }
 
@@ -1603,6 +1709,14 @@ refreshCache (void) {
 static int
 refresh_LinuxScreen (void) {
   if (screenUpdated) {
+    /* When console switches are being tracked via sysfs, the console number
+     * and the text mode only need to be rechecked after a switch or while
+     * there's a problem. The mode is also rechecked periodically in case it
+     * changes without a switch.
+     */
+    int checkConsole = consoleSwitched || consoleProblem || !isTrackingConsoleSwitches();
+    consoleSwitched = 0;
+
     while (1) {
       problemText = NULL;
 
@@ -1611,6 +1725,11 @@ refresh_LinuxScreen (void) {
         goto done;
       }
 
+      if (!checkConsole) {
+        problemText = consoleProblem;
+        break;
+      }
+
       {
         int consoleNumber = getConsoleNumber();
         if (consoleNumber == currentConsoleNumber) break;
@@ -1623,7 +1742,15 @@ refresh_LinuxScreen (void) {
       }
     }
 
-    inTextMode = testTextMode();
+    if (checkConsole || !inTextMode || afterTimePeriod(&textModeTimer, NULL)) {
+      inTextMode = testTextMode();
+      consoleProblem = problemText;
+    }
+
+    if (inTextMode) {
+      if (afterTimePeriod(&mappingRecalculationTimer, NULL)) setTranslationTable(0);
+    }
+
     screenUpdated = 0;
 
   done:
@@ -412,12 +412,20 @@ static int
 refresh_TerminalEmulatorScreen (void) {
   if (!screenSegment) return 0;
   size_t size = screenSegment->segmentSize;
+  int haveGeneration = haveScreenUpdateGeneration(screenSegment);
 
   if (cachedSegment) {
     if (cachedSegment->segmentSize != size) {
       logMessage(LOG_CATEGORY(SCREEN_DRIVER), "deallocating old screen cache");
       free(cachedSegment);
       cachedSegment = NULL;
+    } else if (haveGeneration) {
+      uint32_t generation = screenSegment->updateGeneration;
+
+      if (!(generation & 1) && (generation == cachedSegment->updateGeneration)) {
+        // it hasn't changed since it was last copied
+        return 1;
+      }
     }
   }
 
@@ -430,7 +438,33 @@ refresh_TerminalEmulatorScreen (void) {
     }
   }
 
-  memcpy(cachedSegment, screenSegment, size);
+  if (!haveGeneration) {
+    memcpy(cachedSegment, screenSegment, size);
+    return 1;
+  }
+
+  // Copy it again if the emulator changed it during the copy. A copy made
+  // while it's being changed (an odd generation) won't be reused.
+  unsigned int attempts = 3;
+
+  while (1) {
+    uint32_t generation = screenSegment->updateGeneration;
+    __sync_synchronize();
+
+    memcpy(cachedSegment, screenSegment, size);
+    __sync_synchronize();
+
+    if (generation == screenSegment->updateGeneration) {
+      cachedSegment->updateGeneration = generation;
+      break;
+    }
+
+    if (!--attempts) {
+      cachedSegment->updateGeneration = generation | 1;
+      break;
+    }
+  }
+
   return 1;
 }
 
@@ -474,6 +508,36 @@ setScreenAttribute (ScreenAttributes *attributes, ScreenAttributes attribute, un
   }
 }
 
+static ScreenAttributes
+getScreenAttributes (const ScreenSegmentCharacter *character) {
+  ScreenAttributes attributes = 0;
+  if (character->blink) attributes |= SCR_ATTR_BLINK;
+
+  setScreenAttribute(&attributes, SCR_ATTR_FG_RED,   character->foreground.red,   1);
+  setScreenAttribute(&attributes, SCR_ATTR_FG_GREEN, character->foreground.green, 1);
+  setScreenAttribute(&attributes, SCR_ATTR_FG_BLUE,  character->foreground.blue,  1);
+
+  setScreenAttribute(&attributes, SCR_ATTR_BG_RED,   character->background.red,   0);
+  setScreenAttribute(&attributes, SCR_ATTR_BG_GREEN, character->background.green, 0);
+  setScreenAttribute(&attributes, SCR_ATTR_BG_BLUE,  character->background.blue,  0);
+
+  return attributes;
+}
+
+static inline int
+isSameColor (const ScreenSegmentColor *color1, const ScreenSegmentColor *color2) {
+  return (color1->red == color2->red)
+      && (color1->green == color2->green)
+      && (color1->blue == color2->blue);
+}
+
+static inline int
+haveSameAttributes (const ScreenSegmentCharacter *character1, const ScreenSegmentCharacter *character2) {
+  return (character1->blink == character2->blink)
+      && isSameColor(&character1->foreground, &character2->foreground)
+      && isSameColor(&character1->background, &character2->background);
+}
+
 static int
 readCharacters_TerminalEmulatorScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   ScreenSegmentHeader *segment = getSegment();
@@ -486,27 +550,25 @@ readCharacters_TerminalEmulatorScreen (const ScreenBox *box, ScreenCharacter *bu
   if (validateScreenBox(box, segment->screenWidth, segment->screenHeight)) {
     ScreenCharacter *target = buffer;
 
+    // Colours usually come in runs, so only convert them when they change.
+    // They're compared with a copy since the segment may be changing.
+    ScreenSegmentCharacter previous = {.blink = 0};
+    ScreenAttributes attributes = getScreenAttributes(&previous);
+
     for (unsigned int row=0; row<box->height; row+=1) {
       const ScreenSegmentCharacter *source =
         getScreenCharacter(segment, box->top + row, box->left, NULL);
+      const ScreenSegmentCharacter *end = source + box->width;
 
-      for (unsigned int column=0; column<box->width; column+=1) {
-        target->text = source->text;
-
-        {
-          ScreenAttributes *attributes = &target->attributes;
-          *attributes = 0;
-          if (source->blink) *attributes |= SCR_ATTR_BLINK;
-
-          setScreenAttribute(attributes, SCR_ATTR_FG_RED,   source->foreground.red,   1);
-          setScreenAttribute(attributes, SCR_ATTR_FG_GREEN, source->foreground.green, 1);
-          setScreenAttribute(attributes, SCR_ATTR_FG_BLUE,  source->foreground.blue,  1);
-
-          setScreenAttribute(attributes, SCR_ATTR_BG_RED,   source->background.red,   0);
-          setScreenAttribute(attributes, SCR_ATTR_BG_GREEN, source->background.green, 0);
-          setScreenAttribute(attributes, SCR_ATTR_BG_BLUE,  source->background.blue,  0);
+      while (source < end) {
+        if (!haveSameAttributes(source, &previous)) {
+          previous = *source;
+          attributes = getScreenAttributes(&previous);
         }
 
+        target->text = source->text;
+        target->attributes = attributes;
+
         source += 1;
         target += 1;
       }
@@ -529,6 +591,32 @@ insertKey_TerminalEmulatorScreen (ScreenKey key) {
   return sendTerminalMessage(TERM_MSG_INPUT_TEXT, utf8, length);
 }
 
+static int
+insertCharacters_TerminalEmulatorScreen (const wchar_t *characters, size_t count) {
+  // the emulator accepts up to 0X200 bytes of text per message
+  char buffer[0X200];
+  size_t length = 0;
+
+  const wchar_t *character = characters;
+  const wchar_t *end = character + count;
+
+  while (character < end) {
+    Utf8Buffer utf8;
+    size_t size = convertWcharToUtf8(*character++, utf8);
+
+    if ((length + size) > sizeof(buffer)) {
+      if (!sendTerminalMessage(TERM_MSG_INPUT_TEXT, buffer, length)) return 0;
+      length = 0;
+    }
+
+    memcpy(&buffer[length], utf8, size);
+    length += size;
+  }
+
+  if (!length) return 1;
+  return sendTerminalMessage(TERM_MSG_INPUT_TEXT, buffer, length);
+}
+
 static void
 scr_initialize (MainScreen *main) {
   initializeRealScreen(main);
@@ -536,6 +624,7 @@ scr_initialize (MainScreen *main) {
   main->base.describe = describe_TerminalEmulatorScreen;
   main->base.readCharacters = readCharacters_TerminalEmulatorScreen;
   main->base.insertKey = insertKey_TerminalEmulatorScreen;
+  main->base.insertCharacters = insertCharacters_TerminalEmulatorScreen;
   main->base.poll = poll_TerminalEmulatorScreen;
   main->base.refresh = refresh_TerminalEmulatorScreen;
 
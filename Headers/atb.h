@@ -35,9 +35,11 @@ extern void destroyAttributesTable (AttributesTable *table);
 extern char *ensureAttributesTableExtension (const char *path);
 extern char *makeAttributesTablePath (const char *directory, const char *name);
 
+extern void installAttributesTable (AttributesTable *table);
 extern int replaceAttributesTable (const char *directory, const char *name);
 
 extern unsigned char convertAttributesToDots (AttributesTable *table, unsigned char attributes);
+extern const unsigned char *getAttributesToDotsMap (AttributesTable *table);
 
 #ifdef __cplusplus
 }
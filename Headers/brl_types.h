@@ -23,6 +23,7 @@
 #include "ctb_types.h"
 #include "ktb_types.h"
 #include "gio_types.h"
+#include "timing_types.h"
 #include "queue.h"
 #include "async_types_handle.h"
 
@@ -50,7 +51,8 @@ typedef enum {
 
 typedef enum {
   BRL_TYPING_TEXT,
-  BRL_TYPING_DOTS
+  BRL_TYPING_DOTS,
+  BRL_TYPING_CONTRACTED
 } BrailleTypingMode;
 
 typedef struct BrailleDisplayStruct BrailleDisplay;
@@ -103,6 +105,7 @@ struct BrailleDisplayStruct {
 
   GioEndpoint *gioEndpoint;
   unsigned int writeDelay;
+  TimeValue writeDrainTime;
 
   unsigned char *buffer;
   void (*bufferResized) (unsigned int rows, unsigned int columns);
@@ -20,13 +20,20 @@
 #define BRLTTY_INCLUDED_BRL_UTILS
 
 #include "brl_types.h"
+#include "async_types_alarm.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
+extern int getBrailleOutputDelay (BrailleDisplay *brl);
 extern void drainBrailleOutput (BrailleDisplay *brl, int minimumDelay);
 
+extern int whenBrailleOutputDrained (
+  BrailleDisplay *brl, AsyncHandle *handle,
+  AsyncAlarmCallback *callback, void *data
+);
+
 extern void announceBrailleOffline (void);
 extern void announceBrailleOnline (void);
 
@@ -49,6 +49,9 @@ isClipboardEmpty (ClipboardObject *cpb) {
 extern int addClipboardHistory (ClipboardObject *cpb, const wchar_t *characters, size_t length);
 extern const wchar_t *getClipboardHistory (ClipboardObject *cpb, unsigned int index, size_t *length);
 
+extern int saveClipboardHistory (ClipboardObject *cpb, const char *path);
+extern int restoreClipboardHistory (ClipboardObject *cpb, const char *path);
+
 extern ClipboardObject *getMainClipboard (void);
 extern void lockMainClipboard (void);
 extern void unlockMainClipboard (void);
@@ -56,6 +59,7 @@ extern void unlockMainClipboard (void);
 extern void onMainClipboardUpdated (void);
 extern int setMainClipboardContent (const char *content);
 extern char *getMainClipboardContent (void);
+extern int persistMainClipboardHistory (void);
 
 #ifdef __cplusplus
 }
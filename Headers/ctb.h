@@ -38,6 +38,7 @@ extern char *ensureContractionTableExtension (const char *path);
 extern char *makeContractionTablePath (const char *directory, const char *name);
 
 extern char *getContractionTableForLocale (const char *directory);
+extern void installContractionTable (ContractionTable *table);
 extern int replaceContractionTable (const char *directory, const char *name);
 
 extern void contractText (
@@ -51,6 +52,22 @@ extern void contractText (
   int cursorOffset /* Position of coursor in source */
 );
 
+extern int startContractionTableProfile (ContractionTable *table);
+extern void stopContractionTableProfile (ContractionTable *table);
+extern void getContractionTableProfileTotals (ContractionTable *table, unsigned long *attempts, unsigned long *matches);
+extern int writeContractionTableProfile (ContractionTable *table, const char *path);
+extern int applyContractionTableProfile (ContractionTable *table, const char *path);
+
+typedef struct ContractedInputStruct ContractedInput;
+extern ContractedInput *newContractedInput (void);
+extern void destroyContractedInput (ContractedInput *ci);
+extern unsigned int getContractedInputCellCount (ContractedInput *ci);
+extern int addContractedInputCell (ContractedInput *ci, ContractionTable *table, unsigned char cell);
+extern int removeContractedInputCell (ContractedInput *ci);
+extern size_t finishContractedInput (ContractedInput *ci, ContractionTable *table, wchar_t *characters, size_t size);
+
+extern void getContractionTableCharacterStatistics (ContractionTable *table, ContractionTableCharacterStatistics *statistics);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
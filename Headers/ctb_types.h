@@ -32,6 +32,13 @@ typedef enum {
   CTB_CAP_DOT7
 } CTB_CapitalizationMode;
 
+typedef struct {
+  unsigned int input;
+  unsigned int output;
+  unsigned int horizon;
+  unsigned char opcode;
+} ContractionResyncPoint;
+
 typedef struct {
   struct {
     wchar_t *characters;
@@ -53,11 +60,25 @@ typedef struct {
     unsigned int count;
   } offsets;
 
+  struct {
+    ContractionResyncPoint *array;
+    unsigned int size;
+    unsigned int count;
+    const void *table;
+  } resync;
+
   int cursorOffset;
   unsigned char expandCurrentWord;
   unsigned char capitalizationMode;
 } ContractionCache;
 
+typedef struct {
+  unsigned int preparedPages;
+  unsigned int addedPages;
+  unsigned int otherCharacters;
+  unsigned long lockedLookups;
+} ContractionTableCharacterStatistics;
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
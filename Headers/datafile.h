@@ -27,6 +27,12 @@
 extern "C" {
 #endif /* __cplusplus */
 
+extern void lockDataFiles (void);
+extern void unlockDataFiles (void);
+extern void forgetProcessedDataFiles (void);
+extern void rememberProcessedDataFile (const char *path);
+extern char **getProcessedDataFiles (void);
+
 extern int setBaseDataVariables (const VariableInitializer *initializers);
 extern int setTableDataVariables (const char *tableExtension, const char *subtableExtension);
 
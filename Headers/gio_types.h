@@ -85,6 +85,7 @@ typedef struct {
 
   struct {
     const HidModelEntry *modelTable;
+    uint16_t usagePage;
     GioOptions options;
   } hid;
 
@@ -104,6 +105,7 @@ typedef enum {
   GIO_TYPE_BLUETOOTH,
   GIO_TYPE_HID,
   GIO_TYPE_NULL,
+  GIO_TYPE_EMULATOR,
 } GioTypeIdentifier;
 
 typedef struct {
@@ -19,10 +19,47 @@
 #ifndef BRLTTY_INCLUDED_HID_BRAILLE
 #define BRLTTY_INCLUDED_HID_BRAILLE
 
+#include "hid_types.h"
+#include "hid_defs.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
+#define HID_BRAILLE_BUTTON_COUNT (HID_USG_BRL_RockerPress - HID_USG_BRL_KeyboardDot1 + 1)
+#define HID_BRAILLE_ROUTER_LIMIT 0X100
+
+typedef struct {
+  unsigned char buttons[HID_BRAILLE_BUTTON_COUNT];
+  unsigned char routers[HID_BRAILLE_ROUTER_LIMIT];
+} HidBrailleKeys;
+
+typedef struct HidBrailleLayoutStruct HidBrailleLayout;
+
+extern HidBrailleLayout *hidNewBrailleLayout (const HidItemsDescriptor *items);
+extern void hidDestroyBrailleLayout (HidBrailleLayout *layout);
+
+extern unsigned int hidGetBrailleCellCount (const HidBrailleLayout *layout);
+extern unsigned int hidGetBrailleRouterCount (const HidBrailleLayout *layout);
+extern int hidHasBrailleButton (const HidBrailleLayout *layout, unsigned int button);
+
+extern size_t hidGetBrailleInputSize (const HidBrailleLayout *layout, HidReportIdentifier identifier);
+extern size_t hidGetBrailleOutputSize (const HidBrailleLayout *layout);
+
+extern int hidDecodeBrailleInput (
+  const HidBrailleLayout *layout, HidBrailleKeys *keys,
+  const unsigned char *report, size_t size
+);
+
+extern size_t hidEncodeBrailleOutput (
+  const HidBrailleLayout *layout,
+  const unsigned char *cells, unsigned int count,
+  unsigned char *report, size_t size
+);
+
+typedef int HidBrailleLayoutLister (const char *line, void *data);
+extern int hidListBrailleLayout (const HidBrailleLayout *layout, HidBrailleLayoutLister *listLine, void *data);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -50,6 +50,8 @@ extern int hidReportSize (
   HidReportSize *size
 );
 
+extern int hidHasUsagePage (const HidItemsDescriptor *items, HidUnsignedValue page);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -43,6 +43,7 @@ typedef struct {
 typedef struct {
   HidDeviceIdentifier vendorIdentifier;
   HidDeviceIdentifier productIdentifier;
+  uint16_t usagePage;
 } HidCommonProperties;
 
 typedef struct {
@@ -76,6 +76,8 @@ extern ssize_t gioAskResource (
   void *buffer, uint16_t size
 );
 
+extern const HidItemsDescriptor *gioGetHidItems (GioEndpoint *endpoint);
+
 extern int gioGetHidReportSize (
   GioEndpoint *endpoint,
   HidReportIdentifier identifier,
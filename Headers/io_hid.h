@@ -45,7 +45,7 @@ extern int hidOpenDeviceWithFilter (
 );
 
 extern int hidOpenDeviceWithParameters (
-  HidDevice **device, const char *string
+  HidDevice **device, const char *string, uint16_t usagePage
 );
 
 extern void hidCloseDevice (HidDevice *device);
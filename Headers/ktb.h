@@ -65,6 +65,7 @@ extern void setKeyTableLogLabel (KeyTable *table, const char *label);
 extern void setLogKeyEventsFlag (KeyTable *table, const unsigned char *flag);
 extern void setKeyboardEnabledFlag (KeyTable *table, const unsigned char *flag);
 extern void setKeyAutoreleaseTime (KeyTable *table, unsigned char setting);
+extern const KeyTableStatistics *getKeyTableStatistics (KeyTable *table);
 
 extern void getKeyGroupCommands (KeyTable *table, KeyGroup group, int *commands, unsigned int size);
 extern int *getBoundCommands (KeyTable *table, unsigned int *count);
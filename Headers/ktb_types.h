@@ -79,6 +79,14 @@ typedef enum {
 
 typedef struct KeyTableStruct KeyTable;
 
+typedef struct {
+  unsigned long keyEvents;
+  unsigned long hotkeyLookups;
+  unsigned long hotkeySearches;
+  unsigned long bindingLookups;
+  unsigned long bindingSearches;
+} KeyTableStatistics;
+
 typedef enum {
   KTB_CTX_MENU,
   KTB_CTX_WAITING,
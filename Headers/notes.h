@@ -59,6 +59,8 @@ extern const NoteMethods midiNoteMethods;
 extern const NoteMethods fmNoteMethods;
 
 extern char *opt_pcmDevice;
+extern void releasePcmTones (void);
+
 extern char *opt_midiDevice;
 
 #ifdef __cplusplus
@@ -29,6 +29,7 @@ extern "C" {
 extern int ptyBeginScreen (PtyObject *pty, int driverDirectives);
 extern void ptyEndScreen (void);
 extern void ptyRefreshScreen (void);
+extern void ptyBeginScreenUpdate (void);
 
 extern void ptySetCursorPosition (unsigned int row, unsigned int column);
 extern void ptySetCursorRow (unsigned int row);
@@ -41,7 +41,10 @@ typedef struct {
   void (*describe) (ScreenDescription *);
 
   int (*readCharacters) (const ScreenBox *box, ScreenCharacter *buffer);
+  int (*readText) (const ScreenBox *box, wchar_t *buffer);
+  int (*getRowLength) (int row, int *length); /* the rest of the row is blank */
   int (*insertKey) (ScreenKey key);
+  int (*insertCharacters) (const wchar_t *characters, size_t count);
   int (*routeCursor) (int column, int row, int screen);
 
   int (*highlightRegion) (int left, int right, int top, int bottom);
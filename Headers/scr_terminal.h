@@ -75,6 +75,9 @@ typedef struct {
 
   uint32_t charactersOffset;
   uint32_t characterSize;
+
+  // odd while the emulator is changing the screen
+  uint32_t updateGeneration;
 } ScreenSegmentHeader;
 
 extern int getScreenSegment (int *identifier, key_t key);
@@ -85,6 +88,11 @@ extern ScreenSegmentHeader *getScreenSegmentForKey (key_t key);
 extern ScreenSegmentHeader *getScreenSegmentForPath (const char *path);
 extern void logScreenSegment (const ScreenSegmentHeader *segment);
 
+static inline int
+haveScreenUpdateGeneration (const ScreenSegmentHeader *segment) {
+  return segment->headerSize >= (offsetof(ScreenSegmentHeader, updateGeneration) + sizeof(segment->updateGeneration));
+}
+
 static inline int
 haveScreenRowArray (const ScreenSegmentHeader *segment) {
   return !!segment->rowsOffset;
@@ -84,16 +84,16 @@ typedef struct {
   ScreenContentQuality quality;
 
   int number;		      /* screen number */
-  short cols, rows;	/* screen dimensions */
-  short posx, posy;	/* cursor position */
+  int cols, rows;	/* screen dimensions */
+  int posx, posy;	/* cursor position */
 
   unsigned char hasCursor:1;
   unsigned char hasSelection:1;
 } ScreenDescription;
 
 typedef struct {
-  short left, top;	/* top-left corner (offset from 0) */
-  short width, height;	/* dimensions */
+  int left, top;	/* top-left corner (offset from 0) */
+  int width, height;	/* dimensions */
 } ScreenBox;
 
 #define SCR_KEY_SHIFT     0X40000000
@@ -0,0 +1,54 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_SCRATCH
+#define BRLTTY_INCLUDED_SCRATCH
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct ScratchBlockStruct ScratchBlock;
+
+typedef struct {
+  ScratchBlock *block;
+  size_t used;
+  size_t inUse;
+} ScratchMark;
+
+extern void *allocateScratch (size_t size);
+#define allocateScratchArray(array, count) ((array) = allocateScratch(ARRAY_SIZE((array), (count))))
+
+extern void getScratchMark (ScratchMark *mark);
+extern void releaseScratch (const ScratchMark *mark);
+
+typedef struct {
+  size_t inUse;
+  size_t highWater;
+  size_t capacity;
+  unsigned long allocations;
+  unsigned long blockAllocations;
+} ScratchStatistics;
+
+extern void getScratchStatistics (ScratchStatistics *statistics);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_SCRATCH */
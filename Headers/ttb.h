@@ -36,6 +36,7 @@ extern char *ensureTextTableExtension (const char *path);
 extern char *makeTextTablePath (const char *directory, const char *name);
 
 extern char *getTextTableForLocale (const char *directory);
+extern void installTextTable (TextTable *table);
 extern int replaceTextTable (const char *directory, const char *name);
 
 extern unsigned char convertCharacterToDots (TextTable *table, wchar_t character);
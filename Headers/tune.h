@@ -48,7 +48,8 @@ typedef struct {
 extern void suppressTuneDeviceOpenErrors (void);
 
 typedef enum {
-  TPO_FREE = 0X01,
+  TPO_FREE      = 0X01,
+  TPO_INTERRUPT = 0X02, /* stop the current tune and discard pending ones */
 } TunePlayOptions;
 
 extern int tuneSetDevice (TuneDevice device);
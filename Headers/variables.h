@@ -38,6 +38,9 @@ extern VariableNestingLevel *claimVariableNestingLevel (VariableNestingLevel *vn
 extern void releaseVariableNestingLevel (VariableNestingLevel *vnl);
 
 extern void listVariables (VariableNestingLevel *from);
+
+typedef void VariableHandler (const Variable *variable, void *data);
+extern void visitVariables (VariableNestingLevel *vnl, VariableHandler *handleVariable, void *data);
 extern const Variable *findReadableVariable (VariableNestingLevel *vnl, const wchar_t *name, int length);
 extern Variable *findWritableVariable (VariableNestingLevel *vnl, const wchar_t *name, int length);
 
@@ -19,6 +19,9 @@
 #include "prologue.h"
 
 #include "alert.h"
+#include "timing.h"
+#include "async_handle.h"
+#include "async_alarm.h"
 #include "program.h"
 #include "prefs.h"
 #include "tune.h"
@@ -37,29 +40,75 @@ typedef struct {
   BrlDots pattern;
 } TactileAlert;
 
+typedef enum {
+  AGR_NONE, // only identical alerts are coalesced
+  AGR_EDGE,
+  AGR_COMMAND,
+  AGR_BRAILLE,
+  AGR_TOGGLE,
+  AGR_CURSOR,
+  AGR_FREEZE,
+  AGR_ROUTING,
+  AGR_MODIFIER,
+  AGR_CONTEXT,
+  AGR_BELL,
+  AGR_WARNING,
+} AlertGroup;
+
+typedef enum {
+  AP_LOW,
+  AP_NORMAL,
+  AP_HIGH,
+} AlertPriority;
+
+typedef struct {
+  unsigned char priority;
+  unsigned short interval; /* minimum milliseconds between tune starts */
+} AlertGroupEntry;
+
+static const AlertGroupEntry alertGroupTable[] = {
+  [AGR_NONE]     = {.priority = AP_NORMAL},
+  [AGR_EDGE]     = {.priority = AP_LOW, .interval = 150},
+  [AGR_COMMAND]  = {.priority = AP_NORMAL},
+  [AGR_BRAILLE]  = {.priority = AP_HIGH},
+  [AGR_TOGGLE]   = {.priority = AP_NORMAL},
+  [AGR_CURSOR]   = {.priority = AP_NORMAL},
+  [AGR_FREEZE]   = {.priority = AP_NORMAL},
+  [AGR_ROUTING]  = {.priority = AP_NORMAL},
+  [AGR_MODIFIER] = {.priority = AP_NORMAL},
+  [AGR_CONTEXT]  = {.priority = AP_NORMAL},
+  [AGR_BELL]     = {.priority = AP_LOW, .interval = 250},
+  [AGR_WARNING]  = {.priority = AP_HIGH},
+};
+
 typedef struct {
   const char *tune;
   const char *message;
   TactileAlert tactile;
+  unsigned char group;
 } AlertEntry;
 
 #define ALERT_TACTILE(d,p) {.duration=(d), .pattern=(p)}
 
 static const AlertEntry alertTable[] = {
   [ALERT_BRAILLE_ON] = {
+    .group = AGR_BRAILLE,
     .tune = "m64@60 m69@100"
   },
 
   [ALERT_BRAILLE_OFF] = {
+    .group = AGR_BRAILLE,
     .tune = "m64@60 m57@60"
   },
 
   [ALERT_COMMAND_DONE] = {
+    .group = AGR_COMMAND,
     .message = strtext("Done"),
     .tune = "m74@40 r@30 m74@40 r@40 m74@140 r@20 m79@50"
   },
 
   [ALERT_COMMAND_REJECTED] = {
+    .group = AGR_COMMAND,
     .tactile = ALERT_TACTILE(50, BRL_DOT_1 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_6),
     .tune = "m78@100"
   },
@@ -82,43 +131,52 @@ static const AlertEntry alertTable[] = {
   },
 
   [ALERT_TOGGLE_ON] = {
+    .group = AGR_TOGGLE,
     .tactile = ALERT_TACTILE(30, BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_4 | BRL_DOT_5),
     .tune = "m74@30 r@30 m79@30 r@30 m86@30"
   },
 
   [ALERT_TOGGLE_OFF] = {
+    .group = AGR_TOGGLE,
     .tactile = ALERT_TACTILE(30, BRL_DOT_3 | BRL_DOT_7 | BRL_DOT_6 | BRL_DOT_8),
     .tune = "m86@30 r@30 m79@30 r@30 m74@30"
   },
 
   [ALERT_CURSOR_LINKED] = {
+    .group = AGR_CURSOR,
     .tune = "m80@7 m79@7 m76@12"
   },
 
   [ALERT_CURSOR_UNLINKED] = {
+    .group = AGR_CURSOR,
     .tune = "m78@7 m79@7 m83@20"
   },
 
   [ALERT_SCREEN_FROZEN] = {
+    .group = AGR_FREEZE,
     .message = strtext("Frozen"),
     .tune = "m58@5 m59 m60 m61 m62 m63 m64 m65 m66 m67 m68 m69 m70 m71 m72 m73 m74 m76 m78 m80 m83 m86 m90 m95"
   },
 
   [ALERT_SCREEN_UNFROZEN] = {
+    .group = AGR_FREEZE,
     .message = strtext("Unfrozen"),
     .tune = "m95@5 m90 m86 m83 m80 m78 m76 m74 m73 m72 m71 m70 m69 m68 m67 m66 m65 m64 m63 m62 m61 m60 m59 m58"
   },
 
   [ALERT_FREEZE_REMINDER] = {
+    .group = AGR_FREEZE,
     .tune = "m60@50 r@30 m60@50"
   },
 
   [ALERT_WRAP_DOWN] = {
+    .group = AGR_EDGE,
     .tactile = ALERT_TACTILE(20, BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_8),
     .tune = "m86@6 m74@6 m62@6 m50@10"
   },
 
   [ALERT_WRAP_UP] = {
+    .group = AGR_EDGE,
     .tactile = ALERT_TACTILE(20, BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_7),
     .tune = "m50@6 m62@6 m74@6 m86@10"
   },
@@ -137,40 +195,49 @@ static const AlertEntry alertTable[] = {
   },
 
   [ALERT_BOUNCE] = {
+    .group = AGR_EDGE,
     .tactile = ALERT_TACTILE(50, BRL_DOT_1 | BRL_DOT_2 | BRL_DOT_3 | BRL_DOT_4 | BRL_DOT_5 | BRL_DOT_6 | BRL_DOT_7 | BRL_DOT_8),
     .tune = "m98@6 m86@6 m74@6 m62@6 m50@10"
   },
 
   [ALERT_ROUTING_STARTED] = {
+    .group = AGR_ROUTING,
     .tune = "m55@10 r@60 m60@15"
   },
 
   [ALERT_ROUTING_SUCCEEDED] = {
+    .group = AGR_ROUTING,
     .tune = "m64@60 m76@20"
   },
 
   [ALERT_ROUTING_FAILED] = {
+    .group = AGR_ROUTING,
     .tune = "m80@80 m79@90 m78@100 m77@100 r@20 m77@100 r@20 m77@150"
   },
 
   [ALERT_MODIFIER_ONCE] = {
+    .group = AGR_MODIFIER,
     .tune = "m70@60 m74@60 m77@90"
   },
 
   [ALERT_MODIFIER_LOCK] = {
+    .group = AGR_MODIFIER,
     .tune = "m70@60 m74@60 m77@60 m82@90"
   },
 
   [ALERT_MODIFIER_OFF] = {
+    .group = AGR_MODIFIER,
     .tune = "m82@60 m77@60 m74@60 m70@90"
   },
 
   [ALERT_CONSOLE_BELL] = {
+    .group = AGR_BELL,
     .message = strtext("Console Bell"),
     .tune = "m78@100"
   },
 
   [ALERT_KEYS_AUTORELEASED] = {
+    .group = AGR_WARNING,
     .message = strtext("Autorelease"),
     .tune = "c6@50 b- g e- p50 c@100 c c"
   },
@@ -180,24 +247,52 @@ static const AlertEntry alertTable[] = {
   },
 
   [ALERT_CONTEXT_DEFAULT] = {
+    .group = AGR_CONTEXT,
     .tune = "m76@60 m73@60 m69@60 m66@90"
   },
 
   [ALERT_CONTEXT_PERSISTENT] = {
+    .group = AGR_CONTEXT,
     .tune = "m66@60 m69@60 m73@60 m76@90"
   },
 
   [ALERT_CONTEXT_TEMPORARY] = {
+    .group = AGR_CONTEXT,
     .tune = "m66@60 m69@60 m73@90"
   },
 };
 
 static ToneElement *tuneTable[ARRAY_COUNT(alertTable)] = {NULL};
+static int tuneDurations[ARRAY_COUNT(alertTable)];
 static TuneBuilder *tuneBuilder = NULL;
 static ToneElement emptyTune[] = {TONE_STOP()};
 
+// Alert tunes aren't sent to the tune thread as soon as they're requested.
+// They're held here (at most once each) until the one that's playing has
+// finished so that a burst of alerts can't queue a backlog of tunes.
+typedef struct {
+  unsigned long int sequence; /* zero when not pending */
+  TimeValue started;          /* when its tune was last started */
+} AlertState;
+
+static AlertState alertStates[ARRAY_COUNT(alertTable)];
+static unsigned long int alertSequence = 0;
+
+static struct {
+  AlertIdentifier identifier; /* ALERT_NONE when nothing is playing */
+  TimeValue end;
+  AsyncHandle alarm;
+} alertPlayer = {
+  .identifier = ALERT_NONE
+};
+
 static void
 exitAlertTunes (void *data) {
+  if (alertPlayer.alarm) {
+    asyncCancelRequest(alertPlayer.alarm);
+    alertPlayer.alarm = NULL;
+  }
+
   tuneSynchronize();
 
   {
@@ -233,34 +328,190 @@ getTuneBuilder (void) {
   return tuneBuilder;
 }
 
-void
-alert (AlertIdentifier identifier) {
-  if (identifier < ARRAY_COUNT(alertTable)) {
-    const AlertEntry *alert = &alertTable[identifier];
+static const ToneElement *
+getAlertTune (AlertIdentifier identifier) {
+  ToneElement **tune = &tuneTable[identifier];
 
-    if (prefs.alertTunes && alert->tune && *alert->tune) {
-      ToneElement **tune = &tuneTable[identifier];
+  if (!*tune) {
+    TuneBuilder *tb = getTuneBuilder();
 
-      if (!*tune) {
-        TuneBuilder *tb = getTuneBuilder();
+    if (tb) {
+      setTuneSourceName(tb, "alert");
+      setTuneSourceIndex(tb, identifier);
 
-        if (tb) {
-          setTuneSourceName(tb, "alert");
-          setTuneSourceIndex(tb, identifier);
+      if (parseTuneString(tb, "p100")) {
+        if (parseTuneString(tb, alertTable[identifier].tune)) {
+          *tune = getTune(tb);
+        }
+      }
 
-          if (parseTuneString(tb, "p100")) {
-            if (parseTuneString(tb, alert->tune)) {
-              *tune = getTune(tb);
-            }
-          }
+      resetTuneBuilder(tb);
+    }
 
-          resetTuneBuilder(tb);
-        }
+    if (!*tune) *tune = emptyTune;
+
+    {
+      int duration = 0;
+      const ToneElement *tone = *tune;
+
+      while (tone->duration) duration += (tone++)->duration;
+      tuneDurations[identifier] = duration;
+    }
+  }
+
+  return *tune;
+}
+
+static const AlertGroupEntry *
+getAlertGroup (AlertIdentifier identifier) {
+  return &alertGroupTable[alertTable[identifier].group];
+}
+
+static int
+getAlertDelay (AlertIdentifier identifier, const TimeValue *now) {
+  int interval = getAlertGroup(identifier)->interval;
+  if (!interval) return 0;
+
+  unsigned char group = alertTable[identifier].group;
+  int delay = 0;
+
+  for (AlertIdentifier member=0; member<ARRAY_COUNT(alertTable); member+=1) {
+    if ((member == identifier) || (group && (alertTable[member].group == group))) {
+      const TimeValue *started = &alertStates[member].started;
+
+      if (started->seconds || started->nanoseconds) {
+        int remaining = interval - millisecondsBetween(started, now);
+        if (remaining > delay) delay = remaining;
+      }
+    }
+  }
+
+  return delay;
+}
+
+static void playPendingAlerts (void);
+
+ASYNC_ALARM_CALLBACK(handleAlertAlarm) {
+  asyncDiscardHandle(alertPlayer.alarm);
+  alertPlayer.alarm = NULL;
+  playPendingAlerts();
+}
+
+static void
+setAlertAlarm (int delay) {
+  if (alertPlayer.alarm) {
+    asyncResetAlarmIn(alertPlayer.alarm, delay);
+  } else {
+    asyncNewRelativeAlarm(&alertPlayer.alarm, delay, handleAlertAlarm, NULL);
+  }
+}
+
+static void
+playPendingAlerts (void) {
+  TimeValue now;
+  getMonotonicTime(&now);
+
+  if (alertPlayer.identifier != ALERT_NONE) {
+    if (compareTimeValues(&now, &alertPlayer.end) >= 0) {
+      alertPlayer.identifier = ALERT_NONE;
+    }
+  }
+
+  AlertIdentifier next = ALERT_NONE;
+
+  for (AlertIdentifier identifier=0; identifier<ARRAY_COUNT(alertTable); identifier+=1) {
+    AlertState *state = &alertStates[identifier];
+    if (!state->sequence) continue;
+
+    if (!prefs.alertTunes) {
+      state->sequence = 0;
+      continue;
+    }
+
+    if (getAlertDelay(identifier, &now) > 0) continue;
+    unsigned char priority = getAlertGroup(identifier)->priority;
+
+    if (alertPlayer.identifier != ALERT_NONE) {
+      // only a higher priority alert may interrupt the one that's playing
+      if (priority <= getAlertGroup(alertPlayer.identifier)->priority) continue;
+    }
 
-        if (!*tune) *tune = emptyTune;
+    if (next != ALERT_NONE) {
+      unsigned char nextPriority = getAlertGroup(next)->priority;
+
+      if (priority < nextPriority) continue;
+      if ((priority == nextPriority) && (state->sequence > alertStates[next].sequence)) continue;
+    }
+
+    next = identifier;
+  }
+
+  if (next != ALERT_NONE) {
+    AlertState *state = &alertStates[next];
+    TunePlayOptions options = 0;
+
+    if (alertPlayer.identifier != ALERT_NONE) options |= TPO_INTERRUPT;
+    tunePlayTones(getAlertTune(next), options);
+
+    state->sequence = 0;
+    state->started = now;
+
+    alertPlayer.identifier = next;
+    alertPlayer.end = now;
+    adjustTimeValue(&alertPlayer.end, tuneDurations[next]);
+  }
+
+  {
+    int wait = -1;
+
+    for (AlertIdentifier identifier=0; identifier<ARRAY_COUNT(alertTable); identifier+=1) {
+      if (!alertStates[identifier].sequence) continue;
+      int delay = getAlertDelay(identifier, &now);
+
+      if (alertPlayer.identifier != ALERT_NONE) {
+        if (getAlertGroup(identifier)->priority <= getAlertGroup(alertPlayer.identifier)->priority) {
+          int remaining = millisecondsBetween(&now, &alertPlayer.end);
+          if (remaining > delay) delay = remaining;
+        }
       }
 
-      tunePlayTones(*tune, 0);
+      if ((wait < 0) || (delay < wait)) wait = delay;
+    }
+
+    if (wait >= 0) {
+      setAlertAlarm(wait);
+    } else if (alertPlayer.alarm) {
+      asyncCancelRequest(alertPlayer.alarm);
+      alertPlayer.alarm = NULL;
+    }
+  }
+}
+
+static void
+scheduleAlertTune (AlertIdentifier identifier) {
+  AlertState *state = &alertStates[identifier];
+  unsigned char group = alertTable[identifier].group;
+
+  if (group) {
+    // a newer alert of the same group supersedes any which are still pending
+    for (AlertIdentifier member=0; member<ARRAY_COUNT(alertTable); member+=1) {
+      if (member == identifier) continue;
+      if (alertTable[member].group != group) continue;
+      alertStates[member].sequence = 0;
+    }
+  }
+
+  if (!state->sequence) state->sequence = ++alertSequence;
+  playPendingAlerts();
+}
+
+void
+alert (AlertIdentifier identifier) {
+  if (identifier < ARRAY_COUNT(alertTable)) {
+    const AlertEntry *alert = &alertTable[identifier];
+
+    if (prefs.alertTunes && alert->tune && *alert->tune) {
+      scheduleAlertTune(identifier);
     } else if (prefs.alertDots && alert->tactile.duration) {
       showDotPattern(alert->tactile.pattern, alert->tactile.duration);
     } else if (prefs.alertMessages && alert->message) {
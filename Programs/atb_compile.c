@@ -165,6 +165,7 @@ AttributesTable *
 compileAttributesTable (const char *name) {
   AttributesTable *table = NULL;
 
+  lockDataFiles();
   if (setTableDataVariables(ATTRIBUTES_TABLE_EXTENSION, ATTRIBUTES_SUBTABLE_EXTENSION)) {
     AttributesTableData atd;
     memset(&atd, 0, sizeof(atd));
@@ -191,6 +192,7 @@ compileAttributesTable (const char *name) {
     }
   }
 
+  unlockDataFiles();
   return table;
 }
 
@@ -56,6 +56,22 @@ convertAttributesToDots (AttributesTable *table, unsigned char attributes) {
   return table->header.fields->attributesToDots[attributes];
 }
 
+const unsigned char *
+getAttributesToDotsMap (AttributesTable *table) {
+  return table->header.fields->attributesToDots;
+}
+
+void
+installAttributesTable (AttributesTable *table) {
+  AttributesTable *oldTable = attributesTable;
+
+  lockAttributesTable();
+    attributesTable = table;
+  unlockAttributesTable();
+
+  destroyAttributesTable(oldTable);
+}
+
 int
 replaceAttributesTable (const char *directory, const char *name) {
   AttributesTable *newTable = NULL;
@@ -77,13 +93,7 @@ replaceAttributesTable (const char *directory, const char *name) {
   }
 
   if (newTable) {
-    AttributesTable *oldTable = attributesTable;
-
-    lockAttributesTable();
-      attributesTable = newTable;
-    unlockAttributesTable();
-
-    destroyAttributesTable(oldTable);
+    installAttributesTable(newTable);
     return 1;
   }
 
@@ -59,6 +59,8 @@ constructBrailleDisplay (BrailleDisplay *brl) {
 
   brl->gioEndpoint = NULL;
   brl->writeDelay = 0;
+  brl->writeDrainTime.seconds = 0;
+  brl->writeDrainTime.nanoseconds = 0;
 
   brl->buffer = NULL;
   brl->bufferResized = NULL;
@@ -100,6 +102,11 @@ destructContractionCache (ContractionCache *cache) {
     free(cache->offsets.array);
     cache->offsets.array = NULL;
   }
+
+  if (cache->resync.array) {
+    free(cache->resync.array);
+    cache->resync.array = NULL;
+  }
 }
 
 static void
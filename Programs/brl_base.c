@@ -257,6 +257,7 @@ writeBraillePacket (
 
   if (endpoint == brl->gioEndpoint) {
     brl->writeDelay += gioGetMillisecondsToTransfer(endpoint, size);
+    getBrailleOutputDelay(brl); // the transfer has started
   }
 
   return 1;
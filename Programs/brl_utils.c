@@ -26,17 +26,46 @@
 #include "brl_utils.h"
 #include "brl_dots.h"
 #include "async_wait.h"
+#include "async_alarm.h"
+#include "timing.h"
 #include "ktb.h"
 
+static void
+foldBrailleWriteDelay (BrailleDisplay *brl, const TimeValue *now) {
+  // Output which has already drained can't delay anything written from now on.
+  if (compareTimeValues(&brl->writeDrainTime, now) < 0) brl->writeDrainTime = *now;
+
+  if (brl->writeDelay) {
+    adjustTimeValue(&brl->writeDrainTime, brl->writeDelay);
+    brl->writeDelay = 0;
+  }
+}
+
+int
+getBrailleOutputDelay (BrailleDisplay *brl) {
+  TimeValue now;
+  getMonotonicTime(&now);
+
+  foldBrailleWriteDelay(brl, &now);
+  return millisecondsBetween(&now, &brl->writeDrainTime);
+}
+
 void
 drainBrailleOutput (BrailleDisplay *brl, int minimumDelay) {
-  int duration = brl->writeDelay + 1;
+  int duration = getBrailleOutputDelay(brl) + 1;
 
-  brl->writeDelay = 0;
   if (duration < minimumDelay) duration = minimumDelay;
   asyncWait(duration);
 }
 
+int
+whenBrailleOutputDrained (
+  BrailleDisplay *brl, AsyncHandle *handle,
+  AsyncAlarmCallback *callback, void *data
+) {
+  return asyncNewRelativeAlarm(handle, getBrailleOutputDelay(brl)+1, callback, data);
+}
+
 void
 announceBrailleOffline (void) {
   logMessage(LOG_DEBUG, "braille is offline");
@@ -72,6 +101,8 @@ setBrailleOnline (BrailleDisplay *brl) {
     announceBrailleOnline();
 
     brl->writeDelay = 0;
+    brl->writeDrainTime.seconds = 0;
+    brl->writeDrainTime.nanoseconds = 0;
   }
 }
 
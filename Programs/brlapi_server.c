@@ -22,6 +22,8 @@
 #define SERVER_SELECT_TIMEOUT 1
 #define UNAUTH_LIMIT 5
 #define UNAUTH_TIMEOUT 30
+#define OUTPUT_QUEUE_LIMIT 0X10000 /* keys are dropped beyond this */
+#define OUTPUT_QUEUE_MAXIMUM 0X40000 /* the client is disconnected beyond this */
 
 #define RELEASE "BrlAPI Server: release " BRLAPI_RELEASE
 #define COPYRIGHT "   Copyright (C) 2002-2023 by Sébastien Hinderer <Sebastien.Hinderer@ens-lyon.org>, \
@@ -99,6 +101,8 @@ Samuel Thibault <samuel.thibault@ens-lyon.org>"
 #include "io_misc.h"
 #include "scr.h"
 #include "charset.h"
+#include "async_handle.h"
+#include "async_alarm.h"
 #include "async_signal.h"
 #include "thread.h"
 #include "blink.h"
@@ -143,26 +147,26 @@ static unsigned int fuzz_writeutf8;
 #endif /* ENABLE_API_FUZZING */
 
 #define WERR(x, y, ...) do { \
-  logMessage(LOG_ERR, "writing error %d to %"PRIfd, y, x); \
+  logMessage(LOG_ERR, "writing error %d to %"PRIfd, y, (x)->fd); \
   logMessage(LOG_ERR, __VA_ARGS__); \
   writeError(x, y); \
 } while(0)
-#define WEXC(fd, err, type, packet, size, ...) do { \
-  logMessage(LOG_ERR, "writing exception %d to fd %"PRIfd, err, fd); \
+#define WEXC(c, err, type, packet, size, ...) do { \
+  logMessage(LOG_ERR, "writing exception %d to fd %"PRIfd, err, (c)->fd); \
   logMessage(LOG_ERR, __VA_ARGS__); \
-  writeException(fd, err, type, packet, size); \
+  writeException(c, err, type, packet, size); \
 } while(0)
 
 /* These CHECK* macros check whether a condition is true, and, if not, */
 /* send back either a non-fatal error, or an exception */
 #define CHECKERR(condition, error, msg, ...) \
 if (!( condition )) { \
-  WERR(c->fd, error, "%s not met: " msg, #condition, ## __VA_ARGS__); \
+  WERR(c, error, "%s not met: " msg, #condition, ## __VA_ARGS__); \
   return 0; \
 } else { }
 #define CHECKEXC(condition, error, msg, ...) \
 if (!( condition )) { \
-  WEXC(c->fd, error, type, packet, size, "%s not met: " msg, #condition, ## __VA_ARGS__); \
+  WEXC(c, error, type, packet, size, "%s not met: " msg, #condition, ## __VA_ARGS__); \
   return 0; \
 } else { }
 
@@ -198,12 +202,32 @@ typedef struct {
 typedef enum { TODISPLAY, EMPTY } BrlBufState;
 
 typedef struct Subscription {
+  struct Connection *connection;
   brlapi_param_t parameter;
   brlapi_param_subparam_t subparam;
   brlapi_param_flags_t flags;
-  struct Subscription *prev, *next;
+  struct Subscription *prev, *next; /* subscriptions of the connection */
+  struct Subscription **prevsubscriber, *nextsubscriber; /* subscribers of the parameter */
 } Subscription;
 
+typedef struct OutputPacket {
+  struct OutputPacket *next;
+  brlapi_packetType_t type;
+  size_t size; /* header and data */
+  size_t written;
+  unsigned char bytes[];
+} OutputPacket;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  OutputPacket *head, **tail;
+  size_t queuedBytes;
+  unsigned int stalls;
+  unsigned int droppedKeys;
+  unsigned int coalescedUpdates;
+  unsigned char failed:1; /* the connection must be closed */
+} OutputQueue;
+
 typedef struct Connection {
   uint32_t clientVersion;
   struct Connection *prev, *next;
@@ -222,6 +246,8 @@ typedef struct Connection {
   time_t upTime;
   Packet packet;
   struct Subscription subscriptions;
+  unsigned int paramUpdateSerial; /* last global update sent, protected by apiParamMutex */
+  OutputQueue output;
 } Connection;
 
 typedef struct Tty {
@@ -236,9 +262,11 @@ typedef struct Tty {
 typedef struct {
   unsigned local_subscriptions;
   unsigned global_subscriptions;
+  Subscription *globalSubscribers; /* index of global subscriptions, protected by apiParamMutex */
 } ParamState;
 
 static ParamState paramState[BRLAPI_PARAM_COUNT];
+static unsigned int paramUpdateSerial;
 
 /* Pointer to the connection accepter thread */
 static pthread_t serverThread; /* server */
@@ -290,6 +318,13 @@ static Tty notty;
 static Tty ttys;
 
 static unsigned int unauthConnections;
+
+#ifndef __MINGW32__
+/* Wakes up the server thread when another thread queues output */
+static FileDescriptor outputWakeupPipe[2] = {
+  INVALID_FILE_DESCRIPTOR, INVALID_FILE_DESCRIPTOR
+};
+#endif /* __MINGW32__ */
 static unsigned int unauthConnLog = 0;
 
 /*
@@ -514,44 +549,301 @@ static int flushOutput(void) {
 /** PACKET HANDLING                                                        **/
 /****************************************************************************/
 
+/*
+ * Packets for a client are appended to its connection's output queue and
+ * written without blocking. Whatever the socket doesn't accept right away
+ * is flushed by the server thread when the socket becomes writable, so a
+ * client which stops reading can't stall the thread which is writing to it.
+ *
+ * When a client falls behind:
+ * - A queued parameter update is replaced by a newer one for the same
+ *   parameter, so only the latest value is delivered.
+ * - Keys are dropped once OUTPUT_QUEUE_LIMIT bytes are queued.
+ * - The client is disconnected once OUTPUT_QUEUE_MAXIMUM bytes are queued.
+ */
+
+static void initializeOutputQueue(OutputQueue *queue)
+{
+  pthread_mutex_init(&queue->mutex, NULL);
+  queue->head = NULL;
+  queue->tail = &queue->head;
+  queue->queuedBytes = 0;
+  queue->stalls = 0;
+  queue->droppedKeys = 0;
+  queue->coalescedUpdates = 0;
+  queue->failed = 0;
+}
+
+static void discardOutputPackets(OutputQueue *queue)
+{
+  while (queue->head) {
+    OutputPacket *packet = queue->head;
+    queue->head = packet->next;
+    free(packet);
+  }
+
+  queue->tail = &queue->head;
+  queue->queuedBytes = 0;
+}
+
+static void destroyOutputQueue(OutputQueue *queue)
+{
+  discardOutputPackets(queue);
+  pthread_mutex_destroy(&queue->mutex);
+}
+
+static void wakeupServer(void)
+{
+#ifndef __MINGW32__
+  if (outputWakeupPipe[1] != INVALID_FILE_DESCRIPTOR) {
+    static const unsigned char byte = 0;
+
+    if (write(outputWakeupPipe[1], &byte, 1) == -1) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+        logSystemError("output wakeup");
+      }
+    }
+  }
+#endif /* __MINGW32__ */
+}
+
+static void failConnectionOutput(Connection *c, const char *reason)
+{
+  if (!c->output.failed) {
+    logMessage(LOG_WARNING, "closing client on fd %"PRIfd": %s", c->fd, reason);
+    c->output.failed = 1;
+    discardOutputPackets(&c->output);
+    wakeupServer();
+  }
+}
+
+static int hasFailedOutput(Connection *c)
+{
+  int failed;
+
+  lockMutex(&c->output.mutex);
+  failed = c->output.failed;
+  unlockMutex(&c->output.mutex);
+
+  return failed;
+}
+
+#ifndef __MINGW32__
+/* Function : __flushConnectionOutput */
+/* Writes as much queued output as the socket accepts without blocking */
+/* Must be called with the output queue locked */
+static void __flushConnectionOutput(Connection *c)
+{
+  OutputQueue *queue = &c->output;
+
+  while (queue->head) {
+    OutputPacket *packet = queue->head;
+    ssize_t res = send(c->fd, packet->bytes + packet->written,
+                       packet->size - packet->written, 0);
+
+    if (res < 0) {
+      setSocketErrno();
+      if (errno == EINTR) continue;
+
+#ifdef EWOULDBLOCK
+      if (errno == EWOULDBLOCK) errno = EAGAIN;
+#endif /* EWOULDBLOCK */
+
+      if (errno == EAGAIN) {
+        queue->stalls += 1;
+      } else {
+        logMessage(LOG_CATEGORY(SERVER_EVENTS), "write to fd %"PRIfd" failed: %s", c->fd, strerror(errno));
+        failConnectionOutput(c, "write error");
+      }
+
+      break;
+    }
+
+    packet->written += res;
+    queue->queuedBytes -= res;
+
+    if (packet->written == packet->size) {
+      if (!(queue->head = packet->next)) queue->tail = &queue->head;
+      free(packet);
+    }
+  }
+}
+
+static void flushConnectionOutput(Connection *c)
+{
+  lockMutex(&c->output.mutex);
+  __flushConnectionOutput(c);
+  unlockMutex(&c->output.mutex);
+}
+
+static inline int hasPendingOutput(Connection *c)
+{
+  int pending;
+
+  lockMutex(&c->output.mutex);
+  pending = c->output.head != NULL;
+  unlockMutex(&c->output.mutex);
+
+  return pending;
+}
+
+/* Function : coalesceParamUpdate */
+/* Replaces a queued, not yet started, update of the same parameter */
+/* The new update takes its place so it stays ordered with respect to */
+/* the acknowledgements and errors queued after it */
+static int coalesceParamUpdate(OutputQueue *queue, OutputPacket *update)
+{
+  const size_t keySize = sizeof(uint32_t) * 4; /* flags, param, subparam */
+  OutputPacket **previous = &queue->head;
+
+  if (update->size < 8 + keySize) return 0;
+
+  while (*previous) {
+    OutputPacket *packet = *previous;
+
+    if ((packet->type == BRLAPI_PACKET_PARAM_UPDATE) && !packet->written &&
+        (packet->size >= 8 + keySize) &&
+        (memcmp(packet->bytes + 8, update->bytes + 8, keySize) == 0)) {
+      update->next = packet->next;
+      *previous = update;
+      if (queue->tail == &packet->next) queue->tail = &update->next;
+
+      queue->queuedBytes -= packet->size;
+      queue->queuedBytes += update->size;
+      queue->coalescedUpdates += 1;
+      free(packet);
+      return 1;
+    }
+
+    previous = &packet->next;
+  }
+
+  return 0;
+}
+#endif /* __MINGW32__ */
+
+/* Function : writeConnectionPacket */
+/* Queues a packet for a client and writes as much of it as possible */
+static void writeConnectionPacket(Connection *c, brlapi_packetType_t type, const void *data, size_t size)
+{
+#ifdef __MINGW32__
+  brlapiserver_writePacket(c->fd, type, data, size);
+#else /* __MINGW32__ */
+  OutputQueue *queue = &c->output;
+  OutputPacket *packet;
+  int wasIdle;
+
+  if (!(packet = malloc(sizeof(*packet) + 8 + size))) {
+    logMallocError();
+    return;
+  }
+
+  {
+    uint32_t header[2] = { htonl(size), htonl(type) };
+    memcpy(packet->bytes, header, sizeof(header));
+  }
+
+  if (size) memcpy(packet->bytes + 8, data, size);
+  packet->next = NULL;
+  packet->type = type;
+  packet->size = 8 + size;
+  packet->written = 0;
+
+  lockMutex(&queue->mutex);
+
+  if (queue->failed) {
+    free(packet);
+    goto done;
+  }
+
+  if (type == BRLAPI_PACKET_PARAM_UPDATE) {
+    if (coalesceParamUpdate(queue, packet)) {
+      if (queue->queuedBytes > OUTPUT_QUEUE_MAXIMUM) {
+        failConnectionOutput(c, "output queue overflow");
+      }
+
+      goto done;
+    }
+  } else if ((type == BRLAPI_PACKET_KEY) && (queue->queuedBytes >= OUTPUT_QUEUE_LIMIT)) {
+    if (!queue->droppedKeys++) {
+      logMessage(LOG_WARNING, "client on fd %"PRIfd" is not reading: dropping keys", c->fd);
+    }
+
+    free(packet);
+    goto done;
+  }
+
+  if (queue->queuedBytes + packet->size > OUTPUT_QUEUE_MAXIMUM) {
+    free(packet);
+    failConnectionOutput(c, "output queue overflow");
+    goto done;
+  }
+
+  wasIdle = !queue->head;
+  *queue->tail = packet;
+  queue->tail = &packet->next;
+  queue->queuedBytes += packet->size;
+
+  if (wasIdle) {
+    __flushConnectionOutput(c);
+
+    if (queue->head && !pthread_equal(pthread_self(), serverThread)) {
+      wakeupServer();
+    }
+  }
+
+done:
+  unlockMutex(&queue->mutex);
+#endif /* __MINGW32__ */
+}
+
 /* Function : writeAck */
-/* Sends an acknowledgement on the given socket */
-static inline void writeAck(FileDescriptor fd)
+/* Sends an acknowledgement to the given client */
+static inline void writeAck(Connection *c)
 {
-  brlapiserver_writePacket(fd,BRLAPI_PACKET_ACK,NULL,0);
+  writeConnectionPacket(c,BRLAPI_PACKET_ACK,NULL,0);
 }
 
-/* Function : writeError */
-/* Sends the given non-fatal error on the given socket */
-static void writeError(FileDescriptor fd, unsigned int err)
+/* Function : writeFileError */
+/* Sends the given error on a socket which has no connection */
+static void writeFileError(FileDescriptor fd, unsigned int err)
 {
   uint32_t code = htonl(err);
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "error %u on fd %"PRIfd, err, fd);
   brlapiserver_writePacket(fd,BRLAPI_PACKET_ERROR,&code,sizeof(code));
 }
 
+/* Function : writeError */
+/* Sends the given non-fatal error to the given client */
+static void writeError(Connection *c, unsigned int err)
+{
+  uint32_t code = htonl(err);
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "error %u on fd %"PRIfd, err, c->fd);
+  writeConnectionPacket(c,BRLAPI_PACKET_ERROR,&code,sizeof(code));
+}
+
 /* Function : writeException */
-/* Sends the given error code on the given socket */
-static void writeException(FileDescriptor fd, unsigned int err, brlapi_packetType_t type, const brlapi_packet_t *packet, size_t size)
+/* Sends the given error code to the given client */
+static void writeException(Connection *c, unsigned int err, brlapi_packetType_t type, const brlapi_packet_t *packet, size_t size)
 {
   int hdrsize, esize;
   brlapi_packet_t epacket;
   brlapi_errorPacket_t * errorPacket = &epacket.error;
-  logMessage(LOG_CATEGORY(SERVER_EVENTS), "exception %u for packet type %lu on fd %"PRIfd, err, (unsigned long)type, fd);
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "exception %u for packet type %lu on fd %"PRIfd, err, (unsigned long)type, c->fd);
   hdrsize = sizeof(errorPacket->code)+sizeof(errorPacket->type);
   errorPacket->code = htonl(err);
   errorPacket->type = htonl(type);
   esize = MIN(size, BRLAPI_MAXPACKETSIZE-hdrsize);
   if ((packet!=NULL) && (size!=0)) memcpy(&errorPacket->packet, &packet->data, esize);
-  brlapiserver_writePacket(fd,BRLAPI_PACKET_EXCEPTION,&epacket.data, hdrsize+esize);
+  writeConnectionPacket(c,BRLAPI_PACKET_EXCEPTION,&epacket.data, hdrsize+esize);
 }
 
-static void writeKey(FileDescriptor fd, brlapi_keyCode_t key) {
+static void writeKey(Connection *c, brlapi_keyCode_t key) {
   uint32_t buf[2];
   buf[0] = htonl(key >> 32);
   buf[1] = htonl(key & 0xffffffff);
-  logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing key %08"PRIx32" %08"PRIx32" to fd %"PRIfd,buf[0],buf[1],fd);
-  brlapiserver_writePacket(fd,BRLAPI_PACKET_KEY,&buf,sizeof(buf));
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing key %08"PRIx32" %08"PRIx32" to fd %"PRIfd,buf[0],buf[1],c->fd);
+  writeConnectionPacket(c,BRLAPI_PACKET_KEY,&buf,sizeof(buf));
 }
 
 typedef int(*PacketHandler)(Connection *, brlapi_packetType_t, brlapi_packet_t *, size_t);
@@ -650,6 +942,26 @@ static void getDots(const BrailleWindow *brailleWindow, unsigned char *buf)
 /** CONNECTIONS MANAGING                                                   **/
 /****************************************************************************/
 
+/* Function : addSubscriber */
+/* Adds a global subscription to the index of its parameter's subscribers */
+static void addSubscriber(Subscription *s)
+{
+  Subscription **head = &paramState[s->parameter].globalSubscribers;
+
+  s->prevsubscriber = head;
+  if ((s->nextsubscriber = *head))
+    s->nextsubscriber->prevsubscriber = &s->nextsubscriber;
+  *head = s;
+}
+
+/* Function : removeSubscriber */
+/* Removes a global subscription from the index of its parameter's subscribers */
+static void removeSubscriber(Subscription *s)
+{
+  if ((*s->prevsubscriber = s->nextsubscriber))
+    s->nextsubscriber->prevsubscriber = s->prevsubscriber;
+}
+
 /* Function : createConnection */
 /* Creates a connection */
 static Connection *createConnection(FileDescriptor fd, time_t currentTime)
@@ -689,13 +1001,15 @@ static Connection *createConnection(FileDescriptor fd, time_t currentTime)
     goto outmalloc;
   c->subscriptions.next = &c->subscriptions;
   c->subscriptions.prev = &c->subscriptions;
+  c->paramUpdateSerial = 0;
+  initializeOutputQueue(&c->output);
   return c;
 
 outmalloc:
   free(c);
 out:
   if (fd != INVALID_FILE_DESCRIPTOR) {
-    writeError(fd,BRLAPI_ERROR_NOMEM);
+    writeFileError(fd,BRLAPI_ERROR_NOMEM);
     closeFileDescriptor(fd);
   }
   return NULL;
@@ -710,9 +1024,10 @@ static void freeConnection(Connection *c)
   if (c->fd != INVALID_FILE_DESCRIPTOR) {
     lockMutex(&apiParamMutex);
     for (s=c->subscriptions.next; s!=&c->subscriptions; s=next) {
-      if (s->flags & BRLAPI_PARAMF_GLOBAL)
+      if (s->flags & BRLAPI_PARAMF_GLOBAL) {
 	paramState[s->parameter].global_subscriptions--;
-      else
+	removeSubscriber(s);
+      } else
 	paramState[s->parameter].local_subscriptions--;
       next = s->next;
       free(s);
@@ -729,6 +1044,14 @@ static void freeConnection(Connection *c)
   pthread_mutex_destroy(&c->acceptedKeysMutex);
   unsetAddressName(&c->acceptedKeysMutex);
 
+  if (c->output.stalls || c->output.droppedKeys || c->output.coalescedUpdates) {
+    logMessage(LOG_CATEGORY(SERVER_EVENTS),
+      "output statistics for fd %"PRIfd": Stalls:%u DroppedKeys:%u CoalescedUpdates:%u",
+      c->fd, c->output.stalls, c->output.droppedKeys, c->output.coalescedUpdates
+    );
+  }
+  destroyOutputQueue(&c->output);
+
   freeBrailleWindow(&c->brailleWindow);
   freeKeyrangeList(&c->acceptedKeys);
   free(c);
@@ -839,7 +1162,7 @@ static int handleGetDriver(Connection *c, brlapi_packetType_t type, size_t size,
   int len = strlen(str);
   CHECKERR(size==0,BRLAPI_ERROR_INVALID_PACKET,"packet should be empty");
   CHECKERR(!c->raw,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed in raw mode");
-  brlapiserver_writePacket(c->fd, type, str, len+1);
+  writeConnectionPacket(c, type, str, len+1);
   return 0;
 }
 
@@ -857,7 +1180,7 @@ static int handleGetDisplaySize(Connection *c, brlapi_packetType_t type, brlapi_
 {
   CHECKERR(size==0,BRLAPI_ERROR_INVALID_PACKET,"packet should be empty");
   CHECKERR(!c->raw,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed in raw mode");
-  brlapiserver_writePacket(c->fd,BRLAPI_PACKET_GETDISPLAYSIZE,&displayDimensions[0],sizeof(displayDimensions));
+  writeConnectionPacket(c,BRLAPI_PACKET_GETDISPLAYSIZE,&displayDimensions[0],sizeof(displayDimensions));
   return 0;
 }
 
@@ -893,7 +1216,7 @@ static int handleEnterTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
   if ((initializeAcceptedKeys(c, how)==-1) || (allocBrailleWindow(&c->brailleWindow)==-1)) {
     logMessage(LOG_WARNING,"Failed to allocate some resources");
     freeKeyrangeList(&c->acceptedKeys);
-    WERR(c->fd,BRLAPI_ERROR_NOMEM, "no memory for accepted keys");
+    WERR(c,BRLAPI_ERROR_NOMEM, "no memory for accepted keys");
     return 0;
   }
 
@@ -916,14 +1239,14 @@ static int handleEnterTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
       /* uhu, we already got a tty, but not this one, since the path
        * doesn't exist yet. This is forbidden. */
       unlockMutex(&apiConnectionsMutex);
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "already having another tty");
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "already having another tty");
       return 0;
     }
     /* ok, allocate path */
     /* we lock the entire subtree for easier cleanup */
     if (!(tty2 = newTty(tty,ntohl(*ptty)))) {
       unlockMutex(&apiConnectionsMutex);
-      WERR(c->fd,BRLAPI_ERROR_NOMEM, "no memory for new tty");
+      WERR(c,BRLAPI_ERROR_NOMEM, "no memory for new tty");
       freeBrailleWindow(&c->brailleWindow);
       return 0;
     }
@@ -937,7 +1260,7 @@ static int handleEnterTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
           freeTty(tty2);
         }
         unlockMutex(&apiConnectionsMutex);
-        WERR(c->fd,BRLAPI_ERROR_NOMEM, "no memory for new tty");
+        WERR(c,BRLAPI_ERROR_NOMEM, "no memory for new tty");
         freeBrailleWindow(&c->brailleWindow);
         return 0;
       }
@@ -949,19 +1272,19 @@ static int handleEnterTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
     unlockMutex(&apiConnectionsMutex);
     if (c->tty == tty) {
       if (c->how==how) {
-	WERR(c->fd, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "already controlling tty %#010x", c->tty->number);
+	WERR(c, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "already controlling tty %#010x", c->tty->number);
       } else {
         /* Here one is in the case where the client tries to change */
         /* from BRL_KEYCODES to BRL_COMMANDS, or something like that */
         /* For the moment this operation is not supported */
         /* A client that wants to do that should first LeaveTty() */
         /* and then get it again, risking to lose it */
-        WERR(c->fd,BRLAPI_ERROR_OPNOTSUPP, "Switching from BRL_KEYCODES to BRL_COMMANDS not supported yet");
+        WERR(c,BRLAPI_ERROR_OPNOTSUPP, "Switching from BRL_KEYCODES to BRL_COMMANDS not supported yet");
       }
       return 0;
     } else {
       /* uhu, we already got a tty, but not this one: this is forbidden. */
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "already having a tty");
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "already having a tty");
       return 0;
     }
   }
@@ -970,7 +1293,7 @@ static int handleEnterTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
   __removeConnection(c);
   __addConnectionSorted(c,tty->connections);
   unlockMutex(&apiConnectionsMutex);
-  writeAck(c->fd);
+  writeAck(c);
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" taking control of tty %#010x (how=%d)",c->fd,tty->number,how);
   return 0;
 }
@@ -1006,7 +1329,7 @@ static int handleLeaveTtyMode(Connection *c, brlapi_packetType_t type, brlapi_pa
   CHECKERR(!c->raw,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed in raw mode");
   CHECKERR(c->tty,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed out of tty mode");
   doLeaveTty(c);
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -1028,12 +1351,12 @@ static int handleKeyRanges(Connection *c, brlapi_packetType_t type, brlapi_packe
     else res = addKeyrange(x,y,&c->acceptedKeys);
     if (res==-1) {
       /* XXX: humf, in the middle of keycode updates :( */
-      WERR(c->fd,BRLAPI_ERROR_NOMEM,"no memory for key range");
+      WERR(c,BRLAPI_ERROR_NOMEM,"no memory for key range");
       break;
     }
   }
   unlockMutex(&c->acceptedKeysMutex);
-  if (!res) writeAck(c->fd);
+  if (!res) writeAck(c);
   return 0;
 }
 
@@ -1348,18 +1671,18 @@ static int handleEnterRawMode(Connection *c, brlapi_packetType_t type, brlapi_pa
   CHECKERR(isRawCapable(trueBraille), BRLAPI_ERROR_OPNOTSUPP, "driver doesn't support Raw mode");
   lockMutex(&apiRawMutex);
   if (rawConnection || suspendConnection) {
-    WERR(c->fd,BRLAPI_ERROR_DEVICEBUSY,"driver busy (%s)", rawConnection?"raw":"suspend");
+    WERR(c,BRLAPI_ERROR_DEVICEBUSY,"driver busy (%s)", rawConnection?"raw":"suspend");
     unlockMutex(&apiRawMutex);
     return 0;
   }
   rawConnection = c;
   unlockMutex(&apiRawMutex);
   if (!resumeDriver()) {
-    WERR(c->fd, BRLAPI_ERROR_DRIVERERROR,"driver resume error");
+    WERR(c, BRLAPI_ERROR_DRIVERERROR,"driver resume error");
     return 0;
   }
   c->raw = 1;
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -1371,7 +1694,7 @@ static int handleLeaveRawMode(Connection *c, brlapi_packetType_t type, brlapi_pa
   lockMutex(&apiRawMutex);
   rawConnection = NULL;
   unlockMutex(&apiRawMutex);
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -1390,7 +1713,7 @@ static int handleSuspendDriver(Connection *c, brlapi_packetType_t type, brlapi_p
   CHECKERR(!c->suspend,BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "not allowed in suspend mode");
   lockMutex(&apiRawMutex);
   if (suspendConnection || rawConnection) {
-    WERR(c->fd, BRLAPI_ERROR_DEVICEBUSY,"driver busy (%s)", rawConnection?"raw":"suspend");
+    WERR(c, BRLAPI_ERROR_DEVICEBUSY,"driver busy (%s)", rawConnection?"raw":"suspend");
     unlockMutex(&apiRawMutex);
     return 0;
   }
@@ -1398,7 +1721,7 @@ static int handleSuspendDriver(Connection *c, brlapi_packetType_t type, brlapi_p
   unlockMutex(&apiRawMutex);
   c->suspend = 1;
   suspendDriver();
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -1410,7 +1733,7 @@ static int handleResumeDriver(Connection *c, brlapi_packetType_t type, brlapi_pa
   suspendConnection = NULL;
   unlockMutex(&apiRawMutex);
   resumeDriver();
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -2299,12 +2622,12 @@ static int checkParamLocalGlobal(Connection *c, brlapi_param_t param, brlapi_par
 {
   if (flags & BRLAPI_PARAMF_GLOBAL) {
     if (!paramDispatch[param].global) {
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u does not make sense globally", param);
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u does not make sense globally", param);
       return 0;
     }
   } else {
     if (!paramDispatch[param].local) {
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u does not make sense locally", param);
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u does not make sense locally", param);
       return 0;
     }
   }
@@ -2323,14 +2646,14 @@ static int handleParamValue(Connection *c, brlapi_packetType_t type, brlapi_pack
   param = ntohl(paramValue->param);
 
   if (param >= sizeof(paramDispatch) / sizeof(*paramDispatch)) {
-    WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "unknown parameter %u", param);
+    WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "unknown parameter %u", param);
     return 0;
   }
 
   ParamWriter *writeHandler = paramDispatch[param].write;
   /* Check against read-only parameters */
   if (!writeHandler) {
-    WERR(c->fd, BRLAPI_ERROR_READONLY_PARAMETER, "parameter %u not available for writing", param);
+    WERR(c, BRLAPI_ERROR_READONLY_PARAMETER, "parameter %u not available for writing", param);
     return 0;
   }
 
@@ -2353,7 +2676,7 @@ static int handleParamValue(Connection *c, brlapi_packetType_t type, brlapi_pack
     unlockMutex(&apiParamMutex);
 
     if (error) {
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u write error: %s", param, error);
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u write error: %s", param, error);
       return 0;
     }
   }
@@ -2361,39 +2684,55 @@ static int handleParamValue(Connection *c, brlapi_packetType_t type, brlapi_pack
   if (!(flags & BRLAPI_PARAMF_GLOBAL)) {
     handleParamUpdate(c, c, param, subparam, flags, paramValue->data, size);
   }
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
 
+/* wantsParamUpdate: Whether a subscription matches the parameter update */
+static inline int wantsParamUpdate(const Subscription *s, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags)
+{
+  return s->subparam == subparam
+      && (s->flags & BRLAPI_PARAMF_GLOBAL) == (flags & BRLAPI_PARAMF_GLOBAL)
+      && ((s->flags & BRLAPI_PARAMF_SELF) || (paramUpdateConnection != s->connection));
+}
+
+/* writeParamUpdate: Write the parameter update packet to a connection */
+static void writeParamUpdate(Connection *c, brlapi_param_t param, brlapi_paramValuePacket_t *paramValue, size_t size)
+{
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing parameter %"PRIx32" update to fd %"PRIfd,param,c->fd);
+  writeConnectionPacket(c,BRLAPI_PACKET_PARAM_UPDATE,paramValue,size);
+}
+
 /* sendConnectionParamUpdate: Send the parameter update to a connection */
 static void sendConnectionParamUpdate(Connection *c, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, brlapi_paramValuePacket_t *paramValue, size_t size)
 {
   struct Subscription *s;
 
   for (s=c->subscriptions.next; s!=&c->subscriptions; s=s->next) {
-    if (s->parameter == param
-	&& s->subparam == subparam
-	&& (s->flags & BRLAPI_PARAMF_GLOBAL) == (flags & BRLAPI_PARAMF_GLOBAL)
-	&& ((s->flags & BRLAPI_PARAMF_SELF) || (paramUpdateConnection != c)))
-    {
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing parameter %"PRIx32" update to fd %"PRIfd,param,c->fd);
-      brlapiserver_writePacket(c->fd,BRLAPI_PACKET_PARAM_UPDATE,paramValue,size);
+    if (s->parameter == param && wantsParamUpdate(s, subparam, flags)) {
+      writeParamUpdate(c, param, paramValue, size);
       break;
     }
   }
 }
 
-/* sendParamUpdate: Send the parameter update to connections bound to a given tree of ttys */
-static void sendParamUpdate(Tty *tty, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, brlapi_paramValuePacket_t *paramValue, size_t size)
+/* sendParamUpdate: Send the global parameter update to its indexed subscribers */
+/* Each connection gets at most one copy, even if it subscribed more than once */
+static void sendParamUpdate(brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, brlapi_paramValuePacket_t *paramValue, size_t size)
 {
-  Connection *c;
-  Tty *t;
+  struct Subscription *s;
+  unsigned int serial = ++paramUpdateSerial;
 
-  for (c = tty->connections->next; c!=tty->connections; c = c->next)
-    sendConnectionParamUpdate(c, param, subparam, flags, paramValue, size);
-  for (t = tty->subttys; t; t = t->next)
-    sendParamUpdate(t, param, subparam, flags, paramValue, size);
+  for (s = paramState[param].globalSubscribers; s; s = s->nextsubscriber) {
+    Connection *c = s->connection;
+
+    if (c->paramUpdateSerial == serial) continue;
+    if (!wantsParamUpdate(s, subparam, flags)) continue;
+
+    c->paramUpdateSerial = serial;
+    writeParamUpdate(c, param, paramValue, size);
+  }
 }
 
 /* handleParamUpdate: Prepare and send the parameter update to all connections */
@@ -2413,8 +2752,7 @@ static void __handleParamUpdate(Connection *dest, brlapi_param_t param, brlapi_p
     sendConnectionParamUpdate(dest,param,subparam,flags,paramValue,size);
   } else {
     lockMutex(&apiConnectionsMutex);
-    sendParamUpdate(&ttys,param,subparam,flags,paramValue,size);
-    sendParamUpdate(&notty,param,subparam,flags,paramValue,size);
+    sendParamUpdate(param,subparam,flags,paramValue,size);
     unlockMutex(&apiConnectionsMutex);
   }
 }
@@ -2479,14 +2817,14 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
   param = ntohl(paramRequest->param);
 
   if (param >= sizeof(paramDispatch) / sizeof(*paramDispatch)) {
-    WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "unknown parameter %u", param);
+    WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "unknown parameter %u", param);
     return 0;
   }
 
   ParamReader *readHandler = paramDispatch[param].read;
   /* Check against non-readable parameters */
   if (!readHandler) {
-    WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u not available for reading", param);
+    WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u not available for reading", param);
     return 0;
   }
 
@@ -2496,7 +2834,7 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
   subparam = (brlapi_param_subparam_t)ntohl(paramRequest->subparam_hi) << 32 | ntohl(paramRequest->subparam_lo);
   if ((flags & BRLAPI_PARAMF_SUBSCRIBE) &&
       (flags & BRLAPI_PARAMF_UNSUBSCRIBE)) {
-    WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "subscribe and unsubscribe flags both set");
+    WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "subscribe and unsubscribe flags both set");
     return 0;
   }
   lockMutex(&apiParamMutex);
@@ -2507,7 +2845,7 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
       brlapi_param_t root = paramDispatch[param].rootParameter;
 
       if (root) {
-        WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u not available for watching - %u should be watched instead", param, root);
+        WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u not available for watching - %u should be watched instead", param, root);
         unlockMutex(&apiParamMutex);
         return 0;
       }
@@ -2520,6 +2858,7 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
     else
       paramState[param].local_subscriptions++;
     s = malloc(sizeof(*s));
+    s->connection = c;
     s->parameter = param;
     s->subparam = subparam;
     s->flags = flags;
@@ -2527,6 +2866,7 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
     s->prev = &c->subscriptions;
     s->next->prev = s;
     s->prev->next = s;
+    if (flags & BRLAPI_PARAMF_GLOBAL) addSubscriber(s);
     unlockMutex(&apiConnectionsMutex);
   } else if (flags & BRLAPI_PARAMF_UNSUBSCRIBE) {
     /* unsubscribe from parameter updates */
@@ -2538,15 +2878,16 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
 	break;
     }
     if (s != &c->subscriptions) {
-      if (flags & BRLAPI_PARAMF_GLOBAL)
+      if (flags & BRLAPI_PARAMF_GLOBAL) {
         paramState[param].global_subscriptions--;
-      else
+        removeSubscriber(s);
+      } else
         paramState[param].local_subscriptions--;
       s->next->prev = s->prev;
       s->prev->next = s->next;
       free(s);
     } else {
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "was not subscribed");
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "was not subscribed");
       unlockMutex(&apiParamMutex);
       unlockMutex(&apiConnectionsMutex);
       return 0;
@@ -2564,14 +2905,14 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
     const char *error = readHandler(c, param, subparam, flags, paramValue->data, &size);
 
     if (error) {
-      WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u read error: %s", param, error);
+      WERR(c, BRLAPI_ERROR_INVALID_PARAMETER, "parameter %u read error: %s", param, error);
     } else {
       _brlapi_htonParameter(param, paramValue, size);
       size += sizeof(flags) + sizeof(param) + sizeof(subparam);
-      brlapiserver_writePacket(c->fd,BRLAPI_PACKET_PARAM_VALUE,paramValue,size);
+      writeConnectionPacket(c,BRLAPI_PACKET_PARAM_VALUE,paramValue,size);
     }
   } else { /* Ack with ack */
-    writeAck(c->fd);
+    writeAck(c);
   }
   unlockMutex(&apiParamMutex);
   return 0;
@@ -2579,7 +2920,7 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
 
 static int handleSync(Connection *c, brlapi_packetType_t type, brlapi_packet_t *packet, size_t size)
 {
-  writeAck(c->fd);
+  writeAck(c);
   return 0;
 }
 
@@ -2598,7 +2939,7 @@ static void handleNewConnection(Connection *c)
   brlapi_packet_t versionPacket;
   versionPacket.version.protocolVersion = htonl(BRLAPI_PROTOCOL_VERSION);
 
-  brlapiserver_writePacket(c->fd,BRLAPI_PACKET_VERSION,&versionPacket.data,sizeof(versionPacket.version));
+  writeConnectionPacket(c,BRLAPI_PACKET_VERSION,&versionPacket.data,sizeof(versionPacket.version));
 }
 
 static int
@@ -2619,7 +2960,7 @@ static int handleUnauthorizedConnection(Connection *c, brlapi_packetType_t type,
 {
   if (c->auth == -1) {
     if (type != BRLAPI_PACKET_VERSION) {
-      WERR(c->fd, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong packet type (should be version)");
+      WERR(c, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong packet type (should be version)");
       return 1;
     }
 
@@ -2630,14 +2971,14 @@ static int handleUnauthorizedConnection(Connection *c, brlapi_packetType_t type,
       int nbmethods = 0;
 
       if (size<sizeof(*versionPacket)) {
-	WERR(c->fd, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong protocol version");
+	WERR(c, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong protocol version");
 	return 1;
       }
 
       c->clientVersion = ntohl(versionPacket->protocolVersion);
       if (c->clientVersion < 8) {
 	/* We only provide compatibility with version 8 and later. */
-	WERR(c->fd, BRLAPI_ERROR_PROTOCOL_VERSION, "protocol version %"PRIu32" < 8 is not supported", c->clientVersion);
+	WERR(c, BRLAPI_ERROR_PROTOCOL_VERSION, "protocol version %"PRIu32" < 8 is not supported", c->clientVersion);
 	return 1;
       }
 
@@ -2652,14 +2993,14 @@ static int handleUnauthorizedConnection(Connection *c, brlapi_packetType_t type,
 	c->auth = 0;
       }
 
-      brlapiserver_writePacket(c->fd,BRLAPI_PACKET_AUTH,&serverPacket,nbmethods*sizeof(authPacket->type));
+      writeConnectionPacket(c,BRLAPI_PACKET_AUTH,&serverPacket,nbmethods*sizeof(authPacket->type));
 
       return 0;
     }
   }
 
   if (type!=BRLAPI_PACKET_AUTH) {
-    WERR(c->fd, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong packet type (should be auth)");
+    WERR(c, BRLAPI_ERROR_PROTOCOL_VERSION, "wrong packet type (should be auth)");
     return 1;
   }
 
@@ -2705,18 +3046,44 @@ static int handleUnauthorizedConnection(Connection *c, brlapi_packetType_t type,
     }
 
     if (!authCorrect) {
-      writeError(c->fd, BRLAPI_ERROR_AUTHENTICATION);
+      writeError(c, BRLAPI_ERROR_AUTHENTICATION);
       logMessage(LOG_WARNING, "BrlAPI connection fd=%"PRIfd" failed authorization", c->fd);
       return 0;
     }
 
     unauthConnections--;
-    writeAck(c->fd);
+    writeAck(c);
     c->auth = 1;
     return 0;
   }
 }
 
+/* Function : abandonConnection */
+/* Releases whatever a departing client did not give up properly */
+static void abandonConnection(Connection *c)
+{
+  if (c->raw) {
+    c->raw = 0;
+    lockMutex(&apiRawMutex);
+    rawConnection = NULL;
+    unlockMutex(&apiRawMutex);
+    logMessage(LOG_WARNING,"Client on fd %"PRIfd" did not give up raw mode properly",c->fd);
+    resetDevice();
+  } else if (c->suspend) {
+    c->suspend = 0;
+    lockMutex(&apiRawMutex);
+    suspendConnection = NULL;
+    unlockMutex(&apiRawMutex);
+    logMessage(LOG_WARNING,"Client on fd %"PRIfd" did not give up suspended mode properly",c->fd);
+    if (!resumeDriver())
+      logMessage(LOG_WARNING,"Couldn't resume braille driver");
+  }
+  if (c->tty) {
+    logMessage(LOG_CATEGORY(SERVER_EVENTS), "client on fd %"PRIfd" did not give up control of tty %#010x properly",c->fd,c->tty->number);
+    doLeaveTty(c);
+  }
+}
+
 /* Function : processRequest */
 /* Reads a packet fro c->fd and processes it */
 /* Returns 1 if connection has to be removed */
@@ -2736,26 +3103,7 @@ static int processRequest(Connection *c, PacketHandlers *handlers)
     } else {
       logMessage(LOG_CATEGORY(SERVER_EVENTS), "closing connection on fd %"PRIfd,c->fd);
     }
-    if (c->raw) {
-      c->raw = 0;
-      lockMutex(&apiRawMutex);
-      rawConnection = NULL;
-      unlockMutex(&apiRawMutex);
-      logMessage(LOG_WARNING,"Client on fd %"PRIfd" did not give up raw mode properly",c->fd);
-      resetDevice();
-    } else if (c->suspend) {
-      c->suspend = 0;
-      lockMutex(&apiRawMutex);
-      suspendConnection = NULL;
-      unlockMutex(&apiRawMutex);
-      logMessage(LOG_WARNING,"Client on fd %"PRIfd" did not give up suspended mode properly",c->fd);
-      if (!resumeDriver())
-	logMessage(LOG_WARNING,"Couldn't resume braille driver");
-    }
-    if (c->tty) {
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "client on fd %"PRIfd" did not give up control of tty %#010x properly",c->fd,c->tty->number);
-      doLeaveTty(c);
-    }
+    abandonConnection(c);
     return 1;
   }
   size = c->packet.header.size;
@@ -2790,7 +3138,7 @@ static int processRequest(Connection *c, PacketHandlers *handlers)
     logRequest(type, c->fd);
     p(c, type, packet, size);
   } else {
-    WEXC(c->fd,BRLAPI_ERROR_UNKNOWN_INSTRUCTION, type, packet, size, "unknown packet type %x", type);
+    WEXC(c,BRLAPI_ERROR_UNKNOWN_INSTRUCTION, type, packet, size, "unknown packet type %x", type);
   }
   return 0;
 }
@@ -3557,7 +3905,7 @@ static void closeSockets(void *arg)
 #ifdef __MINGW32__
 static void addTtyFds(HANDLE **lpHandles, int *nbAlloc, int *nbHandles, Tty *tty) {
 #else /* __MINGW32__ */
-static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
+static void addTtyFds(fd_set *fds, fd_set *wfds, int *fdmax, Tty *tty) {
 #endif /* __MINGW32__ */
   {
     Connection *c;
@@ -3571,6 +3919,7 @@ static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
 #else /* __MINGW32__ */
       if (c->fd>*fdmax) *fdmax = c->fd;
       FD_SET(c->fd,fds);
+      if (hasPendingOutput(c)) FD_SET(c->fd,wfds);
 #endif /* __MINGW32__ */
     }
   }
@@ -3580,14 +3929,14 @@ static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
 #ifdef __MINGW32__
       addTtyFds(lpHandles, nbAlloc, nbHandles, t);
 #else /* __MINGW32__ */
-      addTtyFds(fds,fdmax,t);
+      addTtyFds(fds,wfds,fdmax,t);
 #endif /* __MINGW32__ */
   }
 }
 
 /* Function: handleTtyFds */
 /* recursively handle ttys' fds */
-static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
+static void handleTtyFds(fd_set *fds, fd_set *wfds, time_t currentTime, Tty *tty) {
   {
     Connection *c,*next;
     c = tty->connections->next;
@@ -3596,6 +3945,13 @@ static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
       int remove = 0;
       next = c->next;
 
+#ifndef __MINGW32__
+      if (FD_ISSET(c->fd, wfds)) {
+        flushConnectionOutput(c);
+        FD_CLR(c->fd, wfds);
+      }
+#endif /* __MINGW32__ */
+
 #ifdef __MINGW32__
       if (WaitForSingleObject(c->packet.overl.hEvent, 0) == WAIT_OBJECT_0)
 #else /* __MINGW32__ */
@@ -3607,6 +3963,11 @@ static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
         remove = (c->auth != 1) && ((currentTime - c->upTime) > UNAUTH_TIMEOUT);
       }
 
+      if (!remove && hasFailedOutput(c)) {
+        abandonConnection(c);
+        remove = 1;
+      }
+
 #ifndef __MINGW32__
       FD_CLR(c->fd,fds);
 #endif /* __MINGW32__ */
@@ -3620,7 +3981,7 @@ static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
     Tty *t,*next;
     for (t = tty->subttys; t; t = next) {
       next = t->next;
-      handleTtyFds(fds,currentTime,t);
+      handleTtyFds(fds,wfds,currentTime,t);
     }
   }
   if (tty!=&ttys && tty!=&notty
@@ -3688,6 +4049,7 @@ THREAD_FUNCTION(runServer) {
   Connection *c;
   time_t currentTime;
   fd_set sockset;
+  fd_set writeset;
   FileDescriptor resfd;
 
 #ifdef __MINGW32__
@@ -3787,6 +4149,16 @@ THREAD_FUNCTION(runServer) {
   unauthConnections = 0;
   unauthConnLog = 0;
 
+#ifndef __MINGW32__
+  if (pipe(outputWakeupPipe) == -1) {
+    logSystemError("output wakeup pipe");
+    outputWakeupPipe[0] = outputWakeupPipe[1] = INVALID_FILE_DESCRIPTOR;
+  } else {
+    setBlockingIo(outputWakeupPipe[0], 0);
+    setBlockingIo(outputWakeupPipe[1], 0);
+  }
+#endif /* __MINGW32__ */
+
   while (running) {
 #ifdef __MINGW32__
     lpHandles = malloc(nbAlloc * sizeof(*lpHandles));
@@ -3822,11 +4194,17 @@ THREAD_FUNCTION(runServer) {
 #else /* __MINGW32__ */
     /* Compute sockets set and fdmax */
     FD_ZERO(&sockset);
+    FD_ZERO(&writeset);
     fdmax=0;
 
+    if (outputWakeupPipe[0] != INVALID_FILE_DESCRIPTOR) {
+      FD_SET(outputWakeupPipe[0], &sockset);
+      fdmax = outputWakeupPipe[0];
+    }
+
     lockMutex(&apiConnectionsMutex);
-    addTtyFds(&sockset, &fdmax, &notty);
-    addTtyFds(&sockset, &fdmax, &ttys);
+    addTtyFds(&sockset, &writeset, &fdmax, &notty);
+    addTtyFds(&sockset, &writeset, &fdmax, &ttys);
     unlockMutex(&apiConnectionsMutex);
 
     {
@@ -3852,12 +4230,18 @@ THREAD_FUNCTION(runServer) {
         }
       unlockMutex(&apiSocketsMutex);
 
-      if (select(fdmax+1, &sockset, NULL, NULL, timeout) < 0) {
+      if (select(fdmax+1, &sockset, &writeset, NULL, timeout) < 0) {
         if (fdmax==0) continue; /* still no server socket */
         logMessage(LOG_WARNING,"select: %s",strerror(errno));
         break;
       }
     }
+
+    if ((outputWakeupPipe[0] != INVALID_FILE_DESCRIPTOR) &&
+        FD_ISSET(outputWakeupPipe[0], &sockset)) {
+      unsigned char buffer[0X40];
+      while (read(outputWakeupPipe[0], buffer, sizeof(buffer)) > 0);
+    }
 #endif /* __MINGW32__ */
 
     time(&currentTime);
@@ -3917,7 +4301,7 @@ THREAD_FUNCTION(runServer) {
         );
 
         if (unauthConnections >= UNAUTH_LIMIT) {
-          writeError(resfd, BRLAPI_ERROR_CONNREFUSED);
+          writeFileError(resfd, BRLAPI_ERROR_CONNREFUSED);
           closeFileDescriptor(resfd);
 
           if (unauthConnLog==0) {
@@ -3946,11 +4330,20 @@ THREAD_FUNCTION(runServer) {
       }
     }
 
-    handleTtyFds(&sockset,currentTime,&notty);
-    handleTtyFds(&sockset,currentTime,&ttys);
+    handleTtyFds(&sockset,&writeset,currentTime,&notty);
+    handleTtyFds(&sockset,&writeset,currentTime,&ttys);
   }
 
   running = 0;
+
+#ifndef __MINGW32__
+  for (i=0; i<2; i+=1) {
+    if (outputWakeupPipe[i] != INVALID_FILE_DESCRIPTOR) {
+      closeFileDescriptor(outputWakeupPipe[i]);
+      outputWakeupPipe[i] = INVALID_FILE_DESCRIPTOR;
+    }
+  }
+#endif /* __MINGW32__ */
 #ifdef __MINGW32__
   pthread_cleanup_pop(1);
 #else /* __MINGW32__ */
@@ -4261,7 +4654,7 @@ static void broadcastKey(Tty *tty, brlapi_keyCode_t code, unsigned int how) {
     pass = ((c->how==how) && (inKeyrangeList(c->acceptedKeys,code) != NULL));
     unlockMutex(&c->acceptedKeysMutex);
     if (pass)
-      writeKey(c->fd,code);
+      writeKey(c,code);
   }
   for (t = tty->subttys; t; t = t->next)
     broadcastKey(t, code, how);
@@ -4278,7 +4671,7 @@ static int api__handleKeyEvent(brlapi_keyCode_t clientCode) {
   /* somebody gets the raw code */
   if ((c = whoGetsKey(&ttys, clientCode, BRL_KEYCODES, 0))) {
     logMessage(LOG_CATEGORY(SERVER_EVENTS), "transmitting accepted key %016"BRLAPI_PRIxKEYCODE" to fd %"PRIfd,clientCode,c->fd);
-    writeKey(c->fd,clientCode);
+    writeKey(c,clientCode);
     return 1;
   }
   return 0;
@@ -4335,7 +4728,7 @@ static int api__handleCommand(int command) {
 
     if (c) {
       logMessage(LOG_CATEGORY(SERVER_EVENTS), "transmitting accepted command %lx as client code %016"BRLAPI_PRIxKEYCODE" to fd %"PRIfd,(unsigned long)command,code,c->fd);
-      writeKey(c->fd, code);
+      writeKey(c, code);
       return 1;
     }
   }
@@ -4373,9 +4766,9 @@ static int api_readCommand(BrailleDisplay *brl, KeyTableCommandContext context)
     size = trueBraille->readPacket(brl, &packet.data, BRLAPI_MAXPACKETSIZE);
     unlockMutex(&apiDriverMutex);
     if (size<0)
-      writeException(rawConnection->fd, BRLAPI_ERROR_DRIVERERROR, BRLAPI_PACKET_PACKET, NULL, 0);
+      writeException(rawConnection, BRLAPI_ERROR_DRIVERERROR, BRLAPI_PACKET_PACKET, NULL, 0);
     else if (size)
-      brlapiserver_writePacket(rawConnection->fd,BRLAPI_PACKET_PACKET,&packet.data,size);
+      writeConnectionPacket(rawConnection,BRLAPI_PACKET_PACKET,&packet.data,size);
     unlockMutex(&apiRawMutex);
     goto out;
   }
@@ -4393,6 +4786,14 @@ out:
   return command;
 }
 
+static AsyncHandle deferredFlushAlarm = NULL;
+
+ASYNC_ALARM_CALLBACK(handleDeferredFlushAlarm) {
+  asyncDiscardHandle(deferredFlushAlarm);
+  deferredFlushAlarm = NULL;
+  flushBrailleOutput(&brl);
+}
+
 /* Function : api_flushOutput
  * Flush writes to the braille device.
  */
@@ -4400,7 +4801,7 @@ int api_flushOutput(BrailleDisplay *brl) {
   Connection *c;
   static Connection *displayed_last;
   int ok = 1;
-  int drain = 0;
+  int deferred = 0;
   int update = 0;
 
   lockMutex(&apiParamMutex);
@@ -4433,7 +4834,11 @@ int api_flushOutput(BrailleDisplay *brl) {
       }
     }
 
-    if (c != displayed_last || c->brlbufstate==TODISPLAY || update) {
+    if (getBrailleOutputDelay(brl) > 0) {
+      /* the previous window is still being written - write this one when
+       * it's done rather than waiting for it here */
+      deferred = 1;
+    } else if (c != displayed_last || c->brlbufstate==TODISPLAY || update) {
       unsigned char *oldbuf = disp->buffer, buf[displaySize];
       disp->buffer = buf;
       getDots(&c->brailleWindow, buf);
@@ -4443,7 +4848,6 @@ int api_flushOutput(BrailleDisplay *brl) {
        * was received, rather than only when it eventually gets displayed
        * (possibly only because of focus change) */
       if (ok) handleParamUpdate(c, c, BRLAPI_PARAM_RENDERED_CELLS, 0, 0, disp->buffer, displaySize);
-      drain = 1;
       disp->buffer = oldbuf;
       displayed_last = c;
     }
@@ -4472,9 +4876,9 @@ int api_flushOutput(BrailleDisplay *brl) {
     unlockMutex(&apiRawMutex);
     goto out;
   }
-  if (drain)
-    drainBrailleOutput(brl, 0);
   unlockMutex(&apiRawMutex);
+  if (deferred && !deferredFlushAlarm)
+    whenBrailleOutputDrained(brl, &deferredFlushAlarm, handleDeferredFlushAlarm, NULL);
 out:
   unlockMutex(&apiConnectionsMutex);
   unlockMutex(&apiParamMutex);
@@ -4567,6 +4971,10 @@ void api_unlinkServer(BrailleDisplay *brl)
   lockMutex(&apiConnectionsMutex);
   broadcastKey(&ttys, BRLAPI_KEY_TYPE_CMD|BRLAPI_KEY_CMD_OFFLINE, BRL_COMMANDS);
   unlockMutex(&apiConnectionsMutex);
+  if (deferredFlushAlarm) {
+    asyncCancelRequest(deferredFlushAlarm);
+    deferredFlushAlarm = NULL;
+  }
   free(coreWindowText);
   coreWindowText = NULL;
   free(coreWindowDots);
@@ -32,9 +32,15 @@
 #include "utf8.h"
 #include "unicode.h"
 #include "ascii.h"
+#include "timing.h"
+#include "thread.h"
 #include "ttb.h"
 #include "ctb.h"
 
+#ifdef GOT_PTHREADS
+#define PARALLEL_TRANSLATION
+#endif /* GOT_PTHREADS */
+
 static char *opt_tablesDirectory;
 static char *opt_contractionTable;
 static char *opt_textTable;
@@ -43,6 +49,11 @@ static char *opt_verificationTable;
 static char *opt_outputWidth;
 static int opt_reformatText;
 static int opt_forceOutput;
+static char *opt_translationThreads;
+static int opt_showThroughput;
+static char *opt_ruleProfile;
+static char *opt_ruleOrder;
+static int opt_backTranslate;
 
 BEGIN_OPTION_TABLE(programOptions)
   { .word = "output-width",
@@ -65,6 +76,40 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Force immediate output.")
   },
 
+  { .word = "translation-threads",
+    .letter = 'j',
+    .argument = "count",
+    .setting.string = &opt_translationThreads,
+    .internal.setting = "1",
+    .description = strtext("Number of threads to translate with.")
+  },
+
+  { .word = "show-throughput",
+    .letter = 's',
+    .setting.flag = &opt_showThroughput,
+    .description = strtext("Show how fast the input was translated.")
+  },
+
+  { .word = "rule-profile",
+    .letter = 'p',
+    .argument = "file",
+    .setting.string = &opt_ruleProfile,
+    .description = strtext("Write how often each contraction rule was tried and selected.")
+  },
+
+  { .word = "rule-order",
+    .letter = 'o',
+    .argument = "file",
+    .setting.string = &opt_ruleOrder,
+    .description = strtext("Try the contraction rules in the order suggested by a rule profile.")
+  },
+
+  { .word = "back-translate",
+    .letter = 'b',
+    .setting.flag = &opt_backTranslate,
+    .description = strtext("Check that each input word is back-translated from its contracted braille.")
+  },
+
   { .word = "contraction-table",
     .letter = 'c',
     .argument = "file",
@@ -112,6 +157,24 @@ static int outputExtend;
 static char *verificationTablePath;
 static FILE *verificationTableStream;
 
+#define RULE_PROFILE_EXTENSION ".ctp"
+
+static char *ruleProfilePath;
+static char *ruleOrderPath;
+
+static struct {
+  unsigned long characters;
+  TimeValue start;
+} translationStatistics;
+
+static struct {
+  ContractedInput *input;
+  unsigned long words;
+  unsigned long matches;
+  unsigned long cells;
+  unsigned long long nanoseconds;
+} backTranslationStatistics;
+
 static int (*processInputCharacters) (const wchar_t *characters, size_t length, void *data);
 static int (*putCell) (unsigned char cell, void *data);
 
@@ -140,14 +203,433 @@ checkOutputStream (void *data) {
   return 1;
 }
 
+/* Lines (or reformatted paragraphs) are translated independently of one
+ * another, so they can be contracted concurrently and then written out in
+ * their original order. Each thread has its own copy of the contraction
+ * table because translating adds entries to the table's character cache.
+ */
+
+#define TRANSLATION_BATCH_JOBS 0X1000
+#define TRANSLATION_BATCH_CHARACTERS 0X100000
+
+typedef struct {
+  struct {
+    wchar_t *characters;
+    size_t size;
+    size_t count;
+  } input;
+
+  struct {
+    unsigned char *cells;
+    size_t size;
+    size_t count;
+  } output;
+
+  struct {
+    size_t *lengths;
+    size_t size;
+    size_t count;
+  } lines;
+
+  struct {
+    unsigned char *characters;
+    size_t size;
+    size_t count;
+  } trailer;
+} TranslationJob;
+
+typedef struct {
+  ContractionTable *table;
+  unsigned char *buffer;
+  int width;
+  int failed;
+} TranslationWorker;
+
+static struct {
+  TranslationWorker *workers;
+  unsigned int workerCount;
+
+  TranslationJob *jobs;
+  unsigned int jobSize;
+  unsigned int jobCount;
+  size_t characterCount;
+
+  unsigned int nextJob;
+
+#ifdef PARALLEL_TRANSLATION
+  pthread_mutex_t mutex;
+#endif /* PARALLEL_TRANSLATION */
+} translationBatch;
+
+static int
+ensureTranslationArray (void **array, size_t *size, size_t count, size_t itemSize) {
+  if (count > *size) {
+    size_t newSize = count | 0XFF;
+    void *newArray = realloc(*array, (newSize * itemSize));
+
+    if (!newArray) {
+      logMallocError();
+      return 0;
+    }
+
+    *array = newArray;
+    *size = newSize;
+  }
+
+  return 1;
+}
+
+#define ENSURE_TRANSLATION_ARRAY(array, size, count) \
+  ensureTranslationArray((void **)&(array), &(size), (count), sizeof(*(array)))
+
+static TranslationJob *
+getTranslationJob (void *data) {
+  if (translationBatch.jobCount == translationBatch.jobSize) {
+    unsigned int newSize = translationBatch.jobSize? translationBatch.jobSize<<1: 0X40;
+    TranslationJob *newJobs = realloc(translationBatch.jobs, ARRAY_SIZE(newJobs, newSize));
+
+    if (!newJobs) {
+      noMemory(data);
+      return NULL;
+    }
+
+    memset(&newJobs[translationBatch.jobSize], 0,
+           ARRAY_SIZE(newJobs, (newSize - translationBatch.jobSize)));
+
+    translationBatch.jobs = newJobs;
+    translationBatch.jobSize = newSize;
+  }
+
+  TranslationJob *job = &translationBatch.jobs[translationBatch.jobCount++];
+  job->input.count = 0;
+  job->output.count = 0;
+  job->lines.count = 0;
+  job->trailer.count = 0;
+  return job;
+}
+
+static int runTranslationBatch (void *data);
+
+static int
+addTranslationJob (const wchar_t *characters, size_t count, void *data) {
+  TranslationJob *job = getTranslationJob(data);
+  if (!job) return 0;
+
+  if (!ENSURE_TRANSLATION_ARRAY(job->input.characters, job->input.size, count)) {
+    noMemory(data);
+    return 0;
+  }
+
+  wmemcpy(job->input.characters, characters, count);
+  job->input.count = count;
+
+  if ((translationBatch.jobCount < TRANSLATION_BATCH_JOBS) &&
+      ((translationBatch.characterCount += count) < TRANSLATION_BATCH_CHARACTERS)) {
+    return 1;
+  }
+
+  return runTranslationBatch(data);
+}
+
+static int
+addTranslationCharacter (unsigned char character, void *data) {
+  TranslationJob *job;
+
+  if (translationBatch.jobCount) {
+    job = &translationBatch.jobs[translationBatch.jobCount - 1];
+  } else if (!(job = getTranslationJob(data))) {
+    return 0;
+  }
+
+  if (!ENSURE_TRANSLATION_ARRAY(job->trailer.characters, job->trailer.size, job->trailer.count+1)) {
+    noMemory(data);
+    return 0;
+  }
+
+  job->trailer.characters[job->trailer.count++] = character;
+  return 1;
+}
+
+static int
+translateJob (TranslationWorker *worker, TranslationJob *job) {
+  const wchar_t *input = job->input.characters;
+  size_t length = job->input.count;
+
+  while (length) {
+    int inputCount = length;
+    int outputCount = worker->width;
+
+    if (!worker->buffer) {
+      if (!(worker->buffer = malloc(worker->width))) {
+        logMallocError();
+        return 0;
+      }
+    }
+
+    contractText(worker->table, NULL,
+                 input, &inputCount,
+                 worker->buffer, &outputCount,
+                 NULL, CTB_NO_CURSOR);
+
+    if ((inputCount < length) && outputExtend) {
+      free(worker->buffer);
+      worker->buffer = NULL;
+      worker->width <<= 1;
+    } else {
+      if (!ENSURE_TRANSLATION_ARRAY(job->output.cells, job->output.size, job->output.count+outputCount)) return 0;
+      if (!ENSURE_TRANSLATION_ARRAY(job->lines.lengths, job->lines.size, job->lines.count+1)) return 0;
+
+      memcpy(&job->output.cells[job->output.count], worker->buffer, outputCount);
+      job->output.count += outputCount;
+      job->lines.lengths[job->lines.count++] = outputCount;
+
+      input += inputCount;
+      length -= inputCount;
+    }
+  }
+
+  return 1;
+}
+
+static void
+runTranslationWorker (TranslationWorker *worker) {
+  while (1) {
+    unsigned int index;
+
+#ifdef PARALLEL_TRANSLATION
+    lockMutex(&translationBatch.mutex);
+      index = translationBatch.nextJob++;
+    unlockMutex(&translationBatch.mutex);
+#else /* PARALLEL_TRANSLATION */
+    index = translationBatch.nextJob++;
+#endif /* PARALLEL_TRANSLATION */
+
+    if (index >= translationBatch.jobCount) break;
+
+    if (!translateJob(worker, &translationBatch.jobs[index])) {
+      worker->failed = 1;
+      break;
+    }
+  }
+}
+
+#ifdef PARALLEL_TRANSLATION
+THREAD_FUNCTION(runTranslationThread) {
+  runTranslationWorker(argument);
+  return NULL;
+}
+#endif /* PARALLEL_TRANSLATION */
+
+static int
+writeTranslationJob (const TranslationJob *job, void *data) {
+  const unsigned char *cells = job->output.cells;
+
+  for (unsigned int line=0; line<job->lines.count; line+=1) {
+    size_t length = job->lines.lengths[line];
+
+    if (line > 0) {
+      fputc('\n', outputStream);
+      if (!checkOutputStream(data)) return 0;
+    }
+
+    for (unsigned int index=0; index<length; index+=1) {
+      if (!putCell(cells[index], data)) return 0;
+    }
+
+    cells += length;
+  }
+
+  for (unsigned int index=0; index<job->trailer.count; index+=1) {
+    fputc(job->trailer.characters[index], outputStream);
+  }
+
+  return checkOutputStream(data);
+}
+
+static int
+runTranslationBatch (void *data) {
+  if (!translationBatch.jobCount) return 1;
+
+  translationBatch.nextJob = 0;
+
+#ifdef PARALLEL_TRANSLATION
+  unsigned int threadCount = translationBatch.workerCount - 1;
+  if (threadCount > translationBatch.jobCount) threadCount = translationBatch.jobCount;
+
+  pthread_t threads[threadCount + 1];
+  unsigned int started = 0;
+
+  while (started < threadCount) {
+    int error = createThread("ctb-translate", &threads[started], NULL,
+                             runTranslationThread, &translationBatch.workers[started+1]);
+
+    if (error) {
+      logActionError(error, "pthread_create");
+      break;
+    }
+
+    started += 1;
+  }
+
+#endif /* PARALLEL_TRANSLATION */
+
+  runTranslationWorker(&translationBatch.workers[0]);
+
+#ifdef PARALLEL_TRANSLATION
+  while (started) pthread_join(threads[--started], NULL);
+#endif /* PARALLEL_TRANSLATION */
+
+  for (unsigned int index=0; index<translationBatch.workerCount; index+=1) {
+    if (translationBatch.workers[index].failed) {
+      noMemory(data);
+      return 0;
+    }
+  }
+
+  for (unsigned int index=0; index<translationBatch.jobCount; index+=1) {
+    if (!writeTranslationJob(&translationBatch.jobs[index], data)) return 0;
+  }
+
+  translationBatch.jobCount = 0;
+  translationBatch.characterCount = 0;
+  return 1;
+}
+
+static int
+orderContractionRules (ContractionTable *table) {
+  if (!ruleOrderPath) return 1;
+  return applyContractionTableProfile(table, ruleOrderPath);
+}
+
+static int
+prepareContractionTable (void) {
+  if (!orderContractionRules(contractionTable)) return 0;
+  if (ruleProfilePath && !startContractionTableProfile(contractionTable)) return 0;
+  return 1;
+}
+
+static int
+startTranslationWorkers (const char *tablePath, unsigned int count) {
+  if (!(translationBatch.workers = calloc(count, sizeof(*translationBatch.workers)))) {
+    logMallocError();
+    return 0;
+  }
+
+  translationBatch.workerCount = count;
+  translationBatch.jobs = NULL;
+  translationBatch.jobSize = 0;
+  translationBatch.jobCount = 0;
+  translationBatch.characterCount = 0;
+
+#ifdef PARALLEL_TRANSLATION
+  pthread_mutex_init(&translationBatch.mutex, NULL);
+#endif /* PARALLEL_TRANSLATION */
+
+  for (unsigned int index=0; index<count; index+=1) {
+    TranslationWorker *worker = &translationBatch.workers[index];
+
+    worker->buffer = NULL;
+    worker->width = outputWidth;
+    worker->failed = 0;
+
+    if (index == 0) {
+      worker->table = contractionTable;
+    } else if (!(worker->table = compileContractionTable(tablePath))) {
+      return 0;
+    } else if (!orderContractionRules(worker->table)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+stopTranslationWorkers (void) {
+  if (translationBatch.workers) {
+    for (unsigned int index=0; index<translationBatch.workerCount; index+=1) {
+      TranslationWorker *worker = &translationBatch.workers[index];
+
+      if (worker->buffer) free(worker->buffer);
+      if (index && worker->table) destroyContractionTable(worker->table);
+    }
+
+    free(translationBatch.workers);
+    translationBatch.workers = NULL;
+
+#ifdef PARALLEL_TRANSLATION
+    pthread_mutex_destroy(&translationBatch.mutex);
+#endif /* PARALLEL_TRANSLATION */
+  }
+
+  if (translationBatch.jobs) {
+    for (unsigned int index=0; index<translationBatch.jobSize; index+=1) {
+      TranslationJob *job = &translationBatch.jobs[index];
+
+      if (job->input.characters) free(job->input.characters);
+      if (job->output.cells) free(job->output.cells);
+      if (job->lines.lengths) free(job->lines.lengths);
+      if (job->trailer.characters) free(job->trailer.characters);
+    }
+
+    free(translationBatch.jobs);
+    translationBatch.jobs = NULL;
+  }
+}
+
+static void
+logTranslationStatistics (void) {
+  TimeValue now;
+  getMonotonicTime(&now);
+  long int milliseconds = millisecondsBetween(&translationStatistics.start, &now);
+
+  logMessage(LOG_NOTICE,
+    "translated %lu characters in %ld.%03ld seconds (%lu characters per second)",
+    translationStatistics.characters,
+    milliseconds / MSECS_PER_SEC, milliseconds % MSECS_PER_SEC,
+    (unsigned long)((translationStatistics.characters * 1000.0) / (milliseconds? milliseconds: 1))
+  );
+
+  {
+    ContractionTableCharacterStatistics statistics;
+    getContractionTableCharacterStatistics(contractionTable, &statistics);
+
+    logMessage(LOG_NOTICE,
+      "character pages: %u prepared, %u added while translating, %u other characters, %lu locked lookups",
+      statistics.preparedPages, statistics.addedPages,
+      statistics.otherCharacters, statistics.lockedLookups
+    );
+  }
+}
+
+static int
+finishRuleProfile (void) {
+  unsigned long attempts;
+  unsigned long matches;
+  getContractionTableProfileTotals(contractionTable, &attempts, &matches);
+
+  unsigned long characters = translationStatistics.characters;
+  if (!characters) characters = 1;
+
+  logMessage(LOG_NOTICE,
+    "tried %lu rules and selected %lu of them for %lu characters (%.3f attempts per character)",
+    attempts, matches, translationStatistics.characters,
+    (double)attempts / (double)characters
+  );
+
+  return writeContractionTableProfile(contractionTable, ruleProfilePath);
+}
+
 static int
 flushOutputStream (void *data) {
+  if (!runTranslationBatch(data)) return 0;
   fflush(outputStream);
   return checkOutputStream(data);
 }
 
 static int
 putCharacter (unsigned char character, void *data) {
+  if (translationBatch.workers) return addTranslationCharacter(character, data);
   fputc(character, outputStream);
   return checkOutputStream(data);
 }
@@ -173,6 +655,9 @@ putBrailleCell (unsigned char cell, void *data) {
 
 static int
 writeCharacters (const wchar_t *inputLine, size_t inputLength, void *data) {
+  translationStatistics.characters += inputLength;
+  if (translationBatch.workers) return addTranslationJob(inputLine, inputLength, data);
+
   const wchar_t *inputBuffer = inputLine;
 
   while (inputLength) {
@@ -358,6 +843,102 @@ outputError:
   return 0;
 }
 
+static unsigned long long
+nanosecondsBetween (const TimeValue *from, const TimeValue *to) {
+  long long nanoseconds = to->seconds - from->seconds;
+  nanoseconds *= NSECS_PER_SEC;
+  nanoseconds += to->nanoseconds - from->nanoseconds;
+  return nanoseconds;
+}
+
+static int
+backTranslateWord (const wchar_t *word, size_t length) {
+  int inputCount = length;
+  int outputCount = length << 3;
+  unsigned char cells[outputCount];
+
+  contractText(contractionTable, NULL,
+               word, &inputCount,
+               cells, &outputCount,
+               NULL, CTB_NO_CURSOR);
+
+  if (inputCount < length) return 1;
+  if (memchr(cells, 0, outputCount)) return 1;
+
+  ContractedInput *input = backTranslationStatistics.input;
+  size_t size = outputCount << 3;
+  wchar_t characters[size];
+  size_t count;
+
+  {
+    TimeValue start;
+    TimeValue end;
+    getMonotonicTime(&start);
+
+    for (int index=0; index<outputCount; index+=1) {
+      if (!addContractedInputCell(input, contractionTable, cells[index])) break;
+    }
+
+    count = finishContractedInput(input, contractionTable, characters, size);
+    getMonotonicTime(&end);
+
+    backTranslationStatistics.nanoseconds += nanosecondsBetween(&start, &end);
+    backTranslationStatistics.cells += outputCount;
+  }
+
+  backTranslationStatistics.words += 1;
+
+  if ((count == length) && (wmemcmp(characters, word, length) == 0)) {
+    backTranslationStatistics.matches += 1;
+    return 1;
+  }
+
+  if (!writeUtf8Characters(outputStream, word, length)) goto outputError;
+  if (fputc(' ', outputStream) == EOF) goto outputError;
+  if (!writeUtf8Characters(outputStream, characters, count)) goto outputError;
+
+  if (fputc('\n', outputStream) == EOF) goto outputError;
+  return 1;
+
+outputError:
+  logMessage(LOG_ERR, "output error: %s", strerror(errno));
+  return 0;
+}
+
+static int
+checkBackTranslation (const wchar_t *characters, size_t length, void *data) {
+  const wchar_t *end = characters + length;
+
+  while (characters < end) {
+    while ((characters < end) && iswspace(*characters)) characters += 1;
+    const wchar_t *word = characters;
+
+    while ((characters < end) && !iswspace(*characters)) characters += 1;
+    if (characters == word) break;
+
+    if (!backTranslateWord(word, characters-word)) {
+      LineProcessingData *lpd = data;
+      lpd->exitStatus = PROG_EXIT_FATAL;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+logBackTranslationStatistics (void) {
+  unsigned long words = backTranslationStatistics.words;
+  unsigned long cells = backTranslationStatistics.cells;
+
+  logMessage(LOG_NOTICE,
+    "back-translated %lu of %lu words correctly (%.1f%%) - %.2f microseconds per cell",
+    backTranslationStatistics.matches, words,
+    (double)backTranslationStatistics.matches * 100.0 / (double)(words? words: 1),
+    (double)backTranslationStatistics.nanoseconds / 1000.0 / (double)(cells? cells: 1)
+  );
+}
+
 static DATA_OPERANDS_PROCESSOR(processContractsOperands) {
   DataString text;
 
@@ -437,6 +1018,9 @@ main (int argc, char *argv[]) {
   verificationTableStream = NULL;
   processInputCharacters = writeContractedBraille;
 
+  ruleProfilePath = NULL;
+  ruleOrderPath = NULL;
+
   resetPreferences();
   prefs.expandCurrentWord = 0;
 
@@ -472,12 +1056,49 @@ main (int argc, char *argv[]) {
     }
   }
 
+  int translationThreads;
+
+  {
+    static const int minimum = 1;
+
+    if (!validateInteger(&translationThreads, opt_translationThreads, &minimum, NULL)) {
+      logMessage(LOG_ERR, "%s: %s", "invalid translation thread count", opt_translationThreads);
+      return PROG_EXIT_SYNTAX;
+    }
+
+#ifndef PARALLEL_TRANSLATION
+    if (translationThreads > 1) {
+      logMessage(LOG_WARNING, "parallel translation not supported");
+      translationThreads = 1;
+    }
+#endif /* PARALLEL_TRANSLATION */
+  }
+
+  if (opt_ruleProfile && *opt_ruleProfile) {
+    if (!(ruleProfilePath = makeFilePath(NULL, opt_ruleProfile, RULE_PROFILE_EXTENSION))) {
+      return PROG_EXIT_FATAL;
+    }
+
+    if (translationThreads > 1) {
+      logMessage(LOG_WARNING, "rule profiling requires a single translation thread");
+      translationThreads = 1;
+    }
+  }
+
+  if (opt_ruleOrder && *opt_ruleOrder) {
+    if (!(ruleOrderPath = makeFilePath(NULL, opt_ruleOrder, RULE_PROFILE_EXTENSION))) {
+      return PROG_EXIT_FATAL;
+    }
+  }
+
   {
     char *contractionTablePath;
 
     if ((contractionTablePath = makeContractionTablePath(opt_tablesDirectory, opt_contractionTable))) {
       if ((contractionTable = compileContractionTable(contractionTablePath))) {
-        if (*opt_textTable) {
+        if (!prepareContractionTable()) {
+          exitStatus = PROG_EXIT_FATAL;
+        } else if (*opt_textTable) {
           putCell = putTextCell;
           char *textTablePath;
 
@@ -510,6 +1131,17 @@ main (int argc, char *argv[]) {
           }
         }
 
+        if (exitStatus == PROG_EXIT_SUCCESS) {
+          if (opt_backTranslate) {
+            if ((backTranslationStatistics.input = newContractedInput())) {
+              processInputCharacters = checkBackTranslation;
+              translationThreads = 1;
+            } else {
+              exitStatus = PROG_EXIT_FATAL;
+            }
+          }
+        }
+
         if (exitStatus == PROG_EXIT_SUCCESS) {
           if (verificationTableStream && !argc) {
             exitStatus = processVerificationTable();
@@ -518,6 +1150,14 @@ main (int argc, char *argv[]) {
               .exitStatus = PROG_EXIT_SUCCESS
             };
 
+            if (translationThreads > 1) {
+              if (!hasNoQualifier(opt_contractionTable)) {
+                logMessage(LOG_WARNING, "parallel translation not supported for this table");
+              } else if (!startTranslationWorkers(contractionTablePath, translationThreads)) {
+                lpd.exitStatus = PROG_EXIT_FATAL;
+              }
+            }
+
             const InputFilesProcessingParameters parameters = {
               .dataFileParameters = {
                 .options = DFO_NO_COMMENTS,
@@ -526,11 +1166,26 @@ main (int argc, char *argv[]) {
               }
             };
 
-            if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
-              if (!(flushCharacters('\n', &lpd) && flushOutputStream(&lpd))) {
+            getMonotonicTime(&translationStatistics.start);
+
+            if (lpd.exitStatus != PROG_EXIT_SUCCESS) {
+              exitStatus = lpd.exitStatus;
+            } else if ((exitStatus = processInputFiles(argv, argc, &parameters)) == PROG_EXIT_SUCCESS) {
+              if (flushCharacters('\n', &lpd) && flushOutputStream(&lpd)) {
+                if (opt_showThroughput) logTranslationStatistics();
+                if (backTranslationStatistics.input) logBackTranslationStatistics();
+                if (ruleProfilePath && !finishRuleProfile()) exitStatus = PROG_EXIT_FATAL;
+              } else {
                 exitStatus = lpd.exitStatus;
               }
             }
+
+            stopTranslationWorkers();
+          }
+
+          if (backTranslationStatistics.input) {
+            destroyContractedInput(backTranslationStatistics.input);
+            backTranslationStatistics.input = NULL;
           }
 
           if (textTable) destroyTextTable(textTable);
@@ -558,6 +1213,9 @@ main (int argc, char *argv[]) {
     verificationTablePath = NULL;
   }
 
+  if (ruleProfilePath) free(ruleProfilePath);
+  if (ruleOrderPath) free(ruleOrderPath);
+
   if (outputBuffer) free(outputBuffer);
   if (inputBuffer) free(inputBuffer);
   return exitStatus;
@@ -31,6 +31,7 @@
 #include "io_hid.h"
 #include "hid_items.h"
 #include "hid_inspect.h"
+#include "hid_braille.h"
 
 static int opt_matchUSBDevices;
 static int opt_matchBluetoothDevices;
@@ -53,6 +54,7 @@ static int opt_showHostDevice;
 
 static int opt_listItems;
 static int opt_listReports;
+static int opt_showBrailleLayout;
 
 static char *opt_readReport;
 static char *opt_readFeature;
@@ -167,6 +169,12 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("List each report's identifier and sizes.")
   },
 
+  { .word = "show-braille-layout",
+    .letter = 'B',
+    .setting.flag = &opt_showBrailleLayout,
+    .description = strtext("Show the braille cells and keys defined by the HID report descriptor.")
+  },
+
   { .word = "read-report",
     .letter = 'r',
     .argument = strtext("identifier"),
@@ -458,6 +466,19 @@ performListReports (HidDevice *device) {
   return 1;
 }
 
+static int
+performShowBrailleLayout (HidDevice *device) {
+  const HidItemsDescriptor *items = getItems(device);
+  if (!items) return 0;
+
+  HidBrailleLayout *layout = hidNewBrailleLayout(items);
+  if (!layout) return 0;
+
+  hidListBrailleLayout(layout, listItem, NULL);
+  hidDestroyBrailleLayout(layout);
+  return 1;
+}
+
 static int
 isReportIdentifier (HidReportIdentifier *identifier, const char *string, unsigned char minimum) {
   if (strlen(string) != 2) return 0;
@@ -1009,6 +1030,11 @@ performActions (HidDevice *device) {
       .option.flag = &opt_listReports,
     },
 
+    { .perform = performShowBrailleLayout,
+      .isFlag = 1,
+      .option.flag = &opt_showBrailleLayout,
+    },
+
     { .perform = performReadReport,
       .option.string = &opt_readReport,
     },
@@ -20,18 +20,26 @@
 
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "log.h"
 #include "clipboard.h"
 #include "utf8.h"
+#include "file.h"
 #include "queue.h"
 #include "lock.h"
 #include "program.h"
 #include "api_control.h"
 
+#define CLIPBOARD_HISTORY_CHARACTER_LIMIT 0X100000
+
 typedef struct {
   wchar_t *characters;
   size_t length;
+  uint32_t hash;
 } HistoryEntry;
 
 struct ClipboardObjectStruct {
@@ -43,6 +51,7 @@ struct ClipboardObjectStruct {
 
   struct {
     Queue *queue;
+    size_t characters;
   } history;
 };
 
@@ -56,20 +65,74 @@ getClipboardHistory (ClipboardObject *cpb, unsigned int index, size_t *length) {
   return entry->characters;
 }
 
+static uint32_t
+hashCharacters (const wchar_t *characters, size_t length) {
+  uint32_t hash = 0X811C9DC5;
+
+  while (length--) {
+    hash ^= *characters++;
+    hash *= 0X01000193;
+  }
+
+  return hash;
+}
+
+typedef struct {
+  const wchar_t *characters;
+  size_t length;
+  uint32_t hash;
+} FindHistoryEntryData;
+
+static int
+testHistoryEntry (const void *item, void *data) {
+  const HistoryEntry *entry = item;
+  const FindHistoryEntryData *fhe = data;
+
+  if (entry->hash != fhe->hash) return 0;
+  if (entry->length != fhe->length) return 0;
+  return wmemcmp(entry->characters, fhe->characters, fhe->length) == 0;
+}
+
+static void
+removeHistoryElement (ClipboardObject *cpb, Element *element) {
+  const HistoryEntry *entry = getElementItem(element);
+  cpb->history.characters -= entry->length;
+  deleteElement(element);
+}
+
+static void
+limitClipboardHistory (ClipboardObject *cpb) {
+  Queue *queue = cpb->history.queue;
+
+  while (cpb->history.characters > CLIPBOARD_HISTORY_CHARACTER_LIMIT) {
+    Element *element = getQueueHead(queue);
+
+    // always keep the most recent entry
+    if (element == getStackHead(queue)) break;
+
+    removeHistoryElement(cpb, element);
+  }
+}
+
 int
 addClipboardHistory (ClipboardObject *cpb, const wchar_t *characters, size_t length) {
   if (!length) return 1;
 
   Queue *queue = cpb->history.queue;
-  Element *element = getStackHead(queue);
 
-  if (element) {
-    const HistoryEntry *entry = getElementItem(element);
+  FindHistoryEntryData fhe = {
+    .characters = characters,
+    .length = length,
+    .hash = hashCharacters(characters, length)
+  };
 
-    if (length == entry->length) {
-      if (wmemcmp(characters, entry->characters, length) == 0) {
-        return 1;
-      }
+  {
+    Element *element = findElement(queue, testHistoryEntry, &fhe);
+
+    if (element) {
+      // it's already there - just make it the most recent entry
+      requeueElement(element);
+      return 1;
     }
   }
 
@@ -80,8 +143,11 @@ addClipboardHistory (ClipboardObject *cpb, const wchar_t *characters, size_t len
       if ((entry->characters = allocateCharacters(length))) {
         wmemcpy(entry->characters, characters, length);
         entry->length = length;
+        entry->hash = fhe.hash;
 
         if (enqueueItem(queue, entry)) {
+          cpb->history.characters += length;
+          limitClipboardHistory(cpb);
           return 1;
         }
 
@@ -99,6 +165,144 @@ addClipboardHistory (ClipboardObject *cpb, const wchar_t *characters, size_t len
   return 0;
 }
 
+static int
+saveClipboardHistoryEntry (FILE *file, const HistoryEntry *entry) {
+  const wchar_t *character = entry->characters;
+  const wchar_t *end = character + entry->length;
+
+  while (character < end) {
+    wchar_t wc = *character++;
+
+    if (wc == WC_C('\\')) {
+      if (fputs("\\\\", file) == EOF) return 0;
+    } else if (wc == WC_C('\n')) {
+      if (fputs("\\n", file) == EOF) return 0;
+    } else if (!writeUtf8Character(file, wc)) {
+      return 0;
+    }
+  }
+
+  return fputc('\n', file) != EOF;
+}
+
+static int
+writeClipboardHistory (ClipboardObject *cpb, FILE *file, const char *path) {
+  Queue *queue = cpb->history.queue;
+  unsigned int count = getQueueSize(queue);
+
+  for (unsigned int index=0; index<count; index+=1) {
+    Element *element = getQueueElement(queue, index);
+
+    if (!saveClipboardHistoryEntry(file, getElementItem(element))) {
+      logMessage(LOG_ERR, "clipboard history write error: %s: %s",
+                 path, strerror(errno));
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+saveClipboardHistory (ClipboardObject *cpb, const char *path) {
+  int ok = 0;
+  char temporary[strlen(path) + 0X20];
+  snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)getpid());
+
+  // the history may contain passwords so only the owner may read it, and
+  // it's written to a new file so that a failed save can't lose the old one
+  unlink(temporary);
+  int descriptor = open(temporary, (O_WRONLY | O_CREAT | O_EXCL), (S_IRUSR | S_IWUSR));
+
+  if (descriptor != -1) {
+    FILE *file = fdopen(descriptor, "w");
+
+    if (file) {
+      ok = writeClipboardHistory(cpb, file, temporary);
+
+      if (fclose(file) == EOF) {
+        logMessage(LOG_ERR, "clipboard history close error: %s: %s",
+                   temporary, strerror(errno));
+        ok = 0;
+      }
+
+      if (ok) {
+#ifdef __MINGW32__
+        // rename() doesn't replace an existing file on Windows
+        unlink(path);
+#endif /* __MINGW32__ */
+
+        if (rename(temporary, path) == -1) {
+          logMessage(LOG_ERR, "clipboard history rename error: %s: %s",
+                     path, strerror(errno));
+          ok = 0;
+        }
+      }
+    } else {
+      logSystemError("fdopen");
+      close(descriptor);
+    }
+
+    if (!ok) unlink(temporary);
+  } else {
+    logMessage(LOG_ERR, "clipboard history create error: %s: %s",
+               temporary, strerror(errno));
+  }
+
+  return ok;
+}
+
+static int
+restoreClipboardHistoryEntry (const LineHandlerParameters *parameters) {
+  ClipboardObject *cpb = parameters->data;
+  const char *line = parameters->line.text;
+  size_t size = parameters->line.length + 1;
+  wchar_t *characters = allocateCharacters(size);
+
+  if (!characters) {
+    logMallocError();
+    return 0;
+  }
+
+  size_t count = makeWcharsFromUtf8(line, characters, size);
+
+  {
+    const wchar_t *from = characters;
+    const wchar_t *end = from + count;
+    wchar_t *to = characters;
+
+    while (from < end) {
+      wchar_t wc = *from++;
+
+      if ((wc == WC_C('\\')) && (from < end)) {
+        wc = *from++;
+        if (wc == WC_C('n')) wc = WC_C('\n');
+      }
+
+      *to++ = wc;
+    }
+
+    count = to - characters;
+  }
+
+  int added = addClipboardHistory(cpb, characters, count);
+  free(characters);
+  return added;
+}
+
+int
+restoreClipboardHistory (ClipboardObject *cpb, const char *path) {
+  int ok = 0;
+  FILE *file = openFile(path, "r", 1);
+
+  if (file) {
+    if (processLines(file, restoreClipboardHistoryEntry, cpb)) ok = 1;
+    fclose(file);
+  }
+
+  return ok;
+}
+
 const wchar_t *
 getClipboardContent (ClipboardObject *cpb, size_t *length) {
   *length = cpb->buffer.length;
@@ -139,16 +343,17 @@ appendClipboardContent (ClipboardObject *cpb, const wchar_t *characters, size_t
   size_t newLength = cpb->buffer.length + length;
 
   if (newLength > cpb->buffer.size) {
-    size_t newSize = newLength | 0XFF;
-    wchar_t *newCharacters = allocateCharacters(newSize);
+    // grow geometrically so that repeated appends don't keep copying
+    size_t newSize = cpb->buffer.size? cpb->buffer.size: 0X100;
+    while (newSize < newLength) newSize <<= 1;
+
+    wchar_t *newCharacters = realloc(cpb->buffer.characters, ARRAY_SIZE(newCharacters, newSize));
 
     if (!newCharacters) {
       logMallocError();
       return 0;
     }
 
-    wmemcpy(newCharacters, cpb->buffer.characters, cpb->buffer.length);
-    if (cpb->buffer.characters) free(cpb->buffer.characters);
     cpb->buffer.characters = newCharacters;
     cpb->buffer.size = newSize;
   }
@@ -274,6 +479,43 @@ setMainClipboardContent (const char *content) {
   return updated;
 }
 
+static char *
+makeMainClipboardHistoryPath (void) {
+  return makeWritablePath(PACKAGE_TARNAME "-clipboard.txt");
+}
+
+static void
+exitMainClipboardHistory (void *data) {
+  ClipboardObject *cpb = getMainClipboard();
+  char *path = makeMainClipboardHistoryPath();
+
+  if (path) {
+    lockMainClipboard();
+      saveClipboardHistory(cpb, path);
+    unlockMainClipboard();
+
+    free(path);
+  }
+}
+
+int
+persistMainClipboardHistory (void) {
+  ClipboardObject *cpb = getMainClipboard();
+  if (!cpb) return 0;
+
+  char *path = makeMainClipboardHistoryPath();
+  if (!path) return 0;
+
+  lockMainClipboard();
+    restoreClipboardHistory(cpb, path);
+  unlockMainClipboard();
+  free(path);
+
+  // registered after the main clipboard so that it's saved before it's destroyed
+  onProgramExit("main-clipboard-history", exitMainClipboardHistory, NULL);
+  return 1;
+}
+
 char *
 getMainClipboardContent (void) {
   ClipboardObject *cpb = getMainClipboard();
@@ -31,6 +31,7 @@
 #include "brl_cmds.h"
 #include "unicode.h"
 #include "ttb.h"
+#include "ctb.h"
 #include "scr.h"
 #include "async_handle.h"
 #include "async_alarm.h"
@@ -39,6 +40,8 @@
 
 typedef struct {
   ReportListenerInstance *resetListener;
+  ReportListenerInstance *routingListener;
+  ContractedInput *contractedInput;
 
   struct {
     AsyncHandle timeout;
@@ -133,6 +136,32 @@ insertKey (ScreenKey key, int flags) {
   return insertScreenKey(key);
 }
 
+static int
+flushContractedInput (InputCommandData *icd) {
+  ContractedInput *ci = icd->contractedInput;
+  if (!getContractedInputCellCount(ci)) return 1;
+
+  wchar_t characters[0X100];
+  size_t count;
+
+  lockContractionTable();
+    count = finishContractedInput(ci, contractionTable, characters, ARRAY_COUNT(characters));
+  unlockContractionTable();
+
+  return insertScreenCharacters(characters, count);
+}
+
+static int
+addContractedInput (InputCommandData *icd, unsigned char dots) {
+  int added;
+
+  lockContractionTable();
+    added = addContractedInputCell(icd->contractedInput, contractionTable, dots);
+  unlockContractionTable();
+
+  return added;
+}
+
 static void
 handleVirtualTerminalSwitched (int switched) {
   if (switched) {
@@ -270,6 +299,12 @@ handleInputCommands (int command, void *data) {
           ScreenKey key;
           int mightScroll = 0;
 
+          if ((arg == BRL_KEY_BACKSPACE) && !flags && !haveModifierFlags(icd)) {
+            if (removeContractedInputCell(icd->contractedInput)) break;
+          }
+
+          if (!flushContractedInput(icd)) goto REJECT_KEY;
+
           switch (arg) {
             case BRL_KEY_ENTER:
               key = SCR_KEY_ENTER;
@@ -357,12 +392,41 @@ handleInputCommands (int command, void *data) {
         }
 
         case BRL_CMD_BLK(PASSCHAR): {
+          if (!flushContractedInput(icd)) {
+            alert(ALERT_COMMAND_REJECTED);
+            break;
+          }
+
           applyModifierFlags(icd, &flags);
           if (!insertKey(BRL_ARG_GET(command), flags)) alert(ALERT_COMMAND_REJECTED);
           break;
         }
 
         case BRL_CMD_BLK(PASSDOTS): {
+          if (prefs.brailleTypingMode == BRL_TYPING_CONTRACTED) {
+            if (!flags && !haveModifierFlags(icd)) {
+              if (arg && addContractedInput(icd, arg)) {
+                if (!(command & BRL_DOTC)) break;
+                arg = 0;
+              }
+
+              if (!arg) {
+                if (!flushContractedInput(icd)) {
+                  alert(ALERT_COMMAND_REJECTED);
+                } else if (!insertKey(WC_C(' '), 0)) {
+                  alert(ALERT_COMMAND_REJECTED);
+                }
+
+                break;
+              }
+            }
+
+            if (!flushContractedInput(icd)) {
+              alert(ALERT_COMMAND_REJECTED);
+              break;
+            }
+          }
+
           applyModifierFlags(icd, &flags);
           wchar_t character = convertInputToCharacter(arg);
 
@@ -396,6 +460,12 @@ handleInputCommands (int command, void *data) {
 
 static void
 resetInputCommandData (InputCommandData *icd) {
+  if (getContractedInputCellCount(icd->contractedInput)) {
+    // the cells typed for the current word are lost
+    alert(ALERT_COMMAND_REJECTED);
+    while (removeContractedInputCell(icd->contractedInput));
+  }
+
   cancelModifierTimeout(icd);
   initializeModifierFlags(icd);
 }
@@ -406,12 +476,21 @@ REPORT_LISTENER(inputCommandDataResetListener) {
   resetInputCommandData(icd);
 }
 
+REPORT_LISTENER(inputCommandDataRoutingListener) {
+  InputCommandData *icd = parameters->listenerData;
+
+  // the word being typed belongs where the cursor is now
+  if (!flushContractedInput(icd)) alert(ALERT_COMMAND_REJECTED);
+}
+
 static void
 destroyInputCommandData (void *data) {
   InputCommandData *icd = data;
 
+  unregisterReportListener(icd->routingListener);
   unregisterReportListener(icd->resetListener);
   cancelModifierTimeout(icd);
+  destroyContractedInput(icd->contractedInput);
   free(icd);
 }
 
@@ -424,13 +503,21 @@ addInputCommands (void) {
     initializeModifierTimeout(icd);
     initializeModifierFlags(icd);
 
-    if ((icd->resetListener = registerReportListener(REPORT_BRAILLE_DEVICE_ONLINE, inputCommandDataResetListener, icd))) {
-      if (pushCommandHandler("input", KTB_CTX_DEFAULT,
-                             handleInputCommands, destroyInputCommandData, icd)) {
-        return 1;
+    if ((icd->contractedInput = newContractedInput())) {
+      if ((icd->resetListener = registerReportListener(REPORT_BRAILLE_DEVICE_ONLINE, inputCommandDataResetListener, icd))) {
+        if ((icd->routingListener = registerReportListener(REPORT_SCREEN_CURSOR_ROUTING, inputCommandDataRoutingListener, icd))) {
+          if (pushCommandHandler("input", KTB_CTX_DEFAULT,
+                                 handleInputCommands, destroyInputCommandData, icd)) {
+            return 1;
+          }
+
+          unregisterReportListener(icd->routingListener);
+        }
+
+        unregisterReportListener(icd->resetListener);
       }
 
-      unregisterReportListener(icd->resetListener);
+      destroyContractedInput(icd->contractedInput);
     }
 
     free(icd);
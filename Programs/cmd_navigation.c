@@ -218,17 +218,7 @@ static int
 testPromptPatterns (int column, int row, void *data) {
   int length = scr.cols;
   wchar_t text[length];
-
-  {
-    ScreenCharacter characters[length];
-    readScreenRow(row, length, characters);
-
-    const ScreenCharacter *from = characters;
-    const ScreenCharacter *end = from + length;
-
-    wchar_t *to = text;
-    while (from < end) *to++ = from++->text;
-  }
+  readScreenText(0, row, length, 1, text);
 
   return !!rgxMatchTextCharacters(promptPatterns, text, length, NULL, NULL);
 }
@@ -389,14 +379,10 @@ handleNavigationCommands (int command, void *data) {
       } State;
 
       State state = STARTING;
-      ScreenCharacter characters[scr.cols];
       int line = ses->winy;
 
       while (1) {
-        int isBlankLine;
-
-        readScreenRow(line, scr.cols, characters);
-        isBlankLine = isAllSpaceCharacters(characters, scr.cols);
+        int isBlankLine = isBlankScreenRow(line);
 
         switch (state) {
           case STARTING:
@@ -433,17 +419,12 @@ handleNavigationCommands (int command, void *data) {
     }
 
     case BRL_CMD_NXPGRPH: {
-      int width = scr.cols;
-      ScreenCharacter characters[width];
-
       int found = 0;
       int findBlankLine = 1;
       int line = ses->winy;
 
       while (line < scr.rows) {
-        readScreenRow(line, width, characters);
-
-        if (isAllSpaceCharacters(characters, width) == findBlankLine) {
+        if (isBlankScreenRow(line) == findBlankLine) {
           if (!findBlankLine) {
             ses->winy = line;
             ses->winx = 0;
@@ -436,12 +436,10 @@ handleSpeechCommands (int command, void *data) {
     }
 
     case BRL_CMD_SPEAK_FRST_LINE: {
-      ScreenCharacter characters[scr.cols];
       int row = 0;
 
       while (row < scr.rows) {
-        readScreenRow(row, scr.cols, characters);
-        if (!isAllSpaceCharacters(characters, scr.cols)) break;
+        if (!isBlankScreenRow(row)) break;
         row += 1;
       }
 
@@ -457,12 +455,10 @@ handleSpeechCommands (int command, void *data) {
     }
 
     case BRL_CMD_SPEAK_LAST_LINE: {
-      ScreenCharacter characters[scr.cols];
       int row = scr.rows - 1;
 
       while (row >= 0) {
-        readScreenRow(row, scr.cols, characters);
-        if (!isAllSpaceCharacters(characters, scr.cols)) break;
+        if (!isBlankScreenRow(row)) break;
         row -= 1;
       }
 
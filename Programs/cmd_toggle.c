@@ -202,9 +202,24 @@ handleToggleCommands (int command, void *data) {
       togglePreferenceSetting(&prefs.brailleKeyboardEnabled, command);
       break;
 
-    case BRL_CMD_BRLUCDOTS:
-      togglePreferenceSetting(&prefs.brailleTypingMode, command);
+    case BRL_CMD_BRLUCDOTS: {
+      unsigned char dots = prefs.brailleTypingMode == BRL_TYPING_DOTS;
+
+      switch (togglePreferenceSetting(&dots, command)) {
+        case TOGGLE_ON:
+          prefs.brailleTypingMode = BRL_TYPING_DOTS;
+          break;
+
+        case TOGGLE_OFF:
+          prefs.brailleTypingMode = BRL_TYPING_TEXT;
+          break;
+
+        default:
+          break;
+      }
+
       break;
+    }
 
     case BRL_CMD_TOUCH_NAV:
       togglePreferenceSetting(&prefs.touchNavigation, command);
@@ -51,6 +51,7 @@
 #include "atb.h"
 #include "ctb.h"
 #include "ktb.h"
+#include "table_reload.h"
 #include "ktb_keyboard.h"
 #include "kbd.h"
 #include "alert.h"
@@ -74,6 +75,7 @@
 #include "cmd_queue.h"
 #include "core.h"
 #include "api_control.h"
+#include "clipboard.h"
 #include "prefs.h"
 #include "utf8.h"
 
@@ -144,6 +146,11 @@ static const char *const *const autodetectableBrailleDrivers_Bluetooth =
     "np", "ht", "al", "bm"
   );
 
+static const char *const *const autodetectableBrailleDrivers_HID =
+  NULL_TERMINATED_STRING_ARRAY(
+    "hw", "hi"
+  );
+
 #define SERVICE_NAME "BrlAPI"
 #define SERVICE_DESCRIPTION "Braille Devices API"
 
@@ -283,6 +290,8 @@ char *opt_tablesDirectory;
 char *opt_textTable;
 char *opt_contractionTable;
 char *opt_attributesTable;
+static int opt_reloadTables;
+static int opt_saveClipboardHistory;
 
 char *opt_keyboardTable;
 KeyTable *keyboardTable = NULL;
@@ -467,6 +476,18 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Name of or path to attributes table.")
   },
 
+  { .word = "reload-tables",
+    .flags = OPT_Config | OPT_EnvVar,
+    .setting.flag = &opt_reloadTables,
+    .description = strtext("Reload the text, contraction, and attributes tables when their files change.")
+  },
+
+  { .word = "save-clipboard-history",
+    .flags = OPT_Config | OPT_EnvVar,
+    .setting.flag = &opt_saveClipboardHistory,
+    .description = strtext("Save the clipboard history when stopping, and restore it when starting.")
+  },
+
 #ifdef ENABLE_SPEECH_SUPPORT
   { .word = "speech-driver",
     .letter = 's',
@@ -909,10 +930,45 @@ brlttyPrepare (int argc, char *argv[]) {
   return PROG_EXIT_SUCCESS;
 }
 
+static void *
+compileReloadedTextTable (const char *path) {
+  return compileTextTable(path);
+}
+
+static void
+installReloadedTextTable (void *table) {
+  installTextTable(table);
+  api.updateParameter(BRLAPI_PARAM_COMPUTER_BRAILLE_TABLE, 0);
+  scheduleUpdate("text table reloaded");
+}
+
+static void
+destroyReloadedTextTable (void *table) {
+  destroyTextTable(table);
+}
+
+static const TableReloadMethods textTableReloadMethods = {
+  .name = "text",
+  .compile = compileReloadedTextTable,
+  .install = installReloadedTextTable,
+  .destroy = destroyReloadedTextTable
+};
+
 static int
 setTextTable (const char *name) {
   if (!name) name = "";
-  if (!replaceTextTable(opt_tablesDirectory, name)) return 0;
+  beginTableLoad();
+
+  if (!replaceTextTable(opt_tablesDirectory, name)) {
+    cancelTableLoad();
+    return 0;
+  }
+
+  {
+    char *path = *name? makeTextTablePath(opt_tablesDirectory, name): NULL;
+    endTableLoad(&textTableReloadMethods, path);
+    if (path) free(path);
+  }
 
   if (!*name) name = TEXT_TABLE;
   changeStringSetting(&opt_textTable, name);
@@ -950,10 +1006,45 @@ exitTextTable (void *data) {
   setTextTable(NULL);
 }
 
+static void *
+compileReloadedContractionTable (const char *path) {
+  return compileContractionTable(path);
+}
+
+static void
+installReloadedContractionTable (void *table) {
+  installContractionTable(table);
+  api.updateParameter(BRLAPI_PARAM_LITERARY_BRAILLE_TABLE, 0);
+  scheduleUpdate("contraction table reloaded");
+}
+
+static void
+destroyReloadedContractionTable (void *table) {
+  destroyContractionTable(table);
+}
+
+static const TableReloadMethods contractionTableReloadMethods = {
+  .name = "contraction",
+  .compile = compileReloadedContractionTable,
+  .install = installReloadedContractionTable,
+  .destroy = destroyReloadedContractionTable
+};
+
 static int
 setContractionTable (const char *name) {
   if (!name) name = "";
-  if (!replaceContractionTable(opt_tablesDirectory, name)) return 0;
+  beginTableLoad();
+
+  if (!replaceContractionTable(opt_tablesDirectory, name)) {
+    cancelTableLoad();
+    return 0;
+  }
+
+  {
+    char *path = *name? makeContractionTablePath(opt_tablesDirectory, name): NULL;
+    endTableLoad(&contractionTableReloadMethods, path);
+    if (path) free(path);
+  }
 
   if (!*name) name = CONTRACTION_TABLE;
   changeStringSetting(&opt_contractionTable, name);
@@ -1037,10 +1128,44 @@ setTextAndContractionTables (void) {
   onProgramExit("contraction-table", exitContractionTable, NULL);
 }
 
+static void *
+compileReloadedAttributesTable (const char *path) {
+  return compileAttributesTable(path);
+}
+
+static void
+installReloadedAttributesTable (void *table) {
+  installAttributesTable(table);
+  scheduleUpdate("attributes table reloaded");
+}
+
+static void
+destroyReloadedAttributesTable (void *table) {
+  destroyAttributesTable(table);
+}
+
+static const TableReloadMethods attributesTableReloadMethods = {
+  .name = "attributes",
+  .compile = compileReloadedAttributesTable,
+  .install = installReloadedAttributesTable,
+  .destroy = destroyReloadedAttributesTable
+};
+
 int
 changeAttributesTable (const char *name) {
   if (!name) name = "";
-  if (!replaceAttributesTable(opt_tablesDirectory, name)) return 0;
+  beginTableLoad();
+
+  if (!replaceAttributesTable(opt_tablesDirectory, name)) {
+    cancelTableLoad();
+    return 0;
+  }
+
+  {
+    char *path = *name? makeAttributesTablePath(opt_tablesDirectory, name): NULL;
+    endTableLoad(&attributesTableReloadMethods, path);
+    if (path) free(path);
+  }
 
   if (!*name) name = ATTRIBUTES_TABLE;
   changeStringSetting(&opt_attributesTable, name);
@@ -1053,6 +1178,11 @@ exitAttributesTable (void *data) {
   changeAttributesTable(NULL);
 }
 
+static void
+exitTableReloading (void *data) {
+  stopTableReloading();
+}
+
 static void
 setAttributesTable (void) {
   if (*opt_attributesTable) {
@@ -1276,29 +1406,8 @@ exitKeyboardTable (void *data) {
   disableKeyboardHelpPage();
 }
 
-int
-changeKeyboardTable (const char *name) {
-  KeyTable *table = NULL;
-
-  if (!*name) name = "";
-  if (strcmp(name, optionOperand_off) == 0) name = "";
-
-  if (*name) {
-    char *path = makeKeyboardTablePath(opt_tablesDirectory, name);
-
-    if (path) {
-      logMessage(LOG_DEBUG, "compiling keyboard table: %s", path);
-
-      if (!(table = compileKeyTable(path, KEY_NAME_TABLES(keyboard)))) {
-        logMessage(LOG_ERR, "%s: %s", gettext("cannot compile keyboard table"), path);
-      }
-
-      free(path);
-    }
-
-    if (!table) return 0;
-  }
-
+static void
+installKeyboardTable (KeyTable *table) {
   if (keyboardTable) {
     disableKeyboardHelpPage();
     disableKeyboardMonitor();
@@ -1315,6 +1424,60 @@ changeKeyboardTable (const char *name) {
     enableKeyboardMonitor();
     makeKeyboardHelpPage();
   }
+}
+
+static void *
+compileReloadedKeyboardTable (const char *path) {
+  return compileKeyTable(path, KEY_NAME_TABLES(keyboard));
+}
+
+static void
+installReloadedKeyboardTable (void *table) {
+  installKeyboardTable(table);
+  scheduleUpdate("keyboard table reloaded");
+}
+
+static void
+destroyReloadedKeyboardTable (void *table) {
+  destroyKeyTable(table);
+}
+
+static const TableReloadMethods keyboardTableReloadMethods = {
+  .name = "keyboard",
+  .compile = compileReloadedKeyboardTable,
+  .install = installReloadedKeyboardTable,
+  .destroy = destroyReloadedKeyboardTable
+};
+
+int
+changeKeyboardTable (const char *name) {
+  KeyTable *table = NULL;
+  char *path = NULL;
+
+  if (!*name) name = "";
+  if (strcmp(name, optionOperand_off) == 0) name = "";
+
+  if (*name) {
+    if (!(path = makeKeyboardTablePath(opt_tablesDirectory, name))) return 0;
+  }
+
+  beginTableLoad();
+
+  if (path) {
+    logMessage(LOG_DEBUG, "compiling keyboard table: %s", path);
+
+    if (!(table = compileKeyTable(path, KEY_NAME_TABLES(keyboard)))) {
+      logMessage(LOG_ERR, "%s: %s", gettext("cannot compile keyboard table"), path);
+      cancelTableLoad();
+      free(path);
+      return 0;
+    }
+  }
+
+  endTableLoad(&keyboardTableReloadMethods, path);
+  if (path) free(path);
+
+  installKeyboardTable(table);
 
   if (!*name) name = optionOperand_off;
   logMessage(LOG_DEBUG, "keyboard table changed: %s -> %s", opt_keyboardTable, name);
@@ -1737,6 +1900,57 @@ setBrailleDriverConstructed (int yes) {
   }
 }
 
+static void
+prepareBrailleKeyTable (KeyTable *table) {
+  setKeyTableLogLabel(table, "brl");
+  setLogKeyEventsFlag(table, &LOG_CATEGORY_FLAG(BRAILLE_KEYS));
+  setKeyboardEnabledFlag(table, &prefs.brailleKeyboardEnabled);
+}
+
+static void *
+compileReloadedBrailleKeyTable (const char *path) {
+  return compileKeyTable(path, brl.keyNames);
+}
+
+static void
+installReloadedBrailleKeyTable (void *table) {
+  prepareBrailleKeyTable(table);
+  setKeyAutoreleaseTime(table, prefs.autoreleaseTime);
+
+  KeyTable *oldTable;
+  lockBrailleDriver();
+    oldTable = brl.keyTable;
+    brl.keyTable = table;
+  unlockBrailleDriver();
+
+  if (oldTable) destroyKeyTable(oldTable);
+  disableBrailleHelpPage();
+
+  if (haveBrailleDisplay()) {
+    char *path = makeBrailleKeyTablePath();
+
+    if (path) {
+      makeBrailleHelpPage(path);
+      free(path);
+    }
+  }
+
+  api.updateParameter(BRLAPI_PARAM_BOUND_COMMAND_CODES, 0);
+  scheduleUpdate("braille key table reloaded");
+}
+
+static void
+destroyReloadedBrailleKeyTable (void *table) {
+  destroyKeyTable(table);
+}
+
+static const TableReloadMethods brailleKeyTableReloadMethods = {
+  .name = "braille key",
+  .compile = compileReloadedBrailleKeyTable,
+  .install = installReloadedBrailleKeyTable,
+  .destroy = destroyReloadedBrailleKeyTable
+};
+
 int
 constructBrailleDriver (void) {
   initializeBrailleDisplay();
@@ -1750,13 +1964,14 @@ constructBrailleDriver (void) {
 
         if (keyTablePath) {
           if (brl.keyNames) {
+            beginTableLoad();
+
             if ((brl.keyTable = compileKeyTable(keyTablePath, brl.keyNames))) {
+              endTableLoad(&brailleKeyTableReloadMethods, keyTablePath);
               logMessage(LOG_INFO, "%s: %s", gettext("Key Table"), keyTablePath);
-
-              setKeyTableLogLabel(brl.keyTable, "brl");
-              setLogKeyEventsFlag(brl.keyTable, &LOG_CATEGORY_FLAG(BRAILLE_KEYS));
-              setKeyboardEnabledFlag(brl.keyTable, &prefs.brailleKeyboardEnabled);
+              prepareBrailleKeyTable(brl.keyTable);
             } else {
+              cancelTableLoad();
               logMessage(LOG_WARNING, "%s: %s", gettext("cannot compile key table"), keyTablePath);
             }
           }
@@ -1783,6 +1998,9 @@ constructBrailleDriver (void) {
 
 void
 destructBrailleDriver (void) {
+  // the key names belong to the driver so a reload mustn't outlive it
+  forgetTableLoad(&brailleKeyTableReloadMethods);
+
   stopBrailleInput();
   drainBrailleOutput(&brl, 0);
 
@@ -1883,7 +2101,8 @@ activateBrailleDriver (int verify) {
         logMessage(LOG_DEBUG, "braille device type: %s", properties->type.name);
 
         switch (properties->type.identifier) {
-          case GIO_TYPE_SERIAL: {
+          case GIO_TYPE_SERIAL:
+          case GIO_TYPE_EMULATOR: {
             autodetectableDrivers = autodetectableBrailleDrivers_serial;
             break;
           }
@@ -1901,6 +2120,11 @@ activateBrailleDriver (int verify) {
             break;
           }
 
+          case GIO_TYPE_HID: {
+            autodetectableDrivers = autodetectableBrailleDrivers_HID;
+            break;
+          }
+
           default:
             break;
         }
@@ -3002,6 +3226,14 @@ brlttyStart (void) {
     }
   }
 
+  if (opt_reloadTables) {
+    if (startTableReloading()) {
+      onProgramExit("table-reload", exitTableReloading, NULL);
+    }
+  }
+
+  if (opt_saveClipboardHistory) persistMainClipboardHistory();
+
   setTextAndContractionTables();
   setAttributesTable();
   setKeyboardTable();
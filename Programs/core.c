@@ -37,6 +37,7 @@
 #include "log.h"
 #include "alert.h"
 #include "strfmt.h"
+#include "report.h"
 
 #include "cmd_queue.h"
 #include "cmd_clipboard.h"
@@ -142,6 +143,7 @@ onBrailleVariantUpdated (void) {
 
 int
 startScreenCursorRouting (int column, int row) {
+  report(REPORT_SCREEN_CURSOR_ROUTING, NULL);
   if (!routeScreenCursor(column, row, scr.number)) return 0;
   if (isRouting()) alert(ALERT_ROUTING_STARTED);
   return 1;
@@ -990,6 +992,22 @@ isAllSpaceCharacters (const ScreenCharacter *characters, int count) {
   return findFirstNonSpaceCharacter(characters, count) < 0;
 }
 
+int
+isBlankScreenRow (int row) {
+  // only the part of the row which might have content needs to be read
+  int length = getScreenRowLength(row, scr.cols);
+  if (!length) return 1;
+
+  wchar_t text[length];
+  if (!readScreenText(0, row, length, 1, text)) return 0;
+
+  for (int index=0; index<length; index+=1) {
+    if (!iswspace(text[index])) return 0;
+  }
+
+  return 1;
+}
+
 #ifdef ENABLE_SPEECH_SUPPORT
 SpeechSynthesizer spk;
 
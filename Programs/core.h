@@ -195,6 +195,7 @@ extern int haveStatusCells (void);
 extern int findFirstNonSpaceCharacter (const ScreenCharacter *characters, int count);
 extern int findLastNonSpaceCharacter (const ScreenCharacter *characters, int count);
 extern int isAllSpaceCharacters (const ScreenCharacter *characters, int count);
+extern int isBlankScreenRow (int row);
 
 #ifdef ENABLE_SPEECH_SUPPORT
 extern SpeechSynthesizer spk;
@@ -699,20 +699,48 @@ static DATA_OPERANDS_PROCESSOR(processContractionTableOperands) {
 
 static void
 initializeCommonFields (ContractionTable *table) {
-  table->characters.array = NULL;
-  table->characters.size = 0;
-  table->characters.count = 0;
+  memset(&table->characters, 0, sizeof(table->characters));
 
   table->rules.array = NULL;
   table->rules.size = 0;
   table->rules.count = 0;
+
+  table->profile.array = NULL;
+  table->profile.count = 0;
+
+  memset(&table->reverse, 0, sizeof(table->reverse));
 }
 
 static void
 destroyCommonFields (ContractionTable *table) {
-  if (table->characters.array) {
-    free(table->characters.array);
-    table->characters.array = NULL;
+  for (unsigned int planeIndex=0; planeIndex<CHARACTER_PLANE_COUNT; planeIndex+=1) {
+    CharacterPlane *plane = table->characters.planes[planeIndex];
+
+    if (plane) {
+      for (unsigned int pageIndex=0; pageIndex<CHARACTER_PLANE_SIZE; pageIndex+=1) {
+        CharacterPage *page = plane->pages[pageIndex];
+        if (page) free(page);
+      }
+
+      free(plane);
+      table->characters.planes[planeIndex] = NULL;
+    }
+  }
+
+  if (table->characters.others.array) {
+    {
+      CharacterEntry **entry = table->characters.others.array;
+      CharacterEntry **end = entry + table->characters.others.count;
+      while (entry < end) free(*entry++);
+    }
+
+    free(table->characters.others.array);
+    table->characters.others.array = NULL;
+  }
+
+  if (table->characters.lock) {
+    freeLockDescriptor(table->characters.lock);
+    table->characters.lock = NULL;
   }
 
   if (table->rules.array) {
@@ -725,6 +753,21 @@ destroyCommonFields (ContractionTable *table) {
     free(table->rules.array);
     table->rules.array = NULL;
   }
+
+  if (table->profile.array) {
+    free(table->profile.array);
+    table->profile.array = NULL;
+  }
+
+  if (table->reverse.nodes) {
+    free(table->reverse.nodes);
+    table->reverse.nodes = NULL;
+  }
+
+  if (table->reverse.outputs) {
+    free(table->reverse.outputs);
+    table->reverse.outputs = NULL;
+  }
 }
 
 static void
@@ -741,6 +784,37 @@ static const ContractionTableManagementMethods nativeManagementMethods = {
   .destroy = destroyContractionTable_native
 };
 
+static void
+checkFindLengths (const unsigned char *bytes, ContractionTableOffset offset, unsigned int *maximum) {
+  while (offset) {
+    const ContractionTableRule *rule = (const void *)&bytes[offset];
+    if (rule->findlen > *maximum) *maximum = rule->findlen;
+    offset = rule->next;
+  }
+}
+
+static unsigned int
+getMaximumFindLength (const unsigned char *bytes) {
+  const ContractionTableHeader *header = (const void *)bytes;
+  unsigned int maximum = 0;
+
+  for (unsigned int index=0; index<HASHNUM; index+=1) {
+    checkFindLengths(bytes, header->rules[index], &maximum);
+  }
+
+  {
+    const ContractionTableCharacter *character = (const void *)&bytes[header->characters];
+    const ContractionTableCharacter *end = character + header->characterCount;
+
+    while (character < end) {
+      checkFindLengths(bytes, character->rules, &maximum);
+      character += 1;
+    }
+  }
+
+  return maximum;
+}
+
 static ContractionTable *
 newContractionTable (const unsigned char *bytes, size_t size) {
   ContractionTable *table;
@@ -752,6 +826,7 @@ newContractionTable (const unsigned char *bytes, size_t size) {
 
     table->data.internal.header.bytes = bytes;
     table->data.internal.size = size;
+    table->data.internal.maximumFindLength = getMaximumFindLength(bytes);
   } else {
     logMallocError();
   }
@@ -763,6 +838,7 @@ static ContractionTable *
 compileContractionTable_native (const char *name) {
   ContractionTable *table = NULL;
 
+  lockDataFiles();
   if (setTableDataVariables(CONTRACTION_TABLE_EXTENSION, CONTRACTION_SUBTABLE_EXTENSION)) {
     ContractionTableData ctd;
     memset(&ctd, 0, sizeof(ctd));
@@ -810,6 +886,7 @@ compileContractionTable_native (const char *name) {
     if (ctd.characterTable) free(ctd.characterTable);
   }
 
+  unlockDataFiles();
   return table;
 }
 
@@ -897,6 +974,7 @@ compileContractionTable_external (const char *name) {
 static void
 destroyContractionTable_louis (ContractionTable *table) {
   free(table->data.louis.tableList);
+  if (table->data.louis.work.buffer) free(table->data.louis.work.buffer);
 
   destroyCommonFields(table);
   free(table);
@@ -985,7 +1063,16 @@ compileContractionTable (const char *name) {
     }
   }
 
-  return compile(name);
+  ContractionTable *table = compile(name);
+
+  if (table) {
+    if (!prepareContractionTableCharacters(table)) {
+      destroyContractionTable(table);
+      table = NULL;
+    }
+  }
+
+  return table;
 }
 
 void
@@ -21,6 +21,8 @@
 
 #include <stdio.h>
 
+#include "lock.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -104,6 +106,26 @@ typedef struct {
   wchar_t findrep[]; /*find and replacement strings*/
 } ContractionTableRule;
 
+typedef struct {
+  const ContractionTableRule *rule;
+  unsigned long attempts;
+  unsigned long matches;
+} ContractionTableRuleCounters;
+
+typedef struct {
+  unsigned int child; /*first node reached by one more cell*/
+  unsigned int sibling; /*next node with the same parent*/
+  unsigned int outputs; /*first text written by these cells*/
+  BYTE cell;
+} ContractionTableReverseNode;
+
+typedef struct {
+  const wchar_t *text;
+  unsigned int next;
+  ContractionTableOpcode opcode;
+  BYTE length;
+} ContractionTableReverseOutput;
+
 typedef struct {
   ContractionTableOffset capitalSign; /*capitalization sign*/
   ContractionTableOffset beginCapitalSign; /*begin capitals sign*/
@@ -124,6 +146,24 @@ typedef struct {
   wchar_t lowercase;
 } CharacterEntry;
 
+#define CHARACTER_PAGE_SIZE 0X100
+#define CHARACTER_PLANE_SIZE 0X100
+#define CHARACTER_PLANE_COUNT 0X11
+#define CHARACTER_ENTRY_LIMIT (CHARACTER_PLANE_COUNT * CHARACTER_PLANE_SIZE * CHARACTER_PAGE_SIZE)
+
+typedef struct CharacterPageStruct CharacterPage;
+
+struct CharacterPageStruct {
+  CharacterPage *pending; /*next page still being built*/
+  wchar_t first; /*first character of the page*/
+  uint32_t finishing[CHARACTER_PAGE_SIZE / 32];
+  CharacterEntry entries[CHARACTER_PAGE_SIZE];
+};
+
+typedef struct {
+  CharacterPage *pages[CHARACTER_PLANE_SIZE];
+} CharacterPlane;
+
 typedef struct {
   void (*destroy) (ContractionTable *table);
 } ContractionTableManagementMethods;
@@ -141,6 +181,7 @@ typedef struct {
   } header;
 
   size_t size;
+  unsigned int maximumFindLength;
 } InternalContractionTable;
 
 struct ContractionTableStruct {
@@ -148,9 +189,17 @@ struct ContractionTableStruct {
   const ContractionTableTranslationMethods *translationMethods;
 
   struct {
-    CharacterEntry *array;
-    unsigned int size;
-    unsigned int count;
+    CharacterPlane *planes[CHARACTER_PLANE_COUNT];
+    CharacterPage *pending;
+    LockDescriptor *lock;
+
+    struct {
+      CharacterEntry **array;
+      unsigned int size;
+      unsigned int count;
+    } others;
+
+    ContractionTableCharacterStatistics statistics;
   } characters;
 
   struct {
@@ -159,6 +208,21 @@ struct ContractionTableStruct {
     unsigned int count;
   } rules;
 
+  struct {
+    ContractionTableRuleCounters *array;
+    unsigned int count;
+  } profile;
+
+  struct {
+    ContractionTableReverseNode *nodes;
+    unsigned int nodeCount;
+
+    ContractionTableReverseOutput *outputs;
+    unsigned int outputCount;
+
+    unsigned int maximumLength;
+  } reverse;
+
   union {
     InternalContractionTable internal;
 
@@ -177,6 +241,13 @@ struct ContractionTableStruct {
 #ifdef LOUIS_TABLES_DIRECTORY
     struct {
       char *tableList;
+      unsigned tableResolved:1;
+      unsigned tableUsable:1;
+
+      struct {
+        void *buffer;
+        size_t size;
+      } work;
     } louis;
 #endif /* LOUIS_TABLES_DIRECTORY */
   } data;
@@ -186,6 +257,10 @@ extern int startContractionCommand (ContractionTable *table);
 extern void stopContractionCommand (ContractionTable *table);
 
 extern const unsigned char *getInternalContractionTableBytes (void);
+extern int prepareContractionTableCharacters (ContractionTable *table);
+
+extern void countContractionTableRuleAttempt (ContractionTable *table, const ContractionTableRule *rule);
+extern void countContractionTableRuleMatch (ContractionTable *table, const ContractionTableRule *rule);
 
 #ifdef __cplusplus
 }
@@ -39,27 +39,80 @@ initialize (void) {
   }
 }
 
+static int
+resolveTable (ContractionTable *table) {
+  if (!table->data.louis.tableResolved) {
+    // a table which can't be compiled would otherwise be retried on every call
+    if (lou_getTable(table->data.louis.tableList)) {
+      table->data.louis.tableUsable = 1;
+    } else {
+      logMessage(LOG_WARNING, "LibLouis table not usable: %s",
+                 table->data.louis.tableList);
+    }
+
+    table->data.louis.tableResolved = 1;
+  }
+
+  return table->data.louis.tableUsable;
+}
+
+typedef struct {
+  int *outputOffsets;
+  int *inputOffsets;
+  widechar *inputBuffer;
+  widechar *outputBuffer;
+} WorkArea;
+
+static int
+getWorkArea (ContractionTable *table, WorkArea *area, int inputLength, int outputLength) {
+  size_t count = inputLength + outputLength;
+  size_t size = count * (sizeof(int) + sizeof(widechar));
+
+  if (size > table->data.louis.work.size) {
+    size_t newSize = table->data.louis.work.size? table->data.louis.work.size: 0X400;
+    while (newSize < size) newSize <<= 1;
+
+    void *newBuffer = realloc(table->data.louis.work.buffer, newSize);
+    if (!newBuffer) {
+      logMallocError();
+      return 0;
+    }
+
+    table->data.louis.work.buffer = newBuffer;
+    table->data.louis.work.size = newSize;
+  }
+
+  // the int arrays come first so that both element types stay aligned
+  area->outputOffsets = table->data.louis.work.buffer;
+  area->inputOffsets = area->outputOffsets + inputLength;
+  area->inputBuffer = (widechar *)(area->inputOffsets + outputLength);
+  area->outputBuffer = area->inputBuffer + inputLength;
+
+  return 1;
+}
+
 static int
 contractText_louis (BrailleContractionData *bcd) {
   initialize();
 
+  ContractionTable *table = bcd->table;
+  if (!resolveTable(table)) return 0;
+
   int inputLength = getInputCount(bcd);
-  widechar inputBuffer[inputLength];
-  int outputOffsets[inputLength];
+  int outputLength = getOutputCount(bcd);
+
+  WorkArea area;
+  if (!getWorkArea(table, &area, inputLength, outputLength)) return 0;
 
   {
     const wchar_t *source = bcd->input.begin;
-    widechar *target = inputBuffer;
+    widechar *target = area.inputBuffer;
 
     while (source < bcd->input.end) {
       *target++ = *source++;
     }
   }
 
-  int outputLength = getOutputCount(bcd);
-  widechar outputBuffer[outputLength];
-  int inputOffsets[outputLength];
-
   int *cursor = NULL;
   int position;
 
@@ -72,10 +125,10 @@ contractText_louis (BrailleContractionData *bcd) {
   if (prefs.expandCurrentWord) translationMode |= compbrlAtCursor;
 
   int translated = lou_translate(
-    bcd->table->data.louis.tableList,
-    inputBuffer, &inputLength, outputBuffer, &outputLength,
+    table->data.louis.tableList,
+    area.inputBuffer, &inputLength, area.outputBuffer, &outputLength,
     NULL /* typeForm */, NULL /* spacing */,
-    outputOffsets, inputOffsets, cursor, translationMode
+    area.outputOffsets, area.inputOffsets, cursor, translationMode
   );
 
   if (translated) {
@@ -83,7 +136,7 @@ contractText_louis (BrailleContractionData *bcd) {
     bcd->output.current = bcd->output.begin + outputLength;
 
     {
-      const widechar *source = outputBuffer;
+      const widechar *source = area.outputBuffer;
       BYTE *target = bcd->output.begin;
 
       while (target < bcd->output.current) {
@@ -92,7 +145,7 @@ contractText_louis (BrailleContractionData *bcd) {
     }
 
     if (bcd->input.offsets) {
-      const int *source = outputOffsets;
+      const int *source = area.outputOffsets;
       int *target = bcd->input.offsets;
       const int *end = target + inputLength;
       int previousOffset = -1;
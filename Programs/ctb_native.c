@@ -592,14 +592,6 @@ setAlwaysRule (wchar_t character, void *data) {
     BYTE cells[0X100];
     size_t count = makeDecomposedBraille(bcd, character, cells, sizeof(cells));
 
-    {
-      unsigned int position;
-      findCharacterEntry(bcd, character, &position);
-
-      entry = &bcd->table->characters.array[position];
-      sar->character = entry;
-    }
-
     if (count) {
       ContractionTableRule *rule;
       size_t size = sizeof(*rule) + sizeof(character) + count;
@@ -712,7 +704,7 @@ setCurrentRule (BrailleContractionData *bcd, const ContractionTableRule *rule) {
 }
 
 static int
-selectRule (BrailleContractionData *bcd, int length) {
+findRule (BrailleContractionData *bcd, int length) {
   if (length < 1) return 0;
 
   int ruleOffset;
@@ -747,6 +739,7 @@ selectRule (BrailleContractionData *bcd, int length) {
 
   while (ruleOffset) {
     setCurrentRule(bcd, getContractionTableItem(bcd, ruleOffset));
+    if (bcd->table->profile.array) countContractionTableRuleAttempt(bcd->table, bcd->current.rule);
 
     if ((length == 1) ||
         ((bcd->current.length <= length) &&
@@ -921,6 +914,13 @@ selectRule (BrailleContractionData *bcd, int length) {
   return 0;
 }
 
+static int
+selectRule (BrailleContractionData *bcd, int length) {
+  if (!findRule(bcd, length)) return 0;
+  if (bcd->table->profile.array) countContractionTableRuleMatch(bcd->table, bcd->current.rule);
+  return 1;
+}
+
 static int
 putCells (BrailleContractionData *bcd, const BYTE *cells, int count) {
   if (bcd->output.current + count > bcd->output.end) return 0;
@@ -987,10 +987,33 @@ clearRemainingOffsets (BrailleContractionData *bcd) {
   while (++bcd->input.current < next) clearOffset(bcd);
 }
 
+static void
+addResyncPoint (BrailleContractionData *bcd) {
+  if (bcd->input.current == bcd->input.begin) return;
+  if (bcd->input.current == bcd->input.end) return;
+  if (!testPrevious(bcd, CTC_Space)) return;
+  if (testCurrent(bcd, CTC_Space)) return;
+
+  /* Any rule which was tried before this point could have looked as far
+   * ahead as the longest find string, plus one following character, plus
+   * any punctuation that isEnding skipped over. Resuming here is only safe
+   * if the input up to that horizon hasn't changed.
+   */
+  const wchar_t *horizon = bcd->input.current + bcd->table->data.internal.maximumFindLength;
+
+  if (horizon < bcd->input.end) {
+    while (testCharacter(bcd, *horizon, CTC_Punctuation)) {
+      if (++horizon == bcd->input.end) break;
+    }
+  } else {
+    horizon = bcd->input.end;
+  }
+
+  addContractionResyncPoint(bcd, (horizon - bcd->input.begin) + 1);
+}
+
 static int
 contractText_native (BrailleContractionData *bcd) {
-  bcd->previous.opcode = CTO_None;
-
   const wchar_t *srcword = NULL;
   const wchar_t *srcjoin = NULL;
   const wchar_t *literal = NULL;
@@ -999,6 +1022,13 @@ contractText_native (BrailleContractionData *bcd) {
   BYTE *destjoin = NULL;
   BYTE *destlast = NULL;
 
+  if (bcd->input.current == bcd->input.begin) {
+    bcd->previous.opcode = CTO_None;
+  } else {
+    srcword = srcjoin = bcd->input.current;
+    destword = destjoin = bcd->output.current;
+  }
+
   unsigned char lineBreakOpportunities[getInputCount(bcd) + 1];
   LineBreakOpportunitiesState lbo;
   prepareLineBreakOpportunitiesState(&lbo);
@@ -1031,6 +1061,8 @@ contractText_native (BrailleContractionData *bcd) {
             bcd->input.current = bcd->input.begin;
             bcd->output.current = bcd->output.begin;
           }
+
+          pruneContractionResyncPoints(bcd);
         }
 
         continue;
@@ -1114,6 +1146,8 @@ contractText_native (BrailleContractionData *bcd) {
                 destptr += 1;
               }
             }
+
+            pruneContractionResyncPoints(bcd);
           }
           break;
 
@@ -1175,6 +1209,7 @@ contractText_native (BrailleContractionData *bcd) {
           if (repeat) {
             bcd->input.current = srcbeg;
             bcd->output.current = destbeg;
+            pruneContractionResyncPoints(bcd);
             continue;
           }
 
@@ -1200,6 +1235,12 @@ contractText_native (BrailleContractionData *bcd) {
     if ((bcd->output.current == bcd->output.begin) || bcd->output.current[-1]) {
       bcd->previous.opcode = bcd->current.opcode;
     }
+
+    if (bcd->cache && !literal) {
+      if ((srcword == bcd->input.current) && (srcjoin == srcword)) {
+        addResyncPoint(bcd);
+      }
+    }
   }
 
 done:
@@ -1240,9 +1281,24 @@ finishCharacterEntry_native (BrailleContractionData *bcd, CharacterEntry *entry)
   }
 }
 
+static int
+prepareCharacterEntries_native (BrailleContractionData *bcd) {
+  const ContractionTableHeader *header = getContractionTableHeader(bcd);
+  const ContractionTableCharacter *character = getContractionTableItem(bcd, header->characters);
+  const ContractionTableCharacter *end = character + header->characterCount;
+
+  while (character < end) {
+    if (!getCharacterEntry(bcd, character->value)) return 0;
+    character += 1;
+  }
+
+  return 1;
+}
+
 static const ContractionTableTranslationMethods nativeTranslationMethods = {
   .contractText = contractText_native,
-  .finishCharacterEntry = finishCharacterEntry_native
+  .finishCharacterEntry = finishCharacterEntry_native,
+  .prepareCharacterEntries = prepareCharacterEntries_native
 };
 
 const ContractionTableTranslationMethods *
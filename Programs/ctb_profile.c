@@ -0,0 +1,595 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "log.h"
+#include "file.h"
+#include "datafile.h"
+#include "ctb.h"
+#include "ctb_internal.h"
+
+/* The native translator tries the rules of a chain in order until one of
+ * them is selected, and the first rule whose find text matches also limits
+ * the length of the rules which may be selected after it. Two rules can only
+ * both match the same input if the find text of one of them (ignoring case)
+ * is a prefix of the find text of the other. Reordering a chain such that
+ * every such pair of rules stays in its original relative order therefore
+ * doesn't change which rule is selected for any input - it only changes how
+ * many rules are tried first.
+ */
+
+typedef int RuleChainHandler (ContractionTable *table, ContractionTableOffset *chain, void *data);
+
+static int
+isNativeContractionTable (ContractionTable *table) {
+  return table->translationMethods == getContractionTableTranslationMethods_native();
+}
+
+static unsigned char *
+getTableBytes (ContractionTable *table) {
+  return (unsigned char *)table->data.internal.header.fields;
+}
+
+static ContractionTableRule *
+getTableRule (ContractionTable *table, ContractionTableOffset offset) {
+  return (void *)&getTableBytes(table)[offset];
+}
+
+static int
+forEachRuleChain (ContractionTable *table, RuleChainHandler *handleChain, void *data) {
+  ContractionTableHeader *header = table->data.internal.header.fields;
+
+  for (unsigned int index=0; index<HASHNUM; index+=1) {
+    if (!handleChain(table, &header->rules[index], data)) return 0;
+  }
+
+  {
+    ContractionTableCharacter *character = (void *)&getTableBytes(table)[header->characters];
+    const ContractionTableCharacter *end = character + header->characterCount;
+
+    while (character < end) {
+      if (!handleChain(table, &character->rules, data)) return 0;
+      character += 1;
+    }
+  }
+
+  return 1;
+}
+
+typedef struct {
+  ContractionTableRuleCounters *array;
+  unsigned int count;
+} RuleCountersData;
+
+static int
+countChainRules (ContractionTable *table, ContractionTableOffset *chain, void *data) {
+  RuleCountersData *rcd = data;
+  ContractionTableOffset offset = *chain;
+
+  while (offset) {
+    rcd->count += 1;
+    offset = getTableRule(table, offset)->next;
+  }
+
+  return 1;
+}
+
+static int
+addChainRules (ContractionTable *table, ContractionTableOffset *chain, void *data) {
+  RuleCountersData *rcd = data;
+  ContractionTableOffset offset = *chain;
+
+  while (offset) {
+    const ContractionTableRule *rule = getTableRule(table, offset);
+    ContractionTableRuleCounters *counters = &rcd->array[rcd->count++];
+
+    counters->rule = rule;
+    counters->attempts = 0;
+    counters->matches = 0;
+
+    offset = rule->next;
+  }
+
+  return 1;
+}
+
+static int
+sortRuleCounters (const void *element1, const void *element2) {
+  uintptr_t address1 = (uintptr_t)((const ContractionTableRuleCounters *)element1)->rule;
+  uintptr_t address2 = (uintptr_t)((const ContractionTableRuleCounters *)element2)->rule;
+
+  if (address1 < address2) return -1;
+  if (address1 > address2) return 1;
+  return 0;
+}
+
+static ContractionTableRuleCounters *
+newRuleCounters (ContractionTable *table, unsigned int *count) {
+  RuleCountersData rcd = {
+    .array = NULL,
+    .count = 0
+  };
+
+  forEachRuleChain(table, countChainRules, &rcd);
+
+  if ((rcd.array = calloc(rcd.count+1, sizeof(*rcd.array)))) {
+    rcd.count = 0;
+    forEachRuleChain(table, addChainRules, &rcd);
+    qsort(rcd.array, rcd.count, sizeof(*rcd.array), sortRuleCounters);
+
+    *count = rcd.count;
+    return rcd.array;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static ContractionTableRuleCounters *
+findRuleCounters (ContractionTableRuleCounters *array, unsigned int count, const ContractionTableRule *rule) {
+  uintptr_t address = (uintptr_t)rule;
+  int first = 0;
+  int last = count - 1;
+
+  while (first <= last) {
+    int current = (first + last) / 2;
+    ContractionTableRuleCounters *counters = &array[current];
+    uintptr_t currentAddress = (uintptr_t)counters->rule;
+
+    if (currentAddress < address) {
+      first = current + 1;
+    } else if (currentAddress > address) {
+      last = current - 1;
+    } else {
+      return counters;
+    }
+  }
+
+  return NULL;
+}
+
+int
+startContractionTableProfile (ContractionTable *table) {
+  if (table->profile.array) return 1;
+
+  if (!isNativeContractionTable(table)) {
+    logMessage(LOG_WARNING, "rule profiling not supported for this contraction table");
+    return 0;
+  }
+
+  unsigned int count;
+  ContractionTableRuleCounters *array = newRuleCounters(table, &count);
+  if (!array) return 0;
+
+  table->profile.array = array;
+  table->profile.count = count;
+  return 1;
+}
+
+void
+stopContractionTableProfile (ContractionTable *table) {
+  if (table->profile.array) {
+    free(table->profile.array);
+    table->profile.array = NULL;
+    table->profile.count = 0;
+  }
+}
+
+void
+countContractionTableRuleAttempt (ContractionTable *table, const ContractionTableRule *rule) {
+  ContractionTableRuleCounters *counters = findRuleCounters(table->profile.array, table->profile.count, rule);
+  if (counters) counters->attempts += 1;
+}
+
+void
+countContractionTableRuleMatch (ContractionTable *table, const ContractionTableRule *rule) {
+  ContractionTableRuleCounters *counters = findRuleCounters(table->profile.array, table->profile.count, rule);
+  if (counters) counters->matches += 1;
+}
+
+void
+getContractionTableProfileTotals (ContractionTable *table, unsigned long *attempts, unsigned long *matches) {
+  *attempts = 0;
+  *matches = 0;
+
+  const ContractionTableRuleCounters *counters = table->profile.array;
+  const ContractionTableRuleCounters *end = counters + table->profile.count;
+
+  while (counters < end) {
+    *attempts += counters->attempts;
+    *matches += counters->matches;
+    counters += 1;
+  }
+}
+
+int
+writeContractionTableProfile (ContractionTable *table, const char *path) {
+  if (!table->profile.array) return 1;
+
+  FILE *stream = openDataFile(path, "w", 0);
+  if (!stream) return 0;
+
+  if (fprintf(stream, "# rule opcode find-text attempts matches\n") == EOF) goto outputError;
+
+  {
+    const ContractionTableRuleCounters *counters = table->profile.array;
+    const ContractionTableRuleCounters *end = counters + table->profile.count;
+
+    while (counters < end) {
+      if (counters->attempts) {
+        const ContractionTableRule *rule = counters->rule;
+
+        if (fprintf(stream, "rule %" PRIws " ", getContractionTableOpcodeName(rule->opcode)) == EOF) goto outputError;
+        if (!writeEscapedCharacters(stream, rule->findrep, rule->findlen)) goto outputError;
+        if (fprintf(stream, " %lu %lu\n", counters->attempts, counters->matches) == EOF) goto outputError;
+      }
+
+      counters += 1;
+    }
+  }
+
+  if (fclose(stream) == EOF) {
+    logSystemError("fclose");
+    return 0;
+  }
+
+  return 1;
+
+outputError:
+  logMessage(LOG_ERR, "output error: %s: %s", path, strerror(errno));
+  fclose(stream);
+  return 0;
+}
+
+typedef struct {
+  ContractionTable *table;
+  ContractionTableRuleCounters *array;
+  unsigned int count;
+} ProfileApplicationData;
+
+static int
+getOpcodeOperand (DataFile *file, ContractionTableOpcode *opcode) {
+  DataOperand operand;
+
+  if (getDataOperand(file, &operand, "opcode")) {
+    for (*opcode=0; *opcode<CTO_None; *opcode+=1) {
+      const wchar_t *name = getContractionTableOpcodeName(*opcode);
+
+      if (operand.length == wcslen(name)) {
+        if (wmemcmp(operand.characters, name, operand.length) == 0) {
+          return 1;
+        }
+      }
+    }
+
+    reportDataError(file, "opcode not defined: %.*" PRIws, operand.length, operand.characters);
+  }
+
+  return 0;
+}
+
+static int
+getCountOperand (DataFile *file, unsigned long *count, const char *description) {
+  DataOperand operand;
+
+  if (getDataOperand(file, &operand, description)) {
+    const wchar_t *character = operand.characters;
+    const wchar_t *end = character + operand.length;
+
+    *count = 0;
+
+    while (character < end) {
+      if ((*character < WC_C('0')) || (*character > WC_C('9'))) break;
+      unsigned long digit = *character++ - WC_C('0');
+
+      if (*count > ((ULONG_MAX - digit) / 10)) break;
+      *count = (*count * 10) + digit;
+    }
+
+    if (character == end) return 1;
+    reportDataError(file, "invalid %s: %.*" PRIws, description, operand.length, operand.characters);
+  }
+
+  return 0;
+}
+
+static ContractionTableRuleCounters *
+findProfiledRule (ProfileApplicationData *pad, ContractionTableOpcode opcode, const DataString *find) {
+  ContractionTable *table = pad->table;
+  ContractionTableHeader *header = table->data.internal.header.fields;
+  ContractionTableOffset offset = 0;
+
+  if (find->length == 1) {
+    const ContractionTableCharacter *characters = (void *)&getTableBytes(table)[header->characters];
+    wchar_t character = find->characters[0];
+    if (iswupper(character)) character = towlower(character);
+
+    int first = 0;
+    int last = header->characterCount - 1;
+
+    while (first <= last) {
+      int current = (first + last) / 2;
+      const ContractionTableCharacter *ctc = &characters[current];
+
+      if (ctc->value < character) {
+        first = current + 1;
+      } else if (ctc->value > character) {
+        last = current - 1;
+      } else {
+        offset = ctc->rules;
+        break;
+      }
+    }
+  } else if (find->length > 1) {
+    offset = header->rules[CTH(find->characters)];
+  }
+
+  while (offset) {
+    const ContractionTableRule *rule = getTableRule(table, offset);
+
+    if ((rule->opcode == opcode) && (rule->findlen == find->length)) {
+      if (wmemcmp(rule->findrep, find->characters, find->length) == 0) {
+        return findRuleCounters(pad->array, pad->count, rule);
+      }
+    }
+
+    offset = rule->next;
+  }
+
+  return NULL;
+}
+
+static DATA_OPERANDS_PROCESSOR(processRuleOperands) {
+  ProfileApplicationData *pad = data;
+  ContractionTableOpcode opcode;
+
+  if (getOpcodeOperand(file, &opcode)) {
+    DataString find;
+
+    if (getDataString(file, &find, 0, "find text")) {
+      unsigned long attempts;
+
+      if (getCountOperand(file, &attempts, "attempt count")) {
+        unsigned long matches;
+
+        if (getCountOperand(file, &matches, "match count")) {
+          ContractionTableRuleCounters *counters = findProfiledRule(pad, opcode, &find);
+
+          if (counters) {
+            counters->attempts += attempts;
+            counters->matches += matches;
+          }
+        }
+      }
+    }
+  }
+
+  return 1;
+}
+
+static DATA_OPERANDS_PROCESSOR(processProfileOperands) {
+  BEGIN_DATA_DIRECTIVE_TABLE
+    {.name=WS_C("rule"), .processor=processRuleOperands},
+  END_DATA_DIRECTIVE_TABLE
+
+  return processDirectiveOperand(file, &directives, "contraction profile directive", data);
+}
+
+typedef struct {
+  ContractionTableOffset offset;
+  ContractionTableRule *rule;
+  unsigned long weight;
+  unsigned char placed;
+} ChainEntry;
+
+typedef struct {
+  ProfileApplicationData *pad;
+
+  struct {
+    ChainEntry *array;
+    unsigned int size;
+  } entries;
+
+  unsigned int chainsReordered;
+  unsigned int rulesMoved;
+} ChainReorderingData;
+
+static int
+canMatchSameInput (const ContractionTableRule *rule1, const ContractionTableRule *rule2) {
+  unsigned int length = MIN(rule1->findlen, rule2->findlen);
+
+  for (unsigned int index=0; index<length; index+=1) {
+    if (towlower(rule1->findrep[index]) != towlower(rule2->findrep[index])) return 0;
+  }
+
+  return 1;
+}
+
+static int
+reorderRuleChain (ContractionTable *table, ContractionTableOffset *chain, void *data) {
+  ChainReorderingData *crd = data;
+  unsigned int count = 0;
+
+  {
+    ContractionTableOffset offset = *chain;
+
+    while (offset) {
+      ContractionTableRule *rule = getTableRule(table, offset);
+
+      if (count == crd->entries.size) {
+        unsigned int newSize = crd->entries.size? crd->entries.size<<1: 0X10;
+        ChainEntry *newArray = realloc(crd->entries.array, ARRAY_SIZE(newArray, newSize));
+
+        if (!newArray) {
+          logMallocError();
+          return 0;
+        }
+
+        crd->entries.array = newArray;
+        crd->entries.size = newSize;
+      }
+
+      ChainEntry *entry = &crd->entries.array[count++];
+      entry->offset = offset;
+      entry->rule = rule;
+      entry->weight = 0;
+      entry->placed = 0;
+
+      {
+        const ContractionTableRuleCounters *counters = findRuleCounters(crd->pad->array, crd->pad->count, rule);
+        if (counters) entry->weight = counters->matches;
+      }
+
+      offset = rule->next;
+    }
+  }
+
+  if (count < 2) return 1;
+  ChainEntry *entries = crd->entries.array;
+
+  ContractionTableOffset *link = chain;
+  unsigned int position = 0;
+  unsigned int moved = 0;
+
+  while (position < count) {
+    // A rule can only be placed after all of the rules ahead of it which can
+    // match the same input. Choose the rule which, together with those rules,
+    // gives the most selections per placed rule.
+    unsigned int best = 0;
+    double bestScore = -1.0;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      const ChainEntry *entry = &entries[index];
+      if (entry->placed) continue;
+
+      unsigned long weight = entry->weight;
+      unsigned int rules = 1;
+
+      for (unsigned int earlier=0; earlier<index; earlier+=1) {
+        const ChainEntry *blocker = &entries[earlier];
+
+        if (!blocker->placed && canMatchSameInput(blocker->rule, entry->rule)) {
+          weight += blocker->weight;
+          rules += 1;
+        }
+      }
+
+      double score = (double)weight / (double)rules;
+
+      if (score > bestScore) {
+        best = index;
+        bestScore = score;
+      }
+    }
+
+    for (unsigned int index=0; index<=best; index+=1) {
+      ChainEntry *entry = &entries[index];
+      if (entry->placed) continue;
+
+      if ((index == best) || canMatchSameInput(entry->rule, entries[best].rule)) {
+        entry->placed = 1;
+        if (index != position) moved += 1;
+        position += 1;
+
+        *link = entry->offset;
+        link = &entry->rule->next;
+      }
+    }
+  }
+
+  *link = 0;
+
+  if (moved) {
+    crd->chainsReordered += 1;
+    crd->rulesMoved += moved;
+  }
+
+  return 1;
+}
+
+int
+applyContractionTableProfile (ContractionTable *table, const char *path) {
+  if (!isNativeContractionTable(table)) {
+    logMessage(LOG_WARNING, "rule ordering not supported for this contraction table");
+    return 0;
+  }
+
+  if (!table->data.internal.size) {
+    logMessage(LOG_WARNING, "rule ordering not supported for the internal contraction table");
+    return 1;
+  }
+
+  int ok = 0;
+
+  ProfileApplicationData pad = {
+    .table = table
+  };
+
+  if ((pad.array = newRuleCounters(table, &pad.count))) {
+    int loaded;
+
+    lockDataFiles();
+
+    {
+      const DataFileParameters parameters = {
+        .processOperands = processProfileOperands,
+        .data = &pad
+      };
+
+      loaded = processDataFile(path, &parameters);
+    }
+
+    unlockDataFiles();
+
+    if (loaded) {
+      ChainReorderingData crd = {
+        .pad = &pad,
+
+        .entries = {
+          .array = NULL,
+          .size = 0
+        },
+
+        .chainsReordered = 0,
+        .rulesMoved = 0
+      };
+
+      if (forEachRuleChain(table, reorderRuleChain, &crd)) {
+        logMessage(LOG_DEBUG,
+          "contraction rules reordered: %u chains, %u rules moved",
+          crd.chainsReordered, crd.rulesMoved
+        );
+
+        ok = 1;
+      }
+
+      if (crd.entries.array) free(crd.entries.array);
+    }
+
+    free(pad.array);
+  }
+
+  return ok;
+}
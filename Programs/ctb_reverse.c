@@ -0,0 +1,857 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "ctb.h"
+#include "ctb_internal.h"
+#include "ttb.h"
+#include "unicode.h"
+#include "brl_dots.h"
+#include "prefs.h"
+
+/* Back-translation works one word (the cells between two blank cells) at a
+ * time. The rules of a native table are compiled into a trie which is keyed
+ * by their braille representations. As each cell arrives, every text which
+ * may end with it is found by walking that trie from each of the preceding
+ * cells which are no further back than the longest representation. The
+ * ways of reaching each cell are kept in a small lattice which respects the
+ * position within the word that each opcode requires. When the word is
+ * finished, the candidates are contracted again (best first) and the first
+ * one which reproduces the typed cells is used.
+ */
+
+#define MAXIMUM_WORD_CELLS 0X40
+#define MAXIMUM_PIECE_LENGTH 0X20
+#define HYPOTHESIS_LIMIT 0X20
+
+typedef enum {
+  HC_NONE,
+  HC_LETTER,
+  HC_DIGIT,
+  HC_PUNCTUATION,
+  HC_SPACE,
+  HC_OTHER
+} HypothesisClass;
+
+typedef enum {
+  HF_NUMBER          = 0X01,
+  HF_CAPITALIZE_NEXT = 0X02,
+  HF_CAPITALIZE_WORD = 0X04,
+  HF_LETTER_SIGN     = 0X08,
+  HF_WORD_START      = 0X10
+} HypothesisFlag;
+
+typedef enum {
+  HN_LETTER = 0X01, /*the next text must begin with a letter*/
+  HN_DIGIT  = 0X02, /*the next text must begin with a digit*/
+  HN_END    = 0X04, /*the next text, if any, must be punctuation*/
+  HN_FINAL  = 0X08, /*there mustn't be any more text*/
+  HN_MORE   = 0X10  /*there must be more text*/
+} HypothesisNeed;
+
+typedef struct {
+  wchar_t text[MAXIMUM_PIECE_LENGTH];
+  uint32_t hash; /*of all of the text so far*/
+  unsigned short score;
+  BYTE length;
+
+  BYTE start;
+  BYTE previous;
+
+  BYTE flags;
+  BYTE needs;
+  BYTE last;
+  BYTE opcode;
+} Hypothesis;
+
+typedef struct {
+  Hypothesis hypotheses[HYPOTHESIS_LIMIT];
+  unsigned int count;
+} HypothesisRow;
+
+struct ContractedInputStruct {
+  ContractionTable *table;
+
+  BYTE cells[MAXIMUM_WORD_CELLS];
+  unsigned int cellCount;
+
+  HypothesisRow *rows;
+  unsigned int rowCount;
+};
+
+static int
+isNativeContractionTable (ContractionTable *table) {
+  return table->translationMethods == getContractionTableTranslationMethods_native();
+}
+
+static const ContractionTableHeader *
+getTableHeader (ContractionTable *table) {
+  return table->data.internal.header.fields;
+}
+
+static const void *
+getTableItem (ContractionTable *table, ContractionTableOffset offset) {
+  return &table->data.internal.header.bytes[offset];
+}
+
+typedef struct {
+  ContractionTable *table;
+  unsigned int nodeSize;
+  unsigned int outputSize;
+} ReverseTrieData;
+
+static unsigned int
+findReverseNode (ContractionTable *table, unsigned int parent, BYTE cell) {
+  const ContractionTableReverseNode *nodes = table->reverse.nodes;
+  unsigned int node = nodes[parent].child;
+
+  while (node) {
+    if (nodes[node].cell == cell) break;
+    node = nodes[node].sibling;
+  }
+
+  return node;
+}
+
+static unsigned int
+addReverseNode (ReverseTrieData *rtd, unsigned int parent, BYTE cell) {
+  ContractionTable *table = rtd->table;
+
+  {
+    unsigned int node = findReverseNode(table, parent, cell);
+    if (node) return node;
+  }
+
+  if (table->reverse.nodeCount == rtd->nodeSize) {
+    unsigned int newSize = rtd->nodeSize << 1;
+    ContractionTableReverseNode *newNodes = realloc(table->reverse.nodes, ARRAY_SIZE(newNodes, newSize));
+
+    if (!newNodes) {
+      logMallocError();
+      return 0;
+    }
+
+    table->reverse.nodes = newNodes;
+    rtd->nodeSize = newSize;
+  }
+
+  unsigned int node = table->reverse.nodeCount++;
+  ContractionTableReverseNode *nodes = table->reverse.nodes;
+
+  nodes[node].cell = cell;
+  nodes[node].child = 0;
+  nodes[node].outputs = 0;
+
+  nodes[node].sibling = nodes[parent].child;
+  nodes[parent].child = node;
+
+  return node;
+}
+
+static int
+addReverseOutput (
+  ReverseTrieData *rtd, const BYTE *cells, unsigned int count,
+  const wchar_t *text, BYTE length, ContractionTableOpcode opcode
+) {
+  ContractionTable *table = rtd->table;
+  if (!count) return 1;
+
+  unsigned int node = 0;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    if (!(node = addReverseNode(rtd, node, cells[index]))) return 0;
+  }
+
+  unsigned int last = 0;
+
+  {
+    unsigned int index = table->reverse.nodes[node].outputs;
+
+    while (index) {
+      const ContractionTableReverseOutput *output = &table->reverse.outputs[index];
+
+      if ((output->opcode == opcode) && (output->length == length)) {
+        if (!length || (wmemcmp(output->text, text, length) == 0)) return 1;
+      }
+
+      /* keep the texts in the order in which their rules were defined */
+      if (!text || !output->text || (output->text < text)) last = index;
+      index = output->next;
+    }
+  }
+
+  if (table->reverse.outputCount == rtd->outputSize) {
+    unsigned int newSize = rtd->outputSize << 1;
+    ContractionTableReverseOutput *newOutputs = realloc(table->reverse.outputs, ARRAY_SIZE(newOutputs, newSize));
+
+    if (!newOutputs) {
+      logMallocError();
+      return 0;
+    }
+
+    table->reverse.outputs = newOutputs;
+    rtd->outputSize = newSize;
+  }
+
+  {
+    unsigned int index = table->reverse.outputCount++;
+    ContractionTableReverseOutput *output = &table->reverse.outputs[index];
+
+    output->text = text;
+    output->length = length;
+    output->opcode = opcode;
+
+    {
+      unsigned int *next = last? &table->reverse.outputs[last].next: &table->reverse.nodes[node].outputs;
+      output->next = *next;
+      *next = index;
+    }
+  }
+
+  if (count > table->reverse.maximumLength) table->reverse.maximumLength = count;
+  return 1;
+}
+
+static int
+addReverseRules (ReverseTrieData *rtd, ContractionTableOffset offset) {
+  ContractionTable *table = rtd->table;
+
+  while (offset) {
+    const ContractionTableRule *rule = getTableItem(table, offset);
+
+    switch (rule->opcode) {
+      case CTO_Literal:
+      case CTO_Contraction:
+      case CTO_Replace:
+        break;
+
+      default:
+        if (rule->findlen && (rule->findlen <= (MAXIMUM_PIECE_LENGTH - 2))) {
+          const BYTE *cells = (const BYTE *)&rule->findrep[rule->findlen];
+
+          if (!addReverseOutput(rtd, cells, rule->replen, rule->findrep, rule->findlen, rule->opcode)) {
+            return 0;
+          }
+        }
+
+        break;
+    }
+
+    offset = rule->next;
+  }
+
+  return 1;
+}
+
+static int
+addReverseSign (ReverseTrieData *rtd, ContractionTableOffset offset, ContractionTableOpcode opcode) {
+  if (!offset) return 1;
+
+  const BYTE *sequence = getTableItem(rtd->table, offset);
+  return addReverseOutput(rtd, sequence+1, *sequence, NULL, 0, opcode);
+}
+
+static int
+makeReverseTrie (ContractionTable *table) {
+  if (table->reverse.nodes) return 1;
+
+  if (!isNativeContractionTable(table)) {
+    logMessage(LOG_DEBUG, "back-translation not supported for this contraction table");
+    return 0;
+  }
+
+  ReverseTrieData rtd = {
+    .table = table,
+    .nodeSize = 0X100,
+    .outputSize = 0X100
+  };
+
+  table->reverse.nodeCount = 1;
+  table->reverse.outputCount = 1;
+  table->reverse.maximumLength = 0;
+
+  if ((table->reverse.nodes = calloc(rtd.nodeSize, sizeof(*table->reverse.nodes)))) {
+    if ((table->reverse.outputs = calloc(rtd.outputSize, sizeof(*table->reverse.outputs)))) {
+      const ContractionTableHeader *header = getTableHeader(table);
+      int ok = 1;
+
+      for (unsigned int index=0; index<HASHNUM; index+=1) {
+        if (!addReverseRules(&rtd, header->rules[index])) {
+          ok = 0;
+          break;
+        }
+      }
+
+      if (ok) {
+        const ContractionTableCharacter *character = getTableItem(table, header->characters);
+        const ContractionTableCharacter *end = character + header->characterCount;
+
+        while (character < end) {
+          if (!addReverseRules(&rtd, character->rules)) {
+            ok = 0;
+            break;
+          }
+
+          character += 1;
+        }
+      }
+
+      if (ok) {
+        if (addReverseSign(&rtd, header->capitalSign, CTO_CapitalSign) &&
+            addReverseSign(&rtd, header->beginCapitalSign, CTO_BeginCapitalSign) &&
+            addReverseSign(&rtd, header->endCapitalSign, CTO_EndCapitalSign) &&
+            addReverseSign(&rtd, header->letterSign, CTO_LetterSign) &&
+            addReverseSign(&rtd, header->numberSign, CTO_NumberSign)) {
+          logMessage(LOG_DEBUG,
+            "back-translation trie: %u nodes, %u texts, longest %u cells",
+            table->reverse.nodeCount-1, table->reverse.outputCount-1,
+            table->reverse.maximumLength
+          );
+
+          return 1;
+        }
+      }
+
+      free(table->reverse.outputs);
+      table->reverse.outputs = NULL;
+    } else {
+      logMallocError();
+    }
+
+    free(table->reverse.nodes);
+    table->reverse.nodes = NULL;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static HypothesisClass
+getCharacterClass (wchar_t character) {
+  if (iswalpha(character)) return HC_LETTER;
+  if (iswdigit(character)) return HC_DIGIT;
+  if (iswspace(character)) return HC_SPACE;
+  if (iswpunct(character)) return HC_PUNCTUATION;
+  return HC_OTHER;
+}
+
+static void
+addHypothesis (HypothesisRow *row, const Hypothesis *hypothesis) {
+  for (unsigned int index=0; index<row->count; index+=1) {
+    Hypothesis *current = &row->hypotheses[index];
+
+    if ((current->hash == hypothesis->hash) &&
+        (current->flags == hypothesis->flags) &&
+        (current->needs == hypothesis->needs) &&
+        (current->last == hypothesis->last)) {
+      if (hypothesis->score < current->score) *current = *hypothesis;
+      return;
+    }
+  }
+
+  if (row->count < HYPOTHESIS_LIMIT) {
+    row->hypotheses[row->count++] = *hypothesis;
+    return;
+  }
+
+  Hypothesis *worst = &row->hypotheses[0];
+
+  for (unsigned int index=1; index<row->count; index+=1) {
+    Hypothesis *current = &row->hypotheses[index];
+    if (current->score >= worst->score) worst = current;
+  }
+
+  if (hypothesis->score < worst->score) *worst = *hypothesis;
+}
+
+static void
+extendHypothesis (
+  ContractedInput *ci, unsigned int start, unsigned int previous,
+  const ContractionTableReverseOutput *output, int upper,
+  unsigned int end, int joined
+) {
+  const Hypothesis *old = &ci->rows[start].hypotheses[previous];
+  ContractionTableOpcode opcode = output->opcode;
+
+  Hypothesis new = {
+    .hash = old->hash,
+    .score = old->score + 10,
+    .length = 0,
+
+    .start = start,
+    .previous = previous,
+
+    .flags = old->flags & ~HF_WORD_START,
+    .needs = 0,
+    .last = old->last,
+    .opcode = opcode
+  };
+
+  if (!output->length) {
+    if (old->needs & (HN_END | HN_FINAL)) return;
+    new.needs = old->needs & (HN_LETTER | HN_DIGIT);
+
+    switch (opcode) {
+      case CTO_CapitalSign:
+        if (prefs.capitalizationMode != CTB_CAP_SIGN) return;
+        new.flags |= HF_CAPITALIZE_NEXT;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_BeginCapitalSign:
+        if (prefs.capitalizationMode != CTB_CAP_SIGN) return;
+        new.flags |= HF_CAPITALIZE_WORD;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_EndCapitalSign:
+        if (!(old->flags & HF_CAPITALIZE_WORD)) return;
+        new.flags &= ~HF_CAPITALIZE_WORD;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_LetterSign:
+        new.flags &= ~HF_NUMBER;
+        new.flags |= HF_LETTER_SIGN;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_NumberSign:
+        if (old->flags & HF_NUMBER) return;
+        new.flags |= HF_NUMBER;
+        new.needs |= HN_DIGIT;
+        break;
+
+      default:
+        return;
+    }
+  } else {
+    HypothesisClass first = getCharacterClass(output->text[0]);
+
+    if (old->needs & HN_FINAL) return;
+    if ((old->needs & HN_END) && (first != HC_PUNCTUATION)) return;
+    if ((old->needs & HN_LETTER) && (first != HC_LETTER)) return;
+    if ((old->needs & HN_DIGIT) && (first != HC_DIGIT)) return;
+
+    int boundary = joined ||
+                   (old->last == HC_NONE) ||
+                   (old->last == HC_SPACE) ||
+                   (old->last == HC_PUNCTUATION);
+
+    if (joined) new.text[new.length++] = WC_C(' ');
+
+    switch (opcode) {
+      case CTO_Always:
+      case CTO_Repeatable:
+      case CTO_LargeSign:
+      case CTO_LastLargeSign:
+        break;
+
+      case CTO_WholeWord:
+        if (!boundary) return;
+        new.needs |= HN_END;
+        break;
+
+      case CTO_LowWord:
+        if (joined || (old->last != HC_NONE)) return;
+        new.needs |= HN_FINAL;
+        break;
+
+      case CTO_JoinedWord:
+        if (!boundary) return;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_SuffixableWord:
+        if (!boundary) return;
+        break;
+
+      case CTO_PrefixableWord:
+        if (old->last == HC_DIGIT) return;
+        new.needs |= HN_END;
+        break;
+
+      case CTO_BegWord:
+        if (!boundary) return;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_BegMidWord:
+        if (!boundary && (old->last != HC_LETTER)) return;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_MidWord:
+        if (old->last != HC_LETTER) return;
+        new.needs |= HN_LETTER;
+        break;
+
+      case CTO_MidEndWord:
+        if (old->last != HC_LETTER) return;
+        break;
+
+      case CTO_EndWord:
+        if (old->last != HC_LETTER) return;
+        new.needs |= HN_END;
+        break;
+
+      case CTO_BegNum:
+        if (!boundary) return;
+        new.needs |= HN_DIGIT;
+        break;
+
+      case CTO_MidNum:
+        if (old->last != HC_DIGIT) return;
+        new.needs |= HN_DIGIT;
+        break;
+
+      case CTO_EndNum:
+        if (old->last != HC_DIGIT) return;
+        new.needs |= HN_END;
+        break;
+
+      case CTO_PrePunc:
+        if (!boundary) return;
+        new.needs |= HN_MORE;
+        break;
+
+      case CTO_PostPunc:
+        if (old->last == HC_NONE) return;
+        new.needs |= HN_END;
+        break;
+
+      default:
+        return;
+    }
+
+    if (first == HC_DIGIT) {
+      if (getTableHeader(ci->table)->numberSign && !(old->flags & HF_NUMBER)) return;
+    } else if (opcode != CTO_MidNum) {
+      if ((first == HC_LETTER) && (old->flags & HF_NUMBER) && !(old->flags & HF_LETTER_SIGN)) return;
+      new.flags &= ~HF_NUMBER;
+    }
+
+    if (boundary) {
+      new.flags |= HF_WORD_START;
+    } else if (output->length > ((end - start) + 2)) {
+      new.score += 10;
+    }
+
+    if ((first == HC_LETTER) && (old->last == HC_PUNCTUATION)) new.score += 8;
+    new.flags &= ~HF_LETTER_SIGN;
+
+    for (unsigned int index=0; index<output->length; index+=1) {
+      wchar_t character = output->text[index];
+      if (character >= 0X80) new.score += 8;
+
+      if (getCharacterClass(character) == HC_LETTER) {
+        if (upper || (new.flags & (HF_CAPITALIZE_NEXT | HF_CAPITALIZE_WORD))) {
+          character = towupper(character);
+        }
+
+        new.flags &= ~HF_CAPITALIZE_NEXT;
+        upper = 0;
+      }
+
+      new.text[new.length++] = character;
+    }
+
+    if (opcode == CTO_JoinedWord) new.text[new.length++] = WC_C(' ');
+    new.last = getCharacterClass(new.text[new.length-1]);
+
+    for (unsigned int index=0; index<new.length; index+=1) {
+      new.hash = (new.hash * 31) + new.text[index];
+    }
+  }
+
+  addHypothesis(&ci->rows[end], &new);
+}
+
+static int
+isJoinableLargeSign (const Hypothesis *hypothesis, const ContractionTableReverseOutput *output) {
+  if (hypothesis->opcode != CTO_LargeSign) return 0;
+  if (!(hypothesis->flags & HF_WORD_START)) return 0;
+  if (hypothesis->needs & (HN_LETTER | HN_DIGIT | HN_MORE)) return 0;
+  return (output->opcode == CTO_LargeSign) || (output->opcode == CTO_LastLargeSign);
+}
+
+static void
+addHypotheses (ContractedInput *ci, unsigned int end) {
+  ContractionTable *table = ci->table;
+  HypothesisRow *row = &ci->rows[end];
+  row->count = 0;
+
+  unsigned int maximum = table->reverse.maximumLength;
+  unsigned int start = (end > maximum)? (end - maximum): 0;
+
+  while (start < end) {
+    const HypothesisRow *from = &ci->rows[start];
+
+    if (from->count) {
+      unsigned int node = 0;
+      int upper = 0;
+
+      for (unsigned int index=start; index<end; index+=1) {
+        BYTE cell = ci->cells[index];
+
+        if (prefs.capitalizationMode == CTB_CAP_DOT7) {
+          if (cell & BRL_DOT_7) {
+            if (index > start) {
+              node = 0;
+              break;
+            }
+
+            cell &= ~BRL_DOT_7;
+            upper = 1;
+          }
+        }
+
+        if (!(node = findReverseNode(table, node, cell))) break;
+      }
+
+      if (node) {
+        unsigned int outputIndex = table->reverse.nodes[node].outputs;
+
+        while (outputIndex) {
+          const ContractionTableReverseOutput *output = &table->reverse.outputs[outputIndex];
+
+          for (unsigned int previous=0; previous<from->count; previous+=1) {
+            extendHypothesis(ci, start, previous, output, upper, end, 0);
+
+            if (isJoinableLargeSign(&from->hypotheses[previous], output)) {
+              extendHypothesis(ci, start, previous, output, upper, end, 1);
+            }
+          }
+
+          outputIndex = output->next;
+        }
+      }
+    }
+
+    start += 1;
+  }
+}
+
+static void
+resetHypotheses (ContractedInput *ci) {
+  HypothesisRow *row = &ci->rows[0];
+  Hypothesis *hypothesis = &row->hypotheses[0];
+
+  memset(hypothesis, 0, sizeof(*hypothesis));
+  hypothesis->last = HC_NONE;
+  hypothesis->opcode = CTO_None;
+  row->count = 1;
+
+  for (unsigned int end=1; end<=ci->cellCount; end+=1) {
+    addHypotheses(ci, end);
+  }
+}
+
+static int
+useContractionTable (ContractedInput *ci, ContractionTable *table) {
+  if (!table) return 0;
+
+  // A reloaded table may have been allocated where the previous one was,
+  // so a table which has no trie yet is also new.
+  int isNew = !table->reverse.nodes || (table != ci->table);
+  if (!makeReverseTrie(table)) return 0;
+
+  if (isNew) {
+    ci->table = table;
+    resetHypotheses(ci);
+  }
+
+  return 1;
+}
+
+ContractedInput *
+newContractedInput (void) {
+  ContractedInput *ci;
+
+  if ((ci = malloc(sizeof(*ci)))) {
+    memset(ci, 0, sizeof(*ci));
+    ci->table = NULL;
+    ci->cellCount = 0;
+
+    ci->rowCount = 0X10;
+
+    if ((ci->rows = malloc(ARRAY_SIZE(ci->rows, ci->rowCount)))) {
+      resetHypotheses(ci);
+      return ci;
+    }
+
+    free(ci);
+  }
+
+  logMallocError();
+  return NULL;
+}
+
+void
+destroyContractedInput (ContractedInput *ci) {
+  free(ci->rows);
+  free(ci);
+}
+
+unsigned int
+getContractedInputCellCount (ContractedInput *ci) {
+  return ci->cellCount;
+}
+
+int
+addContractedInputCell (ContractedInput *ci, ContractionTable *table, unsigned char cell) {
+  if (!cell) return 0;
+  if (ci->cellCount == MAXIMUM_WORD_CELLS) return 0;
+  if (!useContractionTable(ci, table)) return 0;
+
+  unsigned int end = ci->cellCount + 1;
+
+  if (end == ci->rowCount) {
+    unsigned int newCount = ci->rowCount << 1;
+    HypothesisRow *newRows = realloc(ci->rows, ARRAY_SIZE(newRows, newCount));
+
+    if (!newRows) {
+      logMallocError();
+      return 0;
+    }
+
+    ci->rows = newRows;
+    ci->rowCount = newCount;
+  }
+
+  ci->cells[ci->cellCount] = cell;
+  ci->cellCount = end;
+  addHypotheses(ci, end);
+  return 1;
+}
+
+int
+removeContractedInputCell (ContractedInput *ci) {
+  if (!ci->cellCount) return 0;
+  ci->cellCount -= 1;
+  return 1;
+}
+
+static size_t
+getHypothesisText (ContractedInput *ci, const Hypothesis *hypothesis, wchar_t *characters, size_t size) {
+  size_t length = 0;
+
+  {
+    const Hypothesis *current = hypothesis;
+
+    while (current != &ci->rows[0].hypotheses[0]) {
+      length += current->length;
+      current = &ci->rows[current->start].hypotheses[current->previous];
+    }
+  }
+
+  if (length > size) return 0;
+
+  {
+    const Hypothesis *current = hypothesis;
+    wchar_t *end = characters + length;
+
+    while (current != &ci->rows[0].hypotheses[0]) {
+      end -= current->length;
+      wmemcpy(end, current->text, current->length);
+      current = &ci->rows[current->start].hypotheses[current->previous];
+    }
+  }
+
+  return length;
+}
+
+static int
+verifyHypothesisText (ContractedInput *ci, const wchar_t *characters, size_t count) {
+  BYTE cells[MAXIMUM_WORD_CELLS + 1];
+  int inputLength = count;
+  int outputLength = sizeof(cells);
+
+  contractText(
+    ci->table, NULL,
+    characters, &inputLength,
+    cells, &outputLength,
+    NULL, CTB_NO_CURSOR
+  );
+
+  if (inputLength != count) return 0;
+  if (outputLength != ci->cellCount) return 0;
+  return memcmp(cells, ci->cells, outputLength) == 0;
+}
+
+static size_t
+getComputerBraille (ContractedInput *ci, wchar_t *characters, size_t size) {
+  size_t count = 0;
+
+  while ((count < ci->cellCount) && (count < size)) {
+    BYTE cell = ci->cells[count];
+    characters[count++] = textTable? convertDotsToCharacter(textTable, cell): (UNICODE_BRAILLE_ROW | cell);
+  }
+
+  return count;
+}
+
+size_t
+finishContractedInput (ContractedInput *ci, ContractionTable *table, wchar_t *characters, size_t size) {
+  size_t count = 0;
+
+  if (ci->cellCount) {
+    if (useContractionTable(ci, table)) {
+      const HypothesisRow *row = &ci->rows[ci->cellCount];
+      const Hypothesis *candidates[HYPOTHESIS_LIMIT];
+      unsigned int candidateCount = 0;
+
+      for (unsigned int index=0; index<row->count; index+=1) {
+        const Hypothesis *hypothesis = &row->hypotheses[index];
+
+        if (hypothesis->needs & (HN_LETTER | HN_DIGIT | HN_MORE)) continue;
+        if (hypothesis->flags & (HF_CAPITALIZE_NEXT | HF_LETTER_SIGN)) continue;
+
+        {
+          unsigned int position = candidateCount++;
+
+          while (position && (candidates[position-1]->score > hypothesis->score)) {
+            candidates[position] = candidates[position-1];
+            position -= 1;
+          }
+
+          candidates[position] = hypothesis;
+        }
+      }
+
+      for (unsigned int index=0; index<candidateCount; index+=1) {
+        size_t length = getHypothesisText(ci, candidates[index], characters, size);
+
+        if (length && verifyHypothesisText(ci, characters, length)) {
+          count = length;
+          break;
+        }
+      }
+    }
+
+    if (!count) count = getComputerBraille(ci, characters, size);
+    ci->cellCount = 0;
+  }
+
+  return count;
+}
@@ -22,6 +22,7 @@
 
 #include "log.h"
 #include "lock.h"
+#include "scratch.h"
 #include "ctb_translate.h"
 #include "ttb.h"
 #include "unicode.h"
@@ -54,54 +55,8 @@ unlockContractionTable (void) {
   releaseLock(getContractionTableLock());
 }
 
-const CharacterEntry *
-findCharacterEntry (BrailleContractionData *bcd, wchar_t character, unsigned int *position) {
-  unsigned int from = 0;
-  unsigned int to = bcd->table->characters.count;
-
-  while (from < to) {
-    unsigned int current = (from + to) / 2;
-    const CharacterEntry *entry = &bcd->table->characters.array[current];
-
-    if (entry->value < character) {
-      from = current + 1;
-    } else if (entry->value > character) {
-      to = current;
-    } else {
-      if (position) *position = current;
-      return entry;
-    }
-  }
-
-  if (position) *position = from;
-  return NULL;
-}
-
-static const CharacterEntry *
-addCharacterEntry (BrailleContractionData *bcd, wchar_t character, unsigned int position) {
-  ContractionTable *table = bcd->table;
-
-  if (table->characters.count == table->characters.size) {
-    int newSize = table->characters.size;
-    newSize = newSize? newSize<<1: 0X80;
-    CharacterEntry *newArray = realloc(table->characters.array, ARRAY_SIZE(newArray, newSize));
-
-    if (!newArray) {
-      logMallocError();
-      return NULL;
-    }
-
-    table->characters.array = newArray;
-    table->characters.size = newSize;
-  }
-
-  memmove(
-    &table->characters.array[position+1],
-    &table->characters.array[position],
-    ((table->characters.count++ - position) * sizeof(*table->characters.array))
-  );
-
-  CharacterEntry *entry = &bcd->table->characters.array[position];
+static void
+initializeCharacterEntry (CharacterEntry *entry, wchar_t character) {
   memset(entry, 0, sizeof(*entry));
   entry->value = entry->uppercase = entry->lowercase = character;
 
@@ -124,17 +79,204 @@ addCharacterEntry (BrailleContractionData *bcd, wchar_t character, unsigned int
   } else if (iswpunct(character)) {
     entry->attributes |= CTC_Punctuation;
   }
+}
+
+static void
+finishCharacterEntry (BrailleContractionData *bcd, CharacterPage *page, unsigned int index) {
+  uint32_t *bits = &page->finishing[index / 32];
+  uint32_t bit = UINT32_C(1) << (index % 32);
+
+  if (!(*bits & bit)) {
+    *bits |= bit;
+    bcd->table->translationMethods->finishCharacterEntry(bcd, &page->entries[index]);
+  }
+}
+
+static CharacterPage *
+getPendingCharacterPage (ContractionTable *table, wchar_t first) {
+  CharacterPage *page = table->characters.pending;
+
+  while (page) {
+    if (page->first == first) break;
+    page = page->pending;
+  }
+
+  return page;
+}
+
+static CharacterPage *
+addCharacterPage (BrailleContractionData *bcd, uint32_t value) {
+  ContractionTable *table = bcd->table;
+  CharacterPlane **plane = &table->characters.planes[value / (CHARACTER_PLANE_SIZE * CHARACTER_PAGE_SIZE)];
+
+  if (!*plane) {
+    CharacterPlane *newPlane;
+
+    if (!(newPlane = malloc(sizeof(*newPlane)))) {
+      logMallocError();
+      return NULL;
+    }
+
+    memset(newPlane, 0, sizeof(*newPlane));
+    __sync_synchronize();
+    *plane = newPlane;
+  }
+
+  CharacterPage **location = &(*plane)->pages[(value / CHARACTER_PAGE_SIZE) % CHARACTER_PLANE_SIZE];
+  CharacterPage *page = *location;
+
+  if (!page) {
+    if (!(page = malloc(sizeof(*page)))) {
+      logMallocError();
+      return NULL;
+    }
+
+    memset(page->finishing, 0, sizeof(page->finishing));
+    page->first = value - (value % CHARACTER_PAGE_SIZE);
+
+    for (unsigned int index=0; index<CHARACTER_PAGE_SIZE; index+=1) {
+      initializeCharacterEntry(&page->entries[index], page->first+index);
+    }
+
+    /* Finishing an entry may look up other characters (e.g. the components
+     * of a decomposable character), including ones within this page, so the
+     * page is only published after all of its entries have been finished.
+     */
+    page->pending = table->characters.pending;
+    table->characters.pending = page;
+
+    for (unsigned int index=0; index<CHARACTER_PAGE_SIZE; index+=1) {
+      finishCharacterEntry(bcd, page, index);
+    }
+
+    table->characters.pending = page->pending;
+    page->pending = NULL;
+
+    __sync_synchronize();
+    *location = page;
+    table->characters.statistics.addedPages += 1;
+  }
 
-  bcd->table->translationMethods->finishCharacterEntry(bcd, entry);
+  return page;
+}
+
+static const CharacterEntry *
+addOtherCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
+  ContractionTable *table = bcd->table;
+
+  {
+    CharacterEntry **entry = table->characters.others.array;
+    CharacterEntry **end = entry + table->characters.others.count;
+
+    while (entry < end) {
+      if ((*entry)->value == character) return *entry;
+      entry += 1;
+    }
+  }
+
+  if (table->characters.others.count == table->characters.others.size) {
+    unsigned int newSize = table->characters.others.size;
+    newSize = newSize? newSize<<1: 0X10;
+    CharacterEntry **newArray = realloc(table->characters.others.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return NULL;
+    }
+
+    table->characters.others.array = newArray;
+    table->characters.others.size = newSize;
+  }
+
+  CharacterEntry *entry;
+
+  if (!(entry = malloc(sizeof(*entry)))) {
+    logMallocError();
+    return NULL;
+  }
+
+  initializeCharacterEntry(entry, character);
+  table->characters.others.array[table->characters.others.count++] = entry;
+  table->characters.statistics.otherCharacters += 1;
+
+  table->translationMethods->finishCharacterEntry(bcd, entry);
   return entry;
 }
 
 const CharacterEntry *
-getCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
-  unsigned int position;
-  const CharacterEntry *entry = findCharacterEntry(bcd, character, &position);
-  if (entry) return entry;
-  return addCharacterEntry(bcd, character, position);
+makeCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
+  ContractionTable *table = bcd->table;
+  const CharacterEntry *entry = NULL;
+  int lock = !bcd->buildingCharacters;
+
+  if (lock) {
+    obtainExclusiveLock(table->characters.lock);
+    table->characters.statistics.lockedLookups += 1;
+    bcd->buildingCharacters = 1;
+  }
+
+  {
+    uint32_t value = character;
+
+    if (value < CHARACTER_ENTRY_LIMIT) {
+      unsigned int index = value % CHARACTER_PAGE_SIZE;
+      CharacterPage *page = getPendingCharacterPage(table, value-index);
+
+      if (page) {
+        finishCharacterEntry(bcd, page, index);
+      } else {
+        page = addCharacterPage(bcd, value);
+      }
+
+      if (page) entry = &page->entries[index];
+    } else {
+      entry = addOtherCharacterEntry(bcd, character);
+    }
+  }
+
+  if (lock) {
+    bcd->buildingCharacters = 0;
+    releaseLock(table->characters.lock);
+  }
+
+  return entry;
+}
+
+int
+prepareContractionTableCharacters (ContractionTable *table) {
+  BrailleContractionData bcd = {
+    .table = table
+  };
+
+  if (!table->characters.lock) {
+    if (!(table->characters.lock = newLockDescriptor())) {
+      return 0;
+    }
+  }
+
+  if (!getCharacterEntry(&bcd, 0)) return 0;
+
+  {
+    int (*prepare) (BrailleContractionData *bcd) = table->translationMethods->prepareCharacterEntries;
+    if (prepare && !prepare(&bcd)) return 0;
+  }
+
+  {
+    ContractionTableCharacterStatistics *statistics = &table->characters.statistics;
+
+    statistics->preparedPages = statistics->addedPages;
+    statistics->addedPages = 0;
+    statistics->lockedLookups = 0;
+  }
+
+  return 1;
+}
+
+void
+getContractionTableCharacterStatistics (ContractionTable *table, ContractionTableCharacterStatistics *statistics) {
+  obtainExclusiveLock(table->characters.lock);
+  *statistics = table->characters.statistics;
+  releaseLock(table->characters.lock);
 }
 
 static inline int
@@ -262,6 +404,122 @@ updateContractionCache (BrailleContractionData *bcd, ContractionCache *cache) {
   }
 }
 
+void
+addContractionResyncPoint (BrailleContractionData *bcd, unsigned int horizon) {
+  ContractionCache *cache = bcd->cache;
+  if (!cache) return;
+
+  if (cache->resync.table != bcd->table) {
+    cache->resync.table = bcd->table;
+    cache->resync.count = 0;
+  }
+
+  if (cache->resync.count == cache->resync.size) {
+    unsigned int newSize = cache->resync.size? cache->resync.size<<1: 0X10;
+    ContractionResyncPoint *newArray = realloc(cache->resync.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return;
+    }
+
+    cache->resync.array = newArray;
+    cache->resync.size = newSize;
+  }
+
+  {
+    ContractionResyncPoint *point = &cache->resync.array[cache->resync.count++];
+
+    point->input = getInputConsumed(bcd);
+    point->output = getOutputConsumed(bcd);
+    point->horizon = horizon;
+    point->opcode = bcd->previous.opcode;
+  }
+}
+
+static const ContractionResyncPoint *
+findContractionResyncPoint (BrailleContractionData *bcd, ContractionCache *cache) {
+  if (!cache) return NULL;
+  if (!cache->resync.count) return NULL;
+  if (cache->resync.table != bcd->table) return NULL;
+  if (!cache->input.characters) return NULL;
+  if (!cache->output.cells) return NULL;
+  if (bcd->input.offsets && !cache->offsets.count) return NULL;
+  if (cache->output.maximum != getOutputCount(bcd)) return NULL;
+  if (cache->expandCurrentWord != prefs.expandCurrentWord) return NULL;
+  if (cache->capitalizationMode != prefs.capitalizationMode) return NULL;
+
+  unsigned int unchanged = 0;
+
+  {
+    unsigned int count = getInputCount(bcd);
+    if (count > cache->input.count) count = cache->input.count;
+
+    while (unchanged < count) {
+      if (bcd->input.begin[unchanged] != cache->input.characters[unchanged]) break;
+      unchanged += 1;
+    }
+  }
+
+  int newCursor = makeCachedCursorOffset(bcd);
+  int oldCursor = cache->cursorOffset;
+  unsigned int index = cache->resync.count;
+
+  while (index > 0) {
+    const ContractionResyncPoint *point = &cache->resync.array[--index];
+
+    if (point->horizon > unchanged) continue;
+    if ((newCursor != CTB_NO_CURSOR) && (newCursor < point->input)) continue;
+    if ((oldCursor != CTB_NO_CURSOR) && (oldCursor < point->input)) continue;
+
+    cache->resync.count = index + 1;
+    return point;
+  }
+
+  return NULL;
+}
+
+static void
+resumeContraction (BrailleContractionData *bcd, ContractionCache *cache) {
+  const ContractionResyncPoint *point = findContractionResyncPoint(bcd, cache);
+
+  if (point) {
+    bcd->input.current = bcd->input.begin + point->input;
+    bcd->output.current = bcd->output.begin + point->output;
+    bcd->previous.opcode = point->opcode;
+
+    memcpy(
+      bcd->output.begin, cache->output.cells,
+      ARRAY_SIZE(bcd->output.begin, point->output)
+    );
+
+    if (bcd->input.offsets) {
+      memcpy(
+        bcd->input.offsets, cache->offsets.array,
+        ARRAY_SIZE(bcd->input.offsets, point->input)
+      );
+    }
+  } else if (cache) {
+    cache->resync.count = 0;
+  }
+}
+
+void
+pruneContractionResyncPoints (BrailleContractionData *bcd) {
+  ContractionCache *cache = bcd->cache;
+
+  if (cache) {
+    unsigned int inputConsumed = getInputConsumed(bcd);
+    unsigned int outputConsumed = getOutputConsumed(bcd);
+
+    while (cache->resync.count) {
+      const ContractionResyncPoint *point = &cache->resync.array[cache->resync.count - 1];
+      if ((point->input <= inputConsumed) && (point->output <= outputConsumed)) break;
+      cache->resync.count -= 1;
+    }
+  }
+}
+
 void
 contractText (
   ContractionTable *contractionTable,
@@ -285,7 +543,9 @@ contractText (
       .begin = outputBuffer,
       .end = outputBuffer + *outputLength,
       .current = outputBuffer
-    }
+    },
+
+    .cache = contractionCache
   };
 
   if (checkContractionCache(&bcd, contractionCache)) {
@@ -294,11 +554,19 @@ contractText (
     int contracted;
 
     {
+      ScratchMark scratchMark;
+      getScratchMark(&scratchMark);
+
       size_t length = getInputCount(&bcd);
-      wchar_t buffer[length];
-      unsigned int map[length + 1];
+      wchar_t *buffer;
+      unsigned int *map;
+
+      if (allocateScratchArray(buffer, length) &&
+          allocateScratchArray(map, length + 1) &&
+          composeCharacters(&length, bcd.input.begin, buffer, map)) {
+        if (contractionCache) contractionCache->resync.count = 0;
+        bcd.cache = NULL;
 
-      if (composeCharacters(&length, bcd.input.begin, buffer, map)) {
         const wchar_t *oldBegin = bcd.input.begin;
         const wchar_t *oldEnd = bcd.input.end;
 
@@ -343,11 +611,15 @@ contractText (
         bcd.input.current = bcd.input.begin + map[bcd.input.current - buffer];
         bcd.input.end = oldEnd;
       } else {
+        resumeContraction(&bcd, contractionCache);
         contracted = contractionTable->translationMethods->contractText(&bcd);
       }
+
+      releaseScratch(&scratchMark);
     }
 
     if (!contracted) {
+      if (contractionCache) contractionCache->resync.count = 0;
       bcd.input.current = bcd.input.begin;
       bcd.output.current = bcd.output.begin;
 
@@ -379,6 +651,7 @@ contractText (
       if (!done) bcd.input.current = srcorig;
     }
 
+    pruneContractionResyncPoints(&bcd);
     updateContractionCache(&bcd, contractionCache);
   }
 
@@ -386,6 +659,17 @@ contractText (
   *outputLength = getOutputConsumed(&bcd);
 }
 
+void
+installContractionTable (ContractionTable *table) {
+  ContractionTable *oldTable = contractionTable;
+
+  lockContractionTable();
+    contractionTable = table;
+  unlockContractionTable();
+
+  if (oldTable) destroyContractionTable(oldTable);
+}
+
 int
 replaceContractionTable (const char *directory, const char *name) {
   ContractionTable *newTable = NULL;
@@ -407,13 +691,7 @@ replaceContractionTable (const char *directory, const char *name) {
   }
 
   if (newTable) {
-    ContractionTable *oldTable = contractionTable;
-
-    lockContractionTable();
-      contractionTable = newTable;
-    unlockContractionTable();
-
-    if (oldTable) destroyContractionTable(oldTable);
+    installContractionTable(newTable);
     return 1;
   }
 
@@ -56,11 +56,15 @@ typedef struct {
   struct {
     ContractionTableOpcode opcode;
   } previous;
+
+  ContractionCache *cache;
+  unsigned char buildingCharacters;
 } BrailleContractionData;
 
 struct ContractionTableTranslationMethodsStruct {
   int (*contractText) (BrailleContractionData *bcd);
   void (*finishCharacterEntry) (BrailleContractionData *bcd, CharacterEntry *entry);
+  int (*prepareCharacterEntries) (BrailleContractionData *bcd);
 };
 
 static inline unsigned int
@@ -105,8 +109,26 @@ clearOffset (BrailleContractionData *bcd) {
   assignOffset(bcd, CTB_NO_OFFSET);
 }
 
-extern const CharacterEntry *getCharacterEntry (BrailleContractionData *bcd, wchar_t character);
-extern const CharacterEntry *findCharacterEntry (BrailleContractionData *bcd, wchar_t character, unsigned int *position);
+extern void addContractionResyncPoint (BrailleContractionData *bcd, unsigned int horizon);
+extern void pruneContractionResyncPoints (BrailleContractionData *bcd);
+
+extern const CharacterEntry *makeCharacterEntry (BrailleContractionData *bcd, wchar_t character);
+
+static inline const CharacterEntry *
+getCharacterEntry (BrailleContractionData *bcd, wchar_t character) {
+  uint32_t value = character;
+
+  if (value < CHARACTER_ENTRY_LIMIT) {
+    const CharacterPlane *plane = bcd->table->characters.planes[value / (CHARACTER_PLANE_SIZE * CHARACTER_PAGE_SIZE)];
+
+    if (plane) {
+      const CharacterPage *page = plane->pages[(value / CHARACTER_PAGE_SIZE) % CHARACTER_PLANE_SIZE];
+      if (page) return &page->entries[value % CHARACTER_PAGE_SIZE];
+    }
+  }
+
+  return makeCharacterEntry(bcd, character);
+}
 
 static inline int
 testCharacter (BrailleContractionData *bcd, wchar_t character, ContractionTableCharacterAttributes attributes) {
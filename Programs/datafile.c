@@ -33,6 +33,8 @@
 #include "utf8.h"
 #include "unicode.h"
 #include "brl_dots.h"
+#include "parse.h"
+#include "get_thread.h"
 
 struct DataFileStruct {
   const char *const name;
@@ -184,6 +186,105 @@ isNumber (int *number, const wchar_t *characters, int length) {
   return 0;
 }
 
+#ifdef GOT_PTHREADS
+static pthread_once_t dataFilesLockOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t dataFilesLock;
+
+static void
+initializeDataFilesLock (void) {
+  pthread_mutexattr_t attributes;
+
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&dataFilesLock, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+}
+#endif /* GOT_PTHREADS */
+
+void
+lockDataFiles (void) {
+#ifdef GOT_PTHREADS
+  pthread_once(&dataFilesLockOnce, initializeDataFilesLock);
+  pthread_mutex_lock(&dataFilesLock);
+#endif /* GOT_PTHREADS */
+}
+
+void
+unlockDataFiles (void) {
+#ifdef GOT_PTHREADS
+  pthread_mutex_unlock(&dataFilesLock);
+#endif /* GOT_PTHREADS */
+}
+
+static struct {
+  char **array;
+  unsigned int size;
+  unsigned int count;
+} processedDataFiles = {
+  .array = NULL,
+  .size = 0,
+  .count = 0
+};
+
+void
+forgetProcessedDataFiles (void) {
+  while (processedDataFiles.count) {
+    free(processedDataFiles.array[--processedDataFiles.count]);
+  }
+}
+
+void
+rememberProcessedDataFile (const char *path) {
+  if (processedDataFiles.count == processedDataFiles.size) {
+    unsigned int newSize = processedDataFiles.size? processedDataFiles.size<<1: 0X10;
+    char **newArray = realloc(processedDataFiles.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return;
+    }
+
+    processedDataFiles.array = newArray;
+    processedDataFiles.size = newSize;
+  }
+
+  {
+    char *copy = strdup(path);
+
+    if (copy) {
+      processedDataFiles.array[processedDataFiles.count++] = copy;
+    } else {
+      logMallocError();
+    }
+  }
+}
+
+char **
+getProcessedDataFiles (void) {
+  char **paths = malloc(ARRAY_SIZE(paths, processedDataFiles.count+1));
+
+  if (paths) {
+    unsigned int count = 0;
+
+    while (count < processedDataFiles.count) {
+      if (!(paths[count] = strdup(processedDataFiles.array[count]))) {
+        logMallocError();
+        paths[count] = NULL;
+        deallocateStrings(paths);
+        return NULL;
+      }
+
+      count += 1;
+    }
+
+    paths[count] = NULL;
+  } else {
+    logMallocError();
+  }
+
+  return paths;
+}
+
 static VariableNestingLevel *baseDataVariables = NULL;
 static VariableNestingLevel *currentDataVariables = NULL;
 
@@ -1283,6 +1384,10 @@ processDataStream (
     logMessage(LOG_DEBUG, "including data file: %s", name);
   }
 
+  lockDataFiles();
+  if (!includer) forgetProcessedDataFiles();
+  rememberProcessedDataFile(name);
+
   DataFile file = {
     .name = name,
     .parameters = parameters,
@@ -1318,6 +1423,7 @@ processDataStream (
     currentDataVariables = oldVariables;
   }
 
+  unlockDataFiles();
   return ok;
 }
 
@@ -34,6 +34,9 @@ const GioProperties *const gioProperties[] = {
   &gioProperties_usb,
   &gioProperties_bluetooth,
   &gioProperties_hid,
+#ifdef ENABLE_IO_EMULATOR
+  &gioProperties_emulator,
+#endif /* ENABLE_IO_EMULATOR */
   &gioProperties_null,
   NULL
 };
@@ -429,7 +432,13 @@ gioReconfigureResource (
   if (!method) {
     logUnsupportedOperation("reconfigureResource");
   } else if (method(endpoint->handle, parameters)) {
-    gioSetBytesPerSecond(endpoint, parameters);
+    GioGetBytesPerSecondMethod *getBytesPerSecond = endpoint->handleMethods->getBytesPerSecond;
+
+    if (getBytesPerSecond) {
+      endpoint->bytesPerSecond = getBytesPerSecond(endpoint->handle);
+    } else {
+      gioSetBytesPerSecond(endpoint, parameters);
+    }
   } else {
     ok = 0;
   }
@@ -487,6 +496,19 @@ gioAskResource (
                 endpoint->options.requestTimeout);
 }
 
+const HidItemsDescriptor *
+gioGetHidItems (GioEndpoint *endpoint) {
+  GioGetHidItemsMethod *method = endpoint->handleMethods->getHidItems;
+
+  if (!method) {
+    logUnsupportedOperation("getHidItems");
+    errno = ENOSYS;
+    return NULL;
+  }
+
+  return method(endpoint->handle, endpoint->options.requestTimeout);
+}
+
 int
 gioGetHidReportSize (
   GioEndpoint *endpoint,
@@ -0,0 +1,1041 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "strfmt.h"
+#include "parse.h"
+#include "device.h"
+#include "file.h"
+#include "queue.h"
+#include "timing.h"
+#include "async_handle.h"
+#include "async_alarm.h"
+#include "async_wait.h"
+#include "io_generic.h"
+#include "gio_internal.h"
+#include "io_serial.h"
+
+/*
+ * An emulator endpoint connects a driver to an in-process device model
+ * rather than to real hardware. The model is described by a script with
+ * one directive per line:
+ *
+ *   bandwidth bytes-per-second
+ *   latency milliseconds
+ *   respond request = response
+ *   prefix request = response
+ *   key delay bytes
+ *   repeat count
+ *
+ * A byte list is a sequence of hexadecimal bytes (optionally followed by
+ * *count to repeat them) and "quoted strings". A respond rule matches a
+ * write which is exactly its request, and a prefix rule matches a write
+ * which starts with its request. The first matching rule's response is
+ * returned to the driver. The key directives define a sequence of input
+ * packets, each sent the given number of milliseconds after the previous
+ * one, which is played the number of times given by repeat.
+ */
+
+#define EMULATOR_PACKET_SIZE 0X400
+#define EMULATOR_SPACES " \t"
+
+typedef struct EmulatorRuleStruct EmulatorRule;
+
+struct EmulatorRuleStruct {
+  EmulatorRule *next;
+  unsigned char isPrefix:1;
+
+  size_t requestLength;
+  size_t responseLength;
+  unsigned char bytes[];
+};
+
+typedef struct EmulatorKeyStruct EmulatorKey;
+
+struct EmulatorKeyStruct {
+  EmulatorKey *next;
+  unsigned int delay;
+
+  size_t length;
+  unsigned char bytes[];
+};
+
+typedef struct {
+  TimeValue time;
+  unsigned char isKey:1;
+
+  size_t offset;
+  size_t length;
+  unsigned char bytes[];
+} EmulatorInput;
+
+struct GioHandleStruct {
+  char *model;
+  char *script;
+
+  unsigned int bandwidth;
+  unsigned int bytesPerSecond;
+  unsigned int latency;
+  unsigned int repeat;
+
+  struct {
+    EmulatorRule *first;
+    EmulatorRule **last;
+  } rules;
+
+  struct {
+    EmulatorKey *first;
+    EmulatorKey **last;
+  } keys;
+
+  TimeValue connectTime;
+  TimeValue outputIdleTime;
+  TimeValue inputIdleTime;
+  Queue *inputQueue;
+
+  struct {
+    AsyncMonitorCallback *callback;
+    void *data;
+    AsyncHandle alarm;
+    unsigned suspended:1;
+  } monitor;
+
+  struct {
+    unsigned long writeCount;
+    unsigned long bytesWritten;
+    unsigned long responseCount;
+    unsigned long bytesRead;
+
+    unsigned long keyCount;
+    long int keyLagTotal;
+    long int keyLagMaximum;
+  } statistics;
+};
+
+typedef struct {
+  const char *name;
+  const char *driver;
+  const char *const *lines;
+} EmulatorModel;
+
+static const char *const emulatorModelLines_baum[] = {
+  "# Baum escape protocol (a 40-cell display)",
+  "latency 2",
+  "respond 1B 01 00 = 1B 01 28",
+
+  "key 2000 1B 24 01",
+  "key 100 1B 24 00",
+  NULL
+};
+
+static const char *const emulatorModelLines_handyTech[] = {
+  "# HandyTech serial protocol (Braille Star 40)",
+  "latency 2",
+  "respond FF = FE 74",
+  "prefix 01 = 7E",
+
+  "key 2000 04",
+  "key 100 84",
+  NULL
+};
+
+static const char *const emulatorModelLines_freedomScientific[] = {
+  "# Freedom Scientific serial protocol (Focus 40)",
+  "latency 2",
+  "respond 00 00 00 00 = 01 00 00 00"
+    " 80 30 00 00"
+    " \"Freedom Scientific\" 00*6 \"Focus 40\" 00*8 \"1.0\" 00*5"
+    " 5A",
+  "prefix 81 = 01 00 00 00",
+  "prefix 0F = 01 00 00 00",
+  "prefix 08 = 01 00 00 00",
+
+  "key 2000 03 00 20 00",
+  "key 100 03 00 00 00",
+  NULL
+};
+
+static const EmulatorModel emulatorModels[] = {
+  { .name = "baum",
+    .driver = "bm",
+    .lines = emulatorModelLines_baum
+  },
+
+  { .name = "handytech",
+    .driver = "ht",
+    .lines = emulatorModelLines_handyTech
+  },
+
+  { .name = "freedomscientific",
+    .driver = "fs",
+    .lines = emulatorModelLines_freedomScientific
+  },
+
+  { .name = NULL }
+};
+
+static const EmulatorModel *
+getEmulatorModel (const char *name) {
+  for (const EmulatorModel *model=emulatorModels; model->name; model+=1) {
+    if (strcasecmp(name, model->name) == 0) return model;
+    if (strcasecmp(name, model->driver) == 0) return model;
+  }
+
+  return NULL;
+}
+
+typedef struct {
+  GioHandle *handle;
+  const char *source;
+  unsigned int line;
+} EmulatorScriptData;
+
+static void
+logEmulatorScriptProblem (const EmulatorScriptData *esd, const char *problem, const char *text) {
+  logMessage(LOG_WARNING, "emulator script error: %s[%u]: %s: %s",
+             esd->source, esd->line, problem, text);
+}
+
+static int
+parseEmulatorBytes (
+  const EmulatorScriptData *esd, const char *text,
+  unsigned char *buffer, size_t size, size_t *length
+) {
+  const char *const start = text;
+  size_t count = 0;
+
+  while (1) {
+    text += strspn(text, EMULATOR_SPACES);
+    if (!*text) break;
+
+    if (*text == '"') {
+      const char *end = strchr(++text, '"');
+
+      if (!end) {
+        logEmulatorScriptProblem(esd, "unterminated string", start);
+        return 0;
+      }
+
+      size_t length = end - text;
+      if (length > (size - count)) goto tooLong;
+
+      memcpy(&buffer[count], text, length);
+      count += length;
+      text = end + 1;
+    } else {
+      char *end;
+      unsigned long int value = strtoul(text, &end, 16);
+      unsigned long int repeat = 1;
+
+      if ((end == text) || (value > UINT8_MAX)) goto invalidByte;
+
+      if (*end == '*') {
+        text = end + 1;
+        repeat = strtoul(text, &end, 10);
+        if ((end == text) || !repeat) goto invalidByte;
+      }
+
+      if (*end && !strchr(EMULATOR_SPACES, *end)) goto invalidByte;
+      if (repeat > (size - count)) goto tooLong;
+
+      memset(&buffer[count], value, repeat);
+      count += repeat;
+      text = end;
+    }
+  }
+
+  *length = count;
+  return 1;
+
+invalidByte:
+  logEmulatorScriptProblem(esd, "invalid byte", text);
+  return 0;
+
+tooLong:
+  logEmulatorScriptProblem(esd, "byte list too long", start);
+  return 0;
+}
+
+static char *
+findEmulatorRuleSeparator (char *text) {
+  int quoted = 0;
+
+  while (*text) {
+    if (*text == '"') {
+      quoted = !quoted;
+    } else if ((*text == '=') && !quoted) {
+      return text;
+    }
+
+    text += 1;
+  }
+
+  return NULL;
+}
+
+static int
+addEmulatorRule (const EmulatorScriptData *esd, char *operands, int isPrefix) {
+  char *separator = findEmulatorRuleSeparator(operands);
+
+  if (!separator) {
+    logEmulatorScriptProblem(esd, "missing response", operands);
+    return 0;
+  }
+
+  *separator = 0;
+
+  unsigned char request[EMULATOR_PACKET_SIZE];
+  size_t requestLength;
+  if (!parseEmulatorBytes(esd, operands, request, sizeof(request), &requestLength)) return 0;
+
+  unsigned char response[EMULATOR_PACKET_SIZE];
+  size_t responseLength;
+  if (!parseEmulatorBytes(esd, separator+1, response, sizeof(response), &responseLength)) return 0;
+
+  if (!requestLength) {
+    logEmulatorScriptProblem(esd, "missing request", operands);
+    return 0;
+  }
+
+  EmulatorRule *rule;
+  size_t size = sizeof(*rule) + requestLength + responseLength;
+
+  if ((rule = malloc(size))) {
+    memset(rule, 0, size);
+    rule->next = NULL;
+    rule->isPrefix = isPrefix;
+
+    rule->requestLength = requestLength;
+    rule->responseLength = responseLength;
+    memcpy(rule->bytes, request, requestLength);
+    memcpy(&rule->bytes[requestLength], response, responseLength);
+
+    GioHandle *handle = esd->handle;
+    *handle->rules.last = rule;
+    handle->rules.last = &rule->next;
+    return 1;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static int
+addEmulatorKey (const EmulatorScriptData *esd, char *operands) {
+  operands += strspn(operands, EMULATOR_SPACES);
+  char *bytes = operands + strcspn(operands, EMULATOR_SPACES);
+  if (*bytes) *bytes++ = 0;
+
+  unsigned int delay;
+
+  if (!isUnsignedInteger(&delay, operands)) {
+    logEmulatorScriptProblem(esd, "invalid key delay", operands);
+    return 0;
+  }
+
+  unsigned char buffer[EMULATOR_PACKET_SIZE];
+  size_t length;
+  if (!parseEmulatorBytes(esd, bytes, buffer, sizeof(buffer), &length)) return 0;
+
+  if (!length) {
+    logEmulatorScriptProblem(esd, "missing key bytes", operands);
+    return 0;
+  }
+
+  EmulatorKey *key;
+  size_t size = sizeof(*key) + length;
+
+  if ((key = malloc(size))) {
+    memset(key, 0, size);
+    key->next = NULL;
+    key->delay = delay;
+
+    key->length = length;
+    memcpy(key->bytes, buffer, length);
+
+    GioHandle *handle = esd->handle;
+    *handle->keys.last = key;
+    handle->keys.last = &key->next;
+    return 1;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static int
+setEmulatorValue (const EmulatorScriptData *esd, unsigned int *value, const char *operand, const char *problem) {
+  if (isUnsignedInteger(value, operand)) return 1;
+  logEmulatorScriptProblem(esd, problem, operand);
+  return 0;
+}
+
+static int
+processEmulatorLine (const EmulatorScriptData *esd, char *line) {
+  {
+    char *comment = strchr(line, '#');
+    if (comment && !memchr(line, '"', (comment - line))) *comment = 0;
+  }
+
+  char *directive = line + strspn(line, EMULATOR_SPACES);
+  if (!*directive) return 1;
+
+  char *operands = directive + strcspn(directive, EMULATOR_SPACES);
+  if (*operands) *operands++ = 0;
+
+  {
+    size_t length = strlen(operands);
+
+    while (length && strchr(EMULATOR_SPACES, operands[length-1])) length -= 1;
+    operands[length] = 0;
+    operands += strspn(operands, EMULATOR_SPACES);
+  }
+
+  GioHandle *handle = esd->handle;
+
+  if (strcasecmp(directive, "respond") == 0) {
+    return addEmulatorRule(esd, operands, 0);
+  }
+
+  if (strcasecmp(directive, "prefix") == 0) {
+    return addEmulatorRule(esd, operands, 1);
+  }
+
+  if (strcasecmp(directive, "key") == 0) {
+    return addEmulatorKey(esd, operands);
+  }
+
+  if (strcasecmp(directive, "bandwidth") == 0) {
+    return setEmulatorValue(esd, &handle->bandwidth, operands, "invalid bandwidth");
+  }
+
+  if (strcasecmp(directive, "latency") == 0) {
+    return setEmulatorValue(esd, &handle->latency, operands, "invalid latency");
+  }
+
+  if (strcasecmp(directive, "repeat") == 0) {
+    return setEmulatorValue(esd, &handle->repeat, operands, "invalid repeat count");
+  }
+
+  logEmulatorScriptProblem(esd, "unknown directive", directive);
+  return 0;
+}
+
+static int
+loadEmulatorModel (GioHandle *handle, const EmulatorModel *model) {
+  EmulatorScriptData esd = {
+    .handle = handle,
+    .source = model->name,
+    .line = 0
+  };
+
+  for (const char *const *line=model->lines; *line; line+=1) {
+    char buffer[strlen(*line) + 1];
+    strcpy(buffer, *line);
+
+    esd.line += 1;
+    if (!processEmulatorLine(&esd, buffer)) return 0;
+  }
+
+  return 1;
+}
+
+static int
+handleEmulatorScriptLine (const LineHandlerParameters *parameters) {
+  EmulatorScriptData *esd = parameters->data;
+
+  esd->line = parameters->line.number;
+  return processEmulatorLine(esd, parameters->line.text);
+}
+
+static int
+loadEmulatorScript (GioHandle *handle, const char *path) {
+  int ok = 0;
+  FILE *file;
+
+  if ((file = openFile(path, "r", 0))) {
+    EmulatorScriptData esd = {
+      .handle = handle,
+      .source = path,
+      .line = 0
+    };
+
+    if (processLines(file, handleEmulatorScriptLine, &esd)) ok = 1;
+    fclose(file);
+  }
+
+  return ok;
+}
+
+static int
+getEmulatorTransferTime (GioHandle *handle, size_t size) {
+  if (!handle->bytesPerSecond) return 0;
+  return ((size * MSECS_PER_SEC) / handle->bytesPerSecond) + 1;
+}
+
+static void
+deallocateEmulatorInput (void *item, void *data) {
+  EmulatorInput *input = item;
+
+  free(input);
+}
+
+static int
+compareEmulatorInput (const void *newItem, const void *existingItem, void *queueData) {
+  const EmulatorInput *newInput = newItem;
+  const EmulatorInput *existingInput = existingItem;
+
+  return compareTimeValues(&newInput->time, &existingInput->time) < 0;
+}
+
+static EmulatorInput *
+getEmulatorInput (GioHandle *handle) {
+  Element *element = getQueueHead(handle->inputQueue);
+  if (!element) return NULL;
+  return getElementItem(element);
+}
+
+static void setEmulatorMonitorAlarm (GioHandle *handle);
+
+ASYNC_ALARM_CALLBACK(handleEmulatorMonitorAlarm) {
+  GioHandle *handle = parameters->data;
+
+  asyncDiscardHandle(handle->monitor.alarm);
+  handle->monitor.alarm = NULL;
+
+  AsyncMonitorCallback *callback = handle->monitor.callback;
+
+  // A read which is waiting for input will consume it, and it rearms the
+  // alarm when it's done.
+  if (callback && !handle->monitor.suspended) {
+    const AsyncMonitorCallbackParameters mcp = {
+      .data = handle->monitor.data,
+      .error = 0
+    };
+
+    if (callback(&mcp)) {
+      setEmulatorMonitorAlarm(handle);
+    } else {
+      handle->monitor.callback = NULL;
+    }
+  }
+}
+
+static void
+setEmulatorMonitorAlarm (GioHandle *handle) {
+  if (handle->monitor.callback && !handle->monitor.suspended) {
+    EmulatorInput *input = getEmulatorInput(handle);
+
+    if (input) {
+      if (handle->monitor.alarm) {
+        asyncResetAlarmTo(handle->monitor.alarm, &input->time);
+      } else {
+        asyncNewAbsoluteAlarm(&handle->monitor.alarm, &input->time,
+                              handleEmulatorMonitorAlarm, handle);
+      }
+    }
+  }
+}
+
+static int
+addEmulatorInput (
+  GioHandle *handle, const TimeValue *sent,
+  const unsigned char *bytes, size_t length, int isKey
+) {
+  EmulatorInput *input;
+  size_t size = sizeof(*input) + length;
+
+  if ((input = malloc(size))) {
+    memset(input, 0, size);
+    input->isKey = isKey;
+
+    input->offset = 0;
+    input->length = length;
+    memcpy(input->bytes, bytes, length);
+
+    // The input arrives once the latency has passed and the link has
+    // finished carrying whatever was sent to the host before it.
+    input->time = *sent;
+    adjustTimeValue(&input->time, handle->latency);
+
+    if (compareTimeValues(&input->time, &handle->inputIdleTime) < 0) {
+      input->time = handle->inputIdleTime;
+    }
+
+    adjustTimeValue(&input->time, getEmulatorTransferTime(handle, length));
+    if (!isKey) handle->inputIdleTime = input->time;
+
+    if (enqueueItem(handle->inputQueue, input)) {
+      setEmulatorMonitorAlarm(handle);
+      return 1;
+    }
+
+    free(input);
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static int
+addEmulatorKeys (GioHandle *handle) {
+  TimeValue time = handle->connectTime;
+
+  for (unsigned int repeat=0; repeat<handle->repeat; repeat+=1) {
+    for (const EmulatorKey *key=handle->keys.first; key; key=key->next) {
+      adjustTimeValue(&time, key->delay);
+      if (!addEmulatorInput(handle, &time, key->bytes, key->length, 1)) return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+logEmulatorStatistics (GioHandle *handle) {
+  logMessage(LOG_INFO,
+    "emulator statistics: %s: %ld ms connected, %lu writes, %lu bytes written (%lu per write), %lu responses, %lu bytes read",
+    handle->model? handle->model: handle->script,
+    getMonotonicElapsed(&handle->connectTime),
+    handle->statistics.writeCount,
+    handle->statistics.bytesWritten,
+    handle->statistics.writeCount? (handle->statistics.bytesWritten / handle->statistics.writeCount): 0,
+    handle->statistics.responseCount,
+    handle->statistics.bytesRead
+  );
+
+  if (handle->statistics.keyCount) {
+    logMessage(LOG_INFO,
+      "emulator key statistics: %lu keys read, %ld ms average lag, %ld ms maximum lag",
+      handle->statistics.keyCount,
+      handle->statistics.keyLagTotal / (long int)handle->statistics.keyCount,
+      handle->statistics.keyLagMaximum
+    );
+  }
+}
+
+static void
+deallocateEmulatorHandle (GioHandle *handle) {
+  if (handle->monitor.alarm) asyncCancelRequest(handle->monitor.alarm);
+  if (handle->inputQueue) deallocateQueue(handle->inputQueue);
+
+  while (handle->rules.first) {
+    EmulatorRule *rule = handle->rules.first;
+    handle->rules.first = rule->next;
+    free(rule);
+  }
+
+  while (handle->keys.first) {
+    EmulatorKey *key = handle->keys.first;
+    handle->keys.first = key->next;
+    free(key);
+  }
+
+  if (handle->script) free(handle->script);
+  if (handle->model) free(handle->model);
+  free(handle);
+}
+
+static int
+disconnectEmulatorResource (GioHandle *handle) {
+  logEmulatorStatistics(handle);
+  deallocateEmulatorHandle(handle);
+  return 1;
+}
+
+static const char *
+makeEmulatorResourceIdentifier (GioHandle *handle, char *buffer, size_t size) {
+  STR_BEGIN(buffer, size);
+  STR_PRINTF("%s%c", "emulator", PARAMETER_QUALIFIER_CHARACTER);
+
+  if (handle->model) {
+    STR_PRINTF("model%c%s", PARAMETER_ASSIGNMENT_CHARACTER, handle->model);
+  } else {
+    STR_PRINTF("script%c%s", PARAMETER_ASSIGNMENT_CHARACTER, handle->script);
+  }
+
+  STR_END;
+  return buffer;
+}
+
+static ssize_t
+writeEmulatorData (GioHandle *handle, const void *data, size_t size, int timeout) {
+  handle->statistics.writeCount += 1;
+  handle->statistics.bytesWritten += size;
+
+  {
+    TimeValue now;
+    getMonotonicTime(&now);
+
+    if (compareTimeValues(&handle->outputIdleTime, &now) < 0) {
+      handle->outputIdleTime = now;
+    }
+
+    adjustTimeValue(&handle->outputIdleTime, getEmulatorTransferTime(handle, size));
+  }
+
+  for (const EmulatorRule *rule=handle->rules.first; rule; rule=rule->next) {
+    if (size < rule->requestLength) continue;
+    if (!rule->isPrefix && (size != rule->requestLength)) continue;
+    if (memcmp(data, rule->bytes, rule->requestLength) != 0) continue;
+
+    if (rule->responseLength) {
+      if (!addEmulatorInput(handle, &handle->outputIdleTime,
+                            &rule->bytes[rule->requestLength],
+                            rule->responseLength, 0)) {
+        return -1;
+      }
+
+      handle->statistics.responseCount += 1;
+    }
+
+    break;
+  }
+
+  return size;
+}
+
+static long int
+getEmulatorInputDelay (const EmulatorInput *input) {
+  TimeValue now;
+  getMonotonicTime(&now);
+  return millisecondsBetween(&now, &input->time);
+}
+
+static EmulatorInput *
+getAvailableEmulatorInput (GioHandle *handle, int timeout) {
+  EmulatorInput *input = getEmulatorInput(handle);
+  long int delay = input? getEmulatorInputDelay(input): timeout;
+
+  if (delay > 0) {
+    if (delay > timeout) delay = timeout;
+
+    if (delay > 0) {
+      int suspended = handle->monitor.suspended;
+      handle->monitor.suspended = 1;
+      asyncWait(delay);
+      handle->monitor.suspended = suspended;
+    }
+
+    if (!(input = getEmulatorInput(handle))) return NULL;
+    if (getEmulatorInputDelay(input) > 0) return NULL;
+  }
+
+  return input;
+}
+
+static int
+awaitEmulatorInput (GioHandle *handle, int timeout) {
+  int available = !!getAvailableEmulatorInput(handle, timeout);
+
+  setEmulatorMonitorAlarm(handle);
+  if (!available) errno = EAGAIN;
+  return available;
+}
+
+static ssize_t
+readEmulatorData (
+  GioHandle *handle, void *buffer, size_t size,
+  int initialTimeout, int subsequentTimeout
+) {
+  unsigned char *const start = buffer;
+  unsigned char *next = start;
+  int timeout = initialTimeout;
+
+  while (size) {
+    EmulatorInput *input = getAvailableEmulatorInput(handle, timeout);
+    if (!input) break;
+
+    size_t count = input->length - input->offset;
+    if (count > size) count = size;
+
+    next = mempcpy(next, &input->bytes[input->offset], count);
+    input->offset += count;
+    size -= count;
+
+    if (input->offset == input->length) {
+      if (input->isKey) {
+        long int lag = -getEmulatorInputDelay(input);
+
+        handle->statistics.keyCount += 1;
+        handle->statistics.keyLagTotal += lag;
+
+        if (lag > handle->statistics.keyLagMaximum) {
+          handle->statistics.keyLagMaximum = lag;
+        }
+      }
+
+      deallocateEmulatorInput(dequeueItem(handle->inputQueue), NULL);
+    }
+
+    timeout = subsequentTimeout;
+  }
+
+  setEmulatorMonitorAlarm(handle);
+  handle->statistics.bytesRead += next - start;
+  return next - start;
+}
+
+static int
+monitorEmulatorInput (GioHandle *handle, AsyncMonitorCallback *callback, void *data) {
+  if (handle->monitor.alarm) {
+    asyncCancelRequest(handle->monitor.alarm);
+    handle->monitor.alarm = NULL;
+  }
+
+  handle->monitor.callback = callback;
+  handle->monitor.data = data;
+  setEmulatorMonitorAlarm(handle);
+  return 1;
+}
+
+static void
+setEmulatorBytesPerSecond (GioHandle *handle, const SerialParameters *parameters) {
+  if (handle->bandwidth) {
+    handle->bytesPerSecond = handle->bandwidth;
+  } else {
+    // Without an explicit bandwidth the link runs at the driver's serial speed.
+    handle->bytesPerSecond = parameters->baud / serialGetCharacterSize(parameters);
+  }
+}
+
+static int
+reconfigureEmulatorResource (GioHandle *handle, const SerialParameters *parameters) {
+  setEmulatorBytesPerSecond(handle, parameters);
+  return 1;
+}
+
+static unsigned int
+getEmulatorBytesPerSecond (GioHandle *handle) {
+  return handle->bytesPerSecond;
+}
+
+static const GioHandleMethods gioEmulatorMethods = {
+  .disconnectResource = disconnectEmulatorResource,
+
+  .makeResourceIdentifier = makeEmulatorResourceIdentifier,
+
+  .writeData = writeEmulatorData,
+  .awaitInput = awaitEmulatorInput,
+  .readData = readEmulatorData,
+  .monitorInput = monitorEmulatorInput,
+  .reconfigureResource = reconfigureEmulatorResource,
+  .getBytesPerSecond = getEmulatorBytesPerSecond
+};
+
+static int
+testEmulatorIdentifier (const char **identifier) {
+  return hasQualifier(identifier, "emulator");
+}
+
+static const GioPublicProperties gioPublicProperties_emulator = {
+  .testIdentifier = testEmulatorIdentifier,
+
+  .type = {
+    .name = "emulator",
+    .identifier = GIO_TYPE_EMULATOR
+  }
+};
+
+static int
+isEmulatorSupported (const GioDescriptor *descriptor) {
+  return descriptor->serial.parameters != NULL;
+}
+
+static const GioOptions *
+getEmulatorOptions (const GioDescriptor *descriptor) {
+  return &descriptor->serial.options;
+}
+
+static const GioHandleMethods *
+getEmulatorMethods (void) {
+  return &gioEmulatorMethods;
+}
+
+typedef enum {
+  EMU_PARM_MODEL,
+  EMU_PARM_SCRIPT,
+  EMU_PARM_BANDWIDTH,
+  EMU_PARM_LATENCY
+} EmulatorDeviceParameter;
+
+static const char *const emulatorDeviceParameterNames[] = {
+  "model",
+  "script",
+  "bandwidth",
+  "latency",
+  NULL
+};
+
+static int
+applyEmulatorParameters (GioHandle *handle, char **parameters) {
+  {
+    const char *name = parameters[EMU_PARM_MODEL];
+
+    if (*name) {
+      const EmulatorModel *model = getEmulatorModel(name);
+
+      if (!model) {
+        logMessage(LOG_ERR, "unknown emulator model: %s", name);
+        return 0;
+      }
+
+      if (!(handle->model = strdup(model->name))) {
+        logMallocError();
+        return 0;
+      }
+
+      if (!loadEmulatorModel(handle, model)) return 0;
+    }
+  }
+
+  {
+    const char *path = parameters[EMU_PARM_SCRIPT];
+
+    if (*path) {
+      if (!(handle->script = strdup(path))) {
+        logMallocError();
+        return 0;
+      }
+
+      if (!loadEmulatorScript(handle, path)) return 0;
+    }
+  }
+
+  if (!(handle->model || handle->script)) {
+    logMessage(LOG_ERR, "emulator model or script not specified");
+    return 0;
+  }
+
+  {
+    const char *bandwidth = parameters[EMU_PARM_BANDWIDTH];
+
+    if (*bandwidth) {
+      if (!isUnsignedInteger(&handle->bandwidth, bandwidth)) {
+        logMessage(LOG_ERR, "invalid emulator bandwidth: %s", bandwidth);
+        return 0;
+      }
+    }
+  }
+
+  {
+    const char *latency = parameters[EMU_PARM_LATENCY];
+
+    if (*latency) {
+      if (!isUnsignedInteger(&handle->latency, latency)) {
+        logMessage(LOG_ERR, "invalid emulator latency: %s", latency);
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
+static GioHandle *
+connectEmulatorResource (
+  const char *identifier,
+  const GioDescriptor *descriptor
+) {
+  GioHandle *handle = malloc(sizeof(*handle));
+
+  if (handle) {
+    memset(handle, 0, sizeof(*handle));
+    handle->model = NULL;
+    handle->script = NULL;
+
+    handle->bandwidth = 0;
+    handle->bytesPerSecond = 0;
+    handle->latency = 0;
+    handle->repeat = 1;
+
+    handle->rules.first = NULL;
+    handle->rules.last = &handle->rules.first;
+
+    handle->keys.first = NULL;
+    handle->keys.last = &handle->keys.first;
+
+    handle->monitor.callback = NULL;
+    handle->monitor.data = NULL;
+    handle->monitor.alarm = NULL;
+    handle->monitor.suspended = 0;
+
+    getMonotonicTime(&handle->connectTime);
+    handle->outputIdleTime = handle->connectTime;
+    handle->inputIdleTime = handle->connectTime;
+
+    if ((handle->inputQueue = newQueue(deallocateEmulatorInput, compareEmulatorInput))) {
+      char **parameters = getDeviceParameters(emulatorDeviceParameterNames, identifier);
+
+      if (parameters) {
+        int ok = applyEmulatorParameters(handle, parameters);
+        deallocateStrings(parameters);
+
+        if (ok) {
+          setEmulatorBytesPerSecond(handle, descriptor->serial.parameters);
+
+          if (addEmulatorKeys(handle)) {
+            logMessage(LOG_DEBUG,
+              "emulator connected: %s: %u bytes per second, %u ms latency",
+              handle->model? handle->model: handle->script,
+              handle->bytesPerSecond, handle->latency
+            );
+
+            return handle;
+          }
+        }
+      }
+    }
+
+    deallocateEmulatorHandle(handle);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static int
+prepareEmulatorEndpoint (GioEndpoint *endpoint) {
+  endpoint->bytesPerSecond = endpoint->handle->bytesPerSecond;
+  return 1;
+}
+
+static const GioPrivateProperties gioPrivateProperties_emulator = {
+  .isSupported = isEmulatorSupported,
+
+  .getOptions = getEmulatorOptions,
+  .getHandleMethods = getEmulatorMethods,
+
+  .connectResource = connectEmulatorResource,
+  .prepareEndpoint = prepareEmulatorEndpoint
+};
+
+const GioProperties gioProperties_emulator = {
+  .public = &gioPublicProperties_emulator,
+  .private = &gioPrivateProperties_emulator
+};
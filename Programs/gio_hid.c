@@ -84,6 +84,11 @@ monitorHidInput (GioHandle *handle, AsyncMonitorCallback *callback, void *data)
   return hidMonitorInput(handle->device, callback, data);
 }
 
+static const HidItemsDescriptor *
+getHidItems (GioHandle *handle, int timeout) {
+  return hidGetItems(handle->device);
+}
+
 int
 getHidReportSize (
   GioHandle *handle, HidReportIdentifier identifier,
@@ -158,6 +163,7 @@ static const GioHandleMethods gioHidMethods = {
   .readData = readHidData,
   .monitorInput = monitorHidInput,
 
+  .getHidItems = getHidItems,
   .getHidReportSize = getHidReportSize,
   .getHidReport = getHidReport,
   .setHidReport = setHidReport,
@@ -181,7 +187,7 @@ static const GioPublicProperties gioPublicProperties_hid = {
 
 static int
 isHidSupported (const GioDescriptor *descriptor) {
-  return !!descriptor->hid.modelTable;
+  return descriptor->hid.modelTable || descriptor->hid.usagePage;
 }
 
 static const GioOptions *
@@ -242,14 +248,17 @@ connectHidResource (
   if (handle) {
     memset(handle, 0, sizeof(*handle));
 
-    if (hidOpenDeviceWithParameters(&handle->device, identifier)) {
+    if (hidOpenDeviceWithParameters(&handle->device, identifier, descriptor->hid.usagePage)) {
       if (handle->device) {
+        if (!descriptor->hid.modelTable) return handle;
+
         handle->model = getHidModelEntry(
           handle->device,
           descriptor->hid.modelTable
         );
 
         if (handle->model) return handle;
+        hidCloseDevice(handle->device);
       }
     }
 
@@ -263,7 +272,8 @@ connectHidResource (
 
 static int
 prepareHidEndpoint (GioEndpoint *endpoint) {
-  gioSetApplicationData(endpoint, endpoint->handle->model->data);
+  const HidModelEntry *model = endpoint->handle->model;
+  if (model) gioSetApplicationData(endpoint, model->data);
   return 1;
 }
 
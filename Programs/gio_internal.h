@@ -48,6 +48,8 @@ typedef int GioMonitorInputMethod (GioHandle *handle, AsyncMonitorCallback *call
 
 typedef int GioReconfigureResourceMethod (GioHandle *handle, const SerialParameters *parameters);
 
+typedef unsigned int GioGetBytesPerSecondMethod (GioHandle *handle);
+
 typedef ssize_t GioTellResourceMethod (
   GioHandle *handle, uint8_t recipient, uint8_t type,
   uint8_t request, uint16_t value, uint16_t index,
@@ -60,6 +62,10 @@ typedef ssize_t GioAskResourceMethod (
   void *buffer, uint16_t size, int timeout
 );
 
+typedef const HidItemsDescriptor *GioGetHidItemsMethod (
+  GioHandle *handle, int timeout
+);
+
 typedef int GioGetHidReportSizeMethod (
   GioHandle *handle, HidReportIdentifier identifier,
   HidReportSize *size, int timeout
@@ -98,10 +104,12 @@ typedef struct {
   GioReadDataMethod *readData;
   GioMonitorInputMethod *monitorInput;
   GioReconfigureResourceMethod *reconfigureResource;
+  GioGetBytesPerSecondMethod *getBytesPerSecond;
 
   GioTellResourceMethod *tellResource;
   GioAskResourceMethod *askResource;
 
+  GioGetHidItemsMethod *getHidItems;
   GioGetHidReportSizeMethod *getHidReportSize;
   GioGetHidReportMethod *getHidReport;
   GioSetHidReportMethod *setHidReport;
@@ -158,6 +166,7 @@ extern const GioProperties gioProperties_serial;
 extern const GioProperties gioProperties_usb;
 extern const GioProperties gioProperties_bluetooth;
 extern const GioProperties gioProperties_hid;
+extern const GioProperties gioProperties_emulator;
 extern const GioProperties gioProperties_null;
 
 extern void gioSetBytesPerSecond (GioEndpoint *endpoint, const SerialParameters *parameters);
@@ -328,6 +328,12 @@ hidOpenDeviceWithFilter (HidDevice **device, const HidFilter *filter) {
       .to = &common.productIdentifier,
     },
 
+    { .name = "usage page",
+      .copy = hidCopyIdentifierFilter,
+      .from = &filter->common.usagePage,
+      .to = &common.usagePage,
+    },
+
     { .name = "manufacturer name",
       .copy = hidCopyStringFilter,
       .from = filter->usb.manufacturerName,
@@ -408,11 +414,15 @@ hidOpenDeviceWithFilter (HidDevice **device, const HidFilter *filter) {
 }
 
 int
-hidOpenDeviceWithParameters (HidDevice **device, const char *string) {
+hidOpenDeviceWithParameters (HidDevice **device, const char *string, uint16_t usagePage) {
   char **parameters = hidGetDeviceParameters(string);
 
   if (parameters) {
     HidFilter filter = {
+      .common = {
+        .usagePage = usagePage,
+      },
+
       .usb = {
         .manufacturerName = parameters[HID_PARM_MANUFACTURER],
         .productDescription = parameters[HID_PARM_DESCRIPTION],
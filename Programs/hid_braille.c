@@ -18,6 +18,667 @@
 
 #include "prologue.h"
 
+#include <string.h>
+
 #include "log.h"
+#include "strfmt.h"
 #include "hid_items.h"
 #include "hid_braille.h"
+
+/* The braille usage page is compiled, once per connection, into a table of
+ * fields indexed by report identifier so that decoding an input report only
+ * has to extract the bits of the fields which are actually of interest.
+ */
+
+#define HID_BRAILLE_REPORT_COUNT 0X100
+#define HID_BRAILLE_STACK_SIZE 4
+#define HID_BRAILLE_USAGE_RANGE_LIMIT 0X40
+#define HID_BRAILLE_COLLECTION_DEPTH 0X10
+
+typedef struct {
+  uint32_t bitOffset;
+  unsigned char bitSize;
+  unsigned char isArray:1;
+  unsigned char isRouter:1;
+
+  union {
+    struct {
+      uint16_t number;
+    } key;
+
+    struct {
+      uint16_t count;
+      uint16_t usageCount;
+      int firstButton;
+      HidSignedValue logicalMinimum;
+    } array;
+  } type;
+} HidBrailleInputField;
+
+typedef struct {
+  HidBrailleInputField *fields;
+  unsigned int fieldCount;
+  size_t size;
+} HidBrailleInputReport;
+
+struct HidBrailleLayoutStruct {
+  unsigned char hasIdentifiers;
+  HidBrailleInputReport inputReports[HID_BRAILLE_REPORT_COUNT];
+
+  struct {
+    HidReportIdentifier identifier;
+    unsigned char bitSize;
+    unsigned char dotMask;
+    uint32_t bitOffset;
+    unsigned int count;
+    size_t size;
+  } cells;
+
+  unsigned int routerCount;
+  unsigned char buttons[HID_BRAILLE_BUTTON_COUNT];
+};
+
+typedef struct {
+  HidUnsignedValue usagePage;
+  HidSignedValue logicalMinimum;
+  HidUnsignedValue reportSize;
+  HidUnsignedValue reportCount;
+  HidUnsignedValue reportIdentifier;
+} HidBrailleGlobals;
+
+typedef struct {
+  HidUnsignedValue minimum;
+  HidUnsignedValue maximum;
+} HidBrailleUsageRange;
+
+typedef struct {
+  HidBrailleLayout *layout;
+
+  HidBrailleGlobals globals;
+  HidBrailleGlobals stack[HID_BRAILLE_STACK_SIZE];
+  unsigned int stackDepth;
+
+  struct {
+    HidBrailleUsageRange ranges[HID_BRAILLE_USAGE_RANGE_LIMIT];
+    unsigned int count;
+    HidUnsignedValue minimum;
+  } usages;
+
+  struct {
+    HidUnsignedValue usages[HID_BRAILLE_COLLECTION_DEPTH];
+    unsigned int depth;
+    unsigned int ignoredRouterSets;
+  } collections;
+
+  uint32_t inputOffsets[HID_BRAILLE_REPORT_COUNT];
+  uint32_t outputOffsets[HID_BRAILLE_REPORT_COUNT];
+  unsigned int fieldSizes[HID_BRAILLE_REPORT_COUNT];
+} HidBrailleParser;
+
+static inline HidUnsignedValue
+makeBrailleUsage (HidUnsignedValue usage) {
+  return (HID_UPG_Braille << 16) | usage;
+}
+
+static HidUnsignedValue
+getItemUsage (const HidBrailleParser *hbp, const HidItem *item) {
+  if (item->valueSize == 4) return item->value.u;
+  return (hbp->globals.usagePage << 16) | item->value.u;
+}
+
+static void
+addUsageRange (HidBrailleParser *hbp, HidUnsignedValue minimum, HidUnsignedValue maximum) {
+  if (hbp->usages.count < ARRAY_COUNT(hbp->usages.ranges)) {
+    HidBrailleUsageRange *range = &hbp->usages.ranges[hbp->usages.count++];
+    range->minimum = minimum;
+    range->maximum = maximum;
+  }
+}
+
+static HidUnsignedValue
+getUsage (const HidBrailleParser *hbp, unsigned int index) {
+  const HidBrailleUsageRange *range = hbp->usages.ranges;
+  const HidBrailleUsageRange *end = range + hbp->usages.count;
+
+  while (range < end) {
+    HidUnsignedValue count = range->maximum - range->minimum + 1;
+    if (index < count) return range->minimum + index;
+
+    index -= count;
+    range += 1;
+  }
+
+  return end[-1].maximum;
+}
+
+static int
+getButtonNumber (HidUnsignedValue usage, unsigned int *button) {
+  if ((usage >> 16) != HID_UPG_Braille) return 0;
+  usage &= 0XFFFF;
+
+  if (usage < HID_USG_BRL_KeyboardDot1) return 0;
+  if (usage > HID_USG_BRL_RockerPress) return 0;
+
+  // these name the collections which group the buttons on each side
+  if ((usage >= HID_USG_BRL_FrontControls) && (usage <= HID_USG_BRL_TopControls)) return 0;
+
+  *button = usage - HID_USG_BRL_KeyboardDot1;
+  return 1;
+}
+
+static HidBrailleInputField *
+addInputField (HidBrailleParser *hbp) {
+  HidBrailleInputReport *report = &hbp->layout->inputReports[hbp->globals.reportIdentifier];
+  unsigned int *size = &hbp->fieldSizes[hbp->globals.reportIdentifier];
+
+  if (report->fieldCount == *size) {
+    unsigned int newSize = *size? (*size << 1): 8;
+    HidBrailleInputField *newFields = realloc(report->fields, ARRAY_SIZE(newFields, newSize));
+
+    if (!newFields) {
+      logMallocError();
+      return NULL;
+    }
+
+    report->fields = newFields;
+    *size = newSize;
+  }
+
+  HidBrailleInputField *field = &report->fields[report->fieldCount++];
+  memset(field, 0, sizeof(*field));
+  field->bitOffset = hbp->inputOffsets[hbp->globals.reportIdentifier];
+  field->bitSize = hbp->globals.reportSize;
+  return field;
+}
+
+static int
+addInputFields (HidBrailleParser *hbp, HidUnsignedValue flags) {
+  const HidBrailleGlobals *globals = &hbp->globals;
+  HidBrailleLayout *layout = hbp->layout;
+
+  if (!(flags & HID_USG_FLG_CONSTANT) && hbp->usages.count) {
+    if (globals->reportSize && (globals->reportSize <= 0X20)) {
+      if (flags & HID_USG_FLG_VARIABLE) {
+        for (unsigned int index=0; index<globals->reportCount; index+=1) {
+          HidUnsignedValue usage = getUsage(hbp, index);
+          unsigned int button;
+
+          if (usage == makeBrailleUsage(HID_USG_BRL_RouterKey)) {
+            if (hbp->collections.ignoredRouterSets) continue;
+            if (layout->routerCount == HID_BRAILLE_ROUTER_LIMIT) continue;
+
+            HidBrailleInputField *field = addInputField(hbp);
+            if (!field) return 0;
+
+            field->bitOffset += index * globals->reportSize;
+            field->isRouter = 1;
+            field->type.key.number = layout->routerCount++;
+          } else if (getButtonNumber(usage, &button)) {
+            HidBrailleInputField *field = addInputField(hbp);
+            if (!field) return 0;
+
+            field->bitOffset += index * globals->reportSize;
+            field->type.key.number = button;
+            layout->buttons[button] = 1;
+          }
+        }
+      } else {
+        HidUnsignedValue minimum = hbp->usages.ranges[0].minimum;
+        HidUnsignedValue maximum = hbp->usages.ranges[hbp->usages.count-1].maximum;
+
+        if (((minimum >> 16) == HID_UPG_Braille) && (maximum >= minimum)) {
+          HidUnsignedValue first = makeBrailleUsage(HID_USG_BRL_KeyboardDot1);
+          HidUnsignedValue last = makeBrailleUsage(HID_USG_BRL_RockerPress);
+
+          if ((maximum >= first) && (minimum <= last)) {
+            HidBrailleInputField *field = addInputField(hbp);
+            if (!field) return 0;
+
+            field->isArray = 1;
+            field->type.array.count = globals->reportCount;
+            field->type.array.usageCount = maximum - minimum + 1;
+            field->type.array.firstButton = (int)minimum - (int)first;
+            field->type.array.logicalMinimum = globals->logicalMinimum;
+
+            for (HidUnsignedValue usage=minimum; usage<=maximum; usage+=1) {
+              unsigned int button;
+              if (getButtonNumber(usage, &button)) layout->buttons[button] = 1;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  hbp->inputOffsets[globals->reportIdentifier] += globals->reportSize * globals->reportCount;
+  return 1;
+}
+
+static void
+addOutputFields (HidBrailleParser *hbp, HidUnsignedValue flags) {
+  const HidBrailleGlobals *globals = &hbp->globals;
+  HidBrailleLayout *layout = hbp->layout;
+  uint32_t *offset = &hbp->outputOffsets[globals->reportIdentifier];
+
+  if (!layout->cells.count && !(flags & HID_USG_FLG_CONSTANT) && hbp->usages.count) {
+    HidUnsignedValue usage = getUsage(hbp, 0);
+    unsigned char dotMask = 0;
+
+    if (usage == makeBrailleUsage(HID_USG_BRL_8DotCell)) {
+      dotMask = 0XFF;
+    } else if (usage == makeBrailleUsage(HID_USG_BRL_6DotCell)) {
+      dotMask = 0X3F;
+    }
+
+    if (dotMask && (globals->reportSize >= 6) && (globals->reportSize <= 8)) {
+      layout->cells.identifier = globals->reportIdentifier;
+      layout->cells.bitSize = globals->reportSize;
+      layout->cells.dotMask = dotMask;
+      layout->cells.bitOffset = *offset;
+      layout->cells.count = globals->reportCount;
+    }
+  }
+
+  *offset += globals->reportSize * globals->reportCount;
+}
+
+static int
+parseBrailleLayout (HidBrailleParser *hbp, const HidItemsDescriptor *items) {
+  const unsigned char *nextByte = items->bytes;
+  size_t bytesLeft = items->count;
+
+  while (bytesLeft) {
+    HidItem item;
+
+    if (!hidNextItem(&item, &nextByte, &bytesLeft)) {
+      logMessage(LOG_WARNING, "incomplete HID item");
+      break;
+    }
+
+    switch (item.tag) {
+      case HID_ITM_UsagePage:
+        hbp->globals.usagePage = item.value.u;
+        break;
+
+      case HID_ITM_LogicalMinimum:
+        hbp->globals.logicalMinimum = item.value.s;
+        break;
+
+      case HID_ITM_ReportSize:
+        hbp->globals.reportSize = item.value.u;
+        break;
+
+      case HID_ITM_ReportCount:
+        hbp->globals.reportCount = item.value.u;
+        break;
+
+      case HID_ITM_ReportID:
+        if (item.value.u >= HID_BRAILLE_REPORT_COUNT) {
+          logMessage(LOG_WARNING, "HID report identifier out of range: %u", item.value.u);
+          return 0;
+        }
+
+        hbp->globals.reportIdentifier = item.value.u;
+        hbp->layout->hasIdentifiers = 1;
+        break;
+
+      case HID_ITM_Push:
+        if (hbp->stackDepth < ARRAY_COUNT(hbp->stack)) {
+          hbp->stack[hbp->stackDepth++] = hbp->globals;
+        }
+        break;
+
+      case HID_ITM_Pop:
+        if (hbp->stackDepth) {
+          hbp->globals = hbp->stack[--hbp->stackDepth];
+        }
+        break;
+
+      case HID_ITM_Usage: {
+        HidUnsignedValue usage = getItemUsage(hbp, &item);
+        addUsageRange(hbp, usage, usage);
+        break;
+      }
+
+      case HID_ITM_UsageMinimum:
+        hbp->usages.minimum = getItemUsage(hbp, &item);
+        break;
+
+      case HID_ITM_UsageMaximum:
+        addUsageRange(hbp, hbp->usages.minimum, getItemUsage(hbp, &item));
+        break;
+
+      case HID_ITM_Collection: {
+        HidUnsignedValue usage = hbp->usages.count? hbp->usages.ranges[0].minimum: 0;
+
+        if ((usage == makeBrailleUsage(HID_USG_BRL_RouterSet2)) ||
+            (usage == makeBrailleUsage(HID_USG_BRL_RouterSet3))) {
+          hbp->collections.ignoredRouterSets += 1;
+        }
+
+        if (hbp->collections.depth < ARRAY_COUNT(hbp->collections.usages)) {
+          hbp->collections.usages[hbp->collections.depth] = usage;
+        }
+
+        hbp->collections.depth += 1;
+        hbp->usages.count = 0;
+        break;
+      }
+
+      case HID_ITM_EndCollection:
+        if (hbp->collections.depth) {
+          hbp->collections.depth -= 1;
+
+          if (hbp->collections.depth < ARRAY_COUNT(hbp->collections.usages)) {
+            HidUnsignedValue usage = hbp->collections.usages[hbp->collections.depth];
+
+            if ((usage == makeBrailleUsage(HID_USG_BRL_RouterSet2)) ||
+                (usage == makeBrailleUsage(HID_USG_BRL_RouterSet3))) {
+              hbp->collections.ignoredRouterSets -= 1;
+            }
+          }
+        }
+
+        hbp->usages.count = 0;
+        break;
+
+      case HID_ITM_Input:
+        if (!addInputFields(hbp, item.value.u)) return 0;
+        hbp->usages.count = 0;
+        break;
+
+      case HID_ITM_Output:
+        addOutputFields(hbp, item.value.u);
+        hbp->usages.count = 0;
+        break;
+
+      case HID_ITM_Feature:
+        hbp->usages.count = 0;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  {
+    HidBrailleLayout *layout = hbp->layout;
+    size_t prefix = layout->hasIdentifiers? 1: 0;
+
+    for (unsigned int identifier=0; identifier<HID_BRAILLE_REPORT_COUNT; identifier+=1) {
+      uint32_t bits = hbp->inputOffsets[identifier];
+      if (bits) layout->inputReports[identifier].size = prefix + ((bits + 7) / 8);
+    }
+
+    if (layout->cells.count) {
+      uint32_t bits = hbp->outputOffsets[layout->cells.identifier];
+      layout->cells.size = (bits + 7) / 8;
+    }
+  }
+
+  return 1;
+}
+
+void
+hidDestroyBrailleLayout (HidBrailleLayout *layout) {
+  for (unsigned int identifier=0; identifier<HID_BRAILLE_REPORT_COUNT; identifier+=1) {
+    HidBrailleInputReport *report = &layout->inputReports[identifier];
+    if (report->fields) free(report->fields);
+  }
+
+  free(layout);
+}
+
+HidBrailleLayout *
+hidNewBrailleLayout (const HidItemsDescriptor *items) {
+  HidBrailleLayout *layout;
+
+  if ((layout = malloc(sizeof(*layout)))) {
+    memset(layout, 0, sizeof(*layout));
+
+    HidBrailleParser *hbp;
+
+    if ((hbp = malloc(sizeof(*hbp)))) {
+      memset(hbp, 0, sizeof(*hbp));
+      hbp->layout = layout;
+
+      int parsed = parseBrailleLayout(hbp, items);
+      free(hbp);
+
+      if (parsed) {
+        if (layout->cells.count) {
+          logMessage(LOG_CATEGORY(HID_IO),
+            "braille layout: Cells:%u Routers:%u",
+            layout->cells.count, layout->routerCount
+          );
+
+          return layout;
+        }
+
+        logMessage(LOG_WARNING, "HID braille cells not defined");
+      }
+    } else {
+      logMallocError();
+    }
+
+    hidDestroyBrailleLayout(layout);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+unsigned int
+hidGetBrailleCellCount (const HidBrailleLayout *layout) {
+  return layout->cells.count;
+}
+
+unsigned int
+hidGetBrailleRouterCount (const HidBrailleLayout *layout) {
+  return layout->routerCount;
+}
+
+int
+hidHasBrailleButton (const HidBrailleLayout *layout, unsigned int button) {
+  if (button >= HID_BRAILLE_BUTTON_COUNT) return 0;
+  return layout->buttons[button];
+}
+
+size_t
+hidGetBrailleInputSize (const HidBrailleLayout *layout, HidReportIdentifier identifier) {
+  return layout->inputReports[identifier].size;
+}
+
+size_t
+hidGetBrailleOutputSize (const HidBrailleLayout *layout) {
+  return 1 + layout->cells.size;
+}
+
+static HidUnsignedValue
+getBits (const unsigned char *bytes, size_t size, uint32_t offset, unsigned char count) {
+  HidUnsignedValue value = 0;
+  unsigned char shift = 0;
+
+  while (count) {
+    size_t index = offset / 8;
+    if (index >= size) break;
+
+    unsigned char bit = offset % 8;
+    unsigned char width = 8 - bit;
+    if (width > count) width = count;
+
+    value |= ((bytes[index] >> bit) & ((1 << width) - 1)) << shift;
+    shift += width;
+    offset += width;
+    count -= width;
+  }
+
+  return value;
+}
+
+static void
+putBits (unsigned char *bytes, uint32_t offset, unsigned char count, HidUnsignedValue value) {
+  while (count) {
+    size_t index = offset / 8;
+    unsigned char bit = offset % 8;
+    unsigned char width = 8 - bit;
+    if (width > count) width = count;
+
+    unsigned char mask = ((1 << width) - 1) << bit;
+    bytes[index] = (bytes[index] & ~mask) | ((value << bit) & mask);
+
+    value >>= width;
+    offset += width;
+    count -= width;
+  }
+}
+
+int
+hidDecodeBrailleInput (
+  const HidBrailleLayout *layout, HidBrailleKeys *keys,
+  const unsigned char *report, size_t size
+) {
+  HidReportIdentifier identifier = 0;
+
+  if (layout->hasIdentifiers) {
+    if (!size) return 0;
+    identifier = *report++;
+    size -= 1;
+  }
+
+  const HidBrailleInputReport *input = &layout->inputReports[identifier];
+  if (!input->fieldCount) return 0;
+
+  const HidBrailleInputField *field = input->fields;
+  const HidBrailleInputField *end = field + input->fieldCount;
+
+  for (; field<end; field+=1) {
+    if (field->isArray) {
+      unsigned int count = field->type.array.usageCount;
+      int button = field->type.array.firstButton;
+
+      while (count--) {
+        if ((button >= 0) && (button < HID_BRAILLE_BUTTON_COUNT)) keys->buttons[button] = 0;
+        button += 1;
+      }
+    }
+  }
+
+  for (field=input->fields; field<end; field+=1) {
+    if (field->isArray) {
+      for (unsigned int index=0; index<field->type.array.count; index+=1) {
+        HidUnsignedValue value = getBits(report, size, field->bitOffset + (index * field->bitSize), field->bitSize);
+        HidSignedValue offset = (HidSignedValue)value - field->type.array.logicalMinimum;
+
+        if ((offset >= 0) && (offset < field->type.array.usageCount)) {
+          int button = field->type.array.firstButton + offset;
+          if ((button >= 0) && (button < HID_BRAILLE_BUTTON_COUNT)) keys->buttons[button] = 1;
+        }
+      }
+    } else {
+      unsigned char pressed = !!getBits(report, size, field->bitOffset, field->bitSize);
+
+      if (field->isRouter) {
+        keys->routers[field->type.key.number] = pressed;
+      } else {
+        keys->buttons[field->type.key.number] = pressed;
+      }
+    }
+  }
+
+  return 1;
+}
+
+size_t
+hidEncodeBrailleOutput (
+  const HidBrailleLayout *layout,
+  const unsigned char *cells, unsigned int count,
+  unsigned char *report, size_t size
+) {
+  size_t length = hidGetBrailleOutputSize(layout);
+  if (length > size) return 0;
+
+  // any cells beyond those supplied are left blank
+  if (count > layout->cells.count) count = layout->cells.count;
+
+  report[0] = layout->cells.identifier;
+  unsigned char *data = &report[1];
+  memset(data, 0, layout->cells.size);
+
+  if (layout->cells.bitSize == 8) {
+    if (!(layout->cells.bitOffset % 8) && (layout->cells.dotMask == 0XFF)) {
+      memcpy(&data[layout->cells.bitOffset / 8], cells, count);
+      return length;
+    }
+  }
+
+  for (unsigned int index=0; index<count; index+=1) {
+    putBits(
+      data, layout->cells.bitOffset + (index * layout->cells.bitSize),
+      layout->cells.bitSize, cells[index] & layout->cells.dotMask
+    );
+  }
+
+  return length;
+}
+
+int
+hidListBrailleLayout (const HidBrailleLayout *layout, HidBrailleLayoutLister *listLine, void *data) {
+  {
+    char line[0X80];
+    STR_BEGIN(line, sizeof(line));
+
+    STR_PRINTF(
+      "Cells: %u (%s-dot) Report:%02X Offset:%u Size:%"PRIsize,
+      layout->cells.count, ((layout->cells.dotMask == 0XFF)? "8": "6"),
+      layout->cells.identifier, layout->cells.bitOffset,
+      hidGetBrailleOutputSize(layout)
+    );
+
+    STR_END;
+    if (!listLine(line, data)) return 0;
+  }
+
+  {
+    char line[0X40];
+    STR_BEGIN(line, sizeof(line));
+    STR_PRINTF("Routers: %u", layout->routerCount);
+    STR_END;
+    if (!listLine(line, data)) return 0;
+  }
+
+  {
+    char line[0X100];
+    STR_BEGIN(line, sizeof(line));
+    STR_PRINTF("Buttons:");
+
+    for (unsigned int button=0; button<HID_BRAILLE_BUTTON_COUNT; button+=1) {
+      if (layout->buttons[button]) {
+        STR_PRINTF(" %03X", HID_USG_BRL_KeyboardDot1+button);
+      }
+    }
+
+    STR_END;
+    if (!listLine(line, data)) return 0;
+  }
+
+  for (unsigned int identifier=0; identifier<HID_BRAILLE_REPORT_COUNT; identifier+=1) {
+    const HidBrailleInputReport *report = &layout->inputReports[identifier];
+
+    if (report->fieldCount) {
+      char line[0X40];
+      STR_BEGIN(line, sizeof(line));
+
+      STR_PRINTF(
+        "Input Report %02X: Size:%"PRIsize " Fields:%u",
+        identifier, report->size, report->fieldCount
+      );
+
+      STR_END;
+      if (!listLine(line, data)) return 0;
+    }
+  }
+
+  return 1;
+}
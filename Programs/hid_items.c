@@ -217,3 +217,31 @@ hidReportSize (
 
   return reportFound;
 }
+
+int
+hidHasUsagePage (const HidItemsDescriptor *items, HidUnsignedValue page) {
+  const unsigned char *nextByte = items->bytes;
+  size_t bytesLeft = items->count;
+  HidItem item;
+
+  while (hidNextItem(&item, &nextByte, &bytesLeft)) {
+    switch (item.tag) {
+      case HID_ITM_UsagePage:
+        if (item.value.u == page) return 1;
+        break;
+
+      case HID_ITM_Usage:
+      case HID_ITM_UsageMinimum:
+      case HID_ITM_UsageMaximum:
+        if (item.valueSize == 4) {
+          if ((item.value.u >> 16) == page) return 1;
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return 0;
+}
@@ -460,6 +460,12 @@ hidLinuxTestCommonProperties (HidHandle *handle, const HidCommonProperties *comm
     }
   }
 
+  if (common->usagePage) {
+    const HidItemsDescriptor *items = hidLinuxGetItems(handle);
+    if (!items) return 0;
+    if (!hidHasUsagePage(items, common->usagePage)) return 0;
+  }
+
   return 1;
 }
 
@@ -0,0 +1,1066 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif /* HAVE_SYS_MMAN_H */
+
+#include "log.h"
+#include "file.h"
+#include "datafile.h"
+#include "parse.h"
+#include "ktb.h"
+#include "ktb_internal.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#define KEY_TABLE_CACHE_SUBDIRECTORY "key-tables"
+#define KEY_TABLE_CACHE_EXTENSION ".ktc"
+#define KEY_TABLE_CACHE_MAGIC "BRLTTYKT"
+#define KEY_TABLE_CACHE_VERSION 1
+#define KEY_TABLE_CACHE_ALIGNMENT 8
+
+/* A cached key table is a single block which is mapped read-only so that
+ * all of the processes using the same table share one copy of it. Every
+ * reference within it is a byte offset from its start - offset zero (the
+ * header) means that the item isn't present.
+ */
+typedef uint32_t CacheOffset;
+
+typedef struct {
+  uint32_t count;
+  CacheOffset table;
+} CacheArray;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t build;
+  uint64_t key;
+  uint32_t size;
+
+  CacheOffset path;
+  CacheOffset title;
+
+  CacheArray sources;
+  CacheArray notes;
+  CacheArray contexts;
+  CacheArray macros;
+  CacheArray hostCommands;
+} CacheHeader;
+
+typedef struct {
+  CacheOffset path;
+  uint32_t reserved;
+  uint64_t device;
+  uint64_t inode;
+  int64_t size;
+  int64_t modified;
+} CacheSource;
+
+typedef enum {
+  CCF_SPECIAL    = 0X01,
+  CCF_DEFINED    = 0X02,
+  CCF_REFERENCED = 0X04,
+  CCF_ISOLATED   = 0X08,
+} CacheContextFlag;
+
+typedef struct {
+  CacheOffset name;
+  CacheOffset title;
+  uint32_t flags;
+  int32_t superimpose;
+  uint16_t modifierCounts[2];
+
+  KeyFilter bindingKeys;
+  KeyFilter hotkeyKeys;
+
+  CacheArray keyBindings;
+  CacheArray hotkeys;
+  CacheArray mappedKeys;
+} CacheContext;
+
+static uint32_t
+hashBytes32 (uint32_t hash, const void *bytes, size_t count) {
+  const unsigned char *byte = bytes;
+
+  while (count--) {
+    hash ^= *byte++;
+    hash *= UINT32_C(0X01000193);
+  }
+
+  return hash;
+}
+
+static uint64_t
+hashBytes64 (uint64_t hash, const void *bytes, size_t count) {
+  const unsigned char *byte = bytes;
+
+  while (count--) {
+    hash ^= *byte++;
+    hash *= UINT64_C(0X100000001B3);
+  }
+
+  return hash;
+}
+
+static uint64_t
+hashString64 (uint64_t hash, const char *string) {
+  return hashBytes64(hash, string, strlen(string)+1);
+}
+
+static uint32_t
+getBuildHash (void) {
+  static uint32_t hash = 0;
+
+  if (!hash) {
+    const size_t sizes[] = {
+      KEY_TABLE_CACHE_VERSION, sizeof(wchar_t),
+      sizeof(CacheHeader), sizeof(CacheSource), sizeof(CacheContext),
+      sizeof(KeyBinding), sizeof(HotkeyEntry), sizeof(MappedKeyEntry),
+      sizeof(BoundCommand), sizeof(KeyFilter)
+    };
+
+    uint32_t h = hashBytes32(UINT32_C(0X811C9DC5), sizes, sizeof(sizes));
+    h = hashBytes32(h, PACKAGE_VERSION, sizeof(PACKAGE_VERSION));
+
+    // the bound commands and mapped keys refer to these tables by index
+    for (const CommandEntry *cmd=commandTable; cmd->name; cmd+=1) {
+      h = hashBytes32(h, cmd->name, strlen(cmd->name)+1);
+      h = hashBytes32(h, &cmd->code, sizeof(cmd->code));
+    }
+
+    for (unsigned int index=0; index<keyboardFunctionCount; index+=1) {
+      const KeyboardFunction *kbf = &keyboardFunctionTable[index];
+      h = hashBytes32(h, kbf->name, strlen(kbf->name)+1);
+      h = hashBytes32(h, &kbf->bit, sizeof(kbf->bit));
+    }
+
+    hash = h? h: 1;
+  }
+
+  return hash;
+}
+
+static void
+hashGlobalVariable (const Variable *variable, void *data) {
+  uint64_t *variables = data;
+  const wchar_t *characters;
+  int length;
+
+  getVariableName(variable, &characters, &length);
+  uint64_t hash = hashBytes64(UINT64_C(0XCBF29CE484222325), characters, (length * sizeof(*characters)));
+
+  getVariableValue(variable, &characters, &length);
+  hash = hashBytes64(hash, &length, sizeof(length));
+  *variables += hashBytes64(hash, characters, (length * sizeof(*characters)));
+}
+
+static uint64_t
+getTableKey (const KeyTable *table, const char *name) {
+  uint64_t key = UINT64_C(0XCBF29CE484222325);
+
+  if (!isAbsolutePath(name)) {
+    char *directory = getWorkingDirectory();
+
+    if (directory) {
+      key = hashString64(key, directory);
+      free(directory);
+    }
+  }
+
+  key = hashString64(key, name);
+
+  // the key names determine which keys can be bound and which ifKey
+  // conditions are satisfied - they're combined without regard to their
+  // order since it changes when the table is sorted
+  uint64_t names = 0;
+
+  for (unsigned int index=0; index<table->keyNames.count; index+=1) {
+    const KeyNameEntry *kne = table->keyNames.table[index];
+    uint64_t hash = hashString64(UINT64_C(0XCBF29CE484222325), kne->name);
+
+    names += hashBytes64(hash, &kne->value, sizeof(kne->value));
+  }
+
+  key = hashBytes64(key, &names, sizeof(names));
+
+  // a table can test (ifVar) or substitute (\{name}) a global variable -
+  // they're set from the configuration so they can change from one run to
+  // the next without any of the sources changing
+  uint64_t variables = 0;
+  VariableNestingLevel *globals = getGlobalVariables(0);
+  if (globals) visitVariables(globals, hashGlobalVariable, &variables);
+
+  return hashBytes64(key, &variables, sizeof(variables));
+}
+
+static char *
+makeCachePath (uint64_t key) {
+  char *directory = makeWritablePath(KEY_TABLE_CACHE_SUBDIRECTORY);
+
+  if (directory) {
+    char *path = NULL;
+
+    if (ensureDirectory(directory, 0)) {
+      char name[0X20];
+      snprintf(name, sizeof(name), "%016" PRIX64 KEY_TABLE_CACHE_EXTENSION, key);
+      path = makePath(directory, name);
+    }
+
+    free(directory);
+    return path;
+  }
+
+  return NULL;
+}
+
+typedef struct {
+  const unsigned char *bytes;
+  size_t size;
+} CacheView;
+
+static const void *
+getCacheItem (const CacheView *view, CacheOffset offset, size_t size) {
+  if (!offset) return NULL;
+  if (offset % KEY_TABLE_CACHE_ALIGNMENT) return NULL;
+  if (offset > view->size) return NULL;
+  if (size > (view->size - offset)) return NULL;
+  return view->bytes + offset;
+}
+
+static const void *
+getCacheArray (const CacheView *view, const CacheArray *array, size_t size) {
+  if (!array->count) return NULL;
+  if (array->count > (view->size / size)) return NULL;
+  return getCacheItem(view, array->table, (array->count * size));
+}
+
+static const char *
+getCacheString (const CacheView *view, CacheOffset offset) {
+  const char *string = getCacheItem(view, offset, 1);
+
+  if (string) {
+    if (!memchr(string, 0, (view->size - offset))) return NULL;
+  }
+
+  return string;
+}
+
+static const wchar_t *
+getCacheCharacters (const CacheView *view, CacheOffset offset) {
+  const wchar_t *characters = getCacheItem(view, offset, sizeof(wchar_t));
+
+  if (characters) {
+    if (!wmemchr(characters, 0, ((view->size - offset) / sizeof(wchar_t)))) return NULL;
+  }
+
+  return characters;
+}
+
+static wchar_t *
+copyCacheCharacters (const CacheView *view, CacheOffset offset, int *ok) {
+  if (!offset) return NULL;
+  const wchar_t *characters = getCacheCharacters(view, offset);
+
+  if (characters) {
+    size_t size = (wcslen(characters) + 1) * sizeof(*characters);
+    wchar_t *copy = malloc(size);
+
+    if (copy) {
+      memcpy(copy, characters, size);
+      return copy;
+    }
+
+    logMallocError();
+  }
+
+  *ok = 0;
+  return NULL;
+}
+
+static int
+isCurrentSource (const CacheView *view, const CacheSource *source) {
+  const char *path = getCacheString(view, source->path);
+  if (!path) return 0;
+
+  struct stat status;
+
+  if (stat(path, &status) == -1) {
+    logMessage(LOG_DEBUG, "key table cache source not accessible: %s: %s", path, strerror(errno));
+    return 0;
+  }
+
+  if ((status.st_dev == source->device) &&
+      (status.st_ino == source->inode) &&
+      (status.st_size == source->size) &&
+      (status.st_mtime == source->modified)) {
+    return 1;
+  }
+
+  logMessage(LOG_DEBUG, "key table cache source changed: %s", path);
+  return 0;
+}
+
+static const CacheHeader *
+verifyCache (const CacheView *view, const char *name, uint64_t key) {
+  if (view->size < sizeof(CacheHeader)) return NULL;
+  const CacheHeader *header = (const void *)view->bytes;
+
+  if (memcmp(header->magic, KEY_TABLE_CACHE_MAGIC, sizeof(header->magic)) != 0) return NULL;
+  if (header->version != KEY_TABLE_CACHE_VERSION) return NULL;
+  if (header->build != getBuildHash()) return NULL;
+  if (header->key != key) return NULL;
+  if (header->size != view->size) return NULL;
+
+  {
+    const char *path = getCacheString(view, header->path);
+    if (!path) return NULL;
+    if (strcmp(path, name) != 0) return NULL;
+  }
+
+  {
+    const CacheSource *source = getCacheArray(view, &header->sources, sizeof(*source));
+    if (!source) return NULL;
+    const CacheSource *end = source + header->sources.count;
+
+    while (source < end) {
+      if (!isCurrentSource(view, source)) return NULL;
+      source += 1;
+    }
+  }
+
+  return header;
+}
+
+static void
+rememberCacheSources (const CacheView *view, const CacheHeader *header) {
+  const CacheSource *source = getCacheArray(view, &header->sources, sizeof(*source));
+  const CacheSource *end = source + header->sources.count;
+
+  // a cached load doesn't process the sources - list them as though it had
+  // so that whoever's watching the table's files still sees all of them
+  lockDataFiles();
+  forgetProcessedDataFiles();
+
+  while (source < end) {
+    const char *path = getCacheString(view, source->path);
+    if (path) rememberProcessedDataFile(path);
+    source += 1;
+  }
+
+  unlockDataFiles();
+}
+
+static int
+restoreNotes (KeyTable *table, const CacheView *view, const CacheHeader *header) {
+  unsigned int count = header->notes.count;
+  if (!count) return 1;
+
+  const CacheOffset *offsets = getCacheArray(view, &header->notes, sizeof(*offsets));
+  if (!offsets) return 0;
+
+  if (!(table->notes.table = malloc(ARRAY_SIZE(table->notes.table, count)))) {
+    logMallocError();
+    return 0;
+  }
+
+  table->notes.size = count;
+
+  while (table->notes.count < count) {
+    int ok = 1;
+    wchar_t *note = copyCacheCharacters(view, offsets[table->notes.count], &ok);
+
+    if (!ok || !note) return 0;
+    table->notes.table[table->notes.count++] = note;
+  }
+
+  return 1;
+}
+
+static int
+isValidBoundCommand (const BoundCommand *cmd) {
+  if (cmd->entry == BOUND_COMMAND_NO_ENTRY) return 1;
+  return cmd->entry < getCommandCount();
+}
+
+static int
+verifyBoundCommands (const KeyContext *ctx) {
+  {
+    const KeyBinding *binding = ctx->keyBindings.table;
+    const KeyBinding *end = binding + ctx->keyBindings.count;
+
+    while (binding < end) {
+      if (!isValidBoundCommand(&binding->primaryCommand)) return 0;
+      if (!isValidBoundCommand(&binding->secondaryCommand)) return 0;
+      binding += 1;
+    }
+  }
+
+  {
+    const HotkeyEntry *hotkey = ctx->hotkeys.table;
+    const HotkeyEntry *end = hotkey + ctx->hotkeys.count;
+
+    while (hotkey < end) {
+      if (!isValidBoundCommand(&hotkey->pressCommand)) return 0;
+      if (!isValidBoundCommand(&hotkey->releaseCommand)) return 0;
+      hotkey += 1;
+    }
+  }
+
+  {
+    const MappedKeyEntry *map = ctx->mappedKeys.table;
+    const MappedKeyEntry *end = map + ctx->mappedKeys.count;
+
+    while (map < end) {
+      if (map->keyboardFunction >= keyboardFunctionCount) return 0;
+      map += 1;
+    }
+  }
+
+  return 1;
+}
+
+static int
+restoreContexts (KeyTable *table, const CacheView *view, const CacheHeader *header) {
+  unsigned int count = header->contexts.count;
+  const CacheContext *cached = getCacheArray(view, &header->contexts, sizeof(*cached));
+  if (!cached) return 0;
+
+  if (!(table->keyContexts.table = malloc(ARRAY_SIZE(table->keyContexts.table, count)))) {
+    logMallocError();
+    return 0;
+  }
+
+  while (table->keyContexts.count < count) {
+    KeyContext *ctx = &table->keyContexts.table[table->keyContexts.count++];
+    memset(ctx, 0, sizeof(*ctx));
+
+    int ok = 1;
+    ctx->name = copyCacheCharacters(view, cached->name, &ok);
+    ctx->title = copyCacheCharacters(view, cached->title, &ok);
+    if (!ok) return 0;
+
+    ctx->isSpecial = !!(cached->flags & CCF_SPECIAL);
+    ctx->isDefined = !!(cached->flags & CCF_DEFINED);
+    ctx->isReferenced = !!(cached->flags & CCF_REFERENCED);
+    ctx->isIsolated = !!(cached->flags & CCF_ISOLATED);
+
+#define RESTORE_ARRAY(field) \
+    if ((ctx->field.count = cached->field.count)) { \
+      const void *address = getCacheArray(view, &cached->field, sizeof(*ctx->field.table)); \
+      if (!address) return 0; \
+      ctx->field.table = (void *)address; \
+      ctx->field.size = ctx->field.count; \
+    }
+
+    RESTORE_ARRAY(keyBindings);
+    RESTORE_ARRAY(hotkeys);
+    RESTORE_ARRAY(mappedKeys);
+#undef RESTORE_ARRAY
+
+    ctx->keyBindings.keys = cached->bindingKeys;
+    ctx->keyBindings.modifierCounts[0] = cached->modifierCounts[0];
+    ctx->keyBindings.modifierCounts[1] = cached->modifierCounts[1];
+    ctx->hotkeys.keys = cached->hotkeyKeys;
+    ctx->mappedKeys.superimpose = cached->superimpose;
+
+    if (!verifyBoundCommands(ctx)) return 0;
+    cached += 1;
+  }
+
+  return 1;
+}
+
+static int
+restoreMacros (KeyTable *table, const CacheView *view, const CacheHeader *header) {
+  unsigned int count = header->macros.count;
+  if (!count) return 1;
+
+  const CacheArray *cached = getCacheArray(view, &header->macros, sizeof(*cached));
+  if (!cached) return 0;
+
+  if (!(table->commandMacros.table = malloc(ARRAY_SIZE(table->commandMacros.table, count)))) {
+    logMallocError();
+    return 0;
+  }
+
+  table->commandMacros.size = count;
+
+  while (table->commandMacros.count < count) {
+    CommandMacro *macro = &table->commandMacros.table[table->commandMacros.count];
+    macro->commands = NULL;
+
+    if ((macro->count = cached->count)) {
+      const BoundCommand *commands = getCacheArray(view, cached, sizeof(*commands));
+      if (!commands) return 0;
+
+      for (unsigned int index=0; index<macro->count; index+=1) {
+        if (!isValidBoundCommand(&commands[index])) return 0;
+      }
+      size_t size = ARRAY_SIZE(macro->commands, macro->count);
+
+      if (!(macro->commands = malloc(size))) {
+        logMallocError();
+        return 0;
+      }
+
+      memcpy(macro->commands, commands, size);
+    }
+
+    table->commandMacros.count += 1;
+    cached += 1;
+  }
+
+  return 1;
+}
+
+static int
+restoreHostCommands (KeyTable *table, const CacheView *view, const CacheHeader *header) {
+  unsigned int count = header->hostCommands.count;
+  if (!count) return 1;
+
+  const CacheArray *cached = getCacheArray(view, &header->hostCommands, sizeof(*cached));
+  if (!cached) return 0;
+
+  if (!(table->hostCommands.table = malloc(ARRAY_SIZE(table->hostCommands.table, count)))) {
+    logMallocError();
+    return 0;
+  }
+
+  table->hostCommands.size = count;
+
+  while (table->hostCommands.count < count) {
+    const CacheOffset *offsets = getCacheArray(view, cached, sizeof(*offsets));
+    if (!offsets) return 0;
+
+    // the arguments are allocated along with the array so that freeing it
+    // (see destroyKeyTable) releases them too
+    size_t size = ARRAY_SIZE(((HostCommand *)NULL)->arguments, cached->count+1);
+
+    for (unsigned int index=0; index<cached->count; index+=1) {
+      const char *argument = getCacheString(view, offsets[index]);
+      if (!argument) return 0;
+      size += strlen(argument) + 1;
+    }
+
+    HostCommand *hc = &table->hostCommands.table[table->hostCommands.count];
+
+    if (!(hc->arguments = malloc(size))) {
+      logMallocError();
+      return 0;
+    }
+
+    {
+      char *string = (char *)&hc->arguments[cached->count+1];
+
+      for (unsigned int index=0; index<cached->count; index+=1) {
+        const char *argument = getCacheString(view, offsets[index]);
+        size_t length = strlen(argument) + 1;
+
+        memcpy(string, argument, length);
+        hc->arguments[index] = string;
+        string += length;
+      }
+
+      hc->arguments[cached->count] = NULL;
+    }
+
+    hc->count = cached->count;
+    table->hostCommands.count += 1;
+    cached += 1;
+  }
+
+  return 1;
+}
+
+static int
+mapCache (const char *path, CacheView *view) {
+  int result = 0;
+  int file = open(path, O_RDONLY);
+
+  if (file != -1) {
+    struct stat status;
+
+    if (fstat(file, &status) != -1) {
+      if ((status.st_size > 0) && (status.st_size <= UINT32_MAX)) {
+        void *address = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, file, 0);
+
+        if (address != MAP_FAILED) {
+          view->bytes = address;
+          view->size = status.st_size;
+          result = 1;
+        } else {
+          logSystemError("mmap");
+        }
+      }
+    } else {
+      logSystemError("fstat");
+    }
+
+    close(file);
+  } else if (errno != ENOENT) {
+    logMessage(LOG_WARNING, "key table cache open error: %s: %s", path, strerror(errno));
+  }
+
+  return result;
+}
+
+static int
+restoreKeyTable (KeyTable *table, const CacheView *view, const CacheHeader *header) {
+  if (!restoreContexts(table, view, header)) return 0;
+  if (!restoreNotes(table, view, header)) return 0;
+  if (!restoreMacros(table, view, header)) return 0;
+  if (!restoreHostCommands(table, view, header)) return 0;
+
+  {
+    int ok = 1;
+    table->title = copyCacheCharacters(view, header->title, &ok);
+    if (!ok) return 0;
+  }
+
+  return 1;
+}
+
+int
+loadCachedKeyTable (KeyTable *table, const char *name) {
+  if (!getWritableDirectory()) return 0;
+
+  int loaded = 0;
+  uint64_t key = getTableKey(table, name);
+  char *path = makeCachePath(key);
+
+  if (path) {
+    CacheView view;
+
+    if (mapCache(path, &view)) {
+      const CacheHeader *header = verifyCache(&view, name, key);
+
+      if (header) {
+        // the table refers to the mapping from here on - whoever destroys
+        // it (even after a partial restore) releases the mapping too
+        table->cache.address = (void *)view.bytes;
+        table->cache.size = view.size;
+
+        if (restoreKeyTable(table, &view, header)) {
+          logMessage(LOG_DEBUG, "key table cache loaded: %s: %s", name, path);
+          rememberCacheSources(&view, header);
+          loaded = 1;
+        } else {
+          logMessage(LOG_WARNING, "key table cache not usable: %s", path);
+        }
+      } else {
+        logMessage(LOG_DEBUG, "key table cache out of date: %s", path);
+        munmap((void *)view.bytes, view.size);
+      }
+    }
+
+    free(path);
+  }
+
+  return loaded;
+}
+
+void
+releaseCachedKeyTable (KeyTable *table) {
+  if (table->cache.address) {
+    munmap(table->cache.address, table->cache.size);
+    table->cache.address = NULL;
+    table->cache.size = 0;
+  }
+}
+
+int
+isCachedKeyTableItem (const KeyTable *table, const void *item) {
+  const unsigned char *address = table->cache.address;
+  if (!address) return 0;
+
+  const unsigned char *byte = item;
+  return (byte >= address) && (byte < (address + table->cache.size));
+}
+
+typedef struct {
+  unsigned char *bytes;
+  size_t size;
+  size_t length;
+} CacheBuilder;
+
+static CacheOffset
+reserveCacheBytes (CacheBuilder *cb, size_t size) {
+  size_t offset = (cb->length + (KEY_TABLE_CACHE_ALIGNMENT - 1)) & ~(size_t)(KEY_TABLE_CACHE_ALIGNMENT - 1);
+  size_t length = offset + size;
+
+  if (length > UINT32_MAX) {
+    logMessage(LOG_WARNING, "key table cache too large");
+    return 0;
+  }
+
+  if (length > cb->size) {
+    size_t newSize = cb->size? cb->size: 0X1000;
+    while (newSize < length) newSize <<= 1;
+
+    unsigned char *newBytes = realloc(cb->bytes, newSize);
+
+    if (!newBytes) {
+      logMallocError();
+      return 0;
+    }
+
+    cb->bytes = newBytes;
+    cb->size = newSize;
+  }
+
+  memset(&cb->bytes[cb->length], 0, (length - cb->length));
+  cb->length = length;
+  return offset;
+}
+
+static void *
+getBuilderItem (CacheBuilder *cb, CacheOffset offset) {
+  return &cb->bytes[offset];
+}
+
+static CacheOffset
+addCacheData (CacheBuilder *cb, const void *data, size_t size) {
+  CacheOffset offset = reserveCacheBytes(cb, size);
+  if (offset) memcpy(getBuilderItem(cb, offset), data, size);
+  return offset;
+}
+
+static int
+addCacheString (CacheBuilder *cb, CacheOffset *offset, const char *string) {
+  return !!(*offset = addCacheData(cb, string, strlen(string)+1));
+}
+
+static int
+addCacheCharacters (CacheBuilder *cb, CacheOffset *offset, const wchar_t *characters) {
+  if (!characters) {
+    *offset = 0;
+    return 1;
+  }
+
+  return !!(*offset = addCacheData(cb, characters, ((wcslen(characters) + 1) * sizeof(*characters))));
+}
+
+#define CACHE_FIELD(type, offset, field) (((type *)getBuilderItem(cb, (offset)))->field)
+
+static int
+addCacheArray (CacheBuilder *cb, CacheOffset owner, size_t field, const void *items, unsigned int count, size_t size) {
+  CacheOffset table = 0;
+
+  if (count) {
+    if (!(table = addCacheData(cb, items, (count * size)))) return 0;
+  }
+
+  CacheArray *array = (CacheArray *)(cb->bytes + owner + field);
+  array->count = count;
+  array->table = table;
+  return 1;
+}
+
+static int
+addSources (CacheBuilder *cb) {
+  char **paths = getProcessedDataFiles();
+  if (!paths) return 0;
+
+  int ok = 0;
+  unsigned int count = 0;
+  while (paths[count]) count += 1;
+
+  CacheOffset sources = reserveCacheBytes(cb, (count * sizeof(CacheSource)));
+
+  if (sources) {
+    CACHE_FIELD(CacheHeader, 0, sources.count) = count;
+    CACHE_FIELD(CacheHeader, 0, sources.table) = sources;
+    ok = 1;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      const char *path = paths[index];
+      CacheOffset source = sources + (index * sizeof(CacheSource));
+      struct stat status;
+
+      if (stat(path, &status) == -1) {
+        logMessage(LOG_WARNING, "key table source not accessible: %s: %s", path, strerror(errno));
+        ok = 0;
+        break;
+      }
+
+      CacheOffset offset;
+      if (!(ok = addCacheString(cb, &offset, path))) break;
+
+      CACHE_FIELD(CacheSource, source, path) = offset;
+      CACHE_FIELD(CacheSource, source, device) = status.st_dev;
+      CACHE_FIELD(CacheSource, source, inode) = status.st_ino;
+      CACHE_FIELD(CacheSource, source, size) = status.st_size;
+      CACHE_FIELD(CacheSource, source, modified) = status.st_mtime;
+    }
+  }
+
+  deallocateStrings(paths);
+  return ok;
+}
+
+static int
+addContexts (CacheBuilder *cb, const KeyTable *table) {
+  unsigned int count = table->keyContexts.count;
+  CacheOffset contexts = reserveCacheBytes(cb, (count * sizeof(CacheContext)));
+  if (!contexts) return 0;
+
+  CACHE_FIELD(CacheHeader, 0, contexts.count) = count;
+  CACHE_FIELD(CacheHeader, 0, contexts.table) = contexts;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    const KeyContext *ctx = &table->keyContexts.table[index];
+    CacheOffset context = contexts + (index * sizeof(CacheContext));
+    CacheOffset offset;
+
+    if (!addCacheCharacters(cb, &offset, ctx->name)) return 0;
+    CACHE_FIELD(CacheContext, context, name) = offset;
+
+    if (!addCacheCharacters(cb, &offset, ctx->title)) return 0;
+    CACHE_FIELD(CacheContext, context, title) = offset;
+
+    {
+      uint32_t flags = 0;
+
+      if (ctx->isSpecial) flags |= CCF_SPECIAL;
+      if (ctx->isDefined) flags |= CCF_DEFINED;
+      if (ctx->isReferenced) flags |= CCF_REFERENCED;
+      if (ctx->isIsolated) flags |= CCF_ISOLATED;
+
+      CACHE_FIELD(CacheContext, context, flags) = flags;
+    }
+
+    CACHE_FIELD(CacheContext, context, superimpose) = ctx->mappedKeys.superimpose;
+    CACHE_FIELD(CacheContext, context, modifierCounts[0]) = ctx->keyBindings.modifierCounts[0];
+    CACHE_FIELD(CacheContext, context, modifierCounts[1]) = ctx->keyBindings.modifierCounts[1];
+    CACHE_FIELD(CacheContext, context, bindingKeys) = ctx->keyBindings.keys;
+    CACHE_FIELD(CacheContext, context, hotkeyKeys) = ctx->hotkeys.keys;
+
+#define ADD_ARRAY(field) \
+    if (!addCacheArray(cb, context, offsetof(CacheContext, field), \
+                       ctx->field.table, ctx->field.count, \
+                       sizeof(*ctx->field.table))) return 0;
+
+    ADD_ARRAY(keyBindings);
+    ADD_ARRAY(hotkeys);
+    ADD_ARRAY(mappedKeys);
+#undef ADD_ARRAY
+  }
+
+  return 1;
+}
+
+static int
+addNotes (CacheBuilder *cb, const KeyTable *table) {
+  unsigned int count = table->notes.count;
+  if (!count) return 1;
+
+  CacheOffset notes = reserveCacheBytes(cb, (count * sizeof(CacheOffset)));
+  if (!notes) return 0;
+
+  CACHE_FIELD(CacheHeader, 0, notes.count) = count;
+  CACHE_FIELD(CacheHeader, 0, notes.table) = notes;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    CacheOffset offset;
+    if (!addCacheCharacters(cb, &offset, table->notes.table[index])) return 0;
+    *(CacheOffset *)getBuilderItem(cb, (notes + (index * sizeof(offset)))) = offset;
+  }
+
+  return 1;
+}
+
+static int
+addMacros (CacheBuilder *cb, const KeyTable *table) {
+  unsigned int count = table->commandMacros.count;
+  if (!count) return 1;
+
+  CacheOffset macros = reserveCacheBytes(cb, (count * sizeof(CacheArray)));
+  if (!macros) return 0;
+
+  CACHE_FIELD(CacheHeader, 0, macros.count) = count;
+  CACHE_FIELD(CacheHeader, 0, macros.table) = macros;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    const CommandMacro *macro = &table->commandMacros.table[index];
+
+    if (!addCacheArray(cb, (macros + (index * sizeof(CacheArray))), 0,
+                       macro->commands, macro->count, sizeof(*macro->commands))) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+addHostCommands (CacheBuilder *cb, const KeyTable *table) {
+  unsigned int count = table->hostCommands.count;
+  if (!count) return 1;
+
+  CacheOffset commands = reserveCacheBytes(cb, (count * sizeof(CacheArray)));
+  if (!commands) return 0;
+
+  CACHE_FIELD(CacheHeader, 0, hostCommands.count) = count;
+  CACHE_FIELD(CacheHeader, 0, hostCommands.table) = commands;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    const HostCommand *hc = &table->hostCommands.table[index];
+    CacheOffset command = commands + (index * sizeof(CacheArray));
+    CacheOffset arguments = reserveCacheBytes(cb, (hc->count * sizeof(CacheOffset)));
+    if (!arguments) return 0;
+
+    CACHE_FIELD(CacheArray, command, count) = hc->count;
+    CACHE_FIELD(CacheArray, command, table) = arguments;
+
+    for (unsigned int argument=0; argument<hc->count; argument+=1) {
+      CacheOffset offset;
+      if (!addCacheString(cb, &offset, hc->arguments[argument])) return 0;
+      *(CacheOffset *)getBuilderItem(cb, (arguments + (argument * sizeof(offset)))) = offset;
+    }
+  }
+
+  return 1;
+}
+
+static int
+writeCache (const char *path, const CacheBuilder *cb) {
+  int written = 0;
+  char temporary[strlen(path) + 0X20];
+  snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)getpid());
+
+  int file = open(temporary, (O_WRONLY | O_CREAT | O_TRUNC), 0644);
+
+  if (file != -1) {
+    if (writeFileDescriptor(file, cb->bytes, cb->length) == cb->length) {
+      if (close(file) != -1) {
+        // other processes may still be using the previous cache - they keep
+        // their mapping of it since it's replaced rather than overwritten
+        if (rename(temporary, path) != -1) {
+          written = 1;
+        } else {
+          logSystemError("rename");
+        }
+      } else {
+        logSystemError("close");
+      }
+    } else {
+      logSystemError("write");
+      close(file);
+    }
+
+    if (!written) unlink(temporary);
+  } else {
+    logMessage(LOG_WARNING, "key table cache create error: %s: %s", temporary, strerror(errno));
+  }
+
+  return written;
+}
+
+static int
+buildCache (CacheBuilder *cb, const KeyTable *table, const char *name, uint64_t key) {
+  // the header is at offset zero so its reservation can't be tested via its offset
+  reserveCacheBytes(cb, sizeof(CacheHeader));
+  if (cb->length != sizeof(CacheHeader)) return 0;
+
+  {
+    CacheOffset offset;
+
+    if (!addCacheString(cb, &offset, name)) return 0;
+    CACHE_FIELD(CacheHeader, 0, path) = offset;
+
+    if (!addCacheCharacters(cb, &offset, table->title)) return 0;
+    CACHE_FIELD(CacheHeader, 0, title) = offset;
+  }
+
+  if (!addSources(cb)) return 0;
+  if (!addContexts(cb, table)) return 0;
+  if (!addNotes(cb, table)) return 0;
+  if (!addMacros(cb, table)) return 0;
+  if (!addHostCommands(cb, table)) return 0;
+
+  {
+    CacheHeader *header = getBuilderItem(cb, 0);
+
+    memcpy(header->magic, KEY_TABLE_CACHE_MAGIC, sizeof(header->magic));
+    header->version = KEY_TABLE_CACHE_VERSION;
+    header->build = getBuildHash();
+    header->key = key;
+    header->size = cb->length;
+  }
+
+  return 1;
+}
+
+int
+saveCachedKeyTable (const KeyTable *table, const char *name) {
+  if (!getWritableDirectory()) return 0;
+
+  int saved = 0;
+  uint64_t key = getTableKey(table, name);
+  char *path = makeCachePath(key);
+
+  if (path) {
+    CacheBuilder cb = {
+      .bytes = NULL,
+      .size = 0,
+      .length = 0
+    };
+
+    if (buildCache(&cb, table, name, key)) {
+      if (writeCache(path, &cb)) {
+        logMessage(LOG_DEBUG, "key table cache saved: %s: %s", name, path);
+        saved = 1;
+      }
+    }
+
+    if (cb.bytes) free(cb.bytes);
+    free(path);
+  }
+
+  return saved;
+}
+
+#else /* HAVE_SYS_MMAN_H */
+int
+loadCachedKeyTable (KeyTable *table, const char *name) {
+  return 0;
+}
+
+void
+releaseCachedKeyTable (KeyTable *table) {
+}
+
+int
+isCachedKeyTableItem (const KeyTable *table, const void *item) {
+  return 0;
+}
+
+int
+saveCachedKeyTable (const KeyTable *table, const char *name) {
+  return 0;
+}
+#endif /* HAVE_SYS_MMAN_H */
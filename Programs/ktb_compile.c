@@ -714,7 +714,8 @@ parseCommandOperand (DataFile *file, BoundCommand *cmd, const wchar_t *character
     }
   }
 
-  cmd->value = (cmd->entry = *command)->code;
+  setBoundCommandEntry(cmd, *command);
+  cmd->value = (*command)->code;
 
   while (end) {
     DataOperand modifier;
@@ -1344,7 +1345,7 @@ static DATA_OPERANDS_PROCESSOR(processMacroOperands) {
   {
     BoundCommand *cmd = &binding.primaryCommand;
     cmd->value = BRL_CMD_BLK(MACRO);
-    cmd->entry = findCommandEntry(cmd->value);
+    setBoundCommandEntry(cmd, findCommandEntry(cmd->value));
     cmd->value += table->commandMacros.count;
   }
 
@@ -1414,7 +1415,10 @@ static DATA_OPERANDS_PROCESSOR(processMapOperands) {
 
   if (getKeyOperand(file, &map.keyValue, ktd)) {
     if (map.keyValue.number != KTB_KEY_ANY) {
-      if (getKeyboardFunctionOperand(file, &map.keyboardFunction, ktd)) {
+      const KeyboardFunction *kbf;
+
+      if (getKeyboardFunctionOperand(file, &kbf, ktd)) {
+        map.keyboardFunction = kbf - keyboardFunctionTable;
         KeyContext *ctx = getCurrentKeyContext(ktd);
 
         if (ctx) {
@@ -1487,7 +1491,7 @@ static DATA_OPERANDS_PROCESSOR(processRunOperands) {
   {
     BoundCommand *cmd = &binding.primaryCommand;
     cmd->value = BRL_CMD_BLK(HOSTCMD);
-    cmd->entry = findCommandEntry(cmd->value);
+    setBoundCommandEntry(cmd, findCommandEntry(cmd->value));
     cmd->value += table->hostCommands.count;
   }
 
@@ -1660,7 +1664,7 @@ resetKeyTable (KeyTable *table) {
 static int
 addIncompleteBinding (KeyContext *ctx, const KeyValue *keys, unsigned char count) {
   static const BoundCommand command = {
-    .entry = NULL,
+    .entry = BOUND_COMMAND_NO_ENTRY,
     .value = EOF
   };
 
@@ -1750,11 +1754,53 @@ prepareKeyBindings (KeyContext *ctx) {
   return 1;
 }
 
+static void
+prepareKeyFilters (KeyContext *ctx) {
+  {
+    KeyFilter *filter = &ctx->keyBindings.keys;
+    BITMASK_ZERO(filter->bits);
+
+    uint16_t *counts = ctx->keyBindings.modifierCounts;
+    counts[0] = counts[1] = 0;
+
+    const KeyBinding *binding = ctx->keyBindings.table;
+    const KeyBinding *end = binding + ctx->keyBindings.count;
+
+    while (binding < end) {
+      const KeyCombination *combination = &binding->keyCombination;
+      int isImmediate = !!(combination->flags & KCF_IMMEDIATE_KEY);
+
+      counts[isImmediate] |= 1 << combination->modifierCount;
+      if (isImmediate) addKeyFilterValue(filter, &combination->immediateKey);
+
+      for (unsigned int index=0; index<combination->modifierCount; index+=1) {
+        addKeyFilterValue(filter, &combination->modifierKeys[index]);
+      }
+
+      binding += 1;
+    }
+  }
+
+  {
+    KeyFilter *filter = &ctx->hotkeys.keys;
+    BITMASK_ZERO(filter->bits);
+
+    const HotkeyEntry *hotkey = ctx->hotkeys.table;
+    const HotkeyEntry *end = hotkey + ctx->hotkeys.count;
+
+    while (hotkey < end) {
+      addKeyFilterValue(filter, &hotkey->keyValue);
+      hotkey += 1;
+    }
+  }
+}
+
 int
 finishKeyTable (KeyTableData *ktd) {
   for (unsigned int context=0; context<ktd->table->keyContexts.count; context+=1) {
     KeyContext *ctx = &ktd->table->keyContexts.table[context];
     if (!prepareKeyBindings(ctx)) return 0;
+    prepareKeyFilters(ctx);
   }
 
   qsort(ktd->table->keyNames.table, ktd->table->keyNames.count, sizeof(*ktd->table->keyNames.table), sortKeyValues);
@@ -1812,88 +1858,156 @@ defineInitialKeyContexts (KeyTableData *ktd) {
   return 1;
 }
 
-KeyTable *
-compileKeyTable (const char *name, KEY_NAME_TABLES_REFERENCE keys) {
-  KeyTable *table = NULL;
+static KeyTable *
+newKeyTable (void) {
+  KeyTable *table;
 
-  if (setTableDataVariables(KEY_TABLE_EXTENSION, KEY_SUBTABLE_EXTENSION)) {
-    KeyTableData ktd;
+  if ((table = malloc(sizeof(*table)))) {
+    table->title = NULL;
 
-    memset(&ktd, 0, sizeof(ktd));
-    ktd.file = name;
-    ktd.context = KTB_CTX_DEFAULT;
+    table->notes.table = NULL;
+    table->notes.size = 0;
+    table->notes.count = 0;
 
-    {
-      BoundCommand *cmd = &ktd.nullBoundCommand;
+    table->keyNames.table = NULL;
+    table->keyNames.count = 0;
 
-      cmd->entry = findCommandEntry(cmd->value = BRL_CMD_NOOP);
-    }
+    table->keyContexts.table = NULL;
+    table->keyContexts.count = 0;
+
+    table->pressedKeys.table = NULL;
+    table->pressedKeys.size = 0;
+    table->pressedKeys.count = 0;
+
+    table->longPress.alarm = NULL;
+
+    table->autorelease.alarm = NULL;
+    table->autorelease.time = 0;
+
+    table->commandMacros.table = NULL;
+    table->commandMacros.size = 0;
+    table->commandMacros.count = 0;
 
-    if ((ktd.table = malloc(sizeof(*ktd.table)))) {
-      ktd.table->title = NULL;
+    table->hostCommands.table = NULL;
+    table->hostCommands.size = 0;
+    table->hostCommands.count = 0;
 
-      ktd.table->notes.table = NULL;
-      ktd.table->notes.size = 0;
-      ktd.table->notes.count = 0;
+    table->options.logLabel = NULL;
+    table->options.logKeyEventsFlag = NULL;
+    table->options.keyboardEnabledFlag = NULL;
 
-      ktd.table->keyNames.table = NULL;
-      ktd.table->keyNames.count = 0;
+    memset(&table->statistics, 0, sizeof(table->statistics));
 
-      ktd.table->keyContexts.table = NULL;
-      ktd.table->keyContexts.count = 0;
+    table->cache.address = NULL;
+    table->cache.size = 0;
+  } else {
+    logMallocError();
+  }
 
-      ktd.table->pressedKeys.table = NULL;
-      ktd.table->pressedKeys.size = 0;
-      ktd.table->pressedKeys.count = 0;
+  return table;
+}
 
-      ktd.table->longPress.alarm = NULL;
+static KeyTable *
+restoreKeyTable (const char *name, KEY_NAME_TABLES_REFERENCE keys) {
+  KeyTableData ktd;
+
+  memset(&ktd, 0, sizeof(ktd));
+  ktd.file = name;
+
+  if ((ktd.table = newKeyTable())) {
+    if (allocateKeyNameTable(&ktd, keys)) {
+      if (loadCachedKeyTable(ktd.table, name)) {
+        KeyTable *table = ktd.table;
+
+        qsort(table->keyNames.table, table->keyNames.count, sizeof(*table->keyNames.table), sortKeyValues);
+        resetKeyTable(table);
+        return table;
+      }
+    }
 
-      ktd.table->autorelease.alarm = NULL;
-      ktd.table->autorelease.time = 0;
+    destroyKeyTable(ktd.table);
+  }
 
-      ktd.table->commandMacros.table = NULL;
-      ktd.table->commandMacros.size = 0;
-      ktd.table->commandMacros.count = 0;
+  return NULL;
+}
 
-      ktd.table->hostCommands.table = NULL;
-      ktd.table->hostCommands.size = 0;
-      ktd.table->hostCommands.count = 0;
+KeyTable *
+compileKeyTable (const char *name, KEY_NAME_TABLES_REFERENCE keys) {
+  KeyTable *table = NULL;
 
-      ktd.table->options.logLabel = NULL;
-      ktd.table->options.logKeyEventsFlag = NULL;
-      ktd.table->options.keyboardEnabledFlag = NULL;
+  lockDataFiles();
+  if (setTableDataVariables(KEY_TABLE_EXTENSION, KEY_SUBTABLE_EXTENSION)) {
+    if (!(table = restoreKeyTable(name, keys))) {
+      KeyTableData ktd;
 
-      if (defineInitialKeyContexts(&ktd)) {
-        if (allocateKeyNameTable(&ktd, keys)) {
-          if (allocateCommandTable(&ktd)) {
-            const DataFileParameters parameters = {
-              .processOperands = processKeyTableOperands,
-              .data = &ktd
-            };
+      memset(&ktd, 0, sizeof(ktd));
+      ktd.file = name;
+      ktd.context = KTB_CTX_DEFAULT;
 
-            if (processDataFile(name, &parameters)) {
-              if (finishKeyTable(&ktd)) {
-                table = ktd.table;
-                ktd.table = NULL;
+      {
+        BoundCommand *cmd = &ktd.nullBoundCommand;
+
+        setBoundCommandEntry(cmd, findCommandEntry(cmd->value = BRL_CMD_NOOP));
+      }
+
+      if ((ktd.table = newKeyTable())) {
+        if (defineInitialKeyContexts(&ktd)) {
+          if (allocateKeyNameTable(&ktd, keys)) {
+            if (allocateCommandTable(&ktd)) {
+              const DataFileParameters parameters = {
+                .processOperands = processKeyTableOperands,
+                .data = &ktd
+              };
+
+              if (processDataFile(name, &parameters)) {
+                if (finishKeyTable(&ktd)) {
+                  table = ktd.table;
+                  ktd.table = NULL;
+                }
               }
-            }
 
-            if (ktd.commandTable) free(ktd.commandTable);
+              if (ktd.commandTable) free(ktd.commandTable);
+            }
           }
         }
+
+        if (ktd.table) destroyKeyTable(ktd.table);
       }
 
-      if (ktd.table) destroyKeyTable(ktd.table);
-    } else {
-      logMallocError();
+      if (table) {
+        if (saveCachedKeyTable(table, name)) {
+          // use the cached copy so that its memory is shared with the other
+          // processes which load the same table
+          KeyTable *cached = restoreKeyTable(name, keys);
+
+          if (cached) {
+            destroyKeyTable(table);
+            table = cached;
+          }
+        }
+      }
     }
   }
 
+  unlockDataFiles();
   return table;
 }
 
 void
 destroyKeyTable (KeyTable *table) {
+  {
+    const KeyTableStatistics *statistics = &table->statistics;
+
+    if (statistics->keyEvents) {
+      logMessage(LOG_DEBUG,
+        "key table statistics: Events:%lu Hotkeys:%lu/%lu Bindings:%lu/%lu",
+        statistics->keyEvents,
+        statistics->hotkeySearches, statistics->hotkeyLookups,
+        statistics->bindingSearches, statistics->bindingLookups
+      );
+    }
+  }
+
   resetLongPressData(table);
   setKeyAutoreleaseTime(table, 0);
 
@@ -1905,9 +2019,9 @@ destroyKeyTable (KeyTable *table) {
     if (ctx->name) free(ctx->name);
     if (ctx->title) free(ctx->title);
 
-    if (ctx->keyBindings.table) free(ctx->keyBindings.table);
-    if (ctx->hotkeys.table) free(ctx->hotkeys.table);
-    if (ctx->mappedKeys.table) free(ctx->mappedKeys.table);
+    if (!isCachedKeyTableItem(table, ctx->keyBindings.table)) free(ctx->keyBindings.table);
+    if (!isCachedKeyTableItem(table, ctx->hotkeys.table)) free(ctx->hotkeys.table);
+    if (!isCachedKeyTableItem(table, ctx->mappedKeys.table)) free(ctx->mappedKeys.table);
   }
 
   if (table->commandMacros.table) {
@@ -1933,6 +2047,7 @@ destroyKeyTable (KeyTable *table) {
   if (table->notes.table) free(table->notes.table);
   if (table->title) free(table->title);
   if (table->pressedKeys.table) free(table->pressedKeys.table);
+  releaseCachedKeyTable(table);
   free(table);
 }
 
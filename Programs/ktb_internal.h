@@ -20,8 +20,9 @@
 #define BRLTTY_INCLUDED_KTB_INTERNAL
 
 #include "strfmth.h"
-#include "cmd_types.h"
+#include "cmd.h"
 #include "async_handle.h"
+#include "bitmask.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,11 +51,27 @@ typedef struct {
   KeyValue immediateKey;
 } KeyCombination;
 
+/* Key tables are shared between processes (see ktb_cache.c) so the
+ * structures which make them up hold indices rather than pointers.
+ */
+#define BOUND_COMMAND_NO_ENTRY UINT16_MAX
+
 typedef struct {
-  const CommandEntry *entry;
+  uint16_t entry; /* index into commandTable */
   int value;
 } BoundCommand;
 
+static inline const CommandEntry *
+getBoundCommandEntry (const BoundCommand *cmd) {
+  if (cmd->entry == BOUND_COMMAND_NO_ENTRY) return NULL;
+  return &commandTable[cmd->entry];
+}
+
+static inline void
+setBoundCommandEntry (BoundCommand *cmd, const CommandEntry *entry) {
+  cmd->entry = entry? (entry - commandTable): BOUND_COMMAND_NO_ENTRY;
+}
+
 typedef enum {
   KBF_HIDDEN    = 0X01,
   KBF_DUPLICATE = 0X80
@@ -86,10 +103,34 @@ typedef enum {
 
 typedef struct {
   KeyValue keyValue;
-  const KeyboardFunction *keyboardFunction;
+  unsigned char keyboardFunction; /* index into keyboardFunctionTable */
   unsigned char flags;
 } MappedKeyEntry;
 
+#define KEY_FILTER_SIZE 0X400
+
+typedef struct {
+  BITMASK(bits, KEY_FILTER_SIZE, int);
+} KeyFilter;
+
+static inline unsigned int
+getKeyFilterBit (KeyGroup group, KeyNumber number) {
+  uint32_t value = (group << 8) | number;
+  return ((value * UINT32_C(0X9E3779B1)) >> 22) % KEY_FILTER_SIZE;
+}
+
+static inline void
+addKeyFilterValue (KeyFilter *filter, const KeyValue *value) {
+  BITMASK_SET(filter->bits, getKeyFilterBit(value->group, value->number));
+}
+
+static inline int
+testKeyFilterValue (const KeyFilter *filter, const KeyValue *value) {
+  if (BITMASK_TEST(filter->bits, getKeyFilterBit(value->group, value->number))) return 1;
+  if (BITMASK_TEST(filter->bits, getKeyFilterBit(value->group, KTB_KEY_ANY))) return 1;
+  return 0;
+}
+
 typedef struct {
   wchar_t *name;
   wchar_t *title;
@@ -103,12 +144,17 @@ typedef struct {
     KeyBinding *table;
     unsigned int size;
     unsigned int count;
+
+    KeyFilter keys;
+    uint16_t modifierCounts[2];
   } keyBindings;
 
   struct {
     HotkeyEntry *table;
     unsigned int size;
     unsigned int count;
+
+    KeyFilter keys;
   } hotkeys;
 
   struct {
@@ -196,6 +242,13 @@ struct KeyTableStruct {
     const unsigned char *logKeyEventsFlag;
     const unsigned char *keyboardEnabledFlag;
   } options;
+
+  KeyTableStatistics statistics;
+
+  struct {
+    void *address;
+    size_t size;
+  } cache;
 };
 
 extern void copyKeyValues (KeyValue *target, const KeyValue *source, unsigned int count);
@@ -223,6 +276,11 @@ extern STR_DECLARE_FORMATTER(formatKeyCombination, KeyTable *table, const KeyCom
 
 extern void resetLongPressData (KeyTable *table);
 
+extern int loadCachedKeyTable (KeyTable *table, const char *name);
+extern int saveCachedKeyTable (const KeyTable *table, const char *name);
+extern void releaseCachedKeyTable (KeyTable *table);
+extern int isCachedKeyTableItem (const KeyTable *table, const void *item);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -329,7 +329,7 @@ listKeyboardFunctions (ListGenerationData *lgd, const KeyContext *ctx) {
       const MappedKeyEntry *map = &ctx->mappedKeys.table[index];
 
       if (!(map->flags & MKF_HIDDEN)) {
-        const KeyboardFunction *kbf = map->keyboardFunction;
+        const KeyboardFunction *kbf = &keyboardFunctionTable[map->keyboardFunction];
 
         if (!putKeyboardFunction(lgd, kbf)) return 0;
         if (!putKeyName(lgd, &map->keyValue)) return 0;
@@ -809,7 +809,7 @@ listCommandMacros (ListGenerationData *lgd) {
 
         while (command < endCommands) {
           if (!putCharacter(lgd, WC_C(' '))) return 0;
-          if (!putUtf8String(lgd, command->entry->name)) return 0;
+          if (!putUtf8String(lgd, getBoundCommandEntry(command)->name)) return 0;
           command += 1;
         }
       }
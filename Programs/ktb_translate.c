@@ -108,6 +108,19 @@ findKeyBinding (KeyTable *table, unsigned char context, const KeyValue *immediat
   if (!ctx) return NULL;
   if (!ctx->keyBindings.table) return NULL;
   if (table->pressedKeys.count > MAX_MODIFIERS_PER_COMBINATION) return NULL;
+  table->statistics.bindingLookups += 1;
+
+  // A binding can only match if it has the same number of modifiers and
+  // every pressed key (or its group's any-key) occurs in some binding.
+  // Most keys pass straight through, so skip the subset search for them.
+  if (!(ctx->keyBindings.modifierCounts[!!immediate] & (1 << table->pressedKeys.count))) return NULL;
+  if (immediate && !testKeyFilterValue(&ctx->keyBindings.keys, immediate)) return NULL;
+
+  for (unsigned int index=0; index<table->pressedKeys.count; index+=1) {
+    if (!testKeyFilterValue(&ctx->keyBindings.keys, &table->pressedKeys.table[index])) return NULL;
+  }
+
+  table->statistics.bindingSearches += 1;
 
   KeyBinding target = {
     .keyCombination.modifierCount = table->pressedKeys.count
@@ -174,6 +187,10 @@ findHotkeyEntry (KeyTable *table, unsigned char context, const KeyValue *keyValu
   if (!ctx) return NULL;
   if (!ctx->hotkeys.table) return NULL;
 
+  table->statistics.hotkeyLookups += 1;
+  if (!testKeyFilterValue(&ctx->hotkeys.keys, keyValue)) return NULL;
+  table->statistics.hotkeySearches += 1;
+
   HotkeyEntry target = {
     .keyValue = *keyValue
   };
@@ -214,7 +231,7 @@ makeKeyboardCommand (KeyTable *table, unsigned char context, int allowChords) {
       const MappedKeyEntry *map = findMappedKeyEntry(ctx, keyValue);
 
       if (!map) return EOF;
-      bits |= map->keyboardFunction->bit;
+      bits |= keyboardFunctionTable[map->keyboardFunction].bit;
     }
 
     {
@@ -586,6 +603,8 @@ processKeyEvent (
   int command = EOF;
   const HotkeyEntry *hotkey;
 
+  table->statistics.keyEvents += 1;
+
   if (press && !table->pressedKeys.count) {
     table->context.current = table->context.next;
     table->context.next = table->context.persistent;
@@ -686,10 +705,10 @@ processKeyEvent (
         table->release.command = BRL_CMD_NOOP;
 
         if (binding) {
-          addCommandArguments(table, &command, binding->primaryCommand.entry, binding);
+          addCommandArguments(table, &command, getBoundCommandEntry(&binding->primaryCommand), binding);
 
           secondaryCommand = binding->secondaryCommand.value;
-          addCommandArguments(table, &secondaryCommand, binding->secondaryCommand.entry, binding);
+          addCommandArguments(table, &secondaryCommand, getBoundCommandEntry(&binding->secondaryCommand), binding);
         }
 
         if (context == KTB_CTX_WAITING) {
@@ -760,6 +779,11 @@ setLogKeyEventsFlag (KeyTable *table, const unsigned char *flag) {
   table->options.logKeyEventsFlag = flag;
 }
 
+const KeyTableStatistics *
+getKeyTableStatistics (KeyTable *table) {
+  return &table->statistics;
+}
+
 void
 setKeyboardEnabledFlag (KeyTable *table, const unsigned char *flag) {
   table->options.keyboardEnabledFlag = flag;
@@ -942,6 +942,7 @@ makePreferencesMenu (void) {
       static const MenuString strings[] = {
         [BRL_TYPING_TEXT] = {.label=strtext("Translated via Text Table")},
         [BRL_TYPING_DOTS] = {.label=strtext("Dots via Unicode Braille")},
+        [BRL_TYPING_CONTRACTED] = {.label=strtext("Contracted via Contraction Table")},
       };
 
       NAME(strtext("Typing Mode"));
@@ -194,10 +194,11 @@ ASYNC_TASK_CALLBACK(presentMessage) {
         break;
       }
 
-      mgd.timeout = messageHoldTimeout - brl.writeDelay;
-      drainBrailleOutput(&brl, 0);
       if (!mgd.hold && lastSegment && (mgp->options & MSG_NODELAY)) break;
-      mgd.timeout = MAX(mgd.timeout, 0);
+
+      // The hold starts now rather than after the output has drained, so
+      // commands are handled while the message is still being written.
+      mgd.timeout = MAX(messageHoldTimeout, getBrailleOutputDelay(&brl)+1);
 
       while (1) {
         int timeout = mgd.timeout;
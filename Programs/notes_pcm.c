@@ -23,11 +23,35 @@
 
 #include "prefs.h"
 #include "log.h"
+#include "parameters.h"
 #include "pcm.h"
 #include "notes.h"
 
 char *opt_pcmDevice;
 
+// Rendered tones are kept (most recently used first) so that those which
+// are played again and again (alerts, morse marks) needn't be synthesized
+// each time.
+typedef struct PcmToneStruct PcmTone;
+
+struct PcmToneStruct {
+  PcmTone *next;
+
+  NoteFrequency frequency;
+  unsigned int duration;
+  unsigned char volume;
+
+  int sampleRate;
+  int channelCount;
+  PcmAmplitudeFormat amplitudeFormat;
+
+  size_t size;
+  unsigned char bytes[];
+};
+
+static PcmTone *pcmTones = NULL;
+static size_t pcmToneBytes = 0;
+
 struct NoteDeviceStruct {
   PcmDevice *pcm;
 
@@ -40,6 +64,7 @@ struct NoteDeviceStruct {
   int blockUsed;
 
   PcmSampleMaker makeSample;
+  PcmSampleSize frameSize;
 };
 
 static int
@@ -49,17 +74,22 @@ pcmFlushBytes (NoteDevice *device) {
   return ok;
 }
 
-static int
-pcmWriteSample (NoteDevice *device, int16_t amplitude) {
-  PcmSample *sample = (PcmSample *)&device->blockAddress[device->blockUsed];
+static void
+pcmMakeFrame (NoteDevice *device, unsigned char *frame, int16_t amplitude) {
+  PcmSample *sample = (PcmSample *)frame;
   PcmSampleSize size = device->makeSample(sample, amplitude);
-  device->blockUsed += size;
+  unsigned char *byte = frame + size;
 
   for (int channel=1; channel<device->channelCount; channel+=1) {
-    for (int byte=0; byte<size; byte+=1) {
-      device->blockAddress[device->blockUsed++] = sample->bytes[byte];
-    }
+    memcpy(byte, sample->bytes, size);
+    byte += size;
   }
+}
+
+static int
+pcmWriteSample (NoteDevice *device, int16_t amplitude) {
+  pcmMakeFrame(device, &device->blockAddress[device->blockUsed], amplitude);
+  device->blockUsed += device->frameSize;
 
   if (device->blockUsed == device->blockSize) {
     if (!pcmFlushBytes(device)) {
@@ -70,6 +100,26 @@ pcmWriteSample (NoteDevice *device, int16_t amplitude) {
   return 1;
 }
 
+static int
+pcmWriteBytes (NoteDevice *device, const unsigned char *bytes, size_t count) {
+  while (count) {
+    size_t amount = MIN(count, (device->blockSize - device->blockUsed));
+    memcpy(&device->blockAddress[device->blockUsed], bytes, amount);
+
+    device->blockUsed += amount;
+    bytes += amount;
+    count -= amount;
+
+    if (device->blockUsed == device->blockSize) {
+      if (!pcmFlushBytes(device)) {
+        return 0;
+      }
+    }
+  }
+
+  return 1;
+}
+
 static int
 pcmFlushBlock (NoteDevice *device) {
   while (device->blockUsed)
@@ -98,6 +148,7 @@ pcmConstruct (int errorLevel) {
       PcmSample sample;
       PcmSampleSize sampleSize = device->makeSample(&sample, 0);
       sampleSize *= device->channelCount;
+      device->frameSize = sampleSize;
 
       if (sampleSize && device->blockSize &&
           !(device->blockSize % sampleSize)) {
@@ -136,6 +187,192 @@ pcmDestruct (NoteDevice *device) {
   logMessage(LOG_DEBUG, "PCM disabled");
 }
 
+typedef struct {
+  int32_t sampleCount;
+  int32_t maximumAmplitude;
+  uint32_t stepsPerSample;
+  int32_t currentValue;
+} PcmToneGenerator;
+
+/* A triangle waveform sounds nice, is lightweight, and avoids
+ * relying too much on floating-point performance and/or on
+ * expensive math functions like sin(). Considerations like
+ * these are especially important on PDAs without any FPU.
+ */ 
+
+/* The two high-order bits specify which quarter wave a sample is for.
+ *   00 -> ascending from the negative peak to zero
+ *   01 -> ascending from zero to the positive peak
+ *   10 -> descending from the positive peak to zero
+ *   11 -> descending from zero to the negative peak
+ * The higher bit is 0 for the ascending segment and 1 for the
+ * descending segment. The lower bit is 0 when going from a peak to
+ * zero and 1 when going from zero to a peak.
+ */
+#define PCM_MAGNITUDE_WIDTH (32 - 2)
+
+/* The amplitude is 0 when the lower bit of the quarter wave indicator
+ * is 1 and the rest of the (magnitude) bits are all 0.
+ */
+#define PCM_ZERO_VALUE (UINT32_C(1) << PCM_MAGNITUDE_WIDTH)
+
+static void
+pcmStartTone (
+  PcmToneGenerator *generator, NoteDevice *device,
+  int32_t sampleCount, NoteFrequency frequency, unsigned char volume
+) {
+  /* We need to know the maximum amplitude based on the currently set
+   * volume percentage. This percentage then needs to be squared because
+   * we perceive loudness exponentially.
+   */
+  generator->maximumAmplitude = INT16_MAX * (volume * volume) / (100 * 100);
+
+  /* The calculations for triangle wave generation work out nicely and
+   * efficiently if we map a full period onto a 32-bit unsigned range.
+   */
+
+  /* We need to know how many steps to make from one sample to the next.
+   * stepsPerSample = stepsPerWave * wavesPerSecond / samplesPerSecond
+   *                = stepsPerWave * frequency / sampleRate
+   *                = stepsPerWave / sampleRate * frequency
+   */
+  generator->stepsPerSample = (NoteFrequency)UINT32_MAX 
+                            / (NoteFrequency)device->sampleRate
+                            * frequency;
+
+  /* The current value needs to be a signed value so that the >> operator
+   * will extend its sign bit. We start by initializing it to the value
+   * that corresponds to the start of the first logical quarter wave
+   * (the one that ascends from zero to the positive peak).
+   */
+  generator->currentValue = PCM_ZERO_VALUE;
+
+  /* Round the number of samples up to a whole number of periods:
+   * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
+   *
+   * With stepsPerWave being (1 << 32), we simply let the product
+   * overflow. The modulus corresponds to the remaining 32 low bits:
+   * partialSteps = (uint32_t)(sampleCount * stepsPerSample)
+   *
+   * missingSteps = stepsPerWave - partialSteps
+   *              = (uint32_t) -partialSteps
+
+   * extraSamples = missingSteps / stepsPerSample
+   */
+  sampleCount += (uint32_t)(sampleCount * -generator->stepsPerSample) / generator->stepsPerSample;
+  generator->sampleCount = sampleCount;
+}
+
+static int16_t
+pcmNextAmplitude (PcmToneGenerator *generator) {
+  /* Convert the current 32-bit unsigned linear value to a 31-bit
+   * triangular amplitude by inverting its low-order 31 bits if its
+   * high-order (sign) bit is set.
+   */
+  int32_t amplitude = generator->currentValue ^ (generator->currentValue >> 31);
+
+  /* Convert the 31-bit amplitude from unsigned to signed. */
+  amplitude -= PCM_ZERO_VALUE;
+
+  /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
+  amplitude >>= PCM_MAGNITUDE_WIDTH - 16;
+
+  /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
+   * the currently set volume (15-bit value):
+   * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
+   */
+  amplitude *= generator->maximumAmplitude;
+
+  /* Convert the signed amplitude from 32 bits to 16 bits. */
+  amplitude >>= 16;
+
+  generator->currentValue += generator->stepsPerSample;
+  generator->sampleCount -= 1;
+  return amplitude;
+}
+
+static const PcmTone *
+pcmGetTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency, unsigned char volume) {
+  PcmTone **previous = &pcmTones;
+
+  while (*previous) {
+    PcmTone *tone = *previous;
+
+    if ((tone->frequency == frequency) &&
+        (tone->duration == duration) &&
+        (tone->volume == volume) &&
+        (tone->sampleRate == device->sampleRate) &&
+        (tone->channelCount == device->channelCount) &&
+        (tone->amplitudeFormat == device->amplitudeFormat)) {
+      *previous = tone->next;
+      tone->next = pcmTones;
+      pcmTones = tone;
+      return tone;
+    }
+
+    previous = &tone->next;
+  }
+
+  return NULL;
+}
+
+static PcmTone *
+pcmNewTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency, unsigned char volume) {
+  PcmToneGenerator generator;
+  pcmStartTone(&generator, device, (device->sampleRate * duration / 1000), frequency, volume);
+
+  size_t size = generator.sampleCount * device->frameSize;
+  if (size > (PCM_TONE_CACHE_SIZE / 4)) return NULL;
+
+  PcmTone *tone;
+
+  if ((tone = malloc(sizeof(*tone) + size))) {
+    tone->frequency = frequency;
+    tone->duration = duration;
+    tone->volume = volume;
+
+    tone->sampleRate = device->sampleRate;
+    tone->channelCount = device->channelCount;
+    tone->amplitudeFormat = device->amplitudeFormat;
+
+    tone->size = size;
+    unsigned char *frame = tone->bytes;
+
+    while (generator.sampleCount > 0) {
+      pcmMakeFrame(device, frame, pcmNextAmplitude(&generator));
+      frame += device->frameSize;
+    }
+
+    while (pcmToneBytes + size > PCM_TONE_CACHE_SIZE) {
+      PcmTone **last = &pcmTones;
+      while ((*last)->next) last = &(*last)->next;
+
+      pcmToneBytes -= (*last)->size;
+      free(*last);
+      *last = NULL;
+    }
+
+    tone->next = pcmTones;
+    pcmTones = tone;
+    pcmToneBytes += size;
+  } else {
+    logMallocError();
+  }
+
+  return tone;
+}
+
+void
+releasePcmTones (void) {
+  while (pcmTones) {
+    PcmTone *tone = pcmTones;
+    pcmTones = tone->next;
+    free(tone);
+  }
+
+  pcmToneBytes = 0;
+}
+
 static int
 pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
   int32_t sampleCount = device->sampleRate * duration / 1000;
@@ -144,98 +381,20 @@ pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
              duration, sampleCount, frequency);
 
   if (frequency) {
-    /* A triangle waveform sounds nice, is lightweight, and avoids
-     * relying too much on floating-point performance and/or on
-     * expensive math functions like sin(). Considerations like
-     * these are especially important on PDAs without any FPU.
-     */ 
-
-    /* We need to know the maximum amplitude based on the currently set
-     * volume percentage. This percentage then needs to be squared because
-     * we perceive loudness exponentially.
-     */
-    const unsigned char fullVolume = 100;
-    const unsigned char currentVolume = MIN(fullVolume, prefs.pcmVolume);
-    const int32_t maximumAmplitude = INT16_MAX
-                                   * (currentVolume * currentVolume)
-                                   / (fullVolume * fullVolume);
-
-    /* The calculations for triangle wave generation work out nicely and
-     * efficiently if we map a full period onto a 32-bit unsigned range.
-     */
-
-    /* The two high-order bits specify which quarter wave a sample is for.
-     *   00 -> ascending from the negative peak to zero
-     *   01 -> ascending from zero to the positive peak
-     *   10 -> descending from the positive peak to zero
-     *   11 -> descending from zero to the negative peak
-     * The higher bit is 0 for the ascending segment and 1 for the
-     * descending segment. The lower bit is 0 when going from a peak to
-     * zero and 1 when going from zero to a peak.
-     */
-    const uint8_t magnitudeWidth = 32 - 2;
-
-    /* The amplitude is 0 when the lower bit of the quarter wave indicator
-     * is 1 and the rest of the (magnitude) bits are all 0.
-     */
-    const uint32_t zeroValue = UINT32_C(1) << magnitudeWidth;
-
-    /* We need to know how many steps to make from one sample to the next.
-     * stepsPerSample = stepsPerWave * wavesPerSecond / samplesPerSecond
-     *                = stepsPerWave * frequency / sampleRate
-     *                = stepsPerWave / sampleRate * frequency
-     */
-    const uint32_t stepsPerSample = (NoteFrequency)UINT32_MAX 
-                                  / (NoteFrequency)device->sampleRate
-                                  * frequency;
-
-    /* The current value needs to be a signed value so that the >> operator
-     * will extend its sign bit. We start by initializing it to the value
-     * that corresponds to the start of the first logical quarter wave
-     * (the one that ascends from zero to the positive peak).
-     */
-    int32_t currentValue = zeroValue;
-
-    /* Round the number of samples up to a whole number of periods:
-     * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
-     *
-     * With stepsPerWave being (1 << 32), we simply let the product
-     * overflow. The modulus corresponds to the remaining 32 low bits:
-     * partialSteps = (uint32_t)(sampleCount * stepsPerSample)
-     *
-     * missingSteps = stepsPerWave - partialSteps
-     *              = (uint32_t) -partialSteps
-
-     * extraSamples = missingSteps / stepsPerSample
-     */
-    sampleCount += (uint32_t)(sampleCount * -stepsPerSample) / stepsPerSample;
-
-    while (sampleCount > 0) {
-      /* Convert the current 32-bit unsigned linear value to a 31-bit
-       * triangular amplitude by inverting its low-order 31 bits if its
-       * high-order (sign) bit is set.
-       */
-      int32_t amplitude = currentValue ^ (currentValue >> 31);
-
-      /* Convert the 31-bit amplitude from unsigned to signed. */
-      amplitude -= zeroValue;
+    const unsigned char volume = MIN(100, prefs.pcmVolume);
+    const PcmTone *tone = pcmGetTone(device, duration, frequency, volume);
+    if (!tone) tone = pcmNewTone(device, duration, frequency, volume);
+    if (tone) return pcmWriteBytes(device, tone->bytes, tone->size);
 
-      /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
-      amplitude >>= magnitudeWidth - 16;
+    /* not kept (too long) - synthesize it as it's written */
+    PcmToneGenerator generator;
+    pcmStartTone(&generator, device, sampleCount, frequency, volume);
 
-      /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
-       * the currently set volume (15-bit value):
-       * (16-bit value) * (15-bit value) + (sign bit) = 32-bit signed value
-       */
-      amplitude *= maximumAmplitude;
-
-      /* Convert the signed amplitude from 32 bits to 16 bits. */
-      amplitude >>= 16;
-
-      if (!pcmWriteSample(device, amplitude)) break;
-      currentValue += stepsPerSample;
-      sampleCount -= 1;
+    while (generator.sampleCount > 0) {
+      if (!pcmWriteSample(device, pcmNextAmplitude(&generator))) return 0;
     }
+
+    return 1;
   } else {
     /* generate silence */
     while (sampleCount > 0) {
@@ -60,6 +60,7 @@ extern "C" {
 
 #define TUNE_DEVICE_CLOSE_DELAY 2000
 #define TUNE_TOGGLE_REPEAT_DELAY 100
+#define PCM_TONE_CACHE_SIZE 0X80000
 
 #define MESSAGE_HOLD_TIMEOUT 4000
 
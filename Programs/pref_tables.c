@@ -106,6 +106,7 @@ PREFERENCE_STRING_TABLE(touchSensitivity,
 PREFERENCE_STRING_TABLE(brailleTypingMode,
   [BRL_TYPING_TEXT] = "text",
   [BRL_TYPING_DOTS] = "dots",
+  [BRL_TYPING_CONTRACTED] = "contracted",
 )
 
 PREFERENCE_STRING_TABLE(tuneDevice,
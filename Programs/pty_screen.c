@@ -308,8 +308,25 @@ ptyEndScreen (void) {
   destroySegment();
 }
 
+void
+ptyBeginScreenUpdate (void) {
+  if (!(segmentHeader->updateGeneration & 1)) {
+    segmentHeader->updateGeneration += 1;
+    __sync_synchronize();
+  }
+}
+
+static void
+endScreenUpdate (void) {
+  if (segmentHeader->updateGeneration & 1) {
+    __sync_synchronize();
+    segmentHeader->updateGeneration += 1;
+  }
+}
+
 void
 ptyRefreshScreen (void) {
+  endScreenUpdate();
   sendTerminalMessage(TERM_MSG_SEGMENT_UPDATED, NULL, 0);
   refresh();
 }
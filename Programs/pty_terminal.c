@@ -829,6 +829,8 @@ ptyProcessTerminalOutput (const unsigned char *bytes, size_t count) {
   const unsigned char *byte = bytes;
   const unsigned char *end = byte + count;
 
+  ptyBeginScreenUpdate();
+
   while (byte < end) {
     wantRefresh = parseOutputByte(*byte++);
   }
@@ -32,6 +32,7 @@ typedef enum {
   REPORT_BRAILLE_WINDOW_UPDATED,
   REPORT_BRAILLE_KEY_EVENT,
   REPORT_API_PARAMETER_UPDATED,
+  REPORT_SCREEN_CURSOR_ROUTING,
 } ReportIdentifier;
 
 extern void report (ReportIdentifier identiier, const void *data);
@@ -25,6 +25,7 @@
 #include "rgx_internal.h"
 #include "utf8.h"
 #include "queue.h"
+#include "scratch.h"
 #include "strfmt.h"
 
 #define RGX_UTF8_TO_CHARACTERS \
@@ -210,14 +211,12 @@ rgxTestMatcher (const void *item, void *data) {
   return handler(match);
 }
 
-RGX_Matcher *
-rgxMatchTextCharacters (
-  RGX_Object *rgx,
+static RGX_Matcher *
+rgxFindMatcher (
+  RGX_Object *rgx, RGX_CharacterType *internal,
   const wchar_t *characters, size_t length,
   RGX_Match **result, void *data
 ) {
-  RGX_CHARACTERS_TO_INTERNAL;
-
   RGX_Match match = {
     .text = {
       .internal = internal,
@@ -262,6 +261,33 @@ rgxMatchTextCharacters (
   return getElementItem(element);
 }
 
+RGX_Matcher *
+rgxMatchTextCharacters (
+  RGX_Object *rgx,
+  const wchar_t *characters, size_t length,
+  RGX_Match **result, void *data
+) {
+  RGX_Matcher *matcher = NULL;
+
+  ScratchMark scratchMark;
+  getScratchMark(&scratchMark);
+
+  RGX_CharacterType *internal;
+
+  if (allocateScratchArray(internal, length + 1)) {
+    internal[length] = 0;
+
+    for (unsigned int index=0; index<length; index+=1) {
+      internal[index] = characters[index];
+    }
+
+    matcher = rgxFindMatcher(rgx, internal, characters, length, result, data);
+  }
+
+  releaseScratch(&scratchMark);
+  return matcher;
+}
+
 RGX_Matcher *
 rgxMatchTextString (
   RGX_Object *rgx,
@@ -100,8 +100,25 @@ describeScreen (ScreenDescription *description) {
   if (description->unreadable) description->quality = SCQ_NONE;
 }
 
+static void
+verifyScreenText (wchar_t *text, const ScreenBox *box, size_t index) {
+  if ((*text <= 0) || (*text > UNICODE_LAST_CHARACTER)) {
+    // This is not a valid Unicode character - return the replacement character.
+
+    unsigned int column = box->left + (index % box->width);
+    unsigned int row = box->top + (index / box->width);
+
+    logMessage(LOG_ERR,
+      "invalid character U+%04lX on screen at [%u,%u]",
+      (unsigned long)*text, column, row
+    );
+
+    *text = UNICODE_REPLACEMENT_CHARACTER;
+  }
+}
+
 int
-readScreen (short left, short top, short width, short height, ScreenCharacter *buffer) {
+readScreen (int left, int top, int width, int height, ScreenCharacter *buffer) {
   const ScreenBox box = {
     .left = left,
     .top = top,
@@ -110,45 +127,43 @@ readScreen (short left, short top, short width, short height, ScreenCharacter *b
   };
 
   if (!currentScreen->readCharacters(&box, buffer)) return 0;
+  size_t count = box.width * box.height;
 
-  ScreenCharacter *character = buffer;
-  const ScreenCharacter *end = character + (box.width * box.height);
-
-  while (character < end) {
-    wchar_t *text = &character->text;
-
-    if ((*text <= 0) || (*text > UNICODE_LAST_CHARACTER)) {
-      // This is not a valid Unicode character - return the replacement character.
+  for (size_t index=0; index<count; index+=1) {
+    verifyScreenText(&buffer[index].text, &box, index);
+  }
 
-      size_t index = character - buffer;
-      unsigned int column = box.left + (index % box.width);
-      unsigned int row = box.top + (index / box.width);
+  return 1;
+}
 
-      logMessage(LOG_ERR,
-        "invalid character U+%04lX on screen at [%u,%u]",
-        (unsigned long)*text, column, row
-      );
+int
+readScreenText (int left, int top, int width, int height, wchar_t *buffer) {
+  const ScreenBox box = {
+    .left = left,
+    .top = top,
+    .width = width,
+    .height = height,
+  };
 
-      *text = UNICODE_REPLACEMENT_CHARACTER;
-    }
+  if (!currentScreen->readText(&box, buffer)) return 0;
+  size_t count = box.width * box.height;
 
-    character += 1;
+  for (size_t index=0; index<count; index+=1) {
+    verifyScreenText(&buffer[index], &box, index);
   }
 
   return 1;
 }
 
 int
-readScreenText (short left, short top, short width, short height, wchar_t *buffer) {
-  unsigned int count = width * height;
-  ScreenCharacter characters[count];
-  if (!readScreen(left, top, width, height, characters)) return 0;
+getScreenRowLength (int row, int columns) {
+  int length;
 
-  for (int i=0; i<count; i+=1) {
-    buffer[i] = characters[i].text;
+  if (currentScreen->getRowLength(row, &length)) {
+    if (length < columns) return length;
   }
 
-  return 1;
+  return columns;
 }
 
 int
@@ -157,6 +172,12 @@ insertScreenKey (ScreenKey key) {
   return currentScreen->insertKey(key);
 }
 
+int
+insertScreenCharacters (const wchar_t *characters, size_t count) {
+  logMessage(LOG_CATEGORY(SCREEN_DRIVER), "insert characters: %"PRIsize, count);
+  return currentScreen->insertCharacters(characters, count);
+}
+
 int
 routeScreenCursor (int column, int row, int screen) {
   return currentScreen->routeCursor(column, row, screen);
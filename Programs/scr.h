@@ -33,9 +33,11 @@ extern int isMainScreen (void);
 extern int pollScreen (void);
 extern int refreshScreen (void);
 extern void describeScreen (ScreenDescription *);		/* get screen status */
-extern int readScreen (short left, short top, short width, short height, ScreenCharacter *buffer);
-extern int readScreenText (short left, short top, short width, short height, wchar_t *buffer);
+extern int readScreen (int left, int top, int width, int height, ScreenCharacter *buffer);
+extern int readScreenText (int left, int top, int width, int height, wchar_t *buffer);
+extern int getScreenRowLength (int row, int columns);
 extern int insertScreenKey (ScreenKey key);
+extern int insertScreenCharacters (const wchar_t *characters, size_t count);
 extern int routeScreenCursor (int column, int row, int screen);
 extern int highlightScreenRegion (int left, int right, int top, int bottom);
 extern int unhighlightScreenRegion (void);
@@ -166,11 +166,40 @@ readCharacters_BaseScreen (const ScreenBox *box, ScreenCharacter *buffer) {
   return 1;
 }
 
+static int
+readText_BaseScreen (const ScreenBox *box, wchar_t *buffer) {
+  unsigned int count = box->width * box->height;
+  ScreenCharacter characters[count];
+  if (!currentScreen->readCharacters(box, characters)) return 0;
+
+  for (unsigned int index=0; index<count; index+=1) {
+    buffer[index] = characters[index].text;
+  }
+
+  return 1;
+}
+
+static int
+getRowLength_BaseScreen (int row, int *length) {
+  return 0;
+}
+
 static int
 insertKey_BaseScreen (ScreenKey key) {
   return 0;
 }
 
+static int
+insertCharacters_BaseScreen (const wchar_t *characters, size_t count) {
+  const wchar_t *end = characters + count;
+
+  while (characters < end) {
+    if (!currentScreen->insertKey(*characters++)) return 0;
+  }
+
+  return 1;
+}
+
 static int
 routeCursor_BaseScreen (int column, int row, int screen) {
   return 0;
@@ -222,7 +251,10 @@ initializeBaseScreen (BaseScreen *base) {
   base->describe = describe_BaseScreen;
 
   base->readCharacters = readCharacters_BaseScreen;
+  base->readText = readText_BaseScreen;
+  base->getRowLength = getRowLength_BaseScreen;
   base->insertKey = insertKey_BaseScreen;
+  base->insertCharacters = insertCharacters_BaseScreen;
   base->routeCursor = routeCursor_BaseScreen;
 
   base->highlightRegion = highlightRegion_BaseScreen;
@@ -212,6 +212,7 @@ createScreenSegment (int *identifier, key_t key, int columns, int rows, int enab
       segment->screenNumber = 0;
       segment->commonFlags = 0;
       segment->privateFlags = 0;
+      segment->updateGeneration = 0;
 
       if (rowsSize) {
         segment->rowSize = sizeof(ScreenSegmentRow);
@@ -0,0 +1,240 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "scratch.h"
+#include "thread.h"
+
+#define SCRATCH_MINIMUM_BLOCK_SIZE 0X4000
+
+typedef union {
+  long double longDouble;
+  long long longLong;
+  void *pointer;
+  void (*function) (void);
+} ScratchAlignment;
+
+struct ScratchBlockStruct {
+  ScratchBlock *previous;
+  size_t size;
+  ScratchAlignment data[];
+};
+
+typedef struct {
+  ScratchBlock *block;
+  size_t used;
+
+  size_t inUse;
+  size_t peak;
+  ScratchStatistics statistics;
+} ScratchArena;
+
+static ScratchBlock *
+newScratchBlock (ScratchArena *arena, size_t size) {
+  ScratchBlock *block;
+
+  if ((block = malloc(sizeof(*block) + size))) {
+    block->previous = NULL;
+    block->size = size;
+
+    arena->statistics.capacity += size;
+    arena->statistics.blockAllocations += 1;
+    return block;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static void
+freeScratchBlock (ScratchArena *arena, ScratchBlock *block) {
+  arena->statistics.capacity -= block->size;
+  free(block);
+}
+
+static void
+removeScratchBlock (ScratchArena *arena) {
+  ScratchBlock *block = arena->block;
+
+  arena->block = block->previous;
+  freeScratchBlock(arena, block);
+}
+
+static void
+consolidateScratchArena (ScratchArena *arena) {
+  ScratchBlock *block = arena->block;
+
+  if (block && (arena->peak > block->size)) {
+    // Everything has been released, and the last cycle needed more than one
+    // block, so replace the base block with one large enough for that much.
+    // This makes later cycles of the same size run without calling malloc.
+    ScratchBlock *newBlock = newScratchBlock(arena, arena->peak);
+
+    if (newBlock) {
+      removeScratchBlock(arena);
+      arena->block = newBlock;
+
+      logMessage(LOG_DEBUG,
+        "scratch arena enlarged: %"PRIsize " bytes", newBlock->size
+      );
+    }
+  }
+
+  arena->peak = 0;
+}
+
+static THREAD_SPECIFIC_DATA_NEW(tsdScratch) {
+  ScratchArena *arena;
+
+  if ((arena = malloc(sizeof(*arena)))) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block = NULL;
+    return arena;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+#ifdef THREAD_LOCAL
+static THREAD_LOCAL ScratchArena *currentScratchArena = NULL;
+#endif /* THREAD_LOCAL */
+
+static THREAD_SPECIFIC_DATA_DESTROY(tsdScratch) {
+  ScratchArena *arena = data;
+
+  if (arena) {
+    while (arena->block) removeScratchBlock(arena);
+    free(arena);
+  }
+
+#ifdef THREAD_LOCAL
+  currentScratchArena = NULL;
+#endif /* THREAD_LOCAL */
+}
+
+THREAD_SPECIFIC_DATA_CONTROL(tsdScratch);
+
+static ScratchArena *
+getScratchArena (void) {
+#ifdef THREAD_LOCAL
+  if (!currentScratchArena) {
+    currentScratchArena = getThreadSpecificData(&tsdScratch);
+  }
+
+  return currentScratchArena;
+#else /* THREAD_LOCAL */
+  return getThreadSpecificData(&tsdScratch);
+#endif /* THREAD_LOCAL */
+}
+
+void *
+allocateScratch (size_t size) {
+  ScratchArena *arena = getScratchArena();
+  if (!arena) return NULL;
+
+  {
+    const size_t alignment = sizeof(ScratchAlignment);
+    if (!size) size = 1;
+    size = ((size + alignment - 1) / alignment) * alignment;
+  }
+
+  ScratchBlock *block = arena->block;
+
+  if (!block || (size > (block->size - arena->used))) {
+    size_t blockSize = block? (block->size * 2): SCRATCH_MINIMUM_BLOCK_SIZE;
+    if (blockSize < size) blockSize = size;
+
+    ScratchBlock *newBlock = newScratchBlock(arena, blockSize);
+    if (!newBlock) return NULL;
+
+    newBlock->previous = block;
+    arena->block = block = newBlock;
+    arena->used = 0;
+  }
+
+  void *address = (unsigned char *)block->data + arena->used;
+  arena->used += size;
+  arena->inUse += size;
+  arena->statistics.allocations += 1;
+
+  if (arena->inUse > arena->peak) arena->peak = arena->inUse;
+  if (arena->inUse > arena->statistics.highWater) arena->statistics.highWater = arena->inUse;
+
+  return address;
+}
+
+void
+getScratchMark (ScratchMark *mark) {
+  ScratchArena *arena = getScratchArena();
+
+  if (arena) {
+    mark->block = arena->block;
+    mark->used = arena->used;
+    mark->inUse = arena->inUse;
+  } else {
+    mark->block = NULL;
+    mark->used = 0;
+    mark->inUse = 0;
+  }
+}
+
+void
+releaseScratch (const ScratchMark *mark) {
+  ScratchArena *arena = getScratchArena();
+  if (!arena) return;
+  if (!arena->block) return;
+
+  if (mark->inUse) {
+    const ScratchBlock *block = arena->block;
+    while (block && (block != mark->block)) block = block->previous;
+
+    if (!block) {
+      logMessage(LOG_ERR, "scratch mark not within arena");
+      return;
+    }
+
+    while (arena->block != mark->block) removeScratchBlock(arena);
+  } else {
+    // Nothing was in use when the mark was taken. Its block may since have
+    // been replaced by consolidation, so just keep the base block.
+    while (arena->block->previous) removeScratchBlock(arena);
+  }
+
+  arena->used = mark->used;
+  arena->inUse = mark->inUse;
+  if (!arena->inUse) consolidateScratchArena(arena);
+}
+
+void
+getScratchStatistics (ScratchStatistics *statistics) {
+  ScratchArena *arena = getScratchArena();
+
+  if (arena) {
+    *statistics = arena->statistics;
+    statistics->inUse = arena->inUse;
+  } else {
+    memset(statistics, 0, sizeof(*statistics));
+  }
+}
@@ -28,8 +28,8 @@ extern "C" {
  */
 
 typedef struct {
-  short column;
-  short row;
+  int column;
+  int row;
 } ScreenLocation;
 
 typedef struct {
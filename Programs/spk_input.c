@@ -19,11 +19,14 @@
 #include "prologue.h"
 
 #include <string.h>
+#include <stdlib.h>
 
 #include "log.h"
 #include "spk_input.h"
 #include "spk.h"
 #include "pipe.h"
+#include "async_handle.h"
+#include "async_alarm.h"
 #include "tune.h"
 #include "tune_builder.h"
 #include "ascii.h"
@@ -32,14 +35,166 @@
 #include "core.h"
 
 #ifdef ENABLE_SPEECH_SUPPORT
+#define SPEECH_INPUT_DISPATCH_DELAY 10
+#define SPEECH_INPUT_FRAGMENT_TIMEOUT 250
+#define SPEECH_INPUT_FRAGMENT_LIMIT 0X4000
+#define SPEECH_INPUT_QUEUE_LIMIT 0X40
+#define SPEECH_INPUT_TUNE_CACHE_SIZE 16
+
+typedef struct {
+  unsigned char *bytes;
+  size_t length;
+
+  unsigned long sequence;
+  unsigned char priority;
+  unsigned char key;
+  unsigned char hasKey:1;
+} SpeechInputMessage;
+
+typedef struct {
+  char *source;
+  ToneElement *tune;
+  size_t size;
+  unsigned long lastUsed;
+} SpeechInputTune;
+
 struct SpeechInputObjectStruct {
   NamedPipeObject *pipe;
+
+  struct {
+    unsigned char *buffer;
+    size_t size;
+    size_t length;
+    AsyncHandle alarm;
+    unsigned char discarding:1;
+  } fragment;
+
+  struct {
+    SpeechInputMessage *array;
+    size_t size;
+    size_t count;
+    unsigned long sequence;
+    AsyncHandle alarm;
+  } queue;
+
+  struct {
+    SpeechInputTune entries[SPEECH_INPUT_TUNE_CACHE_SIZE];
+    unsigned int count;
+    unsigned long usage;
+  } tunes;
 };
 
-static
-NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
-  const unsigned char *buffer = parameters->buffer;
-  size_t bufferSize = parameters->length;
+static ToneElement *
+copyTune (const SpeechInputTune *entry) {
+  ToneElement *tune;
+
+  if ((tune = malloc(entry->size))) {
+    memcpy(tune, entry->tune, entry->size);
+  } else {
+    logMallocError();
+  }
+
+  return tune;
+}
+
+static void
+forgetTune (SpeechInputTune *entry) {
+  free(entry->source);
+  free(entry->tune);
+  memset(entry, 0, sizeof(*entry));
+}
+
+static SpeechInputTune *
+findTune (SpeechInputObject *obj, const char *source) {
+  for (unsigned int index=0; index<obj->tunes.count; index+=1) {
+    SpeechInputTune *entry = &obj->tunes.entries[index];
+
+    if (strcmp(entry->source, source) == 0) {
+      entry->lastUsed = ++obj->tunes.usage;
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static SpeechInputTune *
+getTuneEntry (SpeechInputObject *obj) {
+  if (obj->tunes.count < SPEECH_INPUT_TUNE_CACHE_SIZE) {
+    return &obj->tunes.entries[obj->tunes.count++];
+  }
+
+  SpeechInputTune *oldest = &obj->tunes.entries[0];
+
+  for (unsigned int index=1; index<obj->tunes.count; index+=1) {
+    SpeechInputTune *entry = &obj->tunes.entries[index];
+    if (entry->lastUsed < oldest->lastUsed) oldest = entry;
+  }
+
+  forgetTune(oldest);
+  return oldest;
+}
+
+static SpeechInputTune *
+compileTune (SpeechInputObject *obj, const char *source) {
+  SpeechInputTune *entry = NULL;
+  TuneBuilder *tb = newTuneBuilder();
+
+  if (tb) {
+    setTuneSourceName(tb, "speech-input");
+    setTuneSourceIndex(tb, 0);
+
+    if (parseTuneString(tb, "p100")) {
+      if (parseTuneString(tb, source)) {
+        ToneElement *tune = getTune(tb);
+
+        if (tune) {
+          char *string = strdup(source);
+
+          if (string) {
+            size_t count = 1;
+            while (tune[count-1].duration) count += 1;
+
+            entry = getTuneEntry(obj);
+            entry->source = string;
+            entry->tune = tune;
+            entry->size = count * sizeof(*tune);
+            entry->lastUsed = ++obj->tunes.usage;
+          } else {
+            logMallocError();
+            free(tune);
+          }
+        }
+      }
+    }
+
+    destroyTuneBuilder(tb);
+  }
+
+  return entry;
+}
+
+static void
+playTune (SpeechInputObject *obj, const char *source) {
+  SpeechInputTune *entry = findTune(obj, source);
+  if (!entry) entry = compileTune(obj, source);
+
+  if (entry) {
+    // the tune thread may still be playing it after it's been evicted
+    ToneElement *tune = copyTune(entry);
+    if (tune) tunePlayTones(tune, TPO_FREE);
+  }
+}
+
+static void
+forgetTunes (SpeechInputObject *obj) {
+  while (obj->tunes.count > 0) {
+    forgetTune(&obj->tunes.entries[--obj->tunes.count]);
+  }
+}
+
+static void
+processSpeechInputMessage (SpeechInputObject *obj, const unsigned char *buffer, size_t bufferSize) {
   const unsigned char *end = buffer + bufferSize;
 
   SayOptions options = 0;
@@ -68,10 +223,20 @@ NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
          if (!prefs.autospeakInsertedCharacters) dontSpeak = 1;
          break;
 
+       case 'k':
+         // handled when the message was queued
+         if (buffer < end) buffer += 1;
+         break;
+
        case 'l':
          if (!prefs.autospeakSelectedLine) dontSpeak = 1;
          break;
 
+       case 'p':
+         // handled when the message was queued
+         if (buffer < end) buffer += 1;
+         break;
+
        case 'r':
          if (!prefs.autospeakReplacedCharacters) dontSpeak = 1;
          break;
@@ -103,21 +268,7 @@ NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
     text[textLength] = 0;
 
     if (asTune) {
-      TuneBuilder *tb = newTuneBuilder();
-
-      if (tb) {
-        setTuneSourceName(tb, "speech-input");
-        setTuneSourceIndex(tb, 0);
-
-        if (parseTuneString(tb, "p100")) {
-          if (parseTuneString(tb, text)) {
-            ToneElement *tune = getTune(tb);
-            if (tune) tunePlayTones(tune, TPO_FREE);
-          }
-        }
-
-        destroyTuneBuilder(tb);
-      }
+      playTune(obj, text);
     } else if (!dontSpeak) {
       size_t attributesCount = countUtf8Characters(text);
       unsigned char attributes[attributesCount + 1];
@@ -129,8 +280,260 @@ NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
       );
     }
   }
+}
+
+static int
+compareSpeechInputMessages (const void *element1, const void *element2) {
+  const SpeechInputMessage *message1 = element1;
+  const SpeechInputMessage *message2 = element2;
+
+  if (message1->priority > message2->priority) return -1;
+  if (message1->priority < message2->priority) return 1;
+
+  if (message1->sequence < message2->sequence) return -1;
+  if (message1->sequence > message2->sequence) return 1;
+  return 0;
+}
+
+static void
+dispatchSpeechInputMessages (SpeechInputObject *obj) {
+  SpeechInputMessage *messages = obj->queue.array;
+  size_t count = obj->queue.count;
+
+  obj->queue.array = NULL;
+  obj->queue.size = 0;
+  obj->queue.count = 0;
+
+  qsort(messages, count, sizeof(*messages), compareSpeechInputMessages);
+
+  for (size_t index=0; index<count; index+=1) {
+    SpeechInputMessage *message = &messages[index];
+    processSpeechInputMessage(obj, message->bytes, message->length);
+    free(message->bytes);
+  }
+
+  if (messages) free(messages);
+}
+
+ASYNC_ALARM_CALLBACK(handleSpeechInputDispatch) {
+  SpeechInputObject *obj = parameters->data;
+
+  asyncDiscardHandle(obj->queue.alarm);
+  obj->queue.alarm = NULL;
+
+  dispatchSpeechInputMessages(obj);
+}
+
+static void
+scheduleSpeechInputDispatch (SpeechInputObject *obj) {
+  if (!obj->queue.alarm) {
+    if (!asyncNewRelativeAlarm(&obj->queue.alarm, SPEECH_INPUT_DISPATCH_DELAY,
+                               handleSpeechInputDispatch, obj)) {
+      dispatchSpeechInputMessages(obj);
+    }
+  }
+}
+
+static void
+getSpeechInputProperties (
+  const unsigned char *buffer, size_t length,
+  unsigned char *priority, unsigned char *key, int *hasKey
+) {
+  const unsigned char *end = buffer + length;
+
+  while (buffer < end) {
+    if (*buffer != ASCII_ESC) break;
+    if (++buffer == end) break;
+
+    switch (*buffer++) {
+      case 'c':
+        if (buffer < end) buffer += 1;
+        break;
+
+      case 'k':
+        if (buffer < end) {
+          *key = *buffer++;
+          *hasKey = 1;
+        }
+        break;
+
+      case 'p':
+        if (buffer < end) *priority = *buffer++;
+        break;
+    }
+  }
+}
+
+static int
+enqueueSpeechInputMessage (
+  SpeechInputObject *obj, const unsigned char *buffer, size_t length,
+  unsigned char *priority
+) {
+  if (!length) return 1;
+
+  unsigned char key = 0;
+  int hasKey = 0;
+  getSpeechInputProperties(buffer, length, priority, &key, &hasKey);
+
+  SpeechInputMessage *message = NULL;
+
+  if (hasKey) {
+    for (size_t index=0; index<obj->queue.count; index+=1) {
+      SpeechInputMessage *queued = &obj->queue.array[index];
+
+      if (queued->hasKey && (queued->key == key)) {
+        free(queued->bytes);
+        message = queued;
+        break;
+      }
+    }
+  }
+
+  if (!message) {
+    if (obj->queue.count == SPEECH_INPUT_QUEUE_LIMIT) {
+      logMessage(LOG_WARNING, "speech input queue full");
+      return 0;
+    }
+
+    if (obj->queue.count == obj->queue.size) {
+      size_t newSize = obj->queue.size? obj->queue.size<<1: 4;
+      SpeechInputMessage *newArray = realloc(obj->queue.array, ARRAY_SIZE(newArray, newSize));
+
+      if (!newArray) {
+        logMallocError();
+        return 0;
+      }
+
+      obj->queue.array = newArray;
+      obj->queue.size = newSize;
+    }
+
+    message = &obj->queue.array[obj->queue.count++];
+  }
+
+  if (!(message->bytes = malloc(length))) {
+    logMallocError();
+    *message = obj->queue.array[--obj->queue.count];
+    return 0;
+  }
+
+  memcpy(message->bytes, buffer, length);
+  message->length = length;
+  message->sequence = ++obj->queue.sequence;
+  message->priority = *priority;
+  message->key = key;
+  message->hasKey = hasKey;
+
+  scheduleSpeechInputDispatch(obj);
+  return 1;
+}
+
+static void
+flushSpeechInputFragment (SpeechInputObject *obj, unsigned char *priority) {
+  if (obj->fragment.length) {
+    enqueueSpeechInputMessage(obj, obj->fragment.buffer, obj->fragment.length, priority);
+    obj->fragment.length = 0;
+  }
+}
+
+ASYNC_ALARM_CALLBACK(handleSpeechInputFragmentTimeout) {
+  SpeechInputObject *obj = parameters->data;
+
+  asyncDiscardHandle(obj->fragment.alarm);
+  obj->fragment.alarm = NULL;
 
-  return bufferSize;
+  // the writer didn't terminate its message - accept it as is
+  unsigned char priority = '0';
+  flushSpeechInputFragment(obj, &priority);
+}
+
+static void
+cancelSpeechInputFragmentTimeout (SpeechInputObject *obj) {
+  if (obj->fragment.alarm) {
+    asyncCancelRequest(obj->fragment.alarm);
+    obj->fragment.alarm = NULL;
+  }
+}
+
+static int
+appendSpeechInputFragment (SpeechInputObject *obj, const unsigned char *buffer, size_t length) {
+  size_t newLength = obj->fragment.length + length;
+
+  if (newLength > SPEECH_INPUT_FRAGMENT_LIMIT) {
+    logMessage(LOG_WARNING, "speech input message too long");
+    obj->fragment.length = 0;
+    return 0;
+  }
+
+  if (newLength > obj->fragment.size) {
+    size_t newSize = obj->fragment.size? obj->fragment.size: 0X100;
+    while (newSize < newLength) newSize <<= 1;
+
+    unsigned char *newBuffer = realloc(obj->fragment.buffer, newSize);
+    if (!newBuffer) {
+      logMallocError();
+      obj->fragment.length = 0;
+      return 0;
+    }
+
+    obj->fragment.buffer = newBuffer;
+    obj->fragment.size = newSize;
+  }
+
+  memcpy(&obj->fragment.buffer[obj->fragment.length], buffer, length);
+  obj->fragment.length = newLength;
+  return 1;
+}
+
+static inline int
+isSpeechInputTerminator (unsigned char byte) {
+  return (byte == ASCII_LF) || (byte == 0);
+}
+
+static
+NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
+  SpeechInputObject *obj = parameters->data;
+  const unsigned char *buffer = parameters->buffer;
+  const unsigned char *end = buffer + parameters->length;
+
+  cancelSpeechInputFragmentTimeout(obj);
+
+  // Messages written together stay together and in order - one which
+  // doesn't set its own priority gets the priority of the one before it.
+  unsigned char priority = '0';
+
+  while (buffer < end) {
+    const unsigned char *terminator = buffer;
+    while ((terminator < end) && !isSpeechInputTerminator(*terminator)) terminator += 1;
+
+    if (terminator == end) {
+      if (!obj->fragment.discarding) {
+        if (appendSpeechInputFragment(obj, buffer, end-buffer)) {
+          asyncNewRelativeAlarm(&obj->fragment.alarm, SPEECH_INPUT_FRAGMENT_TIMEOUT,
+                                handleSpeechInputFragmentTimeout, obj);
+        } else {
+          // the rest of this message isn't usable on its own
+          obj->fragment.discarding = 1;
+        }
+      }
+
+      break;
+    }
+
+    if (obj->fragment.discarding) {
+      obj->fragment.discarding = 0;
+    } else if (obj->fragment.length) {
+      if (appendSpeechInputFragment(obj, buffer, terminator-buffer)) {
+        flushSpeechInputFragment(obj, &priority);
+      }
+    } else {
+      enqueueSpeechInputMessage(obj, buffer, terminator-buffer, &priority);
+    }
+
+    buffer = terminator + 1;
+  }
+
+  return parameters->length;
 }
 
 SpeechInputObject *
@@ -155,6 +558,19 @@ newSpeechInputObject (const char *name) {
 void
 destroySpeechInputObject (SpeechInputObject *obj) {
   if (obj->pipe) destroyNamedPipeObject(obj->pipe);
+
+  cancelSpeechInputFragmentTimeout(obj);
+  if (obj->fragment.buffer) free(obj->fragment.buffer);
+
+  if (obj->queue.alarm) {
+    asyncCancelRequest(obj->queue.alarm);
+    obj->queue.alarm = NULL;
+  }
+
+  while (obj->queue.count > 0) free(obj->queue.array[--obj->queue.count].bytes);
+  if (obj->queue.array) free(obj->queue.array);
+
+  forgetTunes(obj);
   free(obj);
 }
 #endif /* ENABLE_SPEECH_SUPPORT */
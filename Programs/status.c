@@ -221,7 +221,7 @@ renderStatusField_stateDots (unsigned char *cells) {
            | (ses->displayMode             ? BRL_DOT_2: 0)
            | (prefs.showAttributes         ? BRL_DOT_5: 0)
            | (prefs.alertTunes             ? BRL_DOT_3: 0)
-           | (prefs.brailleTypingMode      ? BRL_DOT_6: 0)
+           | ((prefs.brailleTypingMode == BRL_TYPING_DOTS) ? BRL_DOT_6: 0)
            | (ses->trackScreenCursor       ? BRL_DOT_7: 0)
            | (prefs.brailleKeyboardEnabled ? BRL_DOT_8: 0)
            ;
@@ -286,7 +286,7 @@ renderStatusField_generic (unsigned char *cells) {
   cells[gscAlertTunes] = prefs.alertTunes;
   cells[gscAutorepeat] = prefs.autorepeatEnabled;
   cells[gscAutospeak] = prefs.autospeak;
-  cells[gscBrailleTypingMode] = prefs.brailleTypingMode;
+  cells[gscBrailleTypingMode] = prefs.brailleTypingMode == BRL_TYPING_DOTS;
 }
 
 static void
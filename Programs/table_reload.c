@@ -0,0 +1,451 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "table_reload.h"
+#include "datafile.h"
+#include "get_thread.h"
+
+#if defined(HAVE_SYS_INOTIFY_H) && defined(GOT_PTHREADS)
+#include <sys/inotify.h>
+
+#include "file.h"
+#include "parse.h"
+#include "thread.h"
+#include "async_handle.h"
+#include "async_io.h"
+#include "async_alarm.h"
+#include "async_event.h"
+
+#define TABLE_RELOAD_DELAY 300
+#define TABLE_RELOAD_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+typedef struct {
+  char *path;
+  const char *name;
+  int watch;
+} WatchedFile;
+
+typedef struct TableReloaderStruct TableReloader;
+
+struct TableReloaderStruct {
+  TableReloader *next;
+  const TableReloadMethods *methods;
+  char *path;
+
+  WatchedFile *files;
+  unsigned int fileCount;
+
+  AsyncHandle alarm;
+  AsyncEvent *event;
+
+  struct {
+    pthread_t thread;
+    char *path;
+    void *table;
+    char **files;
+  } compile;
+
+  unsigned char compiling:1;
+  unsigned char changed:1;
+};
+
+static int notifyDescriptor = -1;
+static AsyncHandle notifyMonitor = NULL;
+static TableReloader *tableReloaders = NULL;
+
+static void
+deallocateWatchedFiles (TableReloader *reloader) {
+  if (reloader->files) {
+    while (reloader->fileCount > 0) {
+      free(reloader->files[--reloader->fileCount].path);
+    }
+
+    free(reloader->files);
+    reloader->files = NULL;
+  }
+
+  reloader->fileCount = 0;
+}
+
+static void
+setWatchedFiles (TableReloader *reloader, char **files) {
+  deallocateWatchedFiles(reloader);
+  if (!files) return;
+
+  unsigned int count = 0;
+  while (files[count]) count += 1;
+  if (!count) return;
+
+  if (!(reloader->files = malloc(ARRAY_SIZE(reloader->files, count)))) {
+    logMallocError();
+    return;
+  }
+
+  for (char **file=files; *file; file+=1) {
+    char *directory = getPathDirectory(*file);
+    if (!directory) continue;
+
+    int watch = inotify_add_watch(notifyDescriptor, directory, TABLE_RELOAD_EVENTS);
+
+    if (watch == -1) {
+      logMessage(LOG_WARNING, "table directory watch error: %s: %s",
+                 directory, strerror(errno));
+    }
+
+    free(directory);
+    if (watch == -1) continue;
+
+    char *path = strdup(*file);
+
+    if (!path) {
+      logMallocError();
+      continue;
+    }
+
+    WatchedFile *wf = &reloader->files[reloader->fileCount++];
+    wf->path = path;
+    wf->name = locatePathName(path);
+    wf->watch = watch;
+    logMessage(LOG_DEBUG, "watching %s table file: %s", reloader->methods->name, path);
+  }
+}
+
+static void
+discardCompiledTable (TableReloader *reloader) {
+  if (reloader->compile.table) {
+    reloader->methods->destroy(reloader->compile.table);
+    reloader->compile.table = NULL;
+  }
+
+  if (reloader->compile.files) {
+    deallocateStrings(reloader->compile.files);
+    reloader->compile.files = NULL;
+  }
+
+  if (reloader->compile.path) {
+    free(reloader->compile.path);
+    reloader->compile.path = NULL;
+  }
+}
+
+THREAD_FUNCTION(runTableCompiler) {
+  TableReloader *reloader = argument;
+
+  lockDataFiles();
+    forgetProcessedDataFiles();
+    reloader->compile.table = reloader->methods->compile(reloader->compile.path);
+    if (reloader->compile.table) reloader->compile.files = getProcessedDataFiles();
+  unlockDataFiles();
+
+  asyncSignalEvent(reloader->event, NULL);
+  return NULL;
+}
+
+static void
+startTableCompiler (TableReloader *reloader) {
+  if (!reloader->path) return;
+
+  if (!(reloader->compile.path = strdup(reloader->path))) {
+    logMallocError();
+    return;
+  }
+
+  logMessage(LOG_INFO, "reloading %s table: %s",
+             reloader->methods->name, reloader->compile.path);
+
+  reloader->changed = 0;
+  reloader->compiling = 1;
+
+  int error = createThread("table-reload", &reloader->compile.thread, NULL,
+                           runTableCompiler, reloader);
+
+  if (!error) return;
+  logActionError(error, "table reload thread creation");
+  reloader->compiling = 0;
+  discardCompiledTable(reloader);
+}
+
+ASYNC_EVENT_CALLBACK(handleTableCompiled) {
+  TableReloader *reloader = parameters->eventData;
+
+  pthread_join(reloader->compile.thread, NULL);
+  reloader->compiling = 0;
+
+  if (!reloader->compile.table) {
+    logMessage(LOG_ERR, "%s table not reloaded (keeping previous table): %s",
+               reloader->methods->name, reloader->compile.path);
+  } else if (!reloader->path || (strcmp(reloader->path, reloader->compile.path) != 0)) {
+    logMessage(LOG_DEBUG, "%s table changed while reloading: %s",
+               reloader->methods->name, reloader->compile.path);
+  } else {
+    reloader->methods->install(reloader->compile.table);
+    reloader->compile.table = NULL;
+
+    setWatchedFiles(reloader, reloader->compile.files);
+    logMessage(LOG_INFO, "%s table reloaded: %s",
+               reloader->methods->name, reloader->path);
+  }
+
+  discardCompiledTable(reloader);
+  if (reloader->changed) startTableCompiler(reloader);
+}
+
+ASYNC_ALARM_CALLBACK(handleTableReloadDelay) {
+  TableReloader *reloader = parameters->data;
+
+  asyncDiscardHandle(reloader->alarm);
+  reloader->alarm = NULL;
+
+  if (reloader->compiling) {
+    reloader->changed = 1;
+  } else {
+    startTableCompiler(reloader);
+  }
+}
+
+static void
+scheduleTableReload (TableReloader *reloader) {
+  if (reloader->alarm) {
+    asyncResetAlarmIn(reloader->alarm, TABLE_RELOAD_DELAY);
+  } else {
+    asyncNewRelativeAlarm(&reloader->alarm, TABLE_RELOAD_DELAY,
+                          handleTableReloadDelay, reloader);
+  }
+}
+
+static void
+handleNotifyEvent (const struct inotify_event *event) {
+  if (!event->len) return;
+
+  for (TableReloader *reloader=tableReloaders; reloader; reloader=reloader->next) {
+    const WatchedFile *file = reloader->files;
+    const WatchedFile *end = file + reloader->fileCount;
+
+    while (file < end) {
+      if ((file->watch == event->wd) && (strcmp(file->name, event->name) == 0)) {
+        logMessage(LOG_DEBUG, "%s table file changed: %s",
+                   reloader->methods->name, file->path);
+
+        scheduleTableReload(reloader);
+        break;
+      }
+
+      file += 1;
+    }
+  }
+}
+
+ASYNC_INPUT_CALLBACK(handleNotifyInput) {
+  if (parameters->error) {
+    logMessage(LOG_WARNING, "table watch input error: %s", strerror(parameters->error));
+  } else if (parameters->end) {
+    logMessage(LOG_WARNING, "table watch end-of-file");
+  } else {
+    const unsigned char *byte = parameters->buffer;
+    const unsigned char *end = byte + parameters->length;
+
+    while ((end - byte) >= sizeof(struct inotify_event)) {
+      const struct inotify_event *event = (const void *)byte;
+      size_t size = sizeof(*event) + event->len;
+
+      if ((end - byte) < size) break;
+      handleNotifyEvent(event);
+      byte += size;
+    }
+
+    return byte - (const unsigned char *)parameters->buffer;
+  }
+
+  asyncDiscardHandle(notifyMonitor);
+  notifyMonitor = NULL;
+  return 0;
+}
+
+static TableReloader *
+getTableReloader (const TableReloadMethods *methods) {
+  TableReloader *reloader = tableReloaders;
+
+  while (reloader) {
+    if (reloader->methods == methods) return reloader;
+    reloader = reloader->next;
+  }
+
+  if ((reloader = malloc(sizeof(*reloader)))) {
+    memset(reloader, 0, sizeof(*reloader));
+    reloader->methods = methods;
+
+    if ((reloader->event = asyncNewEvent(handleTableCompiled, reloader))) {
+      reloader->next = tableReloaders;
+      tableReloaders = reloader;
+      return reloader;
+    }
+
+    free(reloader);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static void
+destroyTableReloader (TableReloader *reloader) {
+  if (reloader->compiling) {
+    pthread_join(reloader->compile.thread, NULL);
+    reloader->compiling = 0;
+  }
+
+  discardCompiledTable(reloader);
+  if (reloader->alarm) asyncCancelRequest(reloader->alarm);
+  asyncDiscardEvent(reloader->event);
+
+  deallocateWatchedFiles(reloader);
+  if (reloader->path) free(reloader->path);
+  free(reloader);
+}
+
+void
+beginTableLoad (void) {
+  lockDataFiles();
+  forgetProcessedDataFiles();
+}
+
+void
+endTableLoad (const TableReloadMethods *methods, const char *path) {
+  if (notifyDescriptor != -1) {
+    TableReloader *reloader = getTableReloader(methods);
+
+    if (reloader) {
+      if (reloader->path) {
+        free(reloader->path);
+        reloader->path = NULL;
+      }
+
+      if (path) {
+        if ((reloader->path = strdup(path))) {
+          char **files = getProcessedDataFiles();
+
+          setWatchedFiles(reloader, files);
+          if (files) deallocateStrings(files);
+        } else {
+          logMallocError();
+        }
+      }
+
+      if (!reloader->path) deallocateWatchedFiles(reloader);
+    }
+  }
+
+  unlockDataFiles();
+}
+
+void
+cancelTableLoad (void) {
+  unlockDataFiles();
+}
+
+void
+forgetTableLoad (const TableReloadMethods *methods) {
+  TableReloader **reloader = &tableReloaders;
+
+  while (*reloader) {
+    if ((*reloader)->methods == methods) {
+      TableReloader *forgotten = *reloader;
+      *reloader = forgotten->next;
+      destroyTableReloader(forgotten);
+      return;
+    }
+
+    reloader = &(*reloader)->next;
+  }
+}
+
+int
+startTableReloading (void) {
+  if (notifyDescriptor != -1) return 1;
+
+  if ((notifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) != -1) {
+    if (asyncReadFile(&notifyMonitor, notifyDescriptor, 0X1000, handleNotifyInput, NULL)) {
+      logMessage(LOG_DEBUG, "table reloading started");
+      return 1;
+    }
+
+    close(notifyDescriptor);
+    notifyDescriptor = -1;
+  } else {
+    logSystemError("inotify_init1");
+  }
+
+  return 0;
+}
+
+void
+stopTableReloading (void) {
+  while (tableReloaders) {
+    TableReloader *reloader = tableReloaders;
+    tableReloaders = reloader->next;
+    destroyTableReloader(reloader);
+  }
+
+  if (notifyMonitor) {
+    asyncCancelRequest(notifyMonitor);
+    notifyMonitor = NULL;
+  }
+
+  if (notifyDescriptor != -1) {
+    close(notifyDescriptor);
+    notifyDescriptor = -1;
+  }
+}
+
+#else /* table reloading */
+void
+beginTableLoad (void) {
+  lockDataFiles();
+  forgetProcessedDataFiles();
+}
+
+void
+endTableLoad (const TableReloadMethods *methods, const char *path) {
+  unlockDataFiles();
+}
+
+void
+cancelTableLoad (void) {
+  unlockDataFiles();
+}
+
+void
+forgetTableLoad (const TableReloadMethods *methods) {
+}
+
+int
+startTableReloading (void) {
+  logMessage(LOG_WARNING, "table reloading not supported on this platform");
+  return 0;
+}
+
+void
+stopTableReloading (void) {
+}
+#endif /* table reloading */
@@ -0,0 +1,45 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2023 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_TABLE_RELOAD
+#define BRLTTY_INCLUDED_TABLE_RELOAD
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef struct {
+  const char *name;
+  void *(*compile) (const char *path);
+  void (*install) (void *table);
+  void (*destroy) (void *table);
+} TableReloadMethods;
+
+extern int startTableReloading (void);
+extern void stopTableReloading (void);
+
+extern void beginTableLoad (void);
+extern void endTableLoad (const TableReloadMethods *methods, const char *path);
+extern void cancelTableLoad (void);
+extern void forgetTableLoad (const TableReloadMethods *methods);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_TABLE_RELOAD */
@@ -263,6 +263,11 @@ getInternalContractionTableBytes (void) {
   return NULL;
 }
 
+int
+prepareContractionTableCharacters (ContractionTable *table) {
+  return 1;
+}
+
 const ContractionTableTranslationMethods *
 getContractionTableTranslationMethods_native (void) {
   return NULL;
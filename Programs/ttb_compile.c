@@ -321,26 +321,25 @@ finishTextTableData (TextTableData *ttd) {
 
 TextTableData *
 processTextTableLines (FILE *stream, const char *name, DataOperandsProcessor *processOperands) {
-  if (setTableDataVariables(TEXT_TABLE_EXTENSION, TEXT_SUBTABLE_EXTENSION)) {
-    TextTableData *ttd;
+  TextTableData *ttd = NULL;
+  lockDataFiles();
 
+  if (setTableDataVariables(TEXT_TABLE_EXTENSION, TEXT_SUBTABLE_EXTENSION)) {
     if ((ttd = newTextTableData())) {
       const DataFileParameters parameters = {
         .processOperands = processOperands,
         .data = ttd
       };
 
-      if (processDataStream(NULL, stream, name, &parameters)) {
-        if (finishTextTableData(ttd)) {
-          return ttd;
-        }
+      if (!processDataStream(NULL, stream, name, &parameters) || !finishTextTableData(ttd)) {
+        destroyTextTableData(ttd);
+        ttd = NULL;
       }
-
-      destroyTextTableData(ttd);
     }
   }
 
-  return NULL;
+  unlockDataFiles();
+  return ttd;
 }
 
 TextTable *
@@ -251,6 +251,7 @@ wchar_t
 convertInputToCharacter (unsigned char dots) {
   switch (prefs.brailleTypingMode) {
     case BRL_TYPING_TEXT:
+    case BRL_TYPING_CONTRACTED:
       return convertDotsToCharacter(textTable, dots);
 
     default:
@@ -261,6 +262,17 @@ convertInputToCharacter (unsigned char dots) {
   }
 }
 
+void
+installTextTable (TextTable *table) {
+  TextTable *oldTable = textTable;
+
+  lockTextTable();
+    textTable = table;
+  unlockTextTable();
+
+  destroyTextTable(oldTable);
+}
+
 int
 replaceTextTable (const char *directory, const char *name) {
   TextTable *newTable = NULL;
@@ -282,13 +294,7 @@ replaceTextTable (const char *directory, const char *name) {
   }
 
   if (newTable) {
-    TextTable *oldTable = textTable;
-
-    lockTextTable();
-      textTable = newTable;
-    unlockTextTable();
-
-    destroyTextTable(oldTable);
+    installTextTable(newTable);
     return 1;
   }
 
@@ -88,6 +88,10 @@ openTuneDevice (void) {
 static const NoteElement *currentlyPlayingNotes = NULL;
 static const ToneElement *currentlyPlayingTones = NULL;
 
+// incremented (by the main thread) each time a tune is to be interrupted -
+// a tune stops (or isn't started) once it no longer matches its request
+static volatile unsigned int tuneGeneration = 0;
+
 typedef unsigned char TuneSynchronizationMonitor;
 
 typedef enum {
@@ -100,6 +104,7 @@ typedef enum {
 
 typedef struct {
   TuneRequestType type;
+  unsigned int generation;
 
   union {
     struct {
@@ -135,8 +140,9 @@ handleTuneRequest_setDevice (const NoteMethods *methods) {
 }
 
 static void
-handleTuneRequest_playNotes (const NoteElement *tune) {
+handleTuneRequest_playNotes (const NoteElement *tune, unsigned int generation) {
   while (tune->duration) {
+    if (generation != tuneGeneration) break;
     if (!openTuneDevice()) return;
     if (!noteMethods->note(noteDevice, tune->duration, tune->note)) return;
     tune += 1;
@@ -146,8 +152,9 @@ handleTuneRequest_playNotes (const NoteElement *tune) {
 }
 
 static void
-handleTuneRequest_playTones (const ToneElement *tune) {
+handleTuneRequest_playTones (const ToneElement *tune, unsigned int generation) {
   while (tune->duration) {
+    if (generation != tuneGeneration) break;
     if (!openTuneDevice()) return;
     if (!noteMethods->tone(noteDevice, tune->duration, tune->frequency)) return;
     tune += 1;
@@ -179,7 +186,7 @@ handleTuneRequest (TuneRequest *req) {
         TunePlayOptions options = req->parameters.playNotes.options;
 
         currentlyPlayingNotes = tune;
-        handleTuneRequest_playNotes(tune);
+        handleTuneRequest_playNotes(tune, req->generation);
         currentlyPlayingNotes = NULL;
 
         if (options & TPO_FREE) free((void *)tune);
@@ -191,7 +198,7 @@ handleTuneRequest (TuneRequest *req) {
         TunePlayOptions options = req->parameters.playTones.options;
 
         currentlyPlayingTones = tune;
-        handleTuneRequest_playTones(tune);
+        handleTuneRequest_playTones(tune, req->generation);
         currentlyPlayingTones = NULL;
 
         if (options & TPO_FREE) free((void *)tune);
@@ -404,6 +411,10 @@ exitTunes (void *data) {
   tuneThreadState = TUNE_THREAD_NONE;
 #endif /* GOT_PTHREADS */
 
+#ifdef HAVE_PCM_SUPPORT
+  releasePcmTones();
+#endif /* HAVE_PCM_SUPPORT */
+
   tuneInitialized = 0;
 }
  
@@ -472,12 +483,19 @@ tuneSetDevice (TuneDevice device) {
   return 1;
 }
 
+static void
+setTuneGeneration (TuneRequest *req, TunePlayOptions options) {
+  if (options & TPO_INTERRUPT) tuneGeneration += 1;
+  req->generation = tuneGeneration;
+}
+
 void
 tunePlayNotes (const NoteElement *tune, TunePlayOptions options) {
-  if (tune != currentlyPlayingNotes) {
+  if ((options & TPO_INTERRUPT) || (tune != currentlyPlayingNotes)) {
     TuneRequest *req;
 
     if ((req = newTuneRequest(TUNE_REQ_PLAY_NOTES))) {
+      setTuneGeneration(req, options);
       req->parameters.playNotes.tune = tune;
       req->parameters.playNotes.options = options;
       if (!sendTuneRequest(req)) free(req);
@@ -487,10 +505,11 @@ tunePlayNotes (const NoteElement *tune, TunePlayOptions options) {
 
 void
 tunePlayTones (const ToneElement *tune, TunePlayOptions options) {
-  if (tune != currentlyPlayingTones) {
+  if ((options & TPO_INTERRUPT) || (tune != currentlyPlayingTones)) {
     TuneRequest *req;
 
     if ((req = newTuneRequest(TUNE_REQ_PLAY_TONES))) {
+      setTuneGeneration(req, options);
       req->parameters.playTones.tune = tune;
       req->parameters.playTones.options = options;
       if (!sendTuneRequest(req)) free(req);
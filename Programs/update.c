@@ -26,6 +26,7 @@
 #include "alert.h"
 #include "report.h"
 #include "strfmt.h"
+#include "scratch.h"
 #include "update.h"
 #include "async_handle.h"
 #include "async_alarm.h"
@@ -34,6 +35,7 @@
 #include "charset.h"
 #include "ttb.h"
 #include "atb.h"
+#include "brl_utils.h"
 #include "brl_dots.h"
 #include "spk.h"
 #include "scr.h"
@@ -46,26 +48,44 @@
 #include "api_control.h"
 #include "core.h"
 
-static void
-overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
-  unsigned char dots;
-
+static unsigned char
+getAttributesUnderlineDots (unsigned char attributes) {
   switch (attributes) {
     case SCR_COLOUR_FG_DARK_GREY | SCR_COLOUR_BG_BLACK:
     case SCR_COLOUR_FG_LIGHT_GREY | SCR_COLOUR_BG_BLACK:
     case SCR_COLOUR_FG_LIGHT_GREY | SCR_COLOUR_BG_BLUE:
     case SCR_COLOUR_FG_BLACK | SCR_COLOUR_BG_CYAN:
-      return;
+      return 0;
 
     case SCR_COLOUR_FG_BLACK | SCR_COLOUR_BG_LIGHT_GREY:
-      dots = BRL_DOT_7 | BRL_DOT_8;
-      break;
+      return BRL_DOT_7 | BRL_DOT_8;
 
     case SCR_COLOUR_FG_WHITE | SCR_COLOUR_BG_BLACK:
     default:
-      dots = BRL_DOT_8;
-      break;
+      return BRL_DOT_8;
   }
+}
+
+static const unsigned char *
+getAttributesUnderlineMap (void) {
+  static unsigned char map[0X100];
+  static unsigned char made = 0;
+
+  if (!made) {
+    for (unsigned int attributes=0; attributes<ARRAY_COUNT(map); attributes+=1) {
+      map[attributes] = getAttributesUnderlineDots(attributes);
+    }
+
+    made = 1;
+  }
+
+  return map;
+}
+
+static void
+overlayAttributesUnderline (unsigned char *cell, unsigned char attributes) {
+  unsigned char dots = getAttributesUnderlineMap()[attributes];
+  if (!dots) return;
 
   {
     BlinkDescriptor *blink = &attributesUnderlineBlinkDescriptor;
@@ -128,12 +148,8 @@ readBrailleWindow (ScreenCharacter *characters, size_t count) {
   }
 }
 
-typedef void ScreenCharacterTranslator (
-  const ScreenCharacter *character, unsigned char *cell, wchar_t *text
-);
-
 static void
-translateScreenCharacter_text (
+translateScreenCharacter (
   const ScreenCharacter *character, unsigned char *cell, wchar_t *text
 ) {
   *cell = convertCharacterToDots(textTable, character->text);
@@ -165,21 +181,12 @@ translateScreenCharacter_text (
   }
 }
 
-static void
-translateScreenCharacter_attributes (
-  const ScreenCharacter *character, unsigned char *cell, wchar_t *text
-) {
-  *text = UNICODE_BRAILLE_ROW | (*cell = convertAttributesToDots(attributesTable, character->attributes));
-}
-
 static void
 translateBrailleWindow (
   const ScreenCharacter *characters, wchar_t *textBuffer
 ) {
-  ScreenCharacterTranslator *translateScreenCharacter =
-    ses->displayMode?
-    translateScreenCharacter_attributes:
-    translateScreenCharacter_text;
+  const unsigned char *attributesToDots =
+    ses->displayMode? getAttributesToDotsMap(attributesTable): NULL;
 
   for (unsigned int row=0; row<brl.textRows; row+=1) {
     const ScreenCharacter *character = &characters[row * textCount];
@@ -189,8 +196,16 @@ translateBrailleWindow (
     unsigned char *cell = &brl.buffer[start];
     wchar_t *text = &textBuffer[start];
 
-    while (character < end) {
-      translateScreenCharacter(character++, cell++, text++);
+    if (attributesToDots) {
+      while (character < end) {
+        unsigned char dots = attributesToDots[character++->attributes];
+        *cell++ = dots;
+        *text++ = UNICODE_BRAILLE_ROW | dots;
+      }
+    } else {
+      while (character < end) {
+        translateScreenCharacter(character++, cell++, text++);
+      }
     }
   }
 }
@@ -211,6 +226,11 @@ constructContractionCache (ContractionCache *cache) {
   cache->offsets.array = NULL;
   cache->offsets.size = 0;
   cache->offsets.count = 0;
+
+  cache->resync.array = NULL;
+  cache->resync.size = 0;
+  cache->resync.count = 0;
+  cache->resync.table = NULL;
 }
 
 static void
@@ -282,10 +302,18 @@ contractScreenRow (BrailleRowDescriptor *brd, unsigned int screenRow, unsigned c
   int isCursorRow = scr.posy == ses->winy;
 
   int inputLength = scr.cols - ses->winx;
-  wchar_t inputText[inputLength];
   int outputLength = cellCount;
 
-  ScreenCharacter inputCharacters[inputLength];
+  wchar_t *inputText;
+  ScreenCharacter *inputCharacters;
+
+  if (!(allocateScratchArray(inputText, inputLength) &&
+        allocateScratchArray(inputCharacters, inputLength))) {
+    memset(cells, 0, cellCount);
+    brd->contracted.length = inputLength;
+    return 1;
+  }
+
   readScreen(ses->winx, screenRow, inputLength, 1, inputCharacters);
 
   for (int i=0; i<inputLength; i+=1) {
@@ -347,7 +375,12 @@ contractScreenRow (BrailleRowDescriptor *brd, unsigned int screenRow, unsigned c
   if (ses->displayMode || prefs.showAttributes) {
     int outputOffset = 0;
     unsigned char attributes = 0;
-    unsigned char attributesBuffer[outputLength];
+    unsigned char *attributesBuffer;
+
+    if (!allocateScratchArray(attributesBuffer, outputLength)) {
+      brd->contracted.length = inputLength;
+      return 1;
+    }
 
     for (int inputOffset=0; inputOffset<inputLength; inputOffset+=1) {
       int offset = offsetsArray[inputOffset];
@@ -365,8 +398,10 @@ contractScreenRow (BrailleRowDescriptor *brd, unsigned int screenRow, unsigned c
     }
 
     if (ses->displayMode) {
+      const unsigned char *attributesToDots = getAttributesToDotsMap(attributesTable);
+
       for (unsigned int i=0; i<outputLength; i+=1) {
-        cells[i] = convertAttributesToDots(attributesTable, attributesBuffer[i]);
+        cells[i] = attributesToDots[attributesBuffer[i]];
       }
     } else {
       for (unsigned int i=0; i<outputLength; i+=1) {
@@ -620,7 +655,8 @@ getBrailleVariantCharacter (void) {
 static inline char
 getBrailleKeyboardCharacter (void) {
   if (!prefs.brailleKeyboardEnabled) return 'd';
-  if (prefs.brailleTypingMode) return 'b';
+  if (prefs.brailleTypingMode == BRL_TYPING_DOTS) return 'b';
+  if (prefs.brailleTypingMode == BRL_TYPING_CONTRACTED) return 'c';
   return ' ';
 }
 
@@ -760,7 +796,8 @@ checkScreenScroll (int track) {
   int newScreen = scr.number;
   int newWidth = scr.cols;
   size_t newCount = newWidth * rowCount;
-  ScreenCharacter newCharacters[newCount];
+  ScreenCharacter *newCharacters;
+  if (!allocateScratchArray(newCharacters, newCount)) return;
 
   int newRow = ses->winy;
   int newTop = newRow - (rowCount - 1);
@@ -818,7 +855,12 @@ autospeak (AutospeakMode mode) {
   int newX = scr.posx;
   int newY = scr.posy;
   int newWidth = scr.cols;
-  ScreenCharacter newCharacters[newWidth];
+
+  ScratchMark scratchMark;
+  getScratchMark(&scratchMark);
+
+  ScreenCharacter *newCharacters;
+  if (!allocateScratchArray(newCharacters, newWidth)) return;
 
   readScreenRow(ses->winy, newWidth, newCharacters);
 
@@ -852,6 +894,7 @@ autospeak (AutospeakMode mode) {
 	  if ((newX == oldX) && !cursorAssumedStable) {
 	    scheduleUpdate("autospeak cursor stability check");
 	    cursorAssumedStable = 1;
+	    releaseScratch(&scratchMark);
 	    return;
 	  }
 
@@ -1035,6 +1078,8 @@ autospeak (AutospeakMode mode) {
     oldWidth = newWidth;
     cursorAssumedStable = 0;
   }
+
+  releaseScratch(&scratchMark);
 }
 
 void
@@ -1078,9 +1123,30 @@ writeBrailleWindow (BrailleDisplay *brl, const wchar_t *text, unsigned char qual
   return braille->writeWindow(brl, text);
 }
 
+static void
+logScratchUsage (const ScratchStatistics *before) {
+  ScratchStatistics after;
+  getScratchStatistics(&after);
+
+  logMessage(LOG_CATEGORY(UPDATE_EVENTS),
+             "scratch: Allocations:%lu Blocks:%lu HighWater:%"PRIsize " Capacity:%"PRIsize,
+             (after.allocations - before->allocations),
+             (after.blockAllocations - before->blockAllocations),
+             after.highWater, after.capacity);
+}
+
 static void
 doUpdate (void) {
   logMessage(LOG_CATEGORY(UPDATE_EVENTS), "starting");
+
+  // an update can run while a caller further up the stack (waiting for
+  // something) still holds scratch space, so only release what it takes
+  ScratchMark scratchMark;
+  getScratchMark(&scratchMark);
+
+  ScratchStatistics scratchStatistics;
+  getScratchStatistics(&scratchStatistics);
+
   unrequireAllBlinkDescriptors();
   refreshScreen();
   updateSessionAttributes();
@@ -1204,13 +1270,13 @@ doUpdate (void) {
   if (!brl.isOffline && canBraille()) {
     api.claimDriver();
 
+    const unsigned int windowLength = brl.textColumns * brl.textRows;
+    wchar_t *textBuffer;
+
     if (infoMode) {
       if (!renderInfoLine()) brl.hasFailed = 1;
-    } else {
-      const unsigned int windowLength = brl.textColumns * brl.textRows;
+    } else if (allocateScratchArray(textBuffer, windowLength)) {
       memset(brl.buffer, 0, windowLength);
-
-      wchar_t textBuffer[windowLength];
       wmemset(textBuffer, WC_C(' '), windowLength);
 
       unsigned int textLength = textCount * brl.textRows;
@@ -1223,9 +1289,14 @@ doUpdate (void) {
           if (generated) break;
         }
       } else {
-        ScreenCharacter characters[textLength];
-        readBrailleWindow(characters, ARRAY_COUNT(characters));
-        translateBrailleWindow(characters, textBuffer);
+        ScreenCharacter *characters;
+
+        if (allocateScratchArray(characters, textLength)) {
+          readBrailleWindow(characters, textLength);
+          translateBrailleWindow(characters, textBuffer);
+        } else {
+          logMessage(LOG_WARNING, "no scratch space for the screen characters");
+        }
       }
 
       if ((brl.cursor = getScreenCursorPosition(scr.posx, scr.posy)) != BRL_NO_CURSOR) {
@@ -1271,12 +1342,17 @@ doUpdate (void) {
       }
 
       if (!(writeStatusCells() && writeBrailleWindow(&brl, textBuffer, scr.quality))) brl.hasFailed = 1;
+    } else {
+      logMessage(LOG_WARNING, "no scratch space for the braille window");
+      brl.hasFailed = 1;
     }
 
     api.releaseDriver();
   }
 
   resetAllBlinkDescriptors();
+  if (LOG_CATEGORY_FLAG(UPDATE_EVENTS)) logScratchUsage(&scratchStatistics);
+  releaseScratch(&scratchMark);
   logMessage(LOG_CATEGORY(UPDATE_EVENTS), "finished");
 }
 
@@ -1350,8 +1426,7 @@ ASYNC_ALARM_CALLBACK(handleUpdateAlarm) {
     }
   }
 
-  setUpdateDelay(MAX((brl.writeDelay + 1), UPDATE_SCHEDULE_DELAY));
-  brl.writeDelay = 0;
+  setUpdateDelay(MAX((getBrailleOutputDelay(&brl) + 1), UPDATE_SCHEDULE_DELAY));
 
   resumeUpdates(0);
 }
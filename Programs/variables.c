@@ -190,6 +190,30 @@ listVariables (VariableNestingLevel *from) {
   listVariableLine("end variable listing");
 }
 
+typedef struct {
+  VariableHandler *handleVariable;
+  void *data;
+} VisitVariableData;
+
+static int
+visitVariable (void *item, void *data) {
+  const Variable *variable = item;
+  const VisitVariableData *vvd = data;
+
+  vvd->handleVariable(variable, vvd->data);
+  return 0;
+}
+
+void
+visitVariables (VariableNestingLevel *vnl, VariableHandler *handleVariable, void *data) {
+  VisitVariableData vvd = {
+    .handleVariable = handleVariable,
+    .data = data
+  };
+
+  processQueue(vnl->variables, visitVariable, &vvd);
+}
+
 static int
 testVariableName (const void *item, void *data) {
   const Variable *variable = item;